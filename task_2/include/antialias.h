@@ -0,0 +1,99 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "thread_pool.h"
+#include "camera.h"
+#include "framebuffer.h"
+#include "world.h"
+#include "renderer.h"
+
+namespace rt::render {
+
+// Adaptive supersampling of the pixels that differ strongly from a neighbour
+struct AntialiasSettings {
+    // a refined pixel gets gridSize x gridSize extra samples, one per cell of a grid over it
+    int gridSize = 3;
+    // pixels whose colour differs by more than this from a neighbour in any channel are refined,
+    // colours are clamped to [0, 1] before, as for 8-bit output
+    float threshold = 0.1f;
+    // at most budget extra camera rays per pixel of the image on average,
+    // the pixels with the largest difference are refined first
+    float budget = 0.5f;
+};
+
+struct AntialiasStatistics {
+    size_t        candidatePixels = 0;  // pixels above the threshold
+    size_t        refinedPixels   = 0;  // pixels refined within the budget
+    WorkerContext rays;                 // the rays of the extra samples, camera rays as primary
+};
+
+// the largest difference in any channel between each pixel and its 4 neighbours, row by row
+std::vector<float> pixelContrast(const fb::MemoryFramebuffer& image);
+
+// the indices y * width + x of the pixels to refine, the pixels above the threshold with the
+// largest contrast that fit into the budget, in ascending order
+std::vector<uint32_t> selectPixels(const std::vector<float>& contrast, int width, int height,
+                                   const AntialiasSettings& settings, size_t& candidatePixels);
+
+// the offset from the pixel centre of the sample in the cell column, row of the grid over the
+// pixel, jittered within the cell. The jitter only depends on the pixel and the cell, so the
+// image is the same for any number of threads.
+void sampleOffset(int x, int y, int column, int row, int gridSize, float& offsetX,
+                  float& offsetY);
+
+// Refines an image rendered with one sample per pixel through the pixel centres, e.g. by
+// renderImage: the pixels selected by selectPixels are set to the mean of their first sample and
+// gridSize x gridSize stratified samples. Edges and other high contrast pixels are smoothed,
+// while uniform regions cost no extra rays.
+template <typename Scene>
+AntialiasStatistics refineAdaptive(parallel::ThreadPool& pool, const camera::Camera& camera,
+                                   const Scene&                          scene,
+                                   const std::vector<world::PointLight>& lights,
+                                   fb::MemoryFramebuffer&                image,
+                                   const AntialiasSettings&              settings,
+                                   const TraceSettings&                  traceSettings = {}) {
+    AntialiasStatistics statistics;
+    if (settings.gridSize < 1) {
+        return statistics;
+    }
+    const int  width    = image.width();
+    const auto contrast = pixelContrast(image);
+    const auto pixels   = selectPixels(contrast, width, image.height(), settings,
+                                       statistics.candidatePixels);
+    statistics.refinedPixels = pixels.size();
+
+    // the samples only read the scene and each task writes its own pixels
+    constexpr size_t PIXELS_PER_TASK = 64;
+    const size_t     tasks    = (pixels.size() + PIXELS_PER_TASK - 1) / PIXELS_PER_TASK;
+    const int        gridSize = settings.gridSize;
+
+    std::vector<WorkerContext> contexts(pool.size());
+    pool.parallelFor(tasks, [&](size_t task, unsigned worker) {
+        WorkerContext& context = contexts[worker];
+        const size_t   end     = std::min(pixels.size(), (task + 1) * PIXELS_PER_TASK);
+        for (size_t i = task * PIXELS_PER_TASK; i < end; i++) {
+            const int x   = static_cast<int>(pixels[i] % static_cast<uint32_t>(width));
+            const int y   = static_cast<int>(pixels[i] / static_cast<uint32_t>(width));
+            Vector3df sum = image.getPixel(x, y);
+            for (int row = 0; row < gridSize; row++) {
+                for (int column = 0; column < gridSize; column++) {
+                    float offsetX, offsetY;
+                    sampleOffset(x, y, column, row, gridSize, offsetX, offsetY);
+                    const Vector3df sample = traceRay(camera.getRay(x, y, offsetX, offsetY),
+                                                      scene, lights, traceSettings, context);
+                    for (size_t k = 0; k < 3; k++) {
+                        sum.vector[k] += sample.vector[k];
+                    }
+                }
+            }
+            image.setPixel(x, y, (1.0f / static_cast<float>(gridSize * gridSize + 1)) * sum);
+        }
+    });
+    statistics.rays = mergeContexts(contexts);
+    return statistics;
+}
+
+}  // namespace rt::render
@@ -0,0 +1,492 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "math.h"
+#include "geometry.h"
+#include "packet.h"
+#include "stats.h"
+
+namespace rt::accel {
+
+// A node of the flattened bounding volume hierarchy (32 bytes, two nodes per cache line).
+// Inner nodes (count == 0) store the index of their left child in first, the right child
+// is always stored directly after the left child.
+// Leaf nodes store the range [first, first + count) of their primitives, all primitives of a
+// leaf belong to the same group.
+struct BvhNode {
+    Vector3df lower;
+    uint32_t  first = 0;
+    Vector3df upper;
+    uint16_t  count = 0;
+    uint16_t  group = 0;
+
+    bool isLeaf() const noexcept {
+        return count > 0;
+    }
+};
+
+// Slab test of the ray against the bounds of a node, limited to the interval [0, tMax].
+// tEntry is set to the distance at which the ray enters the bounds.
+inline bool intersectsNode(const BvhNode& node, const Ray3df& ray,
+                           const Vector3df& inverseDirection, float tMax, float& tEntry) {
+    float tNear = 0.0f;
+    float tFar  = tMax;
+    for (size_t i = 0; i < 3; i++) {
+        const float t0 = (node.lower.vector[i] - ray.origin.vector[i]) * inverseDirection.vector[i];
+        const float t1 = (node.upper.vector[i] - ray.origin.vector[i]) * inverseDirection.vector[i];
+        tNear          = std::max(tNear, std::min(t0, t1));
+        tFar           = std::min(tFar, std::max(t0, t1));
+    }
+    tEntry = tNear;
+    return tNear <= tFar;
+}
+
+inline Vector3df inverseDirection(const Vector3df& direction) {
+    return Vector3df{1.0f / direction.vector[0], 1.0f / direction.vector[1],
+                     1.0f / direction.vector[2]};
+}
+
+// A bounding volume hierarchy built with the surface area heuristic (SAH).
+// The hierarchy only knows the bounds of its primitives, intersecting the primitives themselves
+// is left to the owner of the primitives, which passes a callback for the leaves to the traversal.
+class Bvh {
+  public:
+    static constexpr uint32_t MAX_LEAF_SIZE = 4;
+    static constexpr uint32_t BIN_COUNT     = 16;
+    static constexpr size_t   STACK_SIZE    = 64;
+
+    // relative costs of a traversal step and a primitive intersection used by the SAH
+    static constexpr float TRAVERSAL_COST    = 1.0f;
+    static constexpr float INTERSECTION_COST = 1.0f;
+
+    // parameters of the construction, the defaults suit scenes of objects of mixed types
+    struct Settings {
+        uint32_t maxLeafSize = MAX_LEAF_SIZE;  // at most 65535
+        // higher costs of a traversal step give larger leaves and fewer nodes
+        float traversalCost = TRAVERSAL_COST;
+    };
+
+    Bvh() = default;
+
+    // Builds the hierarchy over the primitives with the given bounds.
+    // Primitives may be assigned to groups (e.g. their type), then each leaf only contains
+    // primitives of one group and its range counts only the primitives of that group.
+    // Without groups all primitives belong to group 0.
+    explicit Bvh(const std::vector<AABB3df>&  primitiveBounds,
+                 const std::vector<uint16_t>& primitiveGroups = {});
+
+    Bvh(const std::vector<AABB3df>& primitiveBounds, const std::vector<uint16_t>& primitiveGroups,
+        const Settings& settings);
+
+    // the primitive indices in leaf order, owners of the primitives have to store the primitives
+    // of each group in this order, so the ranges of the leaves index into them
+    const std::vector<uint32_t>& primitiveIndices() const {
+        return _indices;
+    }
+
+    // frees the primitive indices once the owner stores its primitives in leaf order
+    void releasePrimitiveIndices() {
+        _indices = std::vector<uint32_t>();
+    }
+
+    // A hierarchy over nodes stored elsewhere, e.g. in a mapped file, as returned by nodes().
+    // The nodes are not copied and have to outlive the hierarchy, it can not be updated.
+    // They are checked in one pass, so damaged nodes can not make the traversal read outside
+    // the nodes, the primitiveCount primitives or its stack.
+    // throws std::runtime_error if a node is out of order or out of range or the hierarchy is
+    // deeper than the traversal stack
+    static Bvh view(std::span<const BvhNode> nodes, size_t primitiveCount);
+
+    std::span<const BvhNode> nodes() const {
+        return _external.empty() ? std::span<const BvhNode>(_nodes) : _external;
+    }
+
+    bool empty() const {
+        return nodes().empty();
+    }
+
+    // Finds the closest intersection along the ray with 0 < t < tMax.
+    // intersectLeaf(leaf, tMax) tests the primitives of a leaf node, lowers tMax if it finds
+    // a closer intersection and returns true iff it did so.
+    // returns true iff any leaf reported an intersection, tMax is then the closest distance
+    template <typename LeafFunction>
+    bool intersect(const Ray3df& ray, float& tMax, LeafFunction&& intersectLeaf) const;
+
+    // Finds the closest intersection of each ray of the packet with 0 < t < packet.tMax[i].
+    // The rays share the traversal: a node is visited once for all rays hitting it. Once a subtree
+    // is only hit by a few rays (1 / SINGLE_RAY_FRACTION of the packet), these are traversed one
+    // by one from there.
+    // intersectLeaf(leaf, i, tMax) tests the primitives of a leaf for ray i of the packet,
+    // as the leaf function of intersect for single rays.
+    // returns the mask of the rays with an intersection, packet.tMax is their closest distance
+    template <typename LeafFunction>
+    uint64_t intersect(RayPacket& packet, LeafFunction&& intersectLeaf) const;
+
+    static constexpr uint32_t SINGLE_RAY_FRACTION = 8;
+
+    // Returns true iff any primitive intersects the ray with 0 < t < tMax, e.g. for shadow rays.
+    // Stops at the first leaf for which occludedLeaf(leaf) returns true, the leaves are not
+    // visited in any particular order.
+    template <typename LeafFunction>
+    bool occluded(const Ray3df& ray, float tMax, LeafFunction&& occludedLeaf) const;
+
+    // The SAH cost of the hierarchy: the traversal costs of the inner nodes and the intersection
+    // costs of the primitives of the leaves, each weighted by the surface area of its node
+    // relative to the root, i.e. the expected cost of a ray through the root.
+    float cost() const;
+
+    // the default maximum growth of the cost by refits before update rebuilds subtrees,
+    // unlike cost the growth is not relative to the root, which grows along with moved primitives
+    static constexpr float MAX_COST_GROWTH = 1.25f;
+
+    struct UpdateStatistics {
+        float    costGrowth        = 1.0f;  // of the refitted hierarchy over the reference
+        uint32_t rebuiltSubtrees   = 0;
+        uint32_t rebuiltPrimitives = 0;
+        double   refitMilliseconds   = 0.0;
+        double   rebuildMilliseconds = 0.0;
+    };
+
+    // Recomputes the bounds of all nodes bottom-up after primitives moved, the tree itself is
+    // kept. primitiveBounds(group, index) returns the bounds of the primitive at index within
+    // its group, with the primitives of each group stored in leaf order as after construction.
+    template <typename BoundsFunction> void refit(BoundsFunction&& primitiveBounds);
+
+    // Updates the hierarchy after primitives moved, e.g. once per frame of an animation.
+    // Refits the hierarchy, then if its cost grew by more than maxCostGrowth since the reference,
+    // rebuilds the topmost subtrees with a child whose surface area grew by more than that factor.
+    // The reference is the hierarchy before the first update, then the one after the last
+    // rebuild. A rebuilt subtree reorders the primitives of its leaves within each group:
+    // reorder(group, first, previous) has to move the primitive at previous[i] of the group to
+    // first + i for all i, previous is a permutation of [first, first + previous.size()).
+    template <typename BoundsFunction, typename ReorderFunction>
+    UpdateStatistics update(BoundsFunction&& primitiveBounds, ReorderFunction&& reorder,
+                            float maxCostGrowth = MAX_COST_GROWTH);
+
+  private:
+    struct BuildPrimitive {
+        Vector3df lower, upper, centroid;
+        uint16_t  group;
+    };
+
+    // a primitive of a subtree to rebuild, index is its position within its group
+    struct SubtreePrimitive {
+        AABB3df  bounds;
+        uint16_t group;
+        uint32_t index;
+    };
+
+    // the range of primitives of a group moved by rebuilding a subtree, see update
+    struct Reordering {
+        uint16_t              group;
+        uint32_t              first;
+        std::vector<uint32_t> previous;
+    };
+
+    void build(std::vector<BuildPrimitive>& primitives, std::vector<uint32_t>& indices,
+               uint32_t nodeIndex, uint32_t begin, uint32_t end, int depth);
+
+    // sets the bounds of the node to the given bounds, padded as in construction
+    void setBounds(BvhNode& node, const Vector3df& lower, const Vector3df& upper);
+
+    // the sum of the costs of the nodes weighted by their surface area, cost without dividing by
+    // the surface area of the root
+    double areaCost() const;
+
+    // remembers the surface areas and the cost as reference for update, unless already done
+    void keepReference();
+
+    // the roots of the subtrees to rebuild by update with the depth of each root
+    std::vector<std::pair<uint32_t, int>> degradedSubtrees(float maxGrowth) const;
+
+    // the leaves of the subtree below root
+    std::vector<uint32_t> subtreeLeaves(uint32_t root) const;
+
+    // Builds the subtree below root anew over its primitives, in leaf order. The new nodes are
+    // appended, the old ones are unreachable until compact.
+    std::vector<Reordering> rebuildSubtree(uint32_t root, int depth,
+                                           const std::vector<SubtreePrimitive>& primitives);
+
+    // stores the reachable nodes in depth first order again, as after construction
+    void compact();
+
+    // single ray traversal of the subtree below root, the ray has to hit the bounds of root
+    template <typename LeafFunction>
+    bool traverse(uint32_t root, const Ray3df& ray, const Vector3df& inverse, float& tMax,
+                  LeafFunction&& intersectLeaf) const;
+
+    // true if the rays with the given direction probably enter the right child of node first
+    bool rightChildFirst(const BvhNode& node, const Vector3df& direction) const;
+
+    // the nodes for the traversal, loaded once per query
+    const BvhNode* nodeData() const {
+        return _external.empty() ? _nodes.data() : _external.data();
+    }
+
+    std::vector<BvhNode>     _nodes;
+    std::span<const BvhNode> _external;  // the nodes of a view, _nodes is empty then
+    std::vector<uint32_t>    _indices;
+    Settings                 _settings;
+
+    // the surface area of each node and the area cost as reference for update, empty before it
+    std::vector<float> _referenceArea;
+    double             _referenceCost = 0.0;
+};
+
+template <typename LeafFunction>
+bool Bvh::intersect(const Ray3df& ray, float& tMax, LeafFunction&& intersectLeaf) const {
+    if (empty()) {
+        return false;
+    }
+
+    const Vector3df inverse = inverseDirection(ray.direction);
+
+    float tEntry;
+    if (!intersectsNode(nodeData()[0], ray, inverse, tMax, tEntry)) {
+        return false;
+    }
+    return traverse(0, ray, inverse, tMax, intersectLeaf);
+}
+
+template <typename LeafFunction>
+bool Bvh::traverse(uint32_t root, const Ray3df& ray, const Vector3df& inverse, float& tMax,
+                   LeafFunction&& intersectLeaf) const {
+    const BvhNode*             nodes = nodeData();
+    std::pair<uint32_t, float> stack[STACK_SIZE];
+    size_t                     stackSize = 0;
+
+    float    tEntry;
+    bool     hit     = false;
+    uint32_t current = root;
+    // counted locally and added once, so the counters of the thread stay out of the loop
+    uint64_t visited = 0, tested = 0;
+    while (true) {
+        const BvhNode& node = nodes[current];
+        visited++;
+        if (node.isLeaf()) {
+            tested += node.count;
+            hit |= intersectLeaf(node, tMax);
+        } else {
+            uint32_t left = node.first, right = node.first + 1;
+            float    tLeft, tRight;
+            bool     hitLeft  = intersectsNode(nodes[left], ray, inverse, tMax, tLeft);
+            bool     hitRight = intersectsNode(nodes[right], ray, inverse, tMax, tRight);
+
+            if (hitLeft && hitRight) {
+                // visit the nearer child first, the farther one might be culled afterwards
+                if (tRight < tLeft) {
+                    std::swap(left, right);
+                    std::swap(tLeft, tRight);
+                }
+                stack[stackSize++] = {right, tRight};
+                current            = left;
+                continue;
+            }
+            if (hitLeft || hitRight) {
+                current = hitLeft ? left : right;
+                continue;
+            }
+        }
+
+        // pop the next node that is still closer than the closest intersection
+        do {
+            if (stackSize == 0) {
+                stats::countNodes(visited);
+                stats::countPrimitiveTests(tested);
+                return hit;
+            }
+            std::tie(current, tEntry) = stack[--stackSize];
+        } while (tEntry > tMax);
+    }
+}
+
+template <typename LeafFunction>
+uint64_t Bvh::intersect(RayPacket& packet, LeafFunction&& intersectLeaf) const {
+    if (empty() || packet.size == 0) {
+        return 0;
+    }
+
+    const BvhNode* nodes = nodeData();
+
+    const int singleRayLimit = std::max<int>(1, packet.size / SINGLE_RAY_FRACTION);
+
+    // nodes to visit with the rays that hit their parent
+    std::pair<uint32_t, uint64_t> stack[STACK_SIZE];
+    size_t                        stackSize = 0;
+    stack[stackSize++]                      = {0, packet.all()};
+
+    uint64_t hits = 0;
+    while (stackSize > 0) {
+        auto [current, mask] = stack[--stackSize];
+        // also drops rays that found a closer intersection since the node was pushed
+        mask = intersectsNode(nodes[current], packet, mask);
+        if (mask == 0) {
+            continue;
+        }
+
+        if (std::popcount(mask) <= singleRayLimit) {
+            // the rays diverged, a packet of few rays would mostly test nodes no ray hits
+            for (; mask != 0; mask &= mask - 1) {
+                const uint32_t  i = std::countr_zero(mask);
+                const Vector3df inverse{packet.inverseX[i], packet.inverseY[i], packet.inverseZ[i]};
+                auto            intersectLeafRay = [&](const BvhNode& leaf, float& tMax) {
+                    return intersectLeaf(leaf, i, tMax);
+                };
+                if (traverse(current, packet.ray(i), inverse, packet.tMax[i], intersectLeafRay)) {
+                    hits |= uint64_t{1} << i;
+                }
+            }
+            continue;
+        }
+
+        // a node is visited once for all rays of the packet
+        const BvhNode& node = nodes[current];
+        stats::countNodes(1);
+        if (node.isLeaf()) {
+            stats::countPrimitiveTests(static_cast<uint64_t>(node.count) * std::popcount(mask));
+            for (; mask != 0; mask &= mask - 1) {
+                const uint32_t i = std::countr_zero(mask);
+                if (intersectLeaf(node, i, packet.tMax[i])) {
+                    hits |= uint64_t{1} << i;
+                }
+            }
+            continue;
+        }
+
+        // the rays are coherent, so the direction of any of them orders the children
+        const uint32_t  first = std::countr_zero(mask);
+        const Vector3df direction{packet.directionX[first], packet.directionY[first],
+                                  packet.directionZ[first]};
+        uint32_t        nearChild = node.first, farChild = node.first + 1;
+        if (rightChildFirst(node, direction)) {
+            std::swap(nearChild, farChild);
+        }
+        stack[stackSize++] = {farChild, mask};
+        stack[stackSize++] = {nearChild, mask};
+    }
+    return hits;
+}
+
+template <typename LeafFunction>
+bool Bvh::occluded(const Ray3df& ray, float tMax, LeafFunction&& occludedLeaf) const {
+    if (empty()) {
+        return false;
+    }
+
+    const BvhNode*  nodes   = nodeData();
+    const Vector3df inverse = inverseDirection(ray.direction);
+
+    uint32_t stack[STACK_SIZE];
+    size_t   stackSize  = 0;
+    stack[stackSize++]  = 0;
+
+    uint64_t visited = 0, tested = 0;  // added once, as in traverse
+    bool     found   = false;
+    while (stackSize > 0) {
+        const BvhNode& node = nodes[stack[--stackSize]];
+        float          tEntry;
+        visited++;
+        if (!intersectsNode(node, ray, inverse, tMax, tEntry)) {
+            continue;
+        }
+        if (node.isLeaf()) {
+            tested += node.count;
+            if (occludedLeaf(node)) {
+                found = true;
+                break;
+            }
+        } else {
+            stack[stackSize++] = node.first + 1;
+            stack[stackSize++] = node.first;
+        }
+    }
+    stats::countNodes(visited);
+    stats::countPrimitiveTests(tested);
+    return found;
+}
+
+template <typename BoundsFunction> void Bvh::refit(BoundsFunction&& primitiveBounds) {
+    if (!_external.empty()) {
+        throw std::runtime_error("a view of a hierarchy can not be updated");
+    }
+    keepReference();
+    // children are stored after their parents, so a backwards pass visits them first
+    for (size_t i = _nodes.size(); i-- > 0;) {
+        BvhNode&  node = _nodes[i];
+        Vector3df lower, upper;
+        if (node.isLeaf()) {
+            for (size_t k = 0; k < 3; k++) {
+                lower.vector[k] = std::numeric_limits<float>::infinity();
+                upper.vector[k] = -std::numeric_limits<float>::infinity();
+            }
+            for (uint32_t index = node.first; index < node.first + node.count; index++) {
+                const AABB3df bounds = primitiveBounds(node.group, index);
+                for (size_t k = 0; k < 3; k++) {
+                    lower.vector[k] = std::min(lower.vector[k], bounds.lower_corner().vector[k]);
+                    upper.vector[k] = std::max(upper.vector[k], bounds.upper_corner().vector[k]);
+                }
+            }
+            setBounds(node, lower, upper);
+        } else {
+            // the children are padded already
+            const BvhNode& left  = _nodes[node.first];
+            const BvhNode& right = _nodes[node.first + 1];
+            for (size_t k = 0; k < 3; k++) {
+                node.lower.vector[k] = std::min(left.lower.vector[k], right.lower.vector[k]);
+                node.upper.vector[k] = std::max(left.upper.vector[k], right.upper.vector[k]);
+            }
+        }
+    }
+}
+
+template <typename BoundsFunction, typename ReorderFunction>
+Bvh::UpdateStatistics Bvh::update(BoundsFunction&& primitiveBounds, ReorderFunction&& reorder,
+                                  float maxCostGrowth) {
+    using Clock = std::chrono::steady_clock;
+    UpdateStatistics statistics;
+    if (empty()) {
+        return statistics;
+    }
+
+    const auto start = Clock::now();
+    refit(primitiveBounds);
+    const auto refitted = Clock::now();
+    statistics.refitMilliseconds =
+        std::chrono::duration<double, std::milli>(refitted - start).count();
+    statistics.costGrowth = static_cast<float>(areaCost() / std::max(_referenceCost, 1e-30));
+    if (!(statistics.costGrowth > maxCostGrowth)) {
+        return statistics;
+    }
+
+    for (const auto& [root, depth] : degradedSubtrees(maxCostGrowth)) {
+        std::vector<SubtreePrimitive> primitives;
+        for (uint32_t leaf : subtreeLeaves(root)) {
+            const BvhNode& node = _nodes[leaf];
+            for (uint32_t index = node.first; index < node.first + node.count; index++) {
+                primitives.push_back({primitiveBounds(node.group, index), node.group, index});
+            }
+        }
+        for (const Reordering& reordering : rebuildSubtree(root, depth, primitives)) {
+            reorder(reordering.group, reordering.first, reordering.previous);
+        }
+        statistics.rebuiltSubtrees++;
+        statistics.rebuiltPrimitives += static_cast<uint32_t>(primitives.size());
+    }
+    compact();
+    _referenceCost = areaCost();
+    statistics.rebuildMilliseconds =
+        std::chrono::duration<double, std::milli>(Clock::now() - refitted).count();
+    return statistics;
+}
+
+}  // namespace rt::accel
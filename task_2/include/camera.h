@@ -1,24 +1,107 @@
 #pragma once
 
 #include "math.h"
-#include "window.h"
 #include "geometry.h"
+#include "transform.h"
 #include "viewport.h"
+#include "packet.h"
 
 #include <memory>
 
 namespace rt::camera {
 
+// The rays of up to MAX_SIZE consecutive pixels of a row. All rays start at the camera position,
+// the unit directions are stored as structure of arrays.
+struct RayRow {
+    static constexpr int MAX_SIZE = 64;
+
+    int       size = 0;
+    Vector3df origin;
+    alignas(16) float directionX[MAX_SIZE];
+    alignas(16) float directionY[MAX_SIZE];
+    alignas(16) float directionZ[MAX_SIZE];
+
+    Ray3df ray(int index) const {
+        return Ray3df{origin, Vector3df{directionX[index], directionY[index], directionZ[index]}};
+    }
+};
+
+// The motion of a camera away from the pose its viewport was set up for: the view is turned by
+// pitch radians about the x axis and then by yaw radians about the y axis, around the camera
+// position, and moved by offset. Positive yaw turns left, positive pitch up.
+struct Pose {
+    Vector3df offset{0.0f, 0.0f, 0.0f};
+    float     yaw   = 0.0f;
+    float     pitch = 0.0f;
+
+    bool operator==(const Pose& other) const {
+        return offset.vector == other.offset.vector && yaw == other.yaw && pitch == other.pitch;
+    }
+};
+
+// The pose moved by move along the right, up and backward axes of the view turned by the new
+// yaw and pitch, which are the ones of the pose plus yaw and pitch radians. The pitch stops short
+// of straight up or down.
+Pose movePose(const Pose& pose, const Vector3df& move, float yaw, float pitch);
+
+// The pose that moves a camera at the origin looking down -z to position and turns it to look
+// along the unit direction, without roll
+Pose lookAlong(const Vector3df& position, const Vector3df& direction);
+
 class Camera {
   public:
     Camera(Vector3df position, Vector3df direction, rt::view::Viewport& viewport);
 
-    Ray3df getRay(int x, int y);
+    // Moves the whole view rigidly, the rays of the default pose are the ones of the viewport.
+    // Not thread safe, the camera must not be used for rendering meanwhile.
+    void setPose(const Pose& pose);
+
+    const Pose& pose() const {
+        return _pose;
+    }
+
+    // the origin of all rays, the position moved by the pose
+    Vector3df origin() const;
+
+    // the rotation of the pose, applied to the directions of the rays
+    const Transform& rotation() const {
+        return _rotation;
+    }
+
+    // The pixel coordinates of the point where the ray from the camera to the point passes the
+    // viewport, pixel centres at whole numbers as for getRay. The inverse of getRay for points
+    // in front of the camera.
+    // returns false if the point does not lie in front of the camera
+    bool project(const Vector3df& point, float& pixelX, float& pixelY) const;
+
+    // the projection of project for many points
+    view::Projection projection() const;
+
+    // the ray through the centre of the pixel, the same as the one of getRow and getRays
+    Ray3df getRay(int x, int y) const;
+
+    // the ray through a point within the pixel, offsets in pixels from its centre
+    Ray3df getRay(int x, int y, float offsetX, float offsetY) const;
+
+    // Generates the rays of the pixels [x, x + width) x [y, y + height) row by row into the
+    // empty packet, width * height must not exceed RayPacket::MAX_SIZE
+    void getRays(int x, int y, int width, int height, accel::RayPacket& packet) const;
+
+    // Generates the rays of the pixels [x, x + count) of row y, count must not exceed
+    // RayRow::MAX_SIZE. Cheaper than count calls of getRay, the directions are computed
+    // incrementally and normalised together.
+    void getRow(int x, int y, int count, RayRow& row) const;
 
   private:
+    // applies the pose to a ray generated by the viewport from _position
+    Ray3df moved(const Ray3df& ray) const;
+
     Vector3df           _position;
     Vector3df           _direction;
     rt::view::Viewport& _viewport;
+    Pose                _pose;
+    Transform           _rotation;
+    bool                _moved = false;  // any other than the default pose
 };
 
 }  // namespace rt::camera
\ No newline at end of file
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "math.h"
+
+namespace rt::fb {
+
+// The target of a render, encapsulates setting the colour of a pixel.
+// Colours are linear RGB with components from 0 to 1, HDR colours may exceed 1.
+class Framebuffer {
+  public:
+    virtual ~Framebuffer() = default;
+
+    virtual int width() const  = 0;
+    virtual int height() const = 0;
+
+    // sets the colour of the pixel x, y (origin upper left)
+    // different pixels may be set concurrently from different threads
+    virtual void setPixel(int x, int y, const Vector3df& color) = 0;
+};
+
+// A framebuffer keeping the pixels in memory as float RGB triples in scanline order.
+// setPixel, getPixel and copyRow access the components atomically, so pixels may be read, e.g.
+// to present a render in progress, while others or the same are set. A pixel read while it is
+// set may mix components of its old and new colour.
+class MemoryFramebuffer : public Framebuffer {
+  public:
+    MemoryFramebuffer(int width, int height);
+
+    int width() const override {
+        return _width;
+    }
+    int height() const override {
+        return _height;
+    }
+
+    void setPixel(int x, int y, const Vector3df& color) override;
+
+    Vector3df getPixel(int x, int y) const;
+
+    // copies the width * 3 RGB components of row y to destination
+    void copyRow(int y, float* destination) const;
+
+    // the RGB components of all pixels, row by row starting with the upper row
+    // not to be read while pixels are set, use getPixel or copyRow then
+    const std::vector<float>& data() const {
+        return _pixels;
+    }
+
+  private:
+    int                _width, _height;
+    std::vector<float> _pixels;
+};
+
+// How linear HDR colours are mapped to 8 bits per channel: scaled by the exposure, clamped to
+// [0, 1], raised to 1 / gamma and quantised. The defaults keep the colours linear.
+struct Tonemap {
+    float exposure = 1.0f;
+    float gamma    = 1.0f;
+};
+
+// writes the framebuffer as binary PPM (P6) with 8 bits per channel, mapped by the tonemap
+// throws std::runtime_error if the file can not be written
+void writePpm(const MemoryFramebuffer& framebuffer, const std::string& path,
+              const Tonemap& tonemap = {});
+
+// writes the framebuffer as little endian PFM (PF) with unclamped float channels
+// throws std::runtime_error if the file can not be written
+void writePfm(const MemoryFramebuffer& framebuffer, const std::string& path);
+
+// writes a PFM file if path ends with ".pfm", a PPM file mapped by the tonemap otherwise
+void writeImage(const MemoryFramebuffer& framebuffer, const std::string& path,
+                const Tonemap& tonemap = {});
+
+// The false colour of a cost in a heatmap, from dark blue without cost over cyan, green and
+// yellow to red at scale, costs beyond it are red as well
+Vector3df heatmapColor(float cost, float scale);
+
+// the cost below which the given fraction of the costs lies, e.g. 0.99 for a heatmap scale
+// that is not dominated by a few outliers, 0 without costs
+float costPercentile(std::vector<float> costs, float fraction);
+
+// Sets each pixel of the framebuffer to the heatmap colour of its cost, costs holds one value per
+// pixel in scanline order, e.g. from render::renderCosts. The heatmap is written like any image,
+// e.g. with writeImage.
+// throws std::invalid_argument if the number of costs does not match the framebuffer
+void drawHeatmap(const std::vector<float>& costs, float scale, MemoryFramebuffer& framebuffer);
+
+}  // namespace rt::fb
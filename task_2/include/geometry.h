@@ -2,6 +2,7 @@
 #define GEOMETRY_H
 
 #include "math.h"
+#include <algorithm>
 #include <iostream>
 #include <vector>
 
@@ -53,6 +54,27 @@ template <class FLOAT, size_t N> class AxisAlignedBoundingBox {
 
   public:
     AxisAlignedBoundingBox(Vector<FLOAT, N> center, Vector<FLOAT, N> half_edge_length);
+
+    // creates the aabb spanned by the corner with the smallest and the corner with the largest
+    // coordinates
+    static AxisAlignedBoundingBox<FLOAT, N> from_corners(Vector<FLOAT, N> lower,
+                                                         Vector<FLOAT, N> upper);
+
+    // returns the center point of this aabb
+    Vector<FLOAT, N> get_center() const;
+
+    // returns the corner with the smallest coordinates
+    Vector<FLOAT, N> lower_corner() const;
+
+    // returns the corner with the largest coordinates
+    Vector<FLOAT, N> upper_corner() const;
+
+    // returns the smallest aabb containing this aabb and the given aabb
+    AxisAlignedBoundingBox<FLOAT, N> merge(AxisAlignedBoundingBox<FLOAT, N> aabb) const;
+
+    // returns the surface area of this aabb (the perimeter in the two-dimensional case)
+    FLOAT surface_area() const;
+
     bool intersects(AxisAlignedBoundingBox<FLOAT, N> aabb) const;
 
     // checks if this aabb is intersected by the given ray
@@ -92,6 +114,9 @@ template <class FLOAT, size_t N> class Sphere {
 
     // returns true iff the given point is inside this Sphere or on its surface
     bool inside(const Vector<FLOAT, N> p) const;
+
+    // returns the smallest axis aligned bounding box containing this sphere
+    AxisAlignedBoundingBox<FLOAT, N> bounds() const;
 };
 
 template <class FLOAT, size_t N> class Triangle {
@@ -126,6 +151,79 @@ template <class FLOAT, size_t N> class Triangle {
     //   context.t is set to a value with intersection = ray.origin + t * ray.direction
     //   context.normal points away from the surface (clockwise order of a,b, and c)
     bool intersects(const Ray<FLOAT, N>& ray, Intersection_Context<FLOAT, N>& context) const;
+
+    // returns the smallest axis aligned bounding box containing this Triangle
+    AxisAlignedBoundingBox<FLOAT, N> bounds() const;
+};
+
+// A triangle prepared for fast ray intersection tests, e.g. when building a scene.
+// Instead of the three corners the corner a and the edges b - a and c - a are stored, together
+// with the normal of the triangle. The intersection (Moeller-Trumbore) needs one division and
+// yields the same t, u, v, normal and intersection point as Triangle::intersects.
+template <class FLOAT, size_t N> class PrecomputedTriangle {
+  protected:
+    Vector<FLOAT, N> a;
+    Vector<FLOAT, N> edge_ab, edge_ac;  // b - a and c - a
+    Vector<FLOAT, N> normal;            // (b - a) x (c - a), not normalized
+
+    // the Moeller-Trumbore test, sets t and the barycentric coordinates of b and c on success
+    bool intersection(const Ray<FLOAT, N>& ray, FLOAT& t, FLOAT& u_b, FLOAT& u_c) const;
+
+  public:
+    // creates a triangle with the given edge points a,b,c
+    PrecomputedTriangle(Vector<FLOAT, N> a, Vector<FLOAT, N> b, Vector<FLOAT, N> c);
+
+    // returns true if this Triangle intersects the given ray
+    // if an intersection occured, than context.intersection is set to the intersection point
+    //   context.u and context.v are set to the barycentric coordinates of a and b
+    //   context.t is set to a value with intersection = ray.origin + t * ray.direction
+    //   context.normal is (b - a) x (c - a), it points away from the surface
+    bool intersects(const Ray<FLOAT, N>& ray, Intersection_Context<FLOAT, N>& context) const;
+
+    // returns a value t such that ray.origin + t * ray.direction is the intersection point
+    // t is zero if no intersection occured, no other attributes of the intersection are computed
+    FLOAT intersects(const Ray<FLOAT, N>& ray) const;
+
+    // returns the smallest axis aligned bounding box containing this Triangle
+    AxisAlignedBoundingBox<FLOAT, N> bounds() const;
+
+    // returns the edge point a
+    Vector<FLOAT, N> get_a() const;
+
+    // returns the edge b - a
+    Vector<FLOAT, N> get_edge_ab() const;
+
+    // returns the edge c - a
+    Vector<FLOAT, N> get_edge_ac() const;
+
+    // returns (b - a) x (c - a), not normalized
+    Vector<FLOAT, N> get_normal() const;
+};
+
+// A PrecomputedTriangle with a normal for each of its points, e.g. of a mesh approximating a
+// curved surface. The normal of an intersection is interpolated from the normals of the points
+// with the barycentric coordinates, so the shading is smooth across the triangles of the mesh.
+template <class FLOAT, size_t N> class SmoothTriangle : public PrecomputedTriangle<FLOAT, N> {
+  protected:
+    Vector<FLOAT, N> na, nb, nc;  // normal vectors for each point
+
+  public:
+    // creates a triangle with the given edge points a,b,c
+    // the normal of each edge a,b, and c are set to na, nb, and nc, as for Triangle
+    SmoothTriangle(Vector<FLOAT, N> a, Vector<FLOAT, N> b, Vector<FLOAT, N> c, Vector<FLOAT, N> na,
+                   Vector<FLOAT, N> nb, Vector<FLOAT, N> nc);
+
+    // as PrecomputedTriangle::intersects, but context.normal is the interpolated normal,
+    // not normalized
+    bool intersects(const Ray<FLOAT, N>& ray, Intersection_Context<FLOAT, N>& context) const;
+
+    // returns a value t such that ray.origin + t * ray.direction is the intersection point
+    // t is zero if no intersection occured, no other attributes of the intersection are computed
+    FLOAT intersects(const Ray<FLOAT, N>& ray) const;
+
+    // returns the normal interpolated at the barycentric coordinates u of a and v of b,
+    // not normalized
+    Vector<FLOAT, N> get_normal_at(FLOAT u, FLOAT v) const;
 };
 
 typedef Ray<float, 2u> Ray2df;
@@ -139,4 +237,8 @@ typedef Sphere<float, 3u> Sphere3df;
 
 typedef Triangle<float, 3u> Triangle3df;
 
+typedef PrecomputedTriangle<float, 3u> PrecomputedTriangle3df;
+
+typedef SmoothTriangle<float, 3u> SmoothTriangle3df;
+
 #endif
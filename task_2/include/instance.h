@@ -0,0 +1,55 @@
+#pragma once
+
+#include <limits>
+
+#include "geometry.h"
+#include "mesh.h"
+#include "transform.h"
+#include "world.h"
+
+namespace rt::world {
+
+// A mesh placed in the scene by an affine transformation. Instances of the same mesh share its
+// vertices, indices and hierarchy, so memory grows with the unique geometry, an instance only
+// adds its transformations and bounds. The scene hierarchy over the instance bounds forms the top
+// level, the hierarchy of the mesh the bottom level: rays entering an instance are transformed
+// into the space of the mesh and traverse its hierarchy there.
+class Instance {
+  public:
+    // throws std::runtime_error if toWorld is not invertible
+    Instance(Mesh mesh, const Transform& toWorld);
+
+    // as Mesh::intersects in world space, the normal is transformed to world space and normalised
+    bool intersects(const Ray3df& ray, Intersection_Context<float, 3>& context,
+                    float tMax = std::numeric_limits<float>::infinity()) const;
+
+    // true iff the ray intersects any triangle with 0 < t < tMax
+    bool occludes(const Ray3df& ray, float tMax) const;
+
+    // the bounds of the transformed bounds of the mesh
+    AABB3df bounds() const {
+        return _bounds;
+    }
+
+    const Mesh& mesh() const {
+        return _mesh;
+    }
+
+    const Transform& transform() const {
+        return _toWorld;
+    }
+
+  private:
+    // the ray in the space of the mesh with a normalised direction, as the triangle tests expect
+    // for their tolerance. A distance t in world space is t * scale in the space of the mesh.
+    Ray3df toObject(const Ray3df& ray, float& scale) const;
+
+    Mesh      _mesh;
+    Transform _toWorld;
+    Transform _toObject;
+    AABB3df   _bounds;
+};
+
+typedef GeometricObject<Instance> InstanceObject;
+
+}  // namespace rt::world
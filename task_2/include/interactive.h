@@ -0,0 +1,233 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "thread_pool.h"
+#include "camera.h"
+#include "framebuffer.h"
+#include "world.h"
+#include "light_tree.h"
+#include "renderer.h"
+#include "progressive.h"
+#include "path_tracer.h"
+#include "sampler.h"
+
+namespace rt::render {
+
+// a pixel stops being traced once it has DEFAULT_INTERACTIVE_SAMPLES samples
+constexpr int DEFAULT_INTERACTIVE_SAMPLES = 64;
+
+// the samples of a pixel that are kept when it is reprojected to a moved camera
+constexpr int DEFAULT_REPROJECTED_SAMPLES = 8;
+
+// how an InteractiveRender renders its frames
+struct InteractiveSettings {
+    int samplesPerPixel       = DEFAULT_INTERACTIVE_SAMPLES;
+    int maxReprojectedSamples = DEFAULT_REPROJECTED_SAMPLES;  // 0 discards the samples on motion
+    // Frames trace one pixel per block of blockSize x blockSize pixels, a power of two of at most
+    // maxBlockSize. The block size is adapted frame by frame so a frame takes about frameSeconds,
+    // 0 always uses maxBlockSize.
+    int           maxBlockSize = DEFAULT_PREVIEW_BLOCK_SIZE;
+    double        frameSeconds = 1.0 / 30.0;
+    int           tileSize     = DEFAULT_TILE_SIZE;
+    TraceSettings trace;
+    bool          pathTraced = false;  // traces paths with path instead of rays with trace
+    PathSettings  path;                // of which samplesPerPixel and firstSample are not used
+};
+
+// Renders frames of a camera that may move between them, e.g. from the input of a window, within
+// a time budget per frame.
+// Each frame traces one sample in every block of blockSize x blockSize pixels, a different pixel of
+// the block in each frame, and adds it to the running mean of the pixel. Pixels without samples
+// show the sample of their block, so a frame is never older than the camera. While the camera
+// stands still the block size shrinks until the frames trace every pixel, and the pixels converge
+// to the mean of samplesPerPixel jittered samples, then they are not traced anymore.
+// When the camera moves, the mean of each pixel is carried to the pixel that now sees its first
+// hit, with at most maxReprojectedSamples samples, so small motions keep most of the image and
+// new samples soon outweigh the old ones, whose shading was seen from elsewhere. Pixels that
+// nothing is reprojected to, e.g. where hidden objects come into view, start without samples.
+class InteractiveRender {
+  public:
+    InteractiveRender(int width, int height, const std::vector<world::PointLight>& lights,
+                      const InteractiveSettings& settings = {});
+
+    // Renders a frame of the scene as seen by the camera into the framebuffer, which has the size
+    // of the render, using all workers of the pool. Reprojects the samples first if the pose of
+    // the camera changed since the last frame.
+    // returns the contexts of all workers for the caller to merge
+    template <typename Scene>
+    std::vector<WorkerContext> renderFrame(parallel::ThreadPool& pool, const camera::Camera& camera,
+                                           const Scene& scene, fb::MemoryFramebuffer& framebuffer);
+
+    // Carries the samples of the last frame over to the camera, see InteractiveRender, the next
+    // frame of the camera is not reprojected again. The hit points are projected on the workers
+    // of the pool, then moved to their pixels on the calling thread.
+    void reproject(parallel::ThreadPool& pool, const camera::Camera& camera);
+
+    // the block size of the next frame
+    int blockSize() const {
+        return _blockSize;
+    }
+
+    // the number of samples in the mean of the pixel
+    uint32_t samples(int x, int y) const {
+        return _pixels[index(x, y)].samples;
+    }
+
+    // the mean of the samples of the pixel
+    const Vector3df& mean(int x, int y) const {
+        return _pixels[index(x, y)].mean;
+    }
+
+    // true once every pixel has samplesPerPixel samples
+    bool converged() const {
+        return _convergedPixels == _pixels.size();
+    }
+
+  private:
+    // a hit point of the pixels whose camera ray missed the scene
+    static constexpr float MISSED = std::numeric_limits<float>::infinity();
+
+    // the target of a pixel that is not reprojected
+    static constexpr uint32_t NO_TARGET = std::numeric_limits<uint32_t>::max();
+
+    // what is kept of a pixel from frame to frame (32 bytes), together for reproject, which
+    // moves all of it
+    struct Pixel {
+        Vector3df mean;
+        uint32_t  samples = 0;
+        Vector3df hitPoint{MISSED, MISSED, MISSED};  // the first hit of the last sample
+        float     distance = 0.0f;  // the squared distance of the hit point to the camera
+    };
+
+    size_t index(int x, int y) const {
+        return static_cast<size_t>(y) * _width + x;
+    }
+
+    // the colour of a new sample of the pixel, the first hit of its camera ray is set to hitPoint
+    template <typename Scene>
+    Vector3df traceSample(const camera::Camera& camera, const Scene& scene, int x, int y,
+                          Vector3df& hitPoint, WorkerContext& context) const;
+
+    // halves or doubles the block size towards frames of settings.frameSeconds
+    void adaptBlockSize(double seconds);
+
+    int                            _width, _height;
+    std::vector<world::PointLight> _lights;
+    accel::LightTree               _lightTree;
+    InteractiveSettings            _settings;
+
+    std::vector<Pixel> _pixels;
+    // the buffers of reproject, kept between frames so moving does not allocate
+    std::vector<Pixel>    _movedPixels;
+    std::vector<uint32_t> _targets;
+
+    camera::Pose        _pose;                 // the pose of the camera of the last frame
+    bool                _hasFrame     = false;  // false before the first frame
+    bool                _fullyWritten = false;  // the framebuffer shows every mean
+    std::atomic<size_t> _convergedPixels{0};
+    uint32_t            _frame = 0;  // frames rendered, chooses the pixel of each block
+    int                 _blockSize;
+};
+
+template <typename Scene>
+Vector3df InteractiveRender::traceSample(const camera::Camera& camera, const Scene& scene, int x,
+                                         int y, Vector3df& hitPoint,
+                                         WorkerContext& context) const {
+    // a random point of the pixel, a pixel gets at most one sample per frame, so the frame
+    // numbers the samples
+    Sampler     sampler(static_cast<uint32_t>(x), static_cast<uint32_t>(y), _frame,
+                        _settings.path.seed);
+    const float offsetX = sampler.uniform() - 0.5f;
+    const float offsetY = sampler.uniform() - 0.5f;
+    const auto  ray     = camera.getRay(x, y, offsetX, offsetY);
+
+    context.primaryRays++;
+    const auto hit = world::findClosestHit(ray, scene);
+    if (!hit.has_value()) {
+        hitPoint = Vector3df{MISSED, MISSED, MISSED};
+        return Vector3df{0.0f, 0.0f, 0.0f};
+    }
+    // at the distance of the hit but on the ray through the centre of the pixel, so the point
+    // projects back onto the centre and reprojecting a still camera keeps every pixel in place
+    hitPoint = ray.origin + hit->t * camera.getRay(x, y).direction;
+    if (_settings.pathTraced) {
+        return tracePathHit(ray, *hit, scene, _lightTree, _settings.path, sampler, context);
+    }
+    return traceHit(ray, *hit, scene, _lights, _settings.trace, context);
+}
+
+template <typename Scene>
+std::vector<WorkerContext> InteractiveRender::renderFrame(parallel::ThreadPool&  pool,
+                                                          const camera::Camera&  camera,
+                                                          const Scene&           scene,
+                                                          fb::MemoryFramebuffer& framebuffer) {
+    const auto start = std::chrono::steady_clock::now();
+    if (_hasFrame && !(camera.pose() == _pose)) {
+        reproject(pool, camera);
+    }
+    _pose     = camera.pose();
+    _hasFrame = true;
+
+    // the pixel of each block traced in this frame, stepping through the block so that
+    // consecutive frames trace pixels far apart; b + 1 is coprime to b * b for b a power of two
+    const int  blockSize  = _blockSize;
+    const int  inBlock    = static_cast<int>(_frame * (blockSize + 1) % (blockSize * blockSize));
+    const int  pixelX     = inBlock % blockSize;
+    const int  pixelY     = inBlock / blockSize;
+    const auto maxSamples = static_cast<uint32_t>(std::max(_settings.samplesPerPixel, 1));
+    // pixels with samples only change when they are traced, unless they were reprojected
+    const bool writeAll = !_fullyWritten;
+
+    // the tiles hold whole blocks, so every pixel is written by one worker
+    const auto tiles    = makeTiles(_width, _height, _settings.tileSize * blockSize);
+    auto       contexts = forEachTile(pool, tiles, [&](const Tile& tile, WorkerContext& context) {
+        size_t converged = 0;
+        for (int y = tile.y; y < tile.y + tile.height; y += blockSize) {
+            for (int x = tile.x; x < tile.x + tile.width; x += blockSize) {
+                const int endX    = std::min(x + blockSize, _width);
+                const int endY    = std::min(y + blockSize, _height);
+                const int sampleX = std::min(x + pixelX, endX - 1);
+                const int sampleY = std::min(y + pixelY, endY - 1);
+                Pixel& sampled = _pixels[index(sampleX, sampleY)];
+                if (sampled.samples < maxSamples) {
+                    const Vector3df color = traceSample(camera, scene, sampleX, sampleY,
+                                                        sampled.hitPoint, context);
+                    const float     count = static_cast<float>(sampled.samples);
+                    for (size_t i = 0; i < 3; i++) {
+                        sampled.mean.vector[i] =
+                            (sampled.mean.vector[i] * count + color.vector[i]) / (count + 1.0f);
+                    }
+                    converged += ++sampled.samples == maxSamples;
+                    framebuffer.setPixel(sampleX, sampleY, sampled.mean);
+                }
+
+                // pixels without samples show the sample of their block
+                for (int blockY = y; blockY < endY; blockY++) {
+                    for (int blockX = x; blockX < endX; blockX++) {
+                        const Pixel& pixel = _pixels[index(blockX, blockY)];
+                        if (pixel.samples == 0) {
+                            framebuffer.setPixel(blockX, blockY, sampled.mean);
+                        } else if (writeAll) {
+                            framebuffer.setPixel(blockX, blockY, pixel.mean);
+                        }
+                    }
+                }
+            }
+        }
+        _convergedPixels.fetch_add(converged, std::memory_order_relaxed);
+    });
+
+    _fullyWritten = true;
+    _frame++;
+    adaptBlockSize(
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    return contexts;
+}
+
+}  // namespace rt::render
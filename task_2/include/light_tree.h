@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "math.h"
+#include "world.h"
+
+namespace rt::accel {
+
+// A node of the light tree (32 bytes). Inner nodes store the index of their left child in first,
+// the right child is stored directly after the left child. Leaves hold a single light, first
+// is its index in LightTree::lights() with LEAF set.
+struct LightTreeNode {
+    static constexpr uint32_t LEAF = 1u << 31;
+
+    Vector3df lower;
+    uint32_t  first = 0;
+    Vector3df upper;
+    float     power = 0.0f;  // the sum of the powers of the lights below the node
+
+    bool isLeaf() const noexcept {
+        return (first & LEAF) != 0;
+    }
+};
+
+// A bounding volume hierarchy over point lights for picking one light of many at a shading
+// point, after Conty Estevez and Kulla, "Importance Sampling of Many Lights with Adaptive Tree
+// Splitting". Each node knows the bounds and the power of its lights. Picking descends from the
+// root into one child at a time, with a probability proportional to an upper bound of the light
+// the child can contribute to the shading point, so a light is found in time logarithmic in the
+// number of lights and bright lights above the surface are picked most often.
+// The bound follows the light model of shadeLambertian: the power of the lights times the largest
+// cosine between the normal and a direction into the bounds, lights have no distance falloff.
+class LightTree {
+  public:
+    LightTree() = default;
+
+    // Builds the tree over the lights, splitting the lights at the median of the axis along which
+    // their positions extend most, so the tree is balanced. Lights without power are never picked.
+    explicit LightTree(const std::vector<world::PointLight>& lights);
+
+    // the lights in leaf order
+    std::span<const world::PointLight> lights() const {
+        return _lights;
+    }
+
+    size_t size() const {
+        return _lights.size();
+    }
+
+    bool empty() const {
+        return _lights.empty();
+    }
+
+    std::span<const LightTreeNode> nodes() const {
+        return _nodes;
+    }
+
+    // a light picked for a shading point and the probability with which it was picked
+    struct Sample {
+        const world::PointLight* light       = nullptr;  // none if no light can reach the point
+        float                    probability = 0.0f;
+    };
+
+    // Picks a light for the point with the unit normal, u is a uniform random number in [0, 1).
+    // Every light that may contribute to the point has a probability above zero.
+    Sample sample(const Vector3df& point, const Vector3df& normal, float u) const;
+
+    // the upper bound of the contribution of the lights of the node to the point, see LightTree
+    static float importance(const LightTreeNode& node, const Vector3df& point,
+                            const Vector3df& normal);
+
+  private:
+    struct BuildLight {
+        Vector3df position;
+        float     power;
+        uint32_t  index;
+    };
+
+    void build(std::vector<BuildLight>& lights, uint32_t nodeIndex, uint32_t begin, uint32_t end);
+
+    std::vector<world::PointLight> _lights;
+    std::vector<LightTreeNode>     _nodes;
+};
+
+}  // namespace rt::accel
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <charconv>
+#include <string_view>
+#include <system_error>
+
+#include "math.h"
+
+namespace rt::io {
+
+// Reads the fields of one line, separated by spaces or tabs
+class LineParser {
+  public:
+    explicit LineParser(std::string_view line)
+        : _position(line.data()), _end(line.data() + line.size()) {}
+
+    // skips spaces, returns false at the end of the line or at a comment
+    bool skipSpaces() {
+        while (_position < _end && isSpace(*_position)) {
+            _position++;
+        }
+        return _position < _end && *_position != '#';
+    }
+
+    // returns the characters up to the next space
+    std::string_view keyword() {
+        skipSpaces();
+        const char* start = _position;
+        while (_position < _end && !isSpace(*_position)) {
+            _position++;
+        }
+        return std::string_view(start, static_cast<size_t>(_position - start));
+    }
+
+    template <typename T> bool read(T& value) {
+        const auto [next, error] = std::from_chars(_position, _end, value);
+        if (error != std::errc()) {
+            return false;
+        }
+        _position = next;
+        return true;
+    }
+
+    bool readVector(Vector3df& vector) {
+        for (size_t i = 0; i < 3; i++) {
+            if (!skipSpaces() || !read(vector.vector[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // consumes the character if it is the next one
+    bool consume(char character) {
+        if (_position < _end && *_position == character) {
+            _position++;
+            return true;
+        }
+        return false;
+    }
+
+  private:
+    // the \r of lines ending with \r\n is treated as space
+    static bool isSpace(char character) {
+        return character == ' ' || character == '\t' || character == '\r';
+    }
+
+    const char* _position;
+    const char* _end;
+};
+
+}  // namespace rt::io
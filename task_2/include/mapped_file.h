@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace rt::io {
+
+// A read-only memory mapping of a whole file
+class MappedFile {
+  public:
+    // throws std::runtime_error if the file can not be opened or mapped
+    explicit MappedFile(const std::string& path);
+
+    ~MappedFile() {
+        release();
+    }
+
+    MappedFile(const MappedFile&)            = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // the mapping starts at a page boundary, so offsets aligned in the file are aligned in memory
+    std::string_view contents() const {
+        return std::string_view(_data, _data != nullptr ? _size : 0);
+    }
+
+  private:
+    void release();
+
+#if defined(_WIN32)
+    void* _file    = nullptr;  // HANDLE, without windows.h in this header
+    void* _mapping = nullptr;
+#else
+    int _descriptor = -1;
+#endif
+    const char* _data = nullptr;
+    size_t      _size = 0;
+};
+
+}  // namespace rt::io
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "geometry.h"
+#include "bvh.h"
+#include "world.h"
+
+namespace rt::world {
+
+// A triangle mesh referencing shared vertex positions and normals through 32-bit indices, with
+// its own bounding volume hierarchy over its triangles. It is one Intersectable of a scene, so a
+// mesh of millions of triangles is a single object with a single material, e.g. as MeshObject.
+// Copies share the vertices, indices and hierarchy, which are immutable after construction.
+class Mesh {
+  public:
+    // positionIndices holds three indices into positions for each triangle.
+    // The normal of an intersection is interpolated from vertex normals if there are normals:
+    // with normalIndices the three indices into normals of each triangle, without normalIndices
+    // one normal for each position, indexed by positionIndices. Without normals the normal of
+    // the triangle is used, (b - a) x (c - a) as for PrecomputedTriangle.
+    // The triangles are reordered for the hierarchy.
+    // throws std::runtime_error if an index is out of range
+    Mesh(std::vector<Vector3df> positions, std::vector<uint32_t> positionIndices,
+         std::vector<Vector3df> normals = {}, std::vector<uint32_t> normalIndices = {});
+
+    // The arrays the mesh reads, the triangles in the leaf order of the hierarchy
+    struct View {
+        std::span<const Vector3df>      positions;
+        std::span<const Vector3df>      normals;
+        std::span<const uint32_t>       positionIndices;
+        std::span<const uint32_t>       normalIndices;
+        std::span<const accel::BvhNode> nodes;
+    };
+
+    // A mesh over arrays as returned by view() of another mesh, e.g. in a mapped file, which
+    // are not copied. storage keeps them alive as long as any copy of the mesh.
+    // The indices and the hierarchy are checked in one pass over the arrays, see Bvh::view.
+    // throws std::runtime_error if the sizes do not fit together or an index is out of range
+    Mesh(const View& view, std::shared_ptr<const void> storage);
+
+    View view() const;
+
+    // returns true if the ray intersects the mesh, context describes the closest intersection
+    // as for PrecomputedTriangle::intersects, but with the interpolated vertex normal.
+    // Only intersections with t < tMax are found, a closer bound skips more of the hierarchy.
+    bool intersects(const Ray3df& ray, Intersection_Context<float, 3>& context,
+                    float tMax = std::numeric_limits<float>::infinity()) const;
+
+    // true iff the ray intersects any triangle with 0 < t < tMax
+    bool occludes(const Ray3df& ray, float tMax) const;
+
+    AABB3df bounds() const;
+
+    size_t triangleCount() const {
+        return _data->positionIndices.size() / 3;
+    }
+
+    size_t vertexCount() const {
+        return _data->positions.size();
+    }
+
+    // the bytes of the vertices, indices and hierarchy
+    size_t memoryBytes() const;
+
+    // true iff both are copies of the same mesh, sharing its memory
+    bool sharesData(const Mesh& other) const {
+        return _data == other._data;
+    }
+
+  private:
+    struct Data {
+        std::span<const Vector3df> positions;
+        std::span<const Vector3df> normals;
+        std::span<const uint32_t>  positionIndices;
+        std::span<const uint32_t>  normalIndices;  // empty for normals indexed by positionIndices
+        accel::Bvh                 bvh;
+
+        // the memory behind the spans, either the vectors or the storage of a view
+        std::vector<Vector3df>      ownedPositions;
+        std::vector<Vector3df>      ownedNormals;
+        std::vector<uint32_t>       ownedPositionIndices;
+        std::vector<uint32_t>       ownedNormalIndices;
+        std::shared_ptr<const void> storage;
+    };
+
+    // the triangle intersected at t with the barycentric coordinates u of a and v of b
+    struct TriangleHit {
+        uint32_t triangle;
+        float    u, v;
+    };
+
+    bool intersectLeaf(const accel::BvhNode& leaf, const Ray3df& ray, float& tMax,
+                       TriangleHit& hit) const;
+
+    Vector3df normal(const TriangleHit& hit) const;
+
+    std::shared_ptr<const Data> _data;
+};
+
+typedef GeometricObject<Mesh> MeshObject;
+
+}  // namespace rt::world
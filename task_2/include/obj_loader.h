@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+#include "thread_pool.h"
+#include "world.h"
+#include "scene.h"
+#include "mesh.h"
+
+namespace rt::world {
+
+// What loadObj added to the scene
+struct ObjStatistics {
+    size_t vertices        = 0;
+    size_t normals         = 0;
+    size_t triangles       = 0;  // flat and smooth ones
+    size_t smoothTriangles = 0;
+};
+
+// Loads the faces of a Wavefront OBJ file as triangles with the given material into the scene,
+// the scene has to be built afterwards. Polygons are split into triangle fans. Faces whose
+// corners all have vertex normals become SmoothTriangleObjects, the others TriangleObjects.
+// Only the statements v, vn and f are interpreted, texture coordinates and materials are ignored.
+// The file is memory mapped and parsed in chunks of lines on the workers of the pool.
+// throws std::runtime_error if the file can not be read or is malformed
+ObjStatistics loadObj(const std::string& path, Scene& scene, const Material& material,
+                      parallel::ThreadPool& pool);
+
+// the same for the contents of an OBJ file in memory, name is used in error messages
+ObjStatistics parseObj(std::string_view contents, const std::string& name, Scene& scene,
+                       const Material& material, parallel::ThreadPool& pool);
+
+// Loads all faces of a Wavefront OBJ file into one indexed mesh, as loadObj. The mesh has vertex
+// normals if every corner of every face has a normal, they share the indices of the vertices if
+// every corner uses the same index for both.
+// throws std::runtime_error if the file can not be read or is malformed
+Mesh loadObjMesh(const std::string& path, parallel::ThreadPool& pool);
+
+Mesh parseObjMesh(std::string_view contents, const std::string& name, parallel::ThreadPool& pool);
+
+}  // namespace rt::world
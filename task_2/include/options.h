@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+// minimal parsing of command line options of the form --name value
+namespace rt::cli {
+
+// returns the value following the option name, or fallback if the option is not given
+inline const char* stringOption(int argc, char* argv[], const char* name, const char* fallback) {
+    for (int i = 1; i + 1 < argc; i++) {
+        if (std::strcmp(argv[i], name) == 0) {
+            return argv[i + 1];
+        }
+    }
+    return fallback;
+}
+
+inline int intOption(int argc, char* argv[], const char* name, int fallback) {
+    const char* value = stringOption(argc, argv, name, nullptr);
+    return value != nullptr ? std::atoi(value) : fallback;
+}
+
+inline float floatOption(int argc, char* argv[], const char* name, float fallback) {
+    const char* value = stringOption(argc, argv, name, nullptr);
+    return value != nullptr ? std::strtof(value, nullptr) : fallback;
+}
+
+}  // namespace rt::cli
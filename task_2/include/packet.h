@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+
+#include "geometry.h"
+
+namespace rt::accel {
+
+struct BvhNode;
+
+// A bundle of up to 64 rays traced through the hierarchy together, stored as structure of arrays.
+// Rays are selected by bit masks, bit i stands for ray i.
+struct RayPacket {
+    static constexpr uint32_t MAX_SIZE = 64;
+
+    uint32_t size = 0;
+
+    // zero initialised, the vectorised kernels may read lanes beyond size
+    alignas(16) float originX[MAX_SIZE]    = {};
+    alignas(16) float originY[MAX_SIZE]    = {};
+    alignas(16) float originZ[MAX_SIZE]    = {};
+    alignas(16) float directionX[MAX_SIZE] = {};
+    alignas(16) float directionY[MAX_SIZE] = {};
+    alignas(16) float directionZ[MAX_SIZE] = {};
+    alignas(16) float inverseX[MAX_SIZE]   = {};
+    alignas(16) float inverseY[MAX_SIZE]   = {};
+    alignas(16) float inverseZ[MAX_SIZE]   = {};
+    // the closest intersection found so far for each ray
+    alignas(16) float tMax[MAX_SIZE] = {};
+
+    // appends a ray, there have to be less than MAX_SIZE rays in the packet
+    void add(const Ray3df& ray, float tMaxRay = std::numeric_limits<float>::infinity());
+
+    Ray3df ray(uint32_t index) const {
+        return Ray3df{Vector3df{originX[index], originY[index], originZ[index]},
+                      Vector3df{directionX[index], directionY[index], directionZ[index]}};
+    }
+
+    // the mask selecting all rays of the packet
+    uint64_t all() const {
+        return size == MAX_SIZE ? ~uint64_t{0} : (uint64_t{1} << size) - 1;
+    }
+};
+
+// Slab test of the rays selected by mask against the bounds of a node, each limited to
+// [0, tMax] of the ray. Returns the mask of the rays hitting the node.
+// Uses SSE if available, the results are the same as with intersectsNode for each ray.
+uint64_t intersectsNode(const BvhNode& node, const RayPacket& packet, uint64_t mask);
+
+}  // namespace rt::accel
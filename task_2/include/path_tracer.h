@@ -0,0 +1,223 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "thread_pool.h"
+#include "camera.h"
+#include "framebuffer.h"
+#include "world.h"
+#include "scene.h"
+#include "shading.h"
+#include "renderer.h"
+#include "sampler.h"
+#include "light_tree.h"
+
+namespace rt::render {
+
+constexpr int DEFAULT_PATH_SAMPLES = 16;
+
+// How paths are traced. Paths end when they leave the scene, by Russian roulette from
+// rouletteBounces on, or at maxBounces, which only limits paths Russian roulette keeps alive
+// unusually long, e.g. between parallel mirrors.
+struct PathSettings {
+    int      samplesPerPixel = DEFAULT_PATH_SAMPLES;
+    int      firstSample     = 0;  // the samples of earlier calls, see renderPathTraced
+    int      rouletteBounces = 3;
+    int      maxBounces      = 64;
+    int      lightSamples    = 1;  // lights picked at each hit for next event estimation
+    uint32_t seed            = 0;
+};
+
+// a unit direction around the unit normal with a density proportional to the cosine to it
+inline Vector3df sampleCosine(const Vector3df& normal, Sampler& sampler) {
+    // a point on the unit disc lifted onto the hemisphere (Malley's method), in the orthonormal
+    // basis of Duff et al., "Building an Orthonormal Basis, Revisited"
+    const float radius = std::sqrt(sampler.uniform());
+    const float angle  = 2.0f * static_cast<float>(PI) * sampler.uniform();
+    const float u = radius * std::cos(angle), v = radius * std::sin(angle);
+    const float w = std::sqrt(std::max(0.0f, 1.0f - u * u - v * v));
+
+    const float nx = normal.vector[0], ny = normal.vector[1], nz = normal.vector[2];
+    const float sign = std::copysign(1.0f, nz);
+    const float a    = -1.0f / (sign + nz);
+    const float b    = nx * ny * a;
+    return Vector3df{u * (1.0f + sign * nx * nx * a) + v * b + w * nx,
+                     u * sign * b + v * (sign + ny * ny * a) + w * ny,
+                     -u * sign * nx - v * ny + w * nz};
+}
+
+// Next event estimation from the point origin with the facing unit normal: picks count lights
+// from the light tree and returns the mean of their contributions divided by the probabilities
+// of picking them. The lights follow the model of shadeLambertian, the cosine weighted colour of
+// each light that is not occluded divided by the number of lights, so both integrators light the
+// first hit alike, but the cost does not grow with the number of lights.
+// Adds the number of traced shadow rays to shadowRays.
+template <typename Scene>
+Vector3df sampleLights(const Vector3df& origin, const Vector3df& normal, const Scene& scene,
+                       const accel::LightTree& lights, int count, Sampler& sampler,
+                       uint64_t& shadowRays) {
+    Vector3df   sum{0.0f, 0.0f, 0.0f};
+    const float weight = 1.0f / static_cast<float>(lights.size() * std::max(count, 1));
+    for (int i = 0; i < std::max(count, 1); i++) {
+        const auto sample = lights.sample(origin, normal, sampler.uniform());
+        if (sample.light == nullptr) {
+            break;  // no light reaches the point
+        }
+
+        Vector3df   toLight  = sample.light->position - origin;
+        const float distance = toLight.length();
+        toLight /= distance;
+
+        const float cosine = normal * toLight;
+        if (cosine <= 0.0f) {
+            continue;
+        }
+        shadowRays++;
+        if (world::occluded(Ray3df{origin, toLight}, distance, scene)) {
+            continue;
+        }
+        const float scale = weight * cosine / sample.probability;
+        for (size_t c = 0; c < 3; c++) {
+            sum.vector[c] += scale * sample.light->color.vector[c];
+        }
+    }
+    return sum;
+}
+
+// Returns an estimate of the light arriving along the camera ray, which hit the scene at
+// cameraHit, by a random path. At each hit the diffuse part of the material is lit by next event
+// estimation towards settings.lightSamples lights, then the path continues: mirrored with
+// probability reflectivity and tinted by the specular colour, as traceHit weights the reflection,
+// otherwise in a cosine distributed direction and tinted by the diffuse colour. The lights are
+// points and can not be hit by the path itself, so light only enters through next event
+// estimation. The ambient colour of materials is not used, the path gathers the light reflected
+// by the scene instead.
+// counts the shadow rays and the continued path as reflection rays
+template <typename Scene>
+Vector3df tracePathHit(const Ray3df& cameraRay, const world::Hit& cameraHit, const Scene& scene,
+                       const accel::LightTree& lights, const PathSettings& settings,
+                       Sampler& sampler, WorkerContext& context) {
+    Vector3df  radiance{0.0f, 0.0f, 0.0f};
+    Vector3df  throughput{1.0f, 1.0f, 1.0f};
+    Ray3df     ray = cameraRay;
+    world::Hit hit = cameraHit;
+    for (int bounce = 0;; bounce++) {
+        const world::Material& material     = *hit.material;
+        const float            reflectivity = std::clamp(material.reflectivity, 0.0f, 1.0f);
+        const Vector3df        normal       = facingNormal(ray, hit);
+        const Vector3df        origin       = offsetHitPoint(ray, hit, normal);
+
+        if (!lights.empty() && reflectivity < 1.0f) {
+            const Vector3df direct = sampleLights(origin, normal, scene, lights,
+                                                  settings.lightSamples, sampler,
+                                                  context.shadowRays);
+            for (size_t i = 0; i < 3; i++) {
+                radiance.vector[i] += (1.0f - reflectivity) * throughput.vector[i] *
+                                      material.diffuse.vector[i] * direct.vector[i];
+            }
+        }
+        if (bounce + 1 >= settings.maxBounces) {
+            break;
+        }
+
+        Vector3df direction;
+        if (sampler.uniform() < reflectivity) {
+            direction = ray.direction.get_reflective(normal);
+            direction.normalize();
+            for (size_t i = 0; i < 3; i++) {
+                throughput.vector[i] *= material.specular.vector[i];
+            }
+        } else {
+            direction = sampleCosine(normal, sampler);
+            for (size_t i = 0; i < 3; i++) {
+                throughput.vector[i] *= material.diffuse.vector[i];
+            }
+        }
+
+        // the path survives with a probability following its throughput, which is divided
+        // by that probability, so paths that carry little light end early without bias
+        if (bounce + 1 >= settings.rouletteBounces) {
+            const float survival = std::min(
+                std::max({throughput.vector[0], throughput.vector[1], throughput.vector[2]}),
+                0.95f);
+            if (sampler.uniform() >= survival) {
+                break;
+            }
+            throughput /= survival;
+        }
+
+        ray = Ray3df{origin, direction};
+        context.reflectionRays++;
+        const auto next = world::findClosestHit(ray, scene);
+        if (!next.has_value()) {
+            break;
+        }
+        hit = *next;
+    }
+    return radiance;
+}
+
+// returns the light arriving along the camera ray as tracePathHit, or black if it misses
+// counts the camera ray as primary, the shadow rays and the continued path as reflection rays
+template <typename Scene>
+Vector3df tracePath(const Ray3df& cameraRay, const Scene& scene, const accel::LightTree& lights,
+                    const PathSettings& settings, Sampler& sampler, WorkerContext& context) {
+    context.primaryRays++;
+    const auto hit = world::findClosestHit(cameraRay, scene);
+    if (!hit.has_value()) {
+        return Vector3df{0.0f, 0.0f, 0.0f};
+    }
+    return tracePathHit(cameraRay, *hit, scene, lights, settings, sampler, context);
+}
+
+// Path traces the samples [settings.firstSample, settings.firstSample +
+// settings.samplesPerPixel) of each pixel, each through a random point of the pixel, on the
+// workers of the pool. Without earlier samples the framebuffer is set to their mean, otherwise
+// the mean is combined with the mean of the firstSample earlier samples in the framebuffer, so
+// repeated calls refine the image. The random numbers of a sample only depend on the pixel, the
+// sample and settings.seed, so the image is the same for any number of threads.
+// The light tree over the lights is built once per call. The render stops early once cancel is
+// set, if given, see CancelFlag.
+template <typename Scene>
+std::vector<WorkerContext>
+renderPathTraced(parallel::ThreadPool& pool, const camera::Camera& camera, const Scene& scene,
+                 const std::vector<world::PointLight>& lights, fb::MemoryFramebuffer& framebuffer,
+                 const PathSettings& settings, int tileSize = DEFAULT_TILE_SIZE,
+                 const CancelFlag* cancel = nullptr) {
+    const int   first = std::max(settings.firstSample, 0);
+    const int   count = std::max(settings.samplesPerPixel, 1);
+    const float total = static_cast<float>(first + count);
+
+    const accel::LightTree lightTree(lights);
+
+    const auto tiles = makeTiles(framebuffer.width(), framebuffer.height(), tileSize);
+    return renderTiles(
+        pool, tiles,
+        [&](int x, int y, WorkerContext& context) {
+            Vector3df sum{0.0f, 0.0f, 0.0f};
+            for (int sample = first; sample < first + count; sample++) {
+                Sampler     sampler(static_cast<uint32_t>(x), static_cast<uint32_t>(y),
+                                    static_cast<uint32_t>(sample), settings.seed);
+                const float offsetX  = sampler.uniform() - 0.5f;
+                const float offsetY  = sampler.uniform() - 0.5f;
+                const auto  radiance = tracePath(camera.getRay(x, y, offsetX, offsetY), scene,
+                                                 lightTree, settings, sampler, context);
+                for (size_t i = 0; i < 3; i++) {
+                    sum.vector[i] += radiance.vector[i];
+                }
+            }
+
+            Vector3df color = first > 0 ? framebuffer.getPixel(x, y) : Vector3df{0.0f, 0.0f, 0.0f};
+            for (size_t i = 0; i < 3; i++) {
+                color.vector[i] =
+                    (color.vector[i] * static_cast<float>(first) + sum.vector[i]) / total;
+            }
+            framebuffer.setPixel(x, y, color);
+        },
+        cancel);
+}
+
+}  // namespace rt::render
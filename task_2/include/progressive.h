@@ -0,0 +1,166 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "thread_pool.h"
+#include "camera.h"
+#include "framebuffer.h"
+#include "world.h"
+#include "renderer.h"
+#include "path_tracer.h"
+
+namespace rt::render {
+
+// the preview traces one ray per block of DEFAULT_PREVIEW_BLOCK_SIZE x DEFAULT_PREVIEW_BLOCK_SIZE
+// pixels, 1/64 of the rays of the image
+constexpr int DEFAULT_PREVIEW_BLOCK_SIZE = 8;
+
+// Renders a coarse preview of the image: traces the ray of the upper left pixel of each block of
+// blockSize x blockSize pixels and sets all pixels of the block to its colour.
+// A blockSize of 1 renders the same image as renderImage with single rays.
+// The render stops early once cancel is set, if given, see CancelFlag.
+template <typename Scene>
+std::vector<WorkerContext> renderPreview(parallel::ThreadPool& pool, const camera::Camera& camera,
+                                         const Scene&                          scene,
+                                         const std::vector<world::PointLight>& lights,
+                                         fb::Framebuffer& framebuffer, int blockSize,
+                                         const TraceSettings& settings = {},
+                                         const CancelFlag*    cancel   = nullptr) {
+    const int  width  = framebuffer.width();
+    const int  height = framebuffer.height();
+    const auto tiles  = makeTiles(width, height, DEFAULT_TILE_SIZE * blockSize);
+    return forEachTile(
+        pool, tiles,
+        [&](const Tile& tile, WorkerContext& context) {
+            for (int y = tile.y; y < tile.y + tile.height; y += blockSize) {
+                for (int x = tile.x; x < tile.x + tile.width; x += blockSize) {
+                    const Vector3df color = traceRay(camera.getRay(x, y), scene, lights,
+                                                     settings, context);
+                    for (int blockY = y; blockY < std::min(y + blockSize, height); blockY++) {
+                        for (int blockX = x; blockX < std::min(x + blockSize, width); blockX++) {
+                            framebuffer.setPixel(blockX, blockY, color);
+                        }
+                    }
+                }
+            }
+        },
+        cancel);
+}
+
+// how a ProgressiveRender renders its passes
+struct ProgressiveSettings {
+    int           previewBlockSize = DEFAULT_PREVIEW_BLOCK_SIZE;  // 1 or less renders no preview
+    int           tileSize         = DEFAULT_TILE_SIZE;
+    int           packetSize       = DEFAULT_PACKET_SIZE;
+    TraceSettings trace;
+};
+
+// Renders an image on a background thread in passes, a coarse preview with renderPreview and then
+// the full image with renderImage, both on the workers of the pool. Meanwhile the caller is free
+// to present the framebuffer, e.g. at a fixed rate from the main thread of a window, and sees the
+// preview refined tile by tile. The framebuffer reads and sets its pixels atomically, so it may
+// be presented while the render sets them.
+// The pool, camera, scene, lights and framebuffer have to outlive the render and must not be
+// used by the caller for rendering until wait() returned. cancel() stops the render early, e.g.
+// when the window it is presented in is closed.
+class ProgressiveRender {
+  public:
+    template <typename Scene>
+    ProgressiveRender(parallel::ThreadPool& pool, const camera::Camera& camera, const Scene& scene,
+                      const std::vector<world::PointLight>& lights, fb::Framebuffer& framebuffer,
+                      const ProgressiveSettings& settings = {})
+        : _start(Clock::now()) {
+        _thread = std::thread([=, this, &pool, &camera, &scene, &lights, &framebuffer] {
+            if (settings.previewBlockSize > 1) {
+                addContexts(renderPreview(pool, camera, scene, lights, framebuffer,
+                                          settings.previewBlockSize, settings.trace, &_cancelled));
+                if (!finishPass()) {
+                    return;
+                }
+            }
+            addContexts(renderImage(pool, camera, scene, lights, framebuffer, settings.tileSize,
+                                    settings.packetSize, settings.trace, &_cancelled));
+            if (finishPass()) {
+                _finished.store(true, std::memory_order_release);
+            }
+        });
+    }
+
+    // Path traces the image with renderPathTraced in passes of 1, 1, 2, 4, ... samples per pixel
+    // until settings.samplesPerPixel samples are reached, each pass refines the mean of the
+    // earlier ones in the framebuffer, so the presented image converges pass by pass.
+    template <typename Scene>
+    ProgressiveRender(parallel::ThreadPool& pool, const camera::Camera& camera, const Scene& scene,
+                      const std::vector<world::PointLight>& lights,
+                      fb::MemoryFramebuffer& framebuffer, const PathSettings& settings,
+                      int tileSize = DEFAULT_TILE_SIZE)
+        : _start(Clock::now()) {
+        _thread = std::thread([=, this, &pool, &camera, &scene, &lights, &framebuffer] {
+            PathSettings pass = settings;
+            const int    last = settings.firstSample + std::max(settings.samplesPerPixel, 1);
+            for (int first = settings.firstSample; first < last; first += pass.samplesPerPixel) {
+                pass.firstSample     = first;
+                pass.samplesPerPixel = std::min(std::max(first - settings.firstSample, 1),
+                                                last - first);
+                addContexts(renderPathTraced(pool, camera, scene, lights, framebuffer, pass,
+                                             tileSize, &_cancelled));
+                if (!finishPass()) {
+                    return;
+                }
+            }
+            _finished.store(true, std::memory_order_release);
+        });
+    }
+
+    // waits for the render to finish
+    ~ProgressiveRender();
+
+    ProgressiveRender(const ProgressiveRender&)            = delete;
+    ProgressiveRender& operator=(const ProgressiveRender&) = delete;
+
+    // Stops the render early from any thread: the tiles of the current pass that were not started
+    // yet and all later passes are skipped, so wait() returns soon. finished() stays false.
+    void cancel() {
+        _cancelled.store(true, std::memory_order_relaxed);
+    }
+
+    // true once all passes are written to the framebuffer
+    bool finished() const {
+        return _finished.load(std::memory_order_acquire);
+    }
+
+    // the number of passes written to the framebuffer completely
+    int completedPasses() const {
+        return _completedPasses.load(std::memory_order_acquire);
+    }
+
+    // waits for the render to finish and returns the counters of all passes, summed up
+    WorkerContext wait();
+
+    // the seconds from the start of the render until each completed pass was finished,
+    // only valid after wait()
+    const std::vector<double>& passSeconds() const {
+        return _passSeconds;
+    }
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    void addContexts(const std::vector<WorkerContext>& contexts);
+    // counts the pass as completed, returns false instead if the render was cancelled during it
+    bool finishPass();
+
+    Clock::time_point   _start;
+    WorkerContext       _rays;
+    std::vector<double> _passSeconds;
+    std::atomic<int>    _completedPasses{0};
+    std::atomic<bool>   _finished{false};
+    CancelFlag          _cancelled{false};
+    std::thread         _thread;
+};
+
+}  // namespace rt::render
@@ -0,0 +1,348 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <concepts>
+#include <cstdint>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "thread_pool.h"
+#include "camera.h"
+#include "packet.h"
+#include "framebuffer.h"
+#include "world.h"
+#include "scene.h"
+#include "shading.h"
+#include "stats.h"
+
+namespace rt::render {
+
+constexpr int DEFAULT_TILE_SIZE = 16;
+
+// primary rays are traced in packets of DEFAULT_PACKET_SIZE x DEFAULT_PACKET_SIZE pixels,
+// 1 traces single rays, at most 8 (RayPacket::MAX_SIZE rays)
+constexpr int DEFAULT_PACKET_SIZE = 8;
+constexpr int MAX_PACKET_SIZE     = 8;
+
+// camera rays are reflected at most DEFAULT_MAX_DEPTH times
+constexpr int DEFAULT_MAX_DEPTH = 4;
+
+// Reflected rays whose weight in the colour of their pixel is below this are not traced.
+// Half a step of an 8-bit channel: at exposure 1 and with colours up to 1 a dropped ray changes
+// its channel by at most about half a step, which may still round to the next one. Higher
+// exposures or brighter lights scale the error up.
+constexpr float DEFAULT_MIN_CONTRIBUTION = 0.5f / 255.0f;
+
+// Limits of the reflections traced for each camera ray
+struct TraceSettings {
+    int   maxDepth        = DEFAULT_MAX_DEPTH;  // 0 traces no reflections
+    float minContribution = DEFAULT_MIN_CONTRIBUTION;
+};
+
+// A rectangular block of pixels that is rendered as one task
+struct Tile {
+    int x, y;           // upper left pixel
+    int width, height;  // smaller than the tile size at the right and lower image border
+};
+
+// the wall time a worker spent on a tile
+struct TileTime {
+    Tile   tile;
+    double milliseconds;
+};
+
+// State owned by exactly one worker thread, may be used without synchronisation.
+// Aligned to a cache line, so neighbouring workers do not share cache lines.
+// The traversal counters and tile times are only collected with stats::ENABLED.
+struct alignas(64) WorkerContext {
+    unsigned                 worker         = 0;
+    uint64_t                 primaryRays    = 0;
+    uint64_t                 shadowRays     = 0;
+    uint64_t                 reflectionRays = 0;
+    stats::TraversalCounters traversal;
+    std::vector<TileTime>    tileTimes;  // in the order the worker rendered them
+};
+
+// splits an image into tiles of at most tileSize x tileSize pixels, in scanline order
+std::vector<Tile> makeTiles(int width, int height, int tileSize = DEFAULT_TILE_SIZE);
+
+// Set from another thread to stop a render early, the tiles that were not started then are
+// skipped and keep the contents of the framebuffer
+using CancelFlag = std::atomic<bool>;
+
+// Renders the given tiles by calling renderTile(tile, context) on the workers of the pool.
+// Tiles are claimed dynamically by idle workers.
+// The result of renderTile may only depend on the tile, not on the worker or the order of the
+// tiles, then the image is the same for any number of threads.
+// With stats::ENABLED the traversal counters of the thread while rendering a tile and the wall
+// time of the tile are added to the context of the worker.
+// Tiles are skipped once cancel is set, if given.
+// returns the contexts of all workers for the caller to merge
+template <typename TileFunction>
+std::vector<WorkerContext> forEachTile(parallel::ThreadPool& pool, const std::vector<Tile>& tiles,
+                                       TileFunction&&    renderTile,
+                                       const CancelFlag* cancel = nullptr) {
+    std::vector<WorkerContext> contexts(pool.size());
+    for (unsigned worker = 0; worker < pool.size(); worker++) {
+        contexts[worker].worker = worker;
+    }
+
+    pool.parallelFor(tiles.size(), [&](size_t index, unsigned worker) {
+        if (cancel != nullptr && cancel->load(std::memory_order_relaxed)) {
+            return;
+        }
+        WorkerContext& context = contexts[worker];
+        if constexpr (stats::ENABLED) {
+            const auto start  = std::chrono::steady_clock::now();
+            const auto before = stats::snapshot();
+            renderTile(tiles[index], context);
+            context.traversal += stats::snapshot() - before;
+            context.tileTimes.push_back(
+                {tiles[index], std::chrono::duration<double, std::milli>(
+                                   std::chrono::steady_clock::now() - start)
+                                   .count()});
+        } else {
+            renderTile(tiles[index], context);
+        }
+    });
+
+    return contexts;
+}
+
+// Renders each pixel of the given tiles by calling renderPixel(x, y, context), as forEachTile
+template <typename PixelFunction>
+std::vector<WorkerContext> renderTiles(parallel::ThreadPool& pool, const std::vector<Tile>& tiles,
+                                       PixelFunction&&   renderPixel,
+                                       const CancelFlag* cancel = nullptr) {
+    return forEachTile(
+        pool, tiles,
+        [&](const Tile& tile, WorkerContext& context) {
+            for (int y = tile.y; y < tile.y + tile.height; y++) {
+                for (int x = tile.x; x < tile.x + tile.width; x++) {
+                    renderPixel(x, y, context);
+                }
+            }
+        },
+        cancel);
+}
+
+// sums up the counters of the worker contexts and collects their tile times
+WorkerContext mergeContexts(const std::vector<WorkerContext>& contexts);
+
+// A line summing up the merged counters of a render that took the given seconds: the rays by
+// type and, with stats::ENABLED, the traversal counters per ray and the spread of the tile times
+std::string statisticsSummary(const WorkerContext& merged, double seconds);
+
+// writes the merged counters of a render that took the given seconds as JSON object, with
+// stats::ENABLED including the traversal counters and the time of each tile
+void writeStatisticsJson(std::ostream& out, const WorkerContext& merged, double seconds);
+
+// returns the colour seen along the ray that hit the scene: each hit is shaded by the lights and,
+// for reflective materials, mirrors the ray. The part reflectivity of the colour of a hit comes
+// from its reflected ray, tinted by the specular colour of the material, the rest from shading.
+// A mirror reflection is the only secondary ray of a hit, so the reflections are followed in a
+// loop, no stack is needed. They end beyond settings.maxDepth reflections or if their weight is
+// below settings.minContribution in every channel, then they contribute black as rays that miss
+// the scene.
+// counts the traced rays in context
+template <typename Scene>
+Vector3df traceHit(const Ray3df& ray, const world::Hit& hit, const Scene& scene,
+                   const std::vector<world::PointLight>& lights, const TraceSettings& settings,
+                   WorkerContext& context) {
+    Vector3df  color{0.0f, 0.0f, 0.0f};
+    Ray3df     currentRay = ray;
+    Vector3df  weight{1.0f, 1.0f, 1.0f};  // the share of the current ray in the colour
+    world::Hit currentHit = hit;
+    for (int depth = 0;; depth++) {
+        const world::Material& material     = *currentHit.material;
+        const float            reflectivity = std::clamp(material.reflectivity, 0.0f, 1.0f);
+
+        const Vector3df shaded = shadeLambertian(currentRay, currentHit, scene, lights,
+                                                 context.shadowRays);
+        for (size_t i = 0; i < 3; i++) {
+            color.vector[i] += (1.0f - reflectivity) * weight.vector[i] * shaded.vector[i];
+        }
+
+        if (!(reflectivity > 0.0f) || depth >= settings.maxDepth) {
+            return color;
+        }
+        float contribution = 0.0f;
+        for (size_t i = 0; i < 3; i++) {
+            weight.vector[i] *= reflectivity * material.specular.vector[i];
+            contribution = std::max(contribution, weight.vector[i]);
+        }
+        if (contribution < settings.minContribution) {
+            return color;
+        }
+
+        currentRay = reflectedRay(currentRay, currentHit);
+        context.reflectionRays++;
+        const auto next = world::findClosestHit(currentRay, scene);
+        if (!next.has_value()) {
+            return color;
+        }
+        currentHit = *next;
+    }
+}
+
+// returns the colour seen along the camera ray, the closest object shaded by the lights and its
+// reflections as traceHit, or black
+// counts the traced rays in context
+template <typename Scene>
+Vector3df traceRay(const Ray3df& ray, const Scene& scene,
+                   const std::vector<world::PointLight>& lights, const TraceSettings& settings,
+                   WorkerContext& context) {
+    context.primaryRays++;
+    auto hit = world::findClosestHit(ray, scene);
+    if (!hit.has_value()) {
+        return Vector3df{0.0f, 0.0f, 0.0f};
+    }
+    return traceHit(ray, *hit, scene, lights, settings, context);
+}
+
+// scenes that can trace ray packets, other scenes are traced with single rays
+template <typename Scene>
+concept PacketScene = requires(const Scene& scene, accel::RayPacket& packet, world::Hit* hits) {
+    { scene.intersect(packet, hits) } -> std::same_as<uint64_t>;
+};
+
+// sets colors[i] to the colour seen along ray i of the packet, as traceRay
+// only the camera rays are traced as a packet, their reflections are incoherent single rays
+template <PacketScene Scene>
+void tracePacket(accel::RayPacket& packet, const Scene& scene,
+                 const std::vector<world::PointLight>& lights, const TraceSettings& settings,
+                 Vector3df* colors, WorkerContext& context) {
+    context.primaryRays += packet.size;
+    world::Hit     hits[accel::RayPacket::MAX_SIZE];
+    const uint64_t mask = scene.intersect(packet, hits);
+    for (uint32_t i = 0; i < packet.size; i++) {
+        colors[i] = (mask >> i) & 1
+                        ? traceHit(packet.ray(i), hits[i], scene, lights, settings, context)
+                        : Vector3df{0.0f, 0.0f, 0.0f};
+    }
+}
+
+// renders the tile with single rays, generated a row at a time
+template <typename Scene>
+void renderTileRows(const Tile& tile, const camera::Camera& camera, const Scene& scene,
+                    const std::vector<world::PointLight>& lights, const TraceSettings& settings,
+                    fb::Framebuffer& framebuffer, WorkerContext& context) {
+    camera::RayRow rays;
+    for (int y = tile.y; y < tile.y + tile.height; y++) {
+        for (int x = tile.x; x < tile.x + tile.width; x += camera::RayRow::MAX_SIZE) {
+            const int count = std::min(camera::RayRow::MAX_SIZE, tile.x + tile.width - x);
+            camera.getRow(x, y, count, rays);
+            for (int i = 0; i < count; i++) {
+                framebuffer.setPixel(x + i, y,
+                                     traceRay(rays.ray(i), scene, lights, settings, context));
+            }
+        }
+    }
+}
+
+// renders the tile in blocks of packetSize x packetSize pixels traced as one packet each
+template <PacketScene Scene>
+void renderTilePackets(const Tile& tile, const camera::Camera& camera, const Scene& scene,
+                       const std::vector<world::PointLight>& lights,
+                       const TraceSettings& settings, fb::Framebuffer& framebuffer,
+                       int packetSize, WorkerContext& context) {
+    Vector3df colors[accel::RayPacket::MAX_SIZE];
+    for (int y = tile.y; y < tile.y + tile.height; y += packetSize) {
+        for (int x = tile.x; x < tile.x + tile.width; x += packetSize) {
+            const int width  = std::min(packetSize, tile.x + tile.width - x);
+            const int height = std::min(packetSize, tile.y + tile.height - y);
+
+            accel::RayPacket packet;
+            camera.getRays(x, y, width, height, packet);
+            tracePacket(packet, scene, lights, settings, colors, context);
+
+            for (int i = 0; i < width * height; i++) {
+                framebuffer.setPixel(x + i % width, y + i / width, colors[i]);
+            }
+        }
+    }
+}
+
+// Renders the scene lit by the lights as seen by the camera into the framebuffer, using all
+// workers of the pool.
+// Primary rays are traced in packets of packetSize x packetSize pixels if the scene supports it,
+// reflections are traced within the limits of settings. The render stops early once cancel is
+// set, if given, see CancelFlag.
+template <typename Scene>
+std::vector<WorkerContext> renderImage(parallel::ThreadPool& pool, const camera::Camera& camera,
+                                       const Scene&                          scene,
+                                       const std::vector<world::PointLight>& lights,
+                                       fb::Framebuffer&                      framebuffer,
+                                       int tileSize   = DEFAULT_TILE_SIZE,
+                                       int packetSize = DEFAULT_PACKET_SIZE,
+                                       const TraceSettings& settings = {},
+                                       const CancelFlag*    cancel   = nullptr) {
+    const auto tiles = makeTiles(framebuffer.width(), framebuffer.height(), tileSize);
+    // every pixel belongs to exactly one tile, so workers never write the same pixel
+    if constexpr (PacketScene<Scene>) {
+        if (packetSize > 1) {
+            packetSize = std::min(packetSize, MAX_PACKET_SIZE);
+            return forEachTile(
+                pool, tiles,
+                [&](const Tile& tile, WorkerContext& context) {
+                    renderTilePackets(tile, camera, scene, lights, settings, framebuffer,
+                                      packetSize, context);
+                },
+                cancel);
+        }
+    }
+    return forEachTile(
+        pool, tiles,
+        [&](const Tile& tile, WorkerContext& context) {
+            renderTileRows(tile, camera, scene, lights, settings, framebuffer, context);
+        },
+        cancel);
+}
+
+// what renderCosts measures per pixel
+enum class CostMetric {
+    Traversal,    // nodes visited plus primitives tested, needs stats::ENABLED
+    Nanoseconds,  // the wall time of tracing the pixel
+};
+
+// Renders the scene like renderImage and stores the cost of each pixel, its camera ray with all
+// shadow and reflection rays, in costs in scanline order, e.g. for fb::drawHeatmap.
+// Every pixel is traced as a single ray, as a packet shares its traversal among its pixels.
+// throws std::runtime_error for CostMetric::Traversal without stats::ENABLED
+template <typename Scene>
+std::vector<WorkerContext> renderCosts(parallel::ThreadPool& pool, const camera::Camera& camera,
+                                       const Scene&                          scene,
+                                       const std::vector<world::PointLight>& lights,
+                                       fb::Framebuffer& framebuffer, std::vector<float>& costs,
+                                       CostMetric           metric   = CostMetric::Traversal,
+                                       const TraceSettings& settings = {},
+                                       int                  tileSize = DEFAULT_TILE_SIZE) {
+    if (metric == CostMetric::Traversal && !stats::ENABLED) {
+        throw std::runtime_error("traversal costs need a build with RAYTRACER_STATS");
+    }
+    const int width = framebuffer.width();
+    costs.assign(static_cast<size_t>(width) * framebuffer.height(), 0.0f);
+
+    const auto tiles = makeTiles(width, framebuffer.height(), tileSize);
+    return renderTiles(pool, tiles, [&](int x, int y, WorkerContext& context) {
+        const auto before = stats::snapshot();
+        const auto start  = std::chrono::steady_clock::now();
+        framebuffer.setPixel(x, y, traceRay(camera.getRay(x, y), scene, lights, settings, context));
+
+        float cost;
+        if (metric == CostMetric::Traversal) {
+            const auto counters = stats::snapshot() - before;
+            cost = static_cast<float>(counters.nodesVisited + counters.primitiveTests);
+        } else {
+            cost = std::chrono::duration<float, std::nano>(std::chrono::steady_clock::now() - start)
+                       .count();
+        }
+        costs[static_cast<size_t>(y) * width + x] = cost;
+    });
+}
+
+}  // namespace rt::render
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+
+namespace rt::render {
+
+// The random numbers of one sample of one pixel, a PCG32 generator (XSH RR, O'Neill 2014) seeded
+// from the pixel, the sample and a seed. The numbers of a sample do not depend on the thread or
+// the order in which pixels and samples are rendered, so images are the same for any number of
+// threads. Each pixel uses its own stream of the generator, so neighbouring pixels are not
+// correlated. Cheap to create, a worker creates one for every sample it traces.
+class Sampler {
+  public:
+    Sampler(uint32_t x, uint32_t y, uint32_t sample, uint32_t seed = 0) {
+        // the initialisation of pcg32_srandom_r with the sample as position and the pixel as
+        // stream, the position mixed by the finaliser of SplitMix64
+        uint64_t position = (static_cast<uint64_t>(seed) << 32 | sample) + 0x9e3779b97f4a7c15ull;
+        position          = (position ^ (position >> 30)) * 0xbf58476d1ce4e5b9ull;
+        position          = (position ^ (position >> 27)) * 0x94d049bb133111ebull;
+        position ^= position >> 31;
+
+        _increment = (static_cast<uint64_t>(y) << 32 | x) << 1 | 1u;
+        _state     = 0;
+        next();
+        _state += position;
+        next();
+    }
+
+    uint32_t next() {
+        const uint64_t state      = _state;
+        _state                    = state * 6364136223846793005ull + _increment;
+        const auto     xorShifted = static_cast<uint32_t>(((state >> 18) ^ state) >> 27);
+        const auto     rotation   = static_cast<uint32_t>(state >> 59);
+        return (xorShifted >> rotation) | (xorShifted << ((32 - rotation) & 31));
+    }
+
+    // uniformly distributed in [0, 1), from the upper 24 bits
+    float uniform() {
+        return static_cast<float>(next() >> 8) * (1.0f / 16777216.0f);
+    }
+
+  private:
+    uint64_t _state;
+    uint64_t _increment;
+};
+
+}  // namespace rt::render
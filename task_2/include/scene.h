@@ -0,0 +1,414 @@
+#pragma once
+
+#include <bit>
+#include <concepts>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "world.h"
+#include "mesh.h"
+#include "instance.h"
+#include "bvh.h"
+#include "triangle_soa.h"
+#include "stats.h"
+
+namespace rt::world {
+
+// The ids of the objects of a batch, the number of objects added before each one.
+// The objects are reordered for the hierarchy, their ids stay the same.
+class ObjectIds {
+  public:
+    // the id of the next object, which is added at the end
+    uint32_t add() {
+        const auto id = static_cast<uint32_t>(_ids.size());
+        _ids.push_back(id);
+        _positions.push_back(id);
+        return id;
+    }
+
+    void reserve(size_t count) {
+        _ids.reserve(count);
+        _positions.reserve(count);
+    }
+
+    // the index of the object with the id in the batch
+    // throws std::out_of_range for ids that were never added
+    uint32_t position(uint32_t id) const {
+        return _positions.at(id);
+    }
+
+    // the object at previous[i] moved to first + i, as in ObjectBatch::reorder
+    void reorder(uint32_t first, const std::vector<uint32_t>& previous) {
+        std::vector<uint32_t> ids(previous.size());
+        for (size_t i = 0; i < previous.size(); i++) {
+            ids[i] = _ids[previous[i]];
+        }
+        for (size_t i = 0; i < previous.size(); i++) {
+            _ids[first + i]    = ids[i];
+            _positions[ids[i]] = first + static_cast<uint32_t>(i);
+        }
+    }
+
+  private:
+    std::vector<uint32_t> _ids;        // of the object at each position
+    std::vector<uint32_t> _positions;  // of the object with each id
+};
+
+// moves the object at previous[i] to first + i for all i,
+// previous is a permutation of [first, first + previous.size())
+template <typename T>
+void reorderObjects(std::vector<T>& objects, uint32_t first,
+                    const std::vector<uint32_t>& previous) {
+    std::vector<T> moved;
+    moved.reserve(previous.size());
+    for (uint32_t index : previous) {
+        moved.push_back(std::move(objects[index]));
+    }
+    for (size_t i = 0; i < moved.size(); i++) {
+        objects[first + i] = std::move(moved[i]);
+    }
+}
+
+// All objects of one type of a scene, stored contiguously.
+// Intersecting them needs no virtual calls, the type is known at compile time.
+template <HittableObject T> class ObjectBatch {
+  public:
+    // returns the id of the object, see ObjectIds
+    uint32_t add(T object) {
+        _objects.push_back(std::move(object));
+        return _ids.add();
+    }
+
+    void reserve(size_t count) {
+        _objects.reserve(count);
+        _ids.reserve(count);
+    }
+
+    const std::vector<T>& objects() const {
+        return _objects;
+    }
+
+    const ObjectIds& ids() const {
+        return _ids;
+    }
+
+    // replaces the object with the id, e.g. by a moved copy
+    void replace(uint32_t id, T object) {
+        _objects[_ids.position(id)] = std::move(object);
+    }
+
+    // moves the object at previous[i] to first + i for all i, e.g. into the leaf order of the
+    // hierarchy, previous is a permutation of [first, first + previous.size())
+    void reorder(uint32_t first, const std::vector<uint32_t>& previous) {
+        reorderObjects(_objects, first, previous);
+        _ids.reorder(first, previous);
+    }
+
+    // finds the closest intersection with 0 < t < tMax among the objects [first, first + count)
+    // on success lowers tMax and sets hit
+    bool intersect(uint32_t first, uint32_t count, const Ray3df& ray, float& tMax,
+                   Hit& hit) const {
+        bool found = false;
+        for (uint32_t i = first; i < first + count; i++) {
+            float     t;
+            Vector3df normal;
+            if (intersectObject(_objects[i], ray, tMax, t, normal) && t > 0 && t < tMax) {
+                tMax  = t;
+                hit   = Hit{.t = t, .normal = normal, .material = &_objects[i].material()};
+                found = true;
+            }
+        }
+        return found;
+    }
+
+    // true iff any of the objects [first, first + count) intersects the ray with 0 < t < tMax
+    bool occluded(uint32_t first, uint32_t count, const Ray3df& ray, float tMax) const {
+        for (uint32_t i = first; i < first + count; i++) {
+            if (_objects[i].occludes(ray, tMax)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+  private:
+    // passes tMax on to objects that can use it, e.g. GeometricObject
+    static bool intersectObject(const T& object, const Ray3df& ray, float tMax, float& t,
+                                Vector3df& normal) {
+        if constexpr (requires {
+                          { object.intersect(ray, tMax, t, normal) } -> std::same_as<bool>;
+                      }) {
+            return object.intersect(ray, tMax, t, normal);
+        } else {
+            return object.intersect(ray, t, normal);
+        }
+    }
+
+    std::vector<T> _objects;
+    ObjectIds      _ids;
+};
+
+// objects whose geometry is a PrecomputedTriangle3df, e.g. a SmoothTriangle3df
+template <typename T>
+concept TriangleObjectType = HittableObject<T> && requires(const T& object) {
+    { object.geometry() } -> std::convertible_to<const PrecomputedTriangle3df&>;
+};
+
+// Triangles additionally keep their vertices as structure of arrays,
+// the triangles of a leaf are intersected with the SIMD kernel of accel::TriangleSoA.
+template <TriangleObjectType T> class ObjectBatch<T> {
+  public:
+    uint32_t add(T object) {
+        _soa.add(object.geometry());
+        _objects.push_back(std::move(object));
+        return _ids.add();
+    }
+
+    void reserve(size_t count) {
+        _objects.reserve(count);
+        _soa.reserve(count);
+        _ids.reserve(count);
+    }
+
+    const std::vector<T>& objects() const {
+        return _objects;
+    }
+
+    const ObjectIds& ids() const {
+        return _ids;
+    }
+
+    void replace(uint32_t id, T object) {
+        const uint32_t position = _ids.position(id);
+        _soa.set(position, object.geometry());
+        _objects[position] = std::move(object);
+    }
+
+    void reorder(uint32_t first, const std::vector<uint32_t>& previous) {
+        reorderObjects(_objects, first, previous);
+        _ids.reorder(first, previous);
+        for (uint32_t i = first; i < first + previous.size(); i++) {
+            _soa.set(i, _objects[i].geometry());
+        }
+    }
+
+    bool intersect(uint32_t first, uint32_t count, const Ray3df& ray, float& tMax,
+                   Hit& hit) const {
+        accel::TriangleHit triangleHit;
+        if (!_soa.intersect(first, count, ray, tMax, triangleHit)) {
+            return false;
+        }
+        const T& object = _objects[triangleHit.index];
+        hit = Hit{.t        = triangleHit.t,
+                  .normal   = normal(object, triangleHit),
+                  .material = &object.material()};
+        return true;
+    }
+
+    bool occluded(uint32_t first, uint32_t count, const Ray3df& ray, float tMax) const {
+        return _soa.occluded(first, count, ray, tMax);
+    }
+
+  private:
+    static Vector3df normal(const T& object, const accel::TriangleHit& hit) {
+        if constexpr (requires { object.geometry().get_normal_at(hit.u, hit.v); }) {
+            return object.geometry().get_normal_at(hit.u, hit.v);
+        } else {
+            return object.geometry().get_normal();
+        }
+    }
+
+    std::vector<T>     _objects;
+    accel::TriangleSoA _soa;
+    ObjectIds          _ids;
+};
+
+// A scene keeping the objects of each type Ts in its own contiguous array.
+// One bounding volume hierarchy is built over the objects of all types, each leaf only contains
+// objects of one type. So the type is resolved once per leaf instead of once per object as with
+// the type-erased Hittable. New object types only have to satisfy HittableObject, e.g.
+// GeometricObject<T> for any Intersectable T.
+template <HittableObject... Ts> class PartitionedScene {
+    static_assert(sizeof...(Ts) > 0);
+
+  public:
+    // returns the id of the object among the objects of type T, the number of them added before
+    template <typename T> uint32_t emplace_back(T object) {
+        static_assert((std::is_same_v<T, Ts> || ...), "object type is not part of this scene");
+        return batch<T>().add(std::move(object));
+    }
+
+    // replaces the object of type T with the id, e.g. by a moved copy,
+    // the hierarchy has to be updated before rendering
+    template <typename T> void replace(uint32_t id, T object) {
+        static_assert((std::is_same_v<T, Ts> || ...), "object type is not part of this scene");
+        batch<T>().replace(id, std::move(object));
+    }
+
+    // builds the hierarchy and stores the objects in its leaf order,
+    // has to be called after adding objects
+    void build() {
+        std::vector<AABB3df>  bounds;
+        std::vector<uint16_t> groups;
+        std::vector<uint32_t> indices;  // index of each object in its batch
+        forEachBatchIndexed([&](auto& batch, uint16_t group) {
+            for (uint32_t i = 0; i < batch.objects().size(); i++) {
+                bounds.push_back(batch.objects()[i].bounds());
+                groups.push_back(group);
+                indices.push_back(i);
+            }
+        });
+
+        _bvh = accel::Bvh(bounds, groups);
+
+        forEachBatchIndexed([&](auto& batch, uint16_t group) {
+            std::vector<uint32_t> previous;
+            previous.reserve(batch.objects().size());
+            for (uint32_t index : _bvh.primitiveIndices()) {
+                if (groups[index] == group) {
+                    previous.push_back(indices[index]);
+                }
+            }
+            batch.reorder(0, previous);
+        });
+    }
+
+    // Updates the hierarchy after objects were replaced, e.g. once per frame of an animation.
+    // Refits the bounds and rebuilds degraded subtrees as accel::Bvh::update, which reorders
+    // the objects of the rebuilt subtrees. Faster than build for a few moved objects.
+    accel::Bvh::UpdateStatistics update(float maxCostGrowth = accel::Bvh::MAX_COST_GROWTH) {
+        return _bvh.update(
+            [&](uint16_t group, uint32_t index) {
+                return objectBounds(group, index, std::index_sequence_for<Ts...>{});
+            },
+            [&](uint16_t group, uint32_t first, const std::vector<uint32_t>& previous) {
+                forEachBatchIndexed([&](auto& batch, uint16_t batchGroup) {
+                    if (batchGroup == group) {
+                        batch.reorder(first, previous);
+                    }
+                });
+            },
+            maxCostGrowth);
+    }
+
+    template <typename T> ObjectBatch<T>& batch() {
+        return std::get<ObjectBatch<T>>(_batches);
+    }
+
+    template <typename T> const ObjectBatch<T>& batch() const {
+        return std::get<ObjectBatch<T>>(_batches);
+    }
+
+    // calls f(batch) for the batch of every object type
+    template <typename F> void forEachBatch(F&& f) const {
+        std::apply([&](const auto&... batches) { (f(batches), ...); }, _batches);
+    }
+
+    size_t size() const {
+        size_t count = 0;
+        forEachBatch([&](const auto& batch) { count += batch.objects().size(); });
+        return count;
+    }
+
+    const accel::Bvh& bvh() const {
+        return _bvh;
+    }
+
+    // finds the closest intersection with 0 < t < tMax, on success lowers tMax and sets hit
+    bool intersect(const Ray3df& ray, float& tMax, Hit& hit) const {
+        const bool found =
+            _bvh.intersect(ray, tMax, [&](const accel::BvhNode& leaf, float& tClosest) {
+                return intersectLeaf(leaf, ray, tClosest, hit, std::index_sequence_for<Ts...>{});
+            });
+        stats::countHits(found);
+        return found;
+    }
+
+    // finds the closest intersection of each ray i of the packet with 0 < t < packet.tMax[i],
+    // lowers packet.tMax[i] and sets hits[i] for the rays with an intersection
+    // returns the mask of the rays with an intersection
+    uint64_t intersect(accel::RayPacket& packet, Hit* hits) const {
+        const uint64_t found = _bvh.intersect(
+            packet, [&](const accel::BvhNode& leaf, uint32_t index, float& tClosest) {
+                return intersectLeaf(leaf, packet.ray(index), tClosest, hits[index],
+                                     std::index_sequence_for<Ts...>{});
+            });
+        stats::countHits(std::popcount(found));
+        return found;
+    }
+
+    // returns true iff any object intersects the ray with 0 < t < tMax, e.g. for shadow rays
+    // stops at the first such object and computes no attributes of the intersection
+    bool occluded(const Ray3df& ray, float tMax) const {
+        const bool found = _bvh.occluded(ray, tMax, [&](const accel::BvhNode& leaf) {
+            return occludedLeaf(leaf, ray, tMax, std::index_sequence_for<Ts...>{});
+        });
+        stats::countHits(found);
+        return found;
+    }
+
+  private:
+    // dispatches the leaf to the batch of its object type
+    template <size_t... I>
+    bool intersectLeaf(const accel::BvhNode& leaf, const Ray3df& ray, float& tMax, Hit& hit,
+                       std::index_sequence<I...>) const {
+        bool found = false;
+        auto intersectBatch = [&](const auto& batch) {
+            found = batch.intersect(leaf.first, leaf.count, ray, tMax, hit);
+            return true;
+        };
+        ((leaf.group == I && intersectBatch(std::get<I>(_batches))) || ...);
+        return found;
+    }
+
+    template <size_t... I>
+    bool occludedLeaf(const accel::BvhNode& leaf, const Ray3df& ray, float tMax,
+                      std::index_sequence<I...>) const {
+        return ((leaf.group == I && std::get<I>(_batches).occluded(leaf.first, leaf.count, ray,
+                                                                    tMax)) ||
+                ...);
+    }
+
+    template <size_t... I>
+    AABB3df objectBounds(uint16_t group, uint32_t index, std::index_sequence<I...>) const {
+        std::optional<AABB3df> bounds;
+        ((group == I && (bounds.emplace(std::get<I>(_batches).objects()[index].bounds()), true)) ||
+         ...);
+        return *bounds;
+    }
+
+    template <typename F> void forEachBatchIndexed(F&& f) {
+        [&]<size_t... I>(std::index_sequence<I...>) {
+            (f(std::get<I>(_batches), static_cast<uint16_t>(I)), ...);
+        }(std::index_sequence_for<Ts...>{});
+    }
+
+    std::tuple<ObjectBatch<Ts>...> _batches;
+    accel::Bvh                     _bvh;
+};
+
+// the object types of the scenes rendered by the raytracer
+using Scene = PartitionedScene<SphereObject, TriangleObject, SmoothTriangleObject, MeshObject,
+                               InstanceObject>;
+
+// returns the closest intersection of the ray with the objects of the scene, if any
+template <HittableObject... Ts>
+std::optional<Hit> findClosestHit(const Ray3df& ray, const PartitionedScene<Ts...>& scene) {
+    Hit   hit{};
+    float tMax = std::numeric_limits<float>::infinity();
+    if (!scene.intersect(ray, tMax, hit)) {
+        return std::nullopt;
+    }
+    return hit;
+}
+
+// returns true iff any object of the scene intersects the ray with 0 < t < tMax
+template <HittableObject... Ts>
+bool occluded(const Ray3df& ray, float tMax, const PartitionedScene<Ts...>& scene) {
+    return scene.occluded(ray, tMax);
+}
+
+}  // namespace rt::world
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "mesh.h"
+#include "thread_pool.h"
+#include "world.h"
+
+namespace rt::world {
+
+// The version of the layout of cache files, files of other versions are not read.
+// Increase it with every change of the layout or of how meshes and hierarchies are built.
+constexpr uint32_t MESH_CACHE_VERSION = 1;
+
+// A fast 64-bit hash of the bytes, to detect changes of the source of a cache, not secure
+uint64_t contentHash(std::string_view bytes, uint64_t seed = 0);
+
+// the hash of a material, to combine with the hash of the geometry as seed
+uint64_t contentHash(const Material& material, uint64_t seed = 0);
+
+// Writes the mesh with its hierarchy and the material into a cache file. The arrays are stored
+// as they are in memory at 64 byte aligned offsets from the start of the file, so mapMeshCache
+// uses them in place. sourceHash identifies the source the mesh was created from.
+// The file is written under a temporary name and renamed, so readers never see half a file.
+// throws std::runtime_error if the file can not be written
+void writeMeshCache(const std::string& path, const Mesh& mesh, const Material& material,
+                    uint64_t sourceHash);
+
+// Maps a cache file written by writeMeshCache, the mesh then reads the mapped file.
+// Nothing is copied or converted, the pages are loaded on first access, except for one pass
+// over the indices and nodes that checks their ranges, see Mesh(View, storage).
+// returns nothing if the file is missing, of another version or byte order, was written for
+// another source hash, is truncated or its indices or nodes are out of range
+std::optional<MeshObject> mapMeshCache(const std::string& path, uint64_t sourceHash);
+
+// How loadObjMeshCached obtained the mesh
+struct MeshCacheStatistics {
+    bool   fromCache        = false;  // mapped, otherwise parsed and built
+    bool   cacheWritten     = false;  // parsed and the cache written anew, which may fail
+    double hashMilliseconds = 0.0;    // hashing the OBJ file
+    double loadMilliseconds = 0.0;    // mapping, or parsing, building and writing
+};
+
+// Loads an OBJ file as one mesh as loadObjMesh, but through a cache file: the cache is mapped if
+// it was written for the same contents of the OBJ file and the same material, otherwise the OBJ
+// file is parsed and the cache is written anew. A cache that can not be written, e.g. in a
+// read-only directory, is skipped and the parsed mesh returned, see MeshCacheStatistics.
+// throws std::runtime_error if the OBJ file can not be read or is malformed
+MeshObject loadObjMeshCached(const std::string& objPath, const std::string& cachePath,
+                             const Material& material, parallel::ThreadPool& pool,
+                             MeshCacheStatistics* statistics = nullptr);
+
+}  // namespace rt::world
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "thread_pool.h"
+#include "camera.h"
+#include "viewport.h"
+#include "world.h"
+#include "scene.h"
+
+namespace rt::world {
+
+// The camera of a scene file, the defaults are the camera of the programs without scene file
+struct CameraSettings {
+    Vector3df position{0.0f, 0.0f, 10.0f};
+    Vector3df direction{0.0f, 0.0f, -1.0f};  // normalised
+    float     viewportWidth  = 0.0f;         // 0 keeps the aspect ratio of the image
+    float     viewportHeight = 2.0f;
+    float     focalLength    = 20.0f;  // the distance of the viewport in front of the camera
+
+    // the viewport for an image of the given size, of a camera at the origin looking down -z
+    view::Viewport viewport(int pixelWidth, int pixelHeight) const;
+
+    // The camera at position looking along direction through the viewport, which has to outlive
+    // it. The viewport is set up at the origin and the pose of the camera moves the whole view,
+    // see camera::lookAlong.
+    camera::Camera camera(view::Viewport& viewport) const;
+};
+
+// What a scene file describes besides the objects added to the scene
+struct SceneFile {
+    std::vector<PointLight> lights;
+    CameraSettings          camera;
+    size_t                  objects = 0;
+};
+
+// Loads a scene file into the scene, which has to be built afterwards. A scene file is a text
+// file with one statement per line, fields separated by spaces, # starts a comment:
+//   material <name> [diffuse r g b] [ambient r g b] [specular r g b] [shininess s]
+//            [reflectivity r]     defines a material for the following objects, unset
+//                                 properties keep the defaults of Material
+//   sphere <material> x y z radius
+//   triangle <material> ax ay az bx by bz cx cy cz
+//   mesh <material> <path> [translate x y z] [rotate ax ay az degrees] [scale s | scale x y z]
+//            an OBJ file as one mesh through its cache <path>.cache, see loadObjMeshCached.
+//            The path is relative to the scene file. The transformations are applied in the
+//            order given and make the mesh an instance.
+//   light x y z [r g b]
+//   camera x y z dx dy dz         the position and the viewing direction, the view is not rolled
+//   viewport width height focal   the size of the viewport in scene units, width 0 keeps the
+//                                 aspect ratio of the image, and its distance in front of the
+//                                 camera
+// The file is parsed line by line in one pass, objects are added to the scene as they are read.
+// throws std::runtime_error if a file can not be read or a statement is malformed, the message
+// names the line
+SceneFile loadSceneFile(const std::string& path, Scene& scene, parallel::ThreadPool& pool);
+
+// the same for the contents of a scene file in memory, name is used in error messages and
+// mesh paths are relative to directory
+SceneFile parseSceneFile(std::string_view contents, const std::string& name,
+                         const std::string& directory, Scene& scene, parallel::ThreadPool& pool);
+
+}  // namespace rt::world
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "math.h"
+#include "geometry.h"
+#include "world.h"
+#include "scene.h"
+
+namespace rt::render {
+
+// Shadow rays start this far above the surface, relative to the distance of the hit point from
+// the origin of the ray, so they do not hit the surface they start on. The rounding error of the
+// hit point grows with that distance.
+constexpr float SHADOW_RAY_OFFSET = 1e-4f;
+
+// the unit normal of the hit on the side of the surface facing the ray
+inline Vector3df facingNormal(const Ray3df& ray, const world::Hit& hit) {
+    Vector3df normal = hit.normal;
+    normal.normalize();
+    if (normal * ray.direction > 0.0f) {
+        normal = -1.0f * normal;
+    }
+    return normal;
+}
+
+// the point of the hit moved off the surface along the facing normal, by the same offset as the
+// origin of shadow rays
+inline Vector3df offsetHitPoint(const Ray3df& ray, const world::Hit& hit, const Vector3df& normal) {
+    const Vector3df point = ray.origin + hit.t * ray.direction;
+    return point + (SHADOW_RAY_OFFSET * std::max(1.0f, hit.t)) * normal;
+}
+
+// the ray mirrored at the surface of the hit, leaving on the side the ray came from
+inline Ray3df reflectedRay(const Ray3df& ray, const world::Hit& hit) {
+    const Vector3df normal    = facingNormal(ray, hit);
+    Vector3df       direction = ray.direction.get_reflective(normal);
+    direction.normalize();
+    return Ray3df{offsetHitPoint(ray, hit, normal), direction};
+}
+
+// Lambertian shading of the point where the ray hits the scene: the ambient part of the material
+// plus the diffuse part of each light that is not occluded from the point, weighted by the cosine
+// between the normal and the direction to the light. The diffuse part is divided by the number
+// of lights. The side of the surface facing the ray is shaded.
+// Adds the number of traced shadow rays to shadowRays.
+template <typename Scene>
+Vector3df shadeLambertian(const Ray3df& ray, const world::Hit& hit, const Scene& scene,
+                          const std::vector<world::PointLight>& lights, uint64_t& shadowRays) {
+    const world::Material& material = *hit.material;
+
+    const Vector3df normal = facingNormal(ray, hit);
+    const Vector3df origin = offsetHitPoint(ray, hit, normal);
+
+    Vector3df diffuse{0.0f, 0.0f, 0.0f};
+    for (const auto& light : lights) {
+        Vector3df   toLight  = light.position - origin;
+        const float distance = toLight.length();
+        toLight /= distance;
+
+        const float cosine = normal * toLight;
+        if (cosine <= 0.0f) {
+            continue;
+        }
+        shadowRays++;
+        if (world::occluded(Ray3df{origin, toLight}, distance, scene)) {
+            continue;
+        }
+        for (size_t i = 0; i < 3; i++) {
+            diffuse.vector[i] += cosine * light.color.vector[i];
+        }
+    }
+
+    const float lightWeight = lights.empty() ? 0.0f : 1.0f / static_cast<float>(lights.size());
+    Vector3df   color;
+    for (size_t i = 0; i < 3; i++) {
+        color.vector[i] = material.diffuse.vector[i] *
+                          (material.ambient.vector[i] + lightWeight * diffuse.vector[i]);
+    }
+    return color;
+}
+
+}  // namespace rt::render
@@ -0,0 +1,34 @@
+#pragma once
+
+// The vectorised kernels are only written for x86-64 processors, where SSE2 is always available.
+// Other processors use the scalar kernels.
+#if defined(__x86_64__) || defined(_M_X64)
+#define RT_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+// GCC and Clang only emit AVX2 instructions in functions marked for it, the rest of the program
+// has to run on processors without AVX2. MSVC allows the intrinsics everywhere.
+#if defined(__GNUC__)
+#define RT_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define RT_TARGET_AVX2
+#endif
+
+namespace rt::simd {
+
+// The instruction set extensions the vectorised kernels are written for, in ascending order.
+// Each level implies the levels below it. Sse means SSE2 with 4 float lanes, Avx2 has 8 lanes.
+enum class Level { Scalar, Sse, Avx2 };
+
+// returns the highest level supported by the processor and the operating system
+Level detectLevel();
+
+// Returns the level the kernels use: the detected level, lowered by the environment variable
+// RT_SIMD (scalar, sse or avx2) if it is set. Requesting a level above the detected one has no
+// effect. Determined once, on the first call.
+Level activeLevel();
+
+const char* levelName(Level level);
+
+}  // namespace rt::simd
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+
+namespace rt::stats {
+
+// The work of the traversal: the nodes of bounding volume hierarchies visited, the primitives
+// tested in their leaves and the queries that found an intersection, by closest hit or
+// occlusion. Nested hierarchies, e.g. of the meshes in a scene, count their nodes and triangles
+// as well.
+struct TraversalCounters {
+    uint64_t nodesVisited   = 0;
+    uint64_t primitiveTests = 0;
+    uint64_t hits           = 0;
+
+    TraversalCounters& operator+=(const TraversalCounters& other) {
+        nodesVisited += other.nodesVisited;
+        primitiveTests += other.primitiveTests;
+        hits += other.hits;
+        return *this;
+    }
+
+    friend TraversalCounters operator-(TraversalCounters a, const TraversalCounters& b) {
+        a.nodesVisited -= b.nodesVisited;
+        a.primitiveTests -= b.primitiveTests;
+        a.hits -= b.hits;
+        return a;
+    }
+};
+
+// The counters are only compiled in with RT_STATS defined, see the RAYTRACER_STATS option of
+// the build. Without it the functions below are empty and the traversal counts nothing.
+#ifdef RT_STATS
+constexpr bool ENABLED = true;
+
+// The counters of the calling thread, incremented by the traversal without synchronisation.
+// They only ever grow, readers take the difference of two snapshots, see forEachTile.
+inline constinit thread_local TraversalCounters threadCounters{};
+
+inline void countNodes(uint64_t count) {
+    threadCounters.nodesVisited += count;
+}
+
+inline void countPrimitiveTests(uint64_t count) {
+    threadCounters.primitiveTests += count;
+}
+
+inline void countHits(uint64_t count) {
+    threadCounters.hits += count;
+}
+
+// a snapshot of the counters of the calling thread
+inline TraversalCounters snapshot() {
+    return threadCounters;
+}
+#else
+constexpr bool ENABLED = false;
+
+inline void countNodes(uint64_t) {}
+inline void countPrimitiveTests(uint64_t) {}
+inline void countHits(uint64_t) {}
+
+inline TraversalCounters snapshot() {
+    return {};
+}
+#endif
+
+}  // namespace rt::stats
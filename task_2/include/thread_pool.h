@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rt::parallel {
+
+// A fixed set of worker threads executing batches of indexed tasks.
+// Every worker owns a queue of task indices, it takes tasks from the front of its own queue
+// and steals from the back of the queues of the other workers once its own queue is empty.
+// Thereby workers that got cheap tasks help out workers that got expensive ones.
+class ThreadPool {
+  public:
+    // the task receives the task index and the index of the executing worker in [0, size())
+    using Task = std::function<void(size_t index, unsigned worker)>;
+
+    // creates a pool with the given number of worker threads,
+    // 0 selects the number of hardware threads
+    explicit ThreadPool(unsigned threadCount = 0);
+
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&)            = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // returns the number of worker threads
+    unsigned size() const {
+        return static_cast<unsigned>(_workers.size());
+    }
+
+    // executes task(index, worker) for each index in [0, count) on the worker threads
+    // returns after all tasks have finished
+    void parallelFor(size_t count, Task task);
+
+  private:
+    struct alignas(64) Queue {
+        std::mutex         mutex;
+        std::deque<size_t> indices;
+    };
+
+    void workerLoop(unsigned worker);
+    bool takeTask(unsigned worker, size_t& index);
+
+    std::vector<std::thread>            _workers;
+    std::vector<std::unique_ptr<Queue>> _queues;
+
+    std::mutex              _mutex;
+    std::condition_variable _wakeUp;
+    std::condition_variable _finished;
+    Task                    _task;
+    size_t                  _generation = 0;
+    bool                    _stop       = false;
+    std::atomic<size_t>     _remaining{0};
+};
+
+}  // namespace rt::parallel
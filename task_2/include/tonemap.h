@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "framebuffer.h"
+
+namespace rt::fb {
+
+// The layout of a packed 8-bit RGB pixel in memory, e.g. of an SDL surface.
+// Pixels of 4 bytes are stored as native 32-bit integers, the shifts are the positions of the
+// channels within it. Pixels of 3 bytes are stored byte by byte, the shift divided by 8 is the
+// byte of the channel.
+struct PixelLayout {
+    int      bytesPerPixel = 4;  // 3 or 4
+    int      redShift      = 16;
+    int      greenShift    = 8;
+    int      blueShift     = 0;
+    uint32_t fill          = 0;  // bits set in every pixel of 4 bytes, e.g. an opaque alpha
+};
+
+// the layout of binary PPM pixels, the bytes red, green, blue
+constexpr PixelLayout RGB_BYTES{.bytesPerPixel = 3, .redShift = 0, .greenShift = 8,
+                                .blueShift = 16};
+
+// Converts rows of a float framebuffer to packed 8-bit pixels.
+// The floats are scaled, clamped and quantised 4 at a time with SSE if available, a gamma other
+// than 1 is applied with a table indexed by the quantised value.
+class Tonemapper {
+  public:
+    explicit Tonemapper(const Tonemap& tonemap = {});
+
+    // converts count floats to bytes, count must be a multiple of 3 for RGB pixels
+    void quantize(const float* values, size_t count, uint8_t* bytes) const;
+
+    // Converts the rows [firstRow, firstRow + rowCount) of the framebuffer into the pixels at
+    // destination, the first byte of each row is pitch bytes after the first of the row before.
+    // Row firstRow is written to destination.
+    void convertRows(const MemoryFramebuffer& source, int firstRow, int rowCount,
+                     const PixelLayout& layout, uint8_t* destination, size_t pitch) const;
+
+  private:
+    float                _scale;
+    bool                 _linear;
+    std::vector<uint8_t> _table;  // the output of each quantised value for a gamma other than 1
+};
+
+}  // namespace rt::fb
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "math.h"
+#include "geometry.h"
+
+namespace rt {
+
+// An affine transformation p -> A p + b of points, e.g. to place an object in a scene.
+// Directions are only transformed by A, normals by the inverse transpose of A.
+class Transform {
+  public:
+    // the identity
+    Transform();
+
+    static Transform translation(const Vector3df& offset);
+    static Transform scaling(const Vector3df& factors);
+    static Transform scaling(float factor);
+    // rotates counter clockwise by angle radians about the axis through the origin
+    static Transform rotation(const Vector3df& axis, float angle);
+
+    // the transformation applying other first, then this
+    Transform operator*(const Transform& other) const;
+
+    // throws std::runtime_error if the transformation is not invertible
+    Transform inverse() const;
+
+    Vector3df point(const Vector3df& point) const;
+    Vector3df direction(const Vector3df& direction) const;
+
+    // applies the transpose of A, the transpose of the inverse transforms normals,
+    // i.e. inverse().transposedDirection(normal) is the transformed normal
+    Vector3df transposedDirection(const Vector3df& direction) const;
+
+    // the bounds of the transformed corners of the box
+    AABB3df bounds(const AABB3df& box) const;
+
+  private:
+    float _matrix[3][4];  // rows of A, b in the last column
+};
+
+}  // namespace rt
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "geometry.h"
+#include "simd.h"
+
+namespace rt::accel {
+
+// The closest intersection found by TriangleSoA::intersect
+struct TriangleHit {
+    uint32_t index;  // of the triangle
+    float    t;
+    float    u, v;  // barycentric coordinates of a and b, as in PrecomputedTriangle::intersects
+};
+
+// Triangles stored as structure of arrays: the x, y and z components of the point a and of the
+// edges b - a and c - a each in their own array. One ray is intersected with 4 (SSE) or 8 (AVX2)
+// consecutive triangles at once, the kernel is chosen at runtime by simd::activeLevel().
+// The results are the same as with PrecomputedTriangle::intersects up to rounding.
+class TriangleSoA {
+  public:
+    // lanes of the widest kernel, the arrays are padded so any range can be loaded in full lanes
+    static constexpr uint32_t MAX_LANES = 8;
+
+    TriangleSoA();
+
+    void add(const PrecomputedTriangle3df& triangle);
+    // replaces the triangle at index < size()
+    void set(uint32_t index, const PrecomputedTriangle3df& triangle);
+    void reserve(size_t count);
+    void clear();
+
+    size_t size() const {
+        return _size;
+    }
+
+    // finds the closest intersection with 0 < t < tMax among the triangles [first, first + count)
+    // on success lowers tMax and sets hit
+    bool intersect(uint32_t first, uint32_t count, const Ray3df& ray, float& tMax,
+                   TriangleHit& hit) const;
+
+    // the same with the kernel of the given level, which has to be supported by the processor
+    bool intersect(simd::Level level, uint32_t first, uint32_t count, const Ray3df& ray,
+                   float& tMax, TriangleHit& hit) const;
+
+    // true iff any of the triangles [first, first + count) intersects the ray with 0 < t < tMax,
+    // stops at the first lanes with an intersection
+    bool occluded(uint32_t first, uint32_t count, const Ray3df& ray, float tMax) const;
+
+    bool occluded(simd::Level level, uint32_t first, uint32_t count, const Ray3df& ray,
+                  float tMax) const;
+
+    enum Component { AX, AY, AZ, ABX, ABY, ABZ, ACX, ACY, ACZ, COMPONENT_COUNT };
+
+    const float* component(Component component) const {
+        return _components[component].data();
+    }
+
+  private:
+    std::array<std::vector<float>, COMPONENT_COUNT> _components;
+    size_t                                          _size = 0;
+};
+
+}  // namespace rt::accel
@@ -4,12 +4,61 @@
 #include "geometry.h"
 
 namespace rt::view {
+
+// The projection of points onto the pixels of a viewport as seen from a camera, see
+// Viewport::project. The parts that only depend on the camera are computed once, so projecting
+// takes a few multiplications and one division per point.
+struct Projection {
+    Vector3df origin;          // the camera position
+    Vector3df toX, toY;        // pixelX = offsetX + (toX * q) / (normal * q), q = point - origin
+    Vector3df normal;          // normal * q > 0 for points in front of the camera
+    float     offsetX, offsetY;
+
+    // returns false if the point does not lie in front of the camera
+    bool operator()(const Vector3df& point, float& pixelX, float& pixelY) const {
+        const float q[3] = {point.vector[0] - origin.vector[0], point.vector[1] - origin.vector[1],
+                            point.vector[2] - origin.vector[2]};
+        const float w = normal.vector[0] * q[0] + normal.vector[1] * q[1] + normal.vector[2] * q[2];
+        if (!(w > 0.0f)) {
+            return false;
+        }
+        pixelX = offsetX + (toX.vector[0] * q[0] + toX.vector[1] * q[1] + toX.vector[2] * q[2]) / w;
+        pixelY = offsetY + (toY.vector[0] * q[0] + toY.vector[1] * q[1] + toY.vector[2] * q[2]) / w;
+        return true;
+    }
+};
+
 class Viewport {
   public:
     Viewport(float width, float height, float focalLength, int pixelWidth, int pixelHeight);
 
+    // the ray through the centre of the pixel, the same as generateDirections gives
     Ray3df generateRay(const Vector3df& cameraPosition, const Vector3df& cameraDirection,
-                       int pixelX, int pixelY);
+                       int pixelX, int pixelY) const;
+
+    // Writes the unit directions of the rays from the camera position through the centres of the
+    // count pixels starting at pixelX, pixelY of a row into directionX, directionY and
+    // directionZ, stepping from pixel to pixel by the pixel width. The direction of a pixel does
+    // not depend on the pixel the row starts with. They are normalised with the vectorised
+    // reciprocal square root if available, so the buffers need room for count rounded up to a
+    // multiple of 4 and have to be aligned to 16 bytes.
+    void generateDirections(const Vector3df& cameraPosition, int pixelX, int pixelY, int count,
+                            float* directionX, float* directionY, float* directionZ) const;
+
+    // the ray through the point offsetX, offsetY pixels from the centre of the pixel,
+    // offsets in [-0.5, 0.5] stay within the pixel
+    Ray3df generateRay(const Vector3df& cameraPosition, int pixelX, int pixelY, float offsetX,
+                       float offsetY) const;
+
+    // The pixel coordinates at which the line from the camera position through the point passes
+    // the viewport, pixel centres at whole numbers as for generateRay, the inverse of
+    // generateRay for points in front of the camera.
+    // returns false if the point does not lie in front of the camera
+    bool project(const Vector3df& cameraPosition, const Vector3df& point, float& pixelX,
+                 float& pixelY) const;
+
+    // the projection of project for many points seen from the camera position
+    Projection projection(const Vector3df& cameraPosition) const;
 
   private:
     Vector3df _u, _v;
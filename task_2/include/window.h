@@ -1,17 +1,18 @@
 #pragma once
 
 #include <SDL2/SDL.h>
+#include <functional>
 #include "math.h"
+#include "framebuffer.h"
+#include "tonemap.h"
 namespace rt::win {
 
 constexpr int         WINDOW_WIDTH  = 1000;
 constexpr int         WINDOW_HEIGTH = 1000;
 constexpr const char* WINDOW_TITLE  = "Raytracer";
 
-struct WindowPos {
-    int x;
-    int y;
-};
+// the surface is presented at most this often per second while rendering
+constexpr int DEFAULT_MAX_FPS = 30;
 
 class Window {
   public:
@@ -31,7 +32,34 @@ class Window {
     SDL_Surface* _surface{};
 };
 
-void setPixelColor(Window& window, WindowPos& pos, Uint32 color);
+// Tonemaps the framebuffer into the surface of the window in one pass and presents it.
+// The surface is locked if SDL requires it, rows are written with the pitch and in the pixel
+// format of the surface. Surfaces larger than the framebuffer keep their other pixels, nothing is
+// written to surfaces narrower than the framebuffer.
+// throws std::runtime_error for surfaces with other than 3 or 4 bytes per pixel
+void present(Window& window, const fb::MemoryFramebuffer& framebuffer,
+             const fb::Tonemapper& tonemapper);
+
+// Presents the framebuffer at most maxFramesPerSecond times per second until done() returns
+// true, then once more. Has to be called from the main thread, which handles the events of the
+// window meanwhile, while other threads write the framebuffer.
+// returns false if the window was closed before
+bool presentUntil(Window& window, const fb::MemoryFramebuffer& framebuffer,
+                  const fb::Tonemapper& tonemapper, const std::function<bool()>& done,
+                  int maxFramesPerSecond);
+
+// The input of the user for moving the camera, gathered by pollCameraControls
+struct CameraControls {
+    Vector3df move{0.0f, 0.0f, 0.0f};  // -1, 0 or 1 along the right, up and backward axes
+    float     turnX = 0.0f;            // the mouse motion in pixels while the left button was held
+    float     turnY = 0.0f;
+    bool      quit  = false;  // the window was closed or escape pressed
+};
+
+// Handles the pending events of the window and returns the camera controls: W, A, S and D move
+// forward, left, backward and right, E and Q or space and shift up and down while they are held,
+// dragging with the left mouse button turns the camera.
+CameraControls pollCameraControls();
 
 void waitForExit();
 
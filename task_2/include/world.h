@@ -1,11 +1,16 @@
 #pragma once
 
+#include <algorithm>
 #include <concepts>
+#include <functional>
+#include <limits>
 #include <memory>
 #include <variant>
 #include <optional>
+#include <vector>
 
 #include "geometry.h"
+#include "bvh.h"
 
 namespace rt::world {
 
@@ -27,6 +32,7 @@ template <typename T>
 concept Intersectable =
     requires(const T& t, const Ray3df& ray, Intersection_Context<float, 3> context) {
         { t.intersects(ray, context) } -> std::same_as<bool>;
+        { t.bounds() } -> std::same_as<AABB3df>;
     };
 
 template <Intersectable T> class GeometricObject {
@@ -40,6 +46,8 @@ template <Intersectable T> class GeometricObject {
     GeometricObject(const Vector3df& a, const Vector3df& b, const Vector3df& c,
                     const Material& material)
         : geoObject(a, b, c), mat(material) {};
+    GeometricObject(const T& object, const Material& material)
+        : geoObject(object), mat(material) {};
 
     bool intersect(const Ray3df& ray, float& tHit, Vector3df& normal) const {
         Intersection_Context<float, 3> context;
@@ -51,20 +59,63 @@ template <Intersectable T> class GeometricObject {
         return hit;
     }
 
+    // as intersect, but only finds intersections with t < tMax,
+    // T may use the bound to skip work, e.g. the subtrees of a mesh behind a closer object
+    bool intersect(const Ray3df& ray, float tMax, float& tHit, Vector3df& normal) const {
+        if constexpr (requires(Intersection_Context<float, 3> context) {
+                          { geoObject.intersects(ray, context, tMax) } -> std::same_as<bool>;
+                      }) {
+            Intersection_Context<float, 3> context;
+            if (!geoObject.intersects(ray, context, tMax)) {
+                return false;
+            }
+            tHit   = context.t;
+            normal = context.normal;
+            return true;
+        } else {
+            return intersect(ray, tHit, normal) && tHit < tMax;
+        }
+    }
+
+    // true iff the ray intersects the object with 0 < t < tMax,
+    // computes no attributes of the intersection if T supports that
+    bool occludes(const Ray3df& ray, float tMax) const {
+        if constexpr (requires { { geoObject.occludes(ray, tMax) } -> std::same_as<bool>; }) {
+            return geoObject.occludes(ray, tMax);
+        } else if constexpr (requires { { geoObject.intersects(ray) } -> std::same_as<float>; }) {
+            const float t = geoObject.intersects(ray);
+            return t > 0 && t < tMax;
+        } else {
+            Intersection_Context<float, 3> context;
+            return geoObject.intersects(ray, context) && context.t > 0 && context.t < tMax;
+        }
+    }
+
     const Material& material() const {
         return mat;
     }
+
+    AABB3df bounds() const {
+        return geoObject.bounds();
+    }
+
+    const T& geometry() const {
+        return geoObject;
+    }
 };
 
 // Conveniece typedefs
-typedef GeometricObject<Sphere3df>   SphereObject;
-typedef GeometricObject<Triangle3df> TriangleObject;
+typedef GeometricObject<Sphere3df>              SphereObject;
+typedef GeometricObject<PrecomputedTriangle3df> TriangleObject;
+typedef GeometricObject<SmoothTriangle3df>      SmoothTriangleObject;
 
 // Type erasure concept
 template <typename T>
 concept HittableObject = requires(const T& t, const Ray3df& r, float& tHit, Vector3df& n) {
     { t.material() } -> std::same_as<const Material&>;
     { t.intersect(r, tHit, n) } -> std::same_as<bool>;
+    { t.occludes(r, tHit) } -> std::same_as<bool>;
+    { t.bounds() } -> std::same_as<AABB3df>;
 };
 
 // Type-erased wrapper class
@@ -73,6 +124,8 @@ class Hittable {
     struct ConceptBase {
         virtual const Material& material() const                                        = 0;
         virtual bool intersect(const Ray3df& ray, float& tHit, Vector3df& normal) const = 0;
+        virtual bool occludes(const Ray3df& ray, float tMax) const                      = 0;
+        virtual AABB3df bounds() const                                                  = 0;
         virtual ~ConceptBase()                                                          = default;
     };
 
@@ -87,6 +140,14 @@ class Hittable {
         bool intersect(const Ray3df& ray, float& tHit, Vector3df& normal) const override {
             return object.intersect(ray, tHit, normal);
         }
+
+        bool occludes(const Ray3df& ray, float tMax) const override {
+            return object.occludes(ray, tMax);
+        }
+
+        AABB3df bounds() const override {
+            return object.bounds();
+        }
     };
 
     std::unique_ptr<ConceptBase> ptr;
@@ -101,11 +162,59 @@ class Hittable {
     bool intersect(const Ray3df& ray, float& tHit, Vector3df& normal) const {
         return ptr->intersect(ray, tHit, normal);
     }
+
+    bool occludes(const Ray3df& ray, float tMax) const {
+        return ptr->occludes(ray, tMax);
+    }
+
+    AABB3df bounds() const {
+        return ptr->bounds();
+    }
+};
+
+// The objects of a scene together with a bounding volume hierarchy built once over them.
+// The objects are stored in the leaf order of the hierarchy.
+class SceneBvh {
+  public:
+    explicit SceneBvh(std::vector<Hittable> objects);
+
+    const std::vector<Hittable>& objects() const {
+        return _objects;
+    }
+
+    const accel::Bvh& bvh() const {
+        return _bvh;
+    }
+
+  private:
+    std::vector<Hittable> _objects;
+    accel::Bvh            _bvh;
+};
+
+// The closest intersection of a ray with the objects of a scene
+struct Hit {
+    float           t;
+    Vector3df       normal;  // points away from the surface, not necessarily normalized
+    const Material* material;
+};
+
+// A point light source, colour components above 1 make it brighter
+struct PointLight {
+    Vector3df position;
+    Vector3df color{1.0f, 1.0f, 1.0f};
 };
 
+// the lights of the Cornell box of createScene
+inline std::vector<PointLight> createLights() {
+    return {PointLight{.position = Vector3df{0.0f, 0.9f, -20.0f}},
+            PointLight{.position = Vector3df{0.5f, 0.8f, -3.0f}}};
+}
+
 // Helper function to create a world with various objects
-inline std::vector<Hittable> createScene() {
-    std::vector<Hittable> objects;
+// SceneType is any container of objects with emplace_back, e.g. std::vector<Hittable>,
+// it is built with build() afterwards if it has such a method
+template <typename SceneType = std::vector<Hittable>> SceneType createScene() {
+    SceneType objects;
 
     // Materials
     Material redMaterial;
@@ -115,7 +224,8 @@ inline std::vector<Hittable> createScene() {
     greenMaterial.diffuse = Vector3df{0.1f, 0.9f, 0.1f};
 
     Material whiteMaterial;
-    whiteMaterial.diffuse = Vector3df{0.9f, 0.9f, 0.9f};
+    whiteMaterial.diffuse      = Vector3df{0.9f, 0.9f, 0.9f};
+    whiteMaterial.reflectivity = 0.5f;
 
     Material wallMaterial;
     wallMaterial.diffuse = Vector3df{0.8f, 0.8f, 0.8f};
@@ -159,6 +269,9 @@ inline std::vector<Hittable> createScene() {
 
     objects.emplace_back(SphereObject(Vector3df{-0.1f, -0.5f, -8.0f}, 0.3f, whiteMaterial));
 
+    if constexpr (requires { objects.build(); }) {
+        objects.build();
+    }
     return objects;
 };
 
@@ -179,4 +292,67 @@ findVisibleObject(const Ray3df& ray, const std::vector<Hittable>& scene) {
     return visibleObject;
 }
 
+// Same as the linear scan above, but only tests the objects in the leaves of the hierarchy
+// that are pierced by the ray, closest first.
+inline std::optional<std::reference_wrapper<const Hittable>>
+findVisibleObject(const Ray3df& ray, const SceneBvh& scene) {
+    const auto&     objects       = scene.objects();
+    const Hittable* visibleObject = nullptr;
+    float           minT          = std::numeric_limits<float>::infinity();
+
+    scene.bvh().intersect(ray, minT, [&](const accel::BvhNode& leaf, float& tMax) {
+        bool hit = false;
+        for (uint32_t i = leaf.first; i < leaf.first + leaf.count; i++) {
+            float     t;
+            Vector3df normal;
+            if (objects[i].intersect(ray, t, normal) && t > 0 && t < tMax) {
+                visibleObject = &objects[i];
+                tMax          = t;
+                hit           = true;
+            }
+        }
+        return hit;
+    });
+
+    if (visibleObject == nullptr) {
+        return std::nullopt;
+    }
+    return std::cref(*visibleObject);
+}
+
+// Returns true iff any object intersects the ray with 0 < t < tMax, e.g. for shadow rays.
+// Stops at the first such object and computes no attributes of the intersection.
+inline bool occluded(const Ray3df& ray, float tMax, const std::vector<Hittable>& scene) {
+    return std::any_of(scene.begin(), scene.end(),
+                       [&](const Hittable& object) { return object.occludes(ray, tMax); });
+}
+
+// Same as the linear scan above, but only tests the objects in the leaves pierced by the ray
+inline bool occluded(const Ray3df& ray, float tMax, const SceneBvh& scene) {
+    const auto& objects = scene.objects();
+    return scene.bvh().occluded(ray, tMax, [&](const accel::BvhNode& leaf) {
+        for (uint32_t i = leaf.first; i < leaf.first + leaf.count; i++) {
+            if (objects[i].occludes(ray, tMax)) {
+                return true;
+            }
+        }
+        return false;
+    });
+}
+
+// returns the closest intersection of the ray with the objects, if any
+template <typename Objects>
+    requires requires(const Ray3df& ray, const Objects& objects) {
+        findVisibleObject(ray, objects);
+    }
+std::optional<Hit> findClosestHit(const Ray3df& ray, const Objects& objects) {
+    auto object = findVisibleObject(ray, objects);
+    if (!object.has_value()) {
+        return std::nullopt;
+    }
+    Hit hit{.t = 0.0f, .normal = {}, .material = &object.value().get().material()};
+    object.value().get().intersect(ray, hit.t, hit.normal);
+    return hit;
+}
+
 }  // namespace rt::world
\ No newline at end of file
@@ -14,5 +14,9 @@ template class Sphere<float, 3u>;
 
 template class Triangle<float, 3u>;
 
+template class PrecomputedTriangle<float, 3u>;
+
+template class SmoothTriangle<float, 3u>;
+
 template bool refract<float, 3u>(float refraction_index, Vector<float, 3u> normal,
                                  Vector<float, 3u> direction, Vector<float, 3>& transmission);
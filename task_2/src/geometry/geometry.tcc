@@ -3,6 +3,54 @@ AxisAlignedBoundingBox<FLOAT, N>::AxisAlignedBoundingBox(Vector<FLOAT, N> center
                                                          Vector<FLOAT, N> half_edge_length)
     : center(center), half_edge_length(half_edge_length) {}
 
+template <class FLOAT, size_t N>
+AxisAlignedBoundingBox<FLOAT, N>
+AxisAlignedBoundingBox<FLOAT, N>::from_corners(Vector<FLOAT, N> lower, Vector<FLOAT, N> upper) {
+    return AxisAlignedBoundingBox<FLOAT, N>(static_cast<FLOAT>(0.5) * (lower + upper),
+                                            static_cast<FLOAT>(0.5) * (upper - lower));
+}
+
+template <class FLOAT, size_t N>
+Vector<FLOAT, N> AxisAlignedBoundingBox<FLOAT, N>::get_center() const {
+    return center;
+}
+
+template <class FLOAT, size_t N>
+Vector<FLOAT, N> AxisAlignedBoundingBox<FLOAT, N>::lower_corner() const {
+    return center - half_edge_length;
+}
+
+template <class FLOAT, size_t N>
+Vector<FLOAT, N> AxisAlignedBoundingBox<FLOAT, N>::upper_corner() const {
+    return center + half_edge_length;
+}
+
+template <class FLOAT, size_t N>
+AxisAlignedBoundingBox<FLOAT, N>
+AxisAlignedBoundingBox<FLOAT, N>::merge(AxisAlignedBoundingBox<FLOAT, N> aabb) const {
+    Vector<FLOAT, N> lower = lower_corner(), upper = upper_corner();
+    Vector<FLOAT, N> other_lower = aabb.lower_corner(), other_upper = aabb.upper_corner();
+    for (size_t i = 0; i < N; i++) {
+        lower[i] = std::min(lower[i], other_lower[i]);
+        upper[i] = std::max(upper[i], other_upper[i]);
+    }
+    return from_corners(lower, upper);
+}
+
+template <class FLOAT, size_t N> FLOAT AxisAlignedBoundingBox<FLOAT, N>::surface_area() const {
+    if (N == 2) {
+        return 4.0 * (half_edge_length[0] + half_edge_length[1]);
+    }
+    // each pair of axes spans two opposing faces with edge lengths 2 * half_edge_length
+    FLOAT area = 0.0;
+    for (size_t i = 0; i < N; i++) {
+        for (size_t j = i + 1; j < N; j++) {
+            area += 8.0 * half_edge_length[i] * half_edge_length[j];
+        }
+    }
+    return area;
+}
+
 template <class FLOAT, size_t N>
 bool AxisAlignedBoundingBox<FLOAT, N>::intersects(AxisAlignedBoundingBox<FLOAT, N> aabb) const {
     bool intersects = true;
@@ -81,6 +129,15 @@ template <class FLOAT, size_t N> bool Sphere<FLOAT, N>::inside(const Vector<FLOA
     return distance_squared <= radius * radius;
 }
 
+template <class FLOAT, size_t N>
+AxisAlignedBoundingBox<FLOAT, N> Sphere<FLOAT, N>::bounds() const {
+    Vector<FLOAT, N> half_edge_length;
+    for (size_t i = 0; i < N; i++) {
+        half_edge_length[i] = radius;
+    }
+    return AxisAlignedBoundingBox<FLOAT, N>(center, half_edge_length);
+}
+
 template <class FLOAT, size_t N>
 Sphere<FLOAT, N>::Sphere(Vector<FLOAT, N> center, FLOAT radius) : center(center), radius(radius) {}
 
@@ -184,6 +241,125 @@ bool Triangle<FLOAT, N>::intersects(const Ray<FLOAT, N>& ray, Vector<FLOAT, N>&
     return true;
 }
 
+template <class FLOAT, size_t N>
+AxisAlignedBoundingBox<FLOAT, N> Triangle<FLOAT, N>::bounds() const {
+    Vector<FLOAT, N> lower = a, upper = a;
+    for (size_t i = 0; i < N; i++) {
+        lower[i] = std::min({a[i], b[i], c[i]});
+        upper[i] = std::max({a[i], b[i], c[i]});
+    }
+    return AxisAlignedBoundingBox<FLOAT, N>::from_corners(lower, upper);
+}
+
+// scalar and cross product of the first three components, written out so that they are inlined
+// into the intersection tests
+template <class FLOAT, size_t N>
+static inline FLOAT dot3(const Vector<FLOAT, N>& a, const Vector<FLOAT, N>& b) {
+    return a.vector[0] * b.vector[0] + a.vector[1] * b.vector[1] + a.vector[2] * b.vector[2];
+}
+
+template <class FLOAT, size_t N>
+static inline Vector<FLOAT, N> cross3(const Vector<FLOAT, N>& a, const Vector<FLOAT, N>& b) {
+    Vector<FLOAT, N> result;
+    result.vector[0] = a.vector[1] * b.vector[2] - a.vector[2] * b.vector[1];
+    result.vector[1] = a.vector[2] * b.vector[0] - a.vector[0] * b.vector[2];
+    result.vector[2] = a.vector[0] * b.vector[1] - a.vector[1] * b.vector[0];
+    return result;
+}
+
+template <class FLOAT, size_t N>
+PrecomputedTriangle<FLOAT, N>::PrecomputedTriangle(Vector<FLOAT, N> a, Vector<FLOAT, N> b,
+                                                   Vector<FLOAT, N> c)
+    : a(a), edge_ab(b - a), edge_ac(c - a), normal(cross3(edge_ab, edge_ac)) {}
+
+template <class FLOAT, size_t N>
+bool PrecomputedTriangle<FLOAT, N>::intersection(const Ray<FLOAT, N>& ray, FLOAT& t, FLOAT& u_b,
+                                                 FLOAT& u_c) const {
+    // same as Triangle::intersects, the determinant is -normal * direction
+    const FLOAT EPSILON = 10e-7;
+
+    const Vector<FLOAT, N> p_vector    = cross3(ray.direction, edge_ac);
+    const FLOAT            determinant = dot3(edge_ab, p_vector);
+    if (fabs(determinant) < EPSILON) {  // ray parallel to the triangle, backface culling off
+        return false;
+    }
+    const FLOAT inverse_determinant = static_cast<FLOAT>(1.0) / determinant;
+
+    Vector<FLOAT, N> a_to_origin;
+    for (size_t i = 0; i < 3; i++) {
+        a_to_origin.vector[i] = ray.origin.vector[i] - a.vector[i];
+    }
+
+    // barycentric coordinates of b and c
+    u_b = dot3(a_to_origin, p_vector) * inverse_determinant;
+    if (u_b < 0.0 || u_b > 1.0) {
+        return false;
+    }
+
+    const Vector<FLOAT, N> q_vector = cross3(a_to_origin, edge_ab);
+    u_c                             = dot3(ray.direction, q_vector) * inverse_determinant;
+    if (u_c < 0.0 || u_b + u_c > 1.0) {
+        return false;
+    }
+
+    t = dot3(edge_ac, q_vector) * inverse_determinant;
+    return t >= 0.0;
+}
+
+template <class FLOAT, size_t N>
+bool PrecomputedTriangle<FLOAT, N>::intersects(const Ray<FLOAT, N>&            ray,
+                                               Intersection_Context<FLOAT, N>& context) const {
+    FLOAT t, u_b, u_c;
+    if (!intersection(ray, t, u_b, u_c)) {
+        return false;
+    }
+
+    context.t = t;
+    context.u = static_cast<FLOAT>(1.0) - u_b - u_c;
+    context.v = u_b;
+    for (size_t i = 0; i < 3; i++) {
+        context.intersection.vector[i] = ray.origin.vector[i] + t * ray.direction.vector[i];
+    }
+    context.normal = normal;
+    return true;
+}
+
+template <class FLOAT, size_t N>
+FLOAT PrecomputedTriangle<FLOAT, N>::intersects(const Ray<FLOAT, N>& ray) const {
+    FLOAT t, u_b, u_c;
+    return intersection(ray, t, u_b, u_c) ? t : 0;
+}
+
+template <class FLOAT, size_t N>
+AxisAlignedBoundingBox<FLOAT, N> PrecomputedTriangle<FLOAT, N>::bounds() const {
+    const Vector<FLOAT, N> b = a + edge_ab, c = a + edge_ac;
+    Vector<FLOAT, N>       lower = a, upper = a;
+    for (size_t i = 0; i < N; i++) {
+        lower[i] = std::min({a[i], b[i], c[i]});
+        upper[i] = std::max({a[i], b[i], c[i]});
+    }
+    return AxisAlignedBoundingBox<FLOAT, N>::from_corners(lower, upper);
+}
+
+template <class FLOAT, size_t N> Vector<FLOAT, N> PrecomputedTriangle<FLOAT, N>::get_a() const {
+    return a;
+}
+
+template <class FLOAT, size_t N>
+Vector<FLOAT, N> PrecomputedTriangle<FLOAT, N>::get_edge_ab() const {
+    return edge_ab;
+}
+
+template <class FLOAT, size_t N>
+Vector<FLOAT, N> PrecomputedTriangle<FLOAT, N>::get_edge_ac() const {
+    return edge_ac;
+}
+
+template <class FLOAT, size_t N>
+Vector<FLOAT, N> PrecomputedTriangle<FLOAT, N>::get_normal() const {
+    return normal;
+}
+
 template <class FLOAT, size_t N>
 bool refract(FLOAT refraction_index, Vector<FLOAT, N> normal, Vector<FLOAT, N> direction,
              Vector<FLOAT, N>& transmission) {
@@ -199,3 +375,34 @@ bool refract(FLOAT refraction_index, Vector<FLOAT, N> normal, Vector<FLOAT, N> d
 
     return true;
 }
+
+template <class FLOAT, size_t N>
+SmoothTriangle<FLOAT, N>::SmoothTriangle(Vector<FLOAT, N> a, Vector<FLOAT, N> b,
+                                         Vector<FLOAT, N> c, Vector<FLOAT, N> na,
+                                         Vector<FLOAT, N> nb, Vector<FLOAT, N> nc)
+    : PrecomputedTriangle<FLOAT, N>(a, b, c), na(na), nb(nb), nc(nc) {}
+
+template <class FLOAT, size_t N>
+bool SmoothTriangle<FLOAT, N>::intersects(const Ray<FLOAT, N>&            ray,
+                                          Intersection_Context<FLOAT, N>& context) const {
+    if (!PrecomputedTriangle<FLOAT, N>::intersects(ray, context)) {
+        return false;
+    }
+    context.normal = get_normal_at(context.u, context.v);
+    return true;
+}
+
+template <class FLOAT, size_t N>
+FLOAT SmoothTriangle<FLOAT, N>::intersects(const Ray<FLOAT, N>& ray) const {
+    return PrecomputedTriangle<FLOAT, N>::intersects(ray);
+}
+
+template <class FLOAT, size_t N>
+Vector<FLOAT, N> SmoothTriangle<FLOAT, N>::get_normal_at(FLOAT u, FLOAT v) const {
+    const FLOAT      w = static_cast<FLOAT>(1.0) - u - v;
+    Vector<FLOAT, N> normal;
+    for (size_t i = 0; i < N; i++) {
+        normal.vector[i] = u * na.vector[i] + v * nb.vector[i] + w * nc.vector[i];
+    }
+    return normal;
+}
@@ -0,0 +1,147 @@
+#include "transform.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace rt {
+
+Transform::Transform()
+    : _matrix{{1.0f, 0.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 1.0f, 0.0f}} {}
+
+Transform Transform::translation(const Vector3df& offset) {
+    Transform transform;
+    for (size_t i = 0; i < 3; i++) {
+        transform._matrix[i][3] = offset.vector[i];
+    }
+    return transform;
+}
+
+Transform Transform::scaling(const Vector3df& factors) {
+    Transform transform;
+    for (size_t i = 0; i < 3; i++) {
+        transform._matrix[i][i] = factors.vector[i];
+    }
+    return transform;
+}
+
+Transform Transform::scaling(float factor) {
+    return scaling(Vector3df{factor, factor, factor});
+}
+
+Transform Transform::rotation(const Vector3df& axis, float angle) {
+    Vector3df unit = axis;
+    unit.normalize();
+    const float x = unit.vector[0], y = unit.vector[1], z = unit.vector[2];
+    const float c = std::cos(angle), s = std::sin(angle), t = 1.0f - c;
+
+    // Rodrigues' rotation formula
+    Transform transform;
+    transform._matrix[0][0] = t * x * x + c;
+    transform._matrix[0][1] = t * x * y - s * z;
+    transform._matrix[0][2] = t * x * z + s * y;
+    transform._matrix[1][0] = t * x * y + s * z;
+    transform._matrix[1][1] = t * y * y + c;
+    transform._matrix[1][2] = t * y * z - s * x;
+    transform._matrix[2][0] = t * x * z - s * y;
+    transform._matrix[2][1] = t * y * z + s * x;
+    transform._matrix[2][2] = t * z * z + c;
+    return transform;
+}
+
+Transform Transform::operator*(const Transform& other) const {
+    Transform result;
+    for (size_t row = 0; row < 3; row++) {
+        for (size_t column = 0; column < 4; column++) {
+            float sum = column == 3 ? _matrix[row][3] : 0.0f;
+            for (size_t k = 0; k < 3; k++) {
+                sum += _matrix[row][k] * other._matrix[k][column];
+            }
+            result._matrix[row][column] = sum;
+        }
+    }
+    return result;
+}
+
+Transform Transform::inverse() const {
+    const float(&m)[3][4] = _matrix;
+
+    // the inverse of A is the adjugate divided by the determinant
+    float cofactor[3][3];
+    for (size_t row = 0; row < 3; row++) {
+        for (size_t column = 0; column < 3; column++) {
+            const size_t r0 = (row + 1) % 3, r1 = (row + 2) % 3;
+            const size_t c0 = (column + 1) % 3, c1 = (column + 2) % 3;
+            cofactor[row][column] = m[r0][c0] * m[r1][c1] - m[r0][c1] * m[r1][c0];
+        }
+    }
+    const float determinant =
+        m[0][0] * cofactor[0][0] + m[0][1] * cofactor[0][1] + m[0][2] * cofactor[0][2];
+    if (!(std::fabs(determinant) > 1e-12f)) {
+        throw std::runtime_error("transformation is not invertible");
+    }
+
+    Transform result;
+    for (size_t row = 0; row < 3; row++) {
+        for (size_t column = 0; column < 3; column++) {
+            result._matrix[row][column] = cofactor[column][row] / determinant;
+        }
+    }
+    // p = A^-1 (q - b)
+    for (size_t row = 0; row < 3; row++) {
+        result._matrix[row][3] = -(result._matrix[row][0] * m[0][3] +
+                                   result._matrix[row][1] * m[1][3] +
+                                   result._matrix[row][2] * m[2][3]);
+    }
+    return result;
+}
+
+Vector3df Transform::point(const Vector3df& point) const {
+    Vector3df result;
+    for (size_t row = 0; row < 3; row++) {
+        result.vector[row] = _matrix[row][0] * point.vector[0] + _matrix[row][1] * point.vector[1] +
+                             _matrix[row][2] * point.vector[2] + _matrix[row][3];
+    }
+    return result;
+}
+
+Vector3df Transform::direction(const Vector3df& direction) const {
+    Vector3df result;
+    for (size_t row = 0; row < 3; row++) {
+        result.vector[row] = _matrix[row][0] * direction.vector[0] +
+                             _matrix[row][1] * direction.vector[1] +
+                             _matrix[row][2] * direction.vector[2];
+    }
+    return result;
+}
+
+Vector3df Transform::transposedDirection(const Vector3df& direction) const {
+    Vector3df result;
+    for (size_t column = 0; column < 3; column++) {
+        result.vector[column] = _matrix[0][column] * direction.vector[0] +
+                                _matrix[1][column] * direction.vector[1] +
+                                _matrix[2][column] * direction.vector[2];
+    }
+    return result;
+}
+
+AABB3df Transform::bounds(const AABB3df& box) const {
+    // the extent along each axis is spanned by the corners, so it suffices to transform the
+    // interval of each coordinate (Arvo's method)
+    const Vector3df lower = box.lower_corner(), upper = box.upper_corner();
+    Vector3df       resultLower, resultUpper;
+    for (size_t row = 0; row < 3; row++) {
+        float minimum = _matrix[row][3], maximum = _matrix[row][3];
+        for (size_t k = 0; k < 3; k++) {
+            const float a = _matrix[row][k] * lower.vector[k];
+            const float b = _matrix[row][k] * upper.vector[k];
+            minimum += std::min(a, b);
+            maximum += std::max(a, b);
+        }
+        resultLower.vector[row] = minimum;
+        resultUpper.vector[row] = maximum;
+    }
+    return AABB3df::from_corners(resultLower, resultUpper);
+}
+
+}  // namespace rt
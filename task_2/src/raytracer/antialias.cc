@@ -0,0 +1,100 @@
+#include "antialias.h"
+
+#include <cmath>
+
+namespace rt::render {
+
+namespace {
+
+float clamp01(float value) {
+    return std::clamp(value, 0.0f, 1.0f);
+}
+
+// a well mixing hash of the integer, the finalizer of MurmurHash3
+uint32_t mix(uint32_t value) {
+    value ^= value >> 16;
+    value *= 0x85ebca6bu;
+    value ^= value >> 13;
+    value *= 0xc2b2ae35u;
+    value ^= value >> 16;
+    return value;
+}
+
+// maps the hash to [0, 1) using its upper 24 bits
+float unitFloat(uint32_t hash) {
+    return static_cast<float>(hash >> 8) * (1.0f / 16777216.0f);
+}
+
+}  // namespace
+
+std::vector<float> pixelContrast(const fb::MemoryFramebuffer& image) {
+    const int          width  = image.width();
+    const int          height = image.height();
+    const auto&        data   = image.data();
+    std::vector<float> contrast(static_cast<size_t>(width) * height, 0.0f);
+
+    auto difference = [&](size_t a, size_t b) {
+        float maximum = 0.0f;
+        for (size_t k = 0; k < 3; k++) {
+            maximum = std::max(maximum, std::fabs(clamp01(data[3 * a + k]) -
+                                                  clamp01(data[3 * b + k])));
+        }
+        return maximum;
+    };
+
+    // each difference is computed once, for the pixel and its right or lower neighbour
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            const size_t pixel = static_cast<size_t>(y) * width + x;
+            if (x + 1 < width) {
+                const float d       = difference(pixel, pixel + 1);
+                contrast[pixel]     = std::max(contrast[pixel], d);
+                contrast[pixel + 1] = std::max(contrast[pixel + 1], d);
+            }
+            if (y + 1 < height) {
+                const float d           = difference(pixel, pixel + width);
+                contrast[pixel]         = std::max(contrast[pixel], d);
+                contrast[pixel + width] = std::max(contrast[pixel + width], d);
+            }
+        }
+    }
+    return contrast;
+}
+
+std::vector<uint32_t> selectPixels(const std::vector<float>& contrast, int width, int height,
+                                   const AntialiasSettings& settings, size_t& candidatePixels) {
+    std::vector<uint32_t> pixels;
+    for (uint32_t pixel = 0; pixel < contrast.size(); pixel++) {
+        if (contrast[pixel] > settings.threshold) {
+            pixels.push_back(pixel);
+        }
+    }
+    candidatePixels = pixels.size();
+
+    const double samplesPerPixel = static_cast<double>(settings.gridSize) * settings.gridSize;
+    const double budgetRays      = std::max(0.0f, settings.budget) * width * height;
+    const size_t maxPixels       = static_cast<size_t>(budgetRays / samplesPerPixel);
+    if (pixels.size() > maxPixels) {
+        // the largest contrast first, ties in scanline order, so the selection is deterministic
+        std::nth_element(pixels.begin(), pixels.begin() + maxPixels, pixels.end(),
+                         [&](uint32_t a, uint32_t b) {
+                             return contrast[a] > contrast[b] ||
+                                    (contrast[a] == contrast[b] && a < b);
+                         });
+        pixels.resize(maxPixels);
+        std::sort(pixels.begin(), pixels.end());
+    }
+    return pixels;
+}
+
+void sampleOffset(int x, int y, int column, int row, int gridSize, float& offsetX,
+                  float& offsetY) {
+    const uint32_t hash = mix(static_cast<uint32_t>(x) * 0x9e3779b9u ^
+                              mix(static_cast<uint32_t>(y) * 0x7feb352du ^
+                                  static_cast<uint32_t>(row * gridSize + column)));
+    const float    cell = 1.0f / static_cast<float>(gridSize);
+    offsetX             = (static_cast<float>(column) + unitFloat(hash)) * cell - 0.5f;
+    offsetY             = (static_cast<float>(row) + unitFloat(mix(hash))) * cell - 0.5f;
+}
+
+}  // namespace rt::render
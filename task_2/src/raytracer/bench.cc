@@ -0,0 +1,478 @@
+#include "math.h"
+#include "geometry.h"
+#include "viewport.h"
+#include "camera.h"
+#include "world.h"
+#include "scene.h"
+#include "instance.h"
+#include "scene_cache.h"
+#include "scene_file.h"
+#include "transform.h"
+#include "simd.h"
+#include "thread_pool.h"
+#include "renderer.h"
+#include "stats.h"
+#include "framebuffer.h"
+#include "options.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#elif defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+using namespace rt;
+
+// Renders a fixed set of scenes without a window and reports the time to build the hierarchy,
+// the time per frame, the traced rays per second and the peak memory of each scene as JSON,
+// so the performance of versions can be compared.
+//   --frames <count>    3, frames rendered per scene
+//   --threads <count>   0 uses all hardware threads
+//   --scene <name>      only the scene with this name: cornell, spheres, triangles, instances,
+//                       file or obj
+//   --moving <count>    0, spheres and instances moved before each frame after the first,
+//                       the hierarchy is updated instead of rebuilt and the times reported
+//   --scene-file <path> adds the scene file with the objects, lights and camera of a scene
+//                       file, see loadSceneFile
+//   --obj <path>        adds the scene obj with the mesh of this OBJ file, loaded once without
+//                       and once through its cache <path>.cache to report both startup times
+//   --output <path>     writes the JSON into a file instead of the standard output
+
+namespace {
+
+// the resolution of all scenes, fixed so results of different runs can be compared
+constexpr int WIDTH  = 1024;
+constexpr int HEIGHT = 768;
+
+constexpr int SPHERE_COUNT   = 100000;
+constexpr int TRIANGLE_COUNT = 250000;
+constexpr int TILE_SIZE      = 100;  // quads per side of the instanced mesh
+constexpr int INSTANCE_COUNT = 2000;
+
+// The scenes are generated from std::mt19937, whose output is the same on all platforms,
+// unlike the standard distributions.
+float uniform(std::mt19937& random, float minimum, float maximum) {
+    return minimum + (maximum - minimum) * static_cast<float>(random() >> 8) / 16777216.0f;
+}
+
+Vector3df uniformVector(std::mt19937& random, float minimum, float maximum) {
+    const float x = uniform(random, minimum, maximum);
+    const float y = uniform(random, minimum, maximum);
+    const float z = uniform(random, minimum, maximum);
+    return Vector3df{x, y, z};
+}
+
+// a point in the part of the view frustum of the camera between z = -10 and z = -40
+Vector3df pointInView(std::mt19937& random) {
+    const float z = uniform(random, -40.0f, -10.0f);
+    // the rays from z = 10 through the viewport at z = -10 spread by 1 / 20 per unit of depth
+    const float halfWidth = (10.0f - z) / 20.0f;
+    const float x         = uniform(random, -halfWidth * 4.0f / 3.0f, halfWidth * 4.0f / 3.0f);
+    const float y         = uniform(random, -halfWidth, halfWidth);
+    return Vector3df{x, y, z};
+}
+
+world::Material randomMaterial(std::mt19937& random) {
+    world::Material material;
+    material.diffuse = uniformVector(random, 0.2f, 1.0f);
+    return material;
+}
+
+world::Scene createSphereField() {
+    std::mt19937 random(1);
+    world::Scene scene;
+    scene.batch<world::SphereObject>().reserve(SPHERE_COUNT);
+    for (int i = 0; i < SPHERE_COUNT; i++) {
+        const Vector3df center = pointInView(random);
+        const float     radius = uniform(random, 0.01f, 0.05f);
+        scene.emplace_back(world::SphereObject(center, radius, randomMaterial(random)));
+    }
+    return scene;
+}
+
+world::Scene createTriangleSoup() {
+    std::mt19937 random(2);
+    world::Scene scene;
+    scene.batch<world::TriangleObject>().reserve(TRIANGLE_COUNT);
+    for (int i = 0; i < TRIANGLE_COUNT; i++) {
+        const Vector3df a = pointInView(random);
+        scene.emplace_back(world::TriangleObject(a, a + uniformVector(random, -0.1f, 0.1f),
+                                                 a + uniformVector(random, -0.1f, 0.1f),
+                                                 randomMaterial(random)));
+    }
+    return scene;
+}
+
+// a wavy square of TILE_SIZE x TILE_SIZE quads over [-1, 1] x [-1, 1]
+world::Mesh createTile() {
+    std::vector<Vector3df> positions;
+    std::vector<uint32_t>  indices;
+    const float            step = 2.0f / TILE_SIZE;
+    for (int y = 0; y <= TILE_SIZE; y++) {
+        for (int x = 0; x <= TILE_SIZE; x++) {
+            const float fx = -1.0f + step * static_cast<float>(x);
+            const float fy = -1.0f + step * static_cast<float>(y);
+            const float fz = 0.2f * std::sin(6.0f * fx) * std::cos(4.0f * fy);
+            positions.push_back(Vector3df{fx, fy, fz});
+        }
+    }
+    for (int y = 0; y < TILE_SIZE; y++) {
+        for (int x = 0; x < TILE_SIZE; x++) {
+            const uint32_t corner = static_cast<uint32_t>(y * (TILE_SIZE + 1) + x);
+            const uint32_t next   = corner + TILE_SIZE + 1;
+            indices.insert(indices.end(), {corner, corner + 1, next + 1});
+            indices.insert(indices.end(), {corner, next + 1, next});
+        }
+    }
+    return world::Mesh(std::move(positions), std::move(indices));
+}
+
+// INSTANCE_COUNT randomly rotated copies of one tile, as many triangles as 80 triangle soups
+// while storing the triangles once
+world::Scene createInstanceField() {
+    std::mt19937      random(3);
+    const world::Mesh tile = createTile();
+    world::Scene      scene;
+    scene.batch<world::InstanceObject>().reserve(INSTANCE_COUNT);
+    for (int i = 0; i < INSTANCE_COUNT; i++) {
+        const Vector3df center = pointInView(random);
+        const Vector3df axis   = uniformVector(random, -1.0f, 1.0f);
+        const float     angle  = uniform(random, 0.0f, 6.2831853f);
+        const float     size   = uniform(random, 0.2f, 0.5f);
+        const Transform toWorld = Transform::translation(center) *
+                                  Transform::rotation(axis, angle) * Transform::scaling(size);
+        scene.emplace_back(
+            world::InstanceObject(world::Instance(tile, toWorld), randomMaterial(random)));
+    }
+    return scene;
+}
+
+// The startup of the obj scene: cold parses the OBJ file, builds the hierarchy and writes the
+// cache, warm maps the cache written by the cold start
+struct ObjStartup {
+    world::MeshCacheStatistics cold, warm;
+};
+
+// the mesh of the OBJ file through its cache, scaled and moved into the middle of the view
+world::Scene createObjScene(const std::string& path, parallel::ThreadPool& pool,
+                            ObjStartup& startup) {
+    const std::string     cachePath = path + ".cache";
+    const world::Material material;
+
+    std::filesystem::remove(cachePath);
+    world::loadObjMeshCached(path, cachePath, material, pool, &startup.cold);
+    const world::MeshObject object =
+        world::loadObjMeshCached(path, cachePath, material, pool, &startup.warm);
+
+    const AABB3df   bounds = object.geometry().bounds();
+    const Vector3df lower = bounds.lower_corner(), upper = bounds.upper_corner();
+    float           extent = 0.0f;
+    Vector3df       center;
+    for (size_t k = 0; k < 3; k++) {
+        extent           = std::max(extent, upper.vector[k] - lower.vector[k]);
+        center.vector[k] = -0.5f * (lower.vector[k] + upper.vector[k]);
+    }
+    const Transform toWorld = Transform::translation({0.0f, 0.0f, -25.0f}) *
+                              Transform::scaling(extent > 0.0f ? 20.0f / extent : 1.0f) *
+                              Transform::translation(center);
+
+    world::Scene scene;
+    scene.emplace_back(
+        world::InstanceObject(world::Instance(object.geometry(), toWorld), object.material()));
+    return scene;
+}
+
+std::vector<world::PointLight> createFieldLights() {
+    return {world::PointLight{.position = Vector3df{-2.0f, 3.0f, 0.0f}},
+            world::PointLight{.position = Vector3df{2.0f, 1.0f, -20.0f}}};
+}
+
+// resets the peak memory of the process to its current memory, returns false if the operating
+// system does not support that, then the peak is the one of the whole process so far
+bool resetPeakMemory() {
+#if defined(__linux__)
+    std::ofstream clearRefs("/proc/self/clear_refs");
+    clearRefs << "5";
+    clearRefs.flush();
+    return static_cast<bool>(clearRefs);
+#else
+    return false;
+#endif
+}
+
+// returns the peak resident memory of the process in bytes, 0 if unknown
+uint64_t peakMemory() {
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return counters.PeakWorkingSetSize;
+    }
+#elif defined(__linux__)
+    // unlike getrusage, VmHWM is reset by resetPeakMemory
+    std::ifstream status("/proc/self/status");
+    std::string   line;
+    while (std::getline(status, line)) {
+        if (line.rfind("VmHWM:", 0) == 0) {
+            return std::stoull(line.substr(6)) * 1024;
+        }
+    }
+#elif defined(__APPLE__)
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        return static_cast<uint64_t>(usage.ru_maxrss);
+    }
+#endif
+    return 0;
+}
+
+// moves count random spheres and instances of the scene by a small random offset
+void moveObjects(world::Scene& scene, std::mt19937& random, int count) {
+    const auto& spheres   = scene.batch<world::SphereObject>();
+    const auto& instances = scene.batch<world::InstanceObject>();
+    const auto  sphereCount = static_cast<uint32_t>(spheres.objects().size());
+    const auto  total = sphereCount + static_cast<uint32_t>(instances.objects().size());
+    if (total == 0) {
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        const uint32_t  id     = static_cast<uint32_t>(random() % total);
+        const Vector3df offset = uniformVector(random, -0.5f, 0.5f);
+        if (id < sphereCount) {
+            const auto&   sphere = spheres.objects()[spheres.ids().position(id)];
+            const AABB3df bounds = sphere.bounds();
+            const float   radius =
+                0.5f * (bounds.upper_corner().vector[0] - bounds.lower_corner().vector[0]);
+            scene.replace(id, world::SphereObject(bounds.get_center() + offset, radius,
+                                                  sphere.material()));
+        } else {
+            const uint32_t instanceId = id - sphereCount;
+            const auto& instance = instances.objects()[instances.ids().position(instanceId)];
+            const world::Instance moved(instance.geometry().mesh(),
+                                        Transform::translation(offset) *
+                                            instance.geometry().transform());
+            scene.replace(instanceId, world::InstanceObject(moved, instance.material()));
+        }
+    }
+}
+
+struct BenchmarkScene {
+    const char*                                    name;
+    std::function<world::Scene()>                  create;
+    std::function<std::vector<world::PointLight>()> createLights;
+    std::function<void(std::ostream&)>              writeStartup = nullptr;  // JSON members
+    std::function<world::CameraSettings()>          createCamera = nullptr;  // or the default
+};
+
+// renders the scene and writes its results as JSON object
+void benchmark(const BenchmarkScene& description, parallel::ThreadPool& pool, int frames,
+               int moving, std::ostream& json) {
+    std::cerr << "benchmarking " << description.name << std::endl;
+    const bool peakReset = resetPeakMemory();
+
+    world::Scene scene  = description.create();
+    const auto   lights = description.createLights();
+
+    const auto build_start = std::chrono::steady_clock::now();
+    scene.build();
+    const double buildSeconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - build_start).count();
+
+    const world::CameraSettings settings =
+        description.createCamera ? description.createCamera() : world::CameraSettings();
+    view::Viewport viewport = settings.viewport(WIDTH, HEIGHT);
+    camera::Camera camera{settings.position, settings.direction, viewport};
+    fb::MemoryFramebuffer framebuffer{WIDTH, HEIGHT};
+
+    std::vector<double>                       frameSeconds;
+    std::vector<accel::Bvh::UpdateStatistics> updates;
+    render::WorkerContext                     rays;
+    std::mt19937                              random(4);
+    for (int frame = 0; frame < frames; frame++) {
+        if (moving > 0 && frame > 0) {
+            moveObjects(scene, random, moving);
+            updates.push_back(scene.update());
+        }
+        const auto start    = std::chrono::steady_clock::now();
+        const auto contexts = render::renderImage(pool, camera, scene, lights, framebuffer);
+        frameSeconds.push_back(
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+        const auto merged = render::mergeContexts(contexts);
+        rays.primaryRays += merged.primaryRays;
+        rays.shadowRays += merged.shadowRays;
+        rays.reflectionRays += merged.reflectionRays;
+        rays.traversal += merged.traversal;
+    }
+
+    double totalSeconds = 0.0;
+    for (double seconds : frameSeconds) {
+        totalSeconds += seconds;
+    }
+    const uint64_t totalRays = rays.primaryRays + rays.shadowRays + rays.reflectionRays;
+
+    json << "    {\n"
+         << "      \"name\": \"" << description.name << "\",\n"
+         << "      \"objects\": " << scene.size() << ",\n"
+         << "      \"lights\": " << lights.size() << ",\n"
+         << "      \"build_ms\": " << buildSeconds * 1000.0 << ",\n";
+    if (description.writeStartup) {
+        description.writeStartup(json);
+    }
+    json << "      \"frame_ms\": [";
+    for (size_t i = 0; i < frameSeconds.size(); i++) {
+        json << (i > 0 ? ", " : "") << frameSeconds[i] * 1000.0;
+    }
+    json << "],\n"
+         << "      \"frame_ms_mean\": " << totalSeconds * 1000.0 / frames << ",\n"
+         << "      \"frame_ms_min\": "
+         << *std::min_element(frameSeconds.begin(), frameSeconds.end()) * 1000.0 << ",\n"
+         << "      \"primary_rays\": " << rays.primaryRays << ",\n"
+         << "      \"shadow_rays\": " << rays.shadowRays << ",\n"
+         << "      \"reflection_rays\": " << rays.reflectionRays << ",\n"
+         << "      \"mrays_per_second\": " << static_cast<double>(totalRays) / totalSeconds / 1e6
+         << ",\n";
+    if constexpr (stats::ENABLED) {
+        // summed over all frames, see stats::TraversalCounters
+        json << "      \"nodes_visited\": " << rays.traversal.nodesVisited << ",\n"
+             << "      \"primitive_tests\": " << rays.traversal.primitiveTests << ",\n"
+             << "      \"hits\": " << rays.traversal.hits << ",\n";
+    }
+    if (moving > 0) {
+        // per frame after the first: the refit, the partial rebuild and the rebuilt subtrees
+        json << "      \"moving_objects\": " << moving << ",\n"
+             << "      \"refit_ms\": [";
+        for (size_t i = 0; i < updates.size(); i++) {
+            json << (i > 0 ? ", " : "") << updates[i].refitMilliseconds;
+        }
+        json << "],\n"
+             << "      \"rebuild_ms\": [";
+        for (size_t i = 0; i < updates.size(); i++) {
+            json << (i > 0 ? ", " : "") << updates[i].rebuildMilliseconds;
+        }
+        json << "],\n"
+             << "      \"rebuilt_subtrees\": [";
+        for (size_t i = 0; i < updates.size(); i++) {
+            json << (i > 0 ? ", " : "") << updates[i].rebuiltSubtrees;
+        }
+        json << "],\n";
+    }
+    json << "      \"peak_memory_bytes\": " << peakMemory() << ",\n"
+         << "      \"peak_memory_per_scene\": " << (peakReset ? "true" : "false") << "\n"
+         << "    }";
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    const int   frames  = cli::intOption(argc, argv, "--frames", 3);
+    const int   threads = cli::intOption(argc, argv, "--threads", 0);
+    const char* only    = cli::stringOption(argc, argv, "--scene", nullptr);
+    const char* output  = cli::stringOption(argc, argv, "--output", nullptr);
+    const int   moving  = cli::intOption(argc, argv, "--moving", 0);
+    const char* obj     = cli::stringOption(argc, argv, "--obj", nullptr);
+    const char* path    = cli::stringOption(argc, argv, "--scene-file", nullptr);
+
+    if (frames <= 0) {
+        std::cerr << "the number of frames has to be positive" << std::endl;
+        return 1;
+    }
+
+    parallel::ThreadPool pool{static_cast<unsigned>(std::max(threads, 0))};
+
+    std::vector<BenchmarkScene> scenes{
+        {"cornell", [] { return world::createScene<world::Scene>(); }, world::createLights},
+        {"spheres", createSphereField, createFieldLights},
+        {"triangles", createTriangleSoup, createFieldLights},
+        {"instances", createInstanceField, createFieldLights},
+    };
+    if (path != nullptr) {
+        auto file = std::make_shared<world::SceneFile>();
+        scenes.push_back(BenchmarkScene{
+            .name = "file",
+            .create =
+                [path, &pool, file] {
+                    world::Scene scene;
+                    *file = world::loadSceneFile(path, scene, pool);
+                    return scene;
+                },
+            .createLights = [file] { return file->lights; },
+            .createCamera = [file] { return file->camera; }});
+    }
+    if (obj != nullptr) {
+        auto startup = std::make_shared<ObjStartup>();
+        scenes.push_back(BenchmarkScene{
+            .name         = "obj",
+            .create       = [obj, &pool, startup] { return createObjScene(obj, pool, *startup); },
+            .createLights = createFieldLights,
+            .writeStartup =
+                [startup](std::ostream& json) {
+                    json << "      \"cold_hash_ms\": " << startup->cold.hashMilliseconds << ",\n"
+                         << "      \"cold_load_ms\": " << startup->cold.loadMilliseconds << ",\n"
+                         << "      \"warm_hash_ms\": " << startup->warm.hashMilliseconds << ",\n"
+                         << "      \"warm_load_ms\": " << startup->warm.loadMilliseconds << ",\n"
+                         << "      \"warm_from_cache\": "
+                         << (startup->warm.fromCache ? "true" : "false") << ",\n";
+                }});
+    }
+
+    std::ostringstream json;
+    json << "{\n"
+         << "  \"width\": " << WIDTH << ",\n"
+         << "  \"height\": " << HEIGHT << ",\n"
+         << "  \"frames\": " << frames << ",\n"
+         << "  \"threads\": " << pool.size() << ",\n"
+         << "  \"simd\": \"" << simd::levelName(simd::activeLevel()) << "\",\n"
+         << "  \"scenes\": [\n";
+    bool first = true;
+    for (const auto& scene : scenes) {
+        if (only != nullptr && std::strcmp(only, scene.name) != 0) {
+            continue;
+        }
+        if (!first) {
+            json << ",\n";
+        }
+        try {
+            benchmark(scene, pool, frames, moving, json);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+        first = false;
+    }
+    json << "\n  ]\n}\n";
+
+    if (first) {
+        std::cerr << "unknown scene " << only << std::endl;
+        return 1;
+    }
+
+    if (output == nullptr) {
+        std::cout << json.str();
+        return 0;
+    }
+    std::ofstream file(output);
+    file << json.str();
+    if (!file) {
+        std::cerr << "can not write " << output << std::endl;
+        return 1;
+    }
+    return 0;
+}
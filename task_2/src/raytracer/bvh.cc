@@ -0,0 +1,436 @@
+#include "bvh.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace rt::accel {
+
+namespace {
+
+// grows the bounds of the nodes slightly so rounding in the conversion from AABB3df to corners
+// can not make rays miss primitives that touch the bounds
+constexpr float BOUNDS_PADDING = 1e-6f;
+
+struct Bounds {
+    Vector3df lower{std::numeric_limits<float>::infinity()};
+    Vector3df upper{-std::numeric_limits<float>::infinity()};
+
+    void extend(const Vector3df& lowerPoint, const Vector3df& upperPoint) {
+        for (size_t i = 0; i < 3; i++) {
+            lower.vector[i] = std::min(lower.vector[i], lowerPoint.vector[i]);
+            upper.vector[i] = std::max(upper.vector[i], upperPoint.vector[i]);
+        }
+    }
+
+    float surfaceArea() const {
+        const float dx = upper.vector[0] - lower.vector[0];
+        const float dy = upper.vector[1] - lower.vector[1];
+        const float dz = upper.vector[2] - lower.vector[2];
+        if (dx < 0.0f || dy < 0.0f || dz < 0.0f) {
+            return 0.0f;
+        }
+        return 2.0f * (dx * dy + dy * dz + dz * dx);
+    }
+};
+
+float nodeArea(const BvhNode& node) {
+    const float dx = node.upper.vector[0] - node.lower.vector[0];
+    const float dy = node.upper.vector[1] - node.lower.vector[1];
+    const float dz = node.upper.vector[2] - node.lower.vector[2];
+    return 2.0f * (dx * dy + dy * dz + dz * dx);
+}
+
+}  // namespace
+
+Bvh::Bvh(const std::vector<AABB3df>&  primitiveBounds,
+         const std::vector<uint16_t>& primitiveGroups)
+    : Bvh(primitiveBounds, primitiveGroups, Settings{}) {}
+
+Bvh Bvh::view(std::span<const BvhNode> nodes, size_t primitiveCount) {
+    // children are stored after their parents, so their depth is known when they are reached
+    std::vector<uint8_t> depth(nodes.size(), 0);
+    for (size_t index = 0; index < nodes.size(); index++) {
+        const BvhNode& node = nodes[index];
+        if (node.isLeaf()) {
+            if (static_cast<uint64_t>(node.first) + node.count > primitiveCount) {
+                throw std::runtime_error("hierarchy leaf out of range");
+            }
+            continue;
+        }
+        if (node.first <= index || node.first + 1ull >= nodes.size()) {
+            throw std::runtime_error("hierarchy child out of range");
+        }
+        // a stack holds at most one entry per level and the root
+        const auto childDepth = static_cast<uint8_t>(depth[index] + 1);
+        if (childDepth + 1u >= STACK_SIZE) {
+            throw std::runtime_error("hierarchy too deep to traverse");
+        }
+        depth[node.first]     = std::max(depth[node.first], childDepth);
+        depth[node.first + 1] = std::max(depth[node.first + 1], childDepth);
+    }
+
+    Bvh bvh;
+    bvh._external = nodes;
+    return bvh;
+}
+
+Bvh::Bvh(const std::vector<AABB3df>&  primitiveBounds,
+         const std::vector<uint16_t>& primitiveGroups, const Settings& settings)
+    : _settings(settings) {
+    if (primitiveBounds.empty()) {
+        return;
+    }
+
+    std::vector<BuildPrimitive> primitives;
+    primitives.reserve(primitiveBounds.size());
+    for (size_t i = 0; i < primitiveBounds.size(); i++) {
+        const auto& bounds = primitiveBounds[i];
+        primitives.push_back({bounds.lower_corner(), bounds.upper_corner(), bounds.get_center(),
+                              primitiveGroups.empty() ? uint16_t{0} : primitiveGroups[i]});
+    }
+
+    _indices.resize(primitiveBounds.size());
+    for (uint32_t i = 0; i < _indices.size(); i++) {
+        _indices[i] = i;
+    }
+
+    _nodes.reserve(2 * primitiveBounds.size());
+    _nodes.emplace_back();
+    build(primitives, _indices, 0, 0, static_cast<uint32_t>(primitives.size()), 0);
+    _nodes.shrink_to_fit();
+
+    // the leaves index the primitives of their group, which are stored in leaf order
+    std::vector<uint32_t> groupIndex(_indices.size());
+    std::vector<uint32_t> groupCount;
+    for (size_t i = 0; i < _indices.size(); i++) {
+        const uint16_t group = primitives[_indices[i]].group;
+        if (group >= groupCount.size()) {
+            groupCount.resize(group + 1, 0);
+        }
+        groupIndex[i] = groupCount[group]++;
+    }
+    for (auto& node : _nodes) {
+        if (node.isLeaf()) {
+            node.first = groupIndex[node.first];
+        }
+    }
+}
+
+void Bvh::build(std::vector<BuildPrimitive>& primitives, std::vector<uint32_t>& indices,
+                uint32_t nodeIndex, uint32_t begin, uint32_t end, int depth) {
+    Bounds bounds, centroidBounds;
+    bool   singleGroup = true;
+    for (uint32_t i = begin; i < end; i++) {
+        const auto& primitive = primitives[indices[i]];
+        bounds.extend(primitive.lower, primitive.upper);
+        centroidBounds.extend(primitive.centroid, primitive.centroid);
+        singleGroup &= primitive.group == primitives[indices[begin]].group;
+    }
+
+    BvhNode& node = _nodes[nodeIndex];
+    setBounds(node, bounds.lower, bounds.upper);
+
+    const uint32_t count    = end - begin;
+    const float    leafCost = INTERSECTION_COST * static_cast<float>(count);
+    if (count == 1) {
+        node.first = begin;
+        node.count = static_cast<uint16_t>(count);
+        node.group = primitives[indices[begin]].group;
+        return;
+    }
+
+    // maps a centroid to one of BIN_COUNT equally sized intervals of the centroid bounds
+    auto binIndex = [&](const Vector3df& centroid, int axis) {
+        const float extent = centroidBounds.upper[axis] - centroidBounds.lower[axis];
+        const float offset = centroid[axis] - centroidBounds.lower[axis];
+        return std::min(BIN_COUNT - 1,
+                        static_cast<uint32_t>(offset * static_cast<float>(BIN_COUNT) / extent));
+    };
+
+    // evaluate the SAH for BIN_COUNT - 1 split planes on each axis
+    float    bestCost  = std::numeric_limits<float>::infinity();
+    int      bestAxis  = -1;
+    uint32_t bestSplit = 0;
+    for (int axis = 0; axis < 3; axis++) {
+        if (centroidBounds.upper[axis] - centroidBounds.lower[axis] <= 0.0f) {
+            continue;
+        }
+
+        Bounds   binBounds[BIN_COUNT];
+        uint32_t binCounts[BIN_COUNT] = {};
+        for (uint32_t i = begin; i < end; i++) {
+            const auto&    primitive = primitives[indices[i]];
+            const uint32_t bin       = binIndex(primitive.centroid, axis);
+            binCounts[bin]++;
+            binBounds[bin].extend(primitive.lower, primitive.upper);
+        }
+
+        // sweep from the right to get the area and count right of each plane
+        float    rightArea[BIN_COUNT];
+        uint32_t rightCount[BIN_COUNT];
+        Bounds   accumulated;
+        uint32_t accumulatedCount = 0;
+        for (uint32_t bin = BIN_COUNT - 1; bin > 0; bin--) {
+            accumulated.extend(binBounds[bin].lower, binBounds[bin].upper);
+            accumulatedCount += binCounts[bin];
+            rightArea[bin]  = accumulated.surfaceArea();
+            rightCount[bin] = accumulatedCount;
+        }
+
+        accumulated      = Bounds{};
+        accumulatedCount = 0;
+        for (uint32_t split = 1; split < BIN_COUNT; split++) {
+            accumulated.extend(binBounds[split - 1].lower, binBounds[split - 1].upper);
+            accumulatedCount += binCounts[split - 1];
+            if (accumulatedCount == 0 || rightCount[split] == 0) {
+                continue;
+            }
+            const float cost = accumulated.surfaceArea() * static_cast<float>(accumulatedCount) +
+                               rightArea[split] * static_cast<float>(rightCount[split]);
+            if (cost < bestCost) {
+                bestCost  = cost;
+                bestAxis  = axis;
+                bestSplit = split;
+            }
+        }
+    }
+
+    const float area = bounds.surfaceArea();
+    bestCost = _settings.traversalCost + INTERSECTION_COST * bestCost / std::max(area, 1e-30f);
+    const bool leaf = count <= _settings.maxLeafSize && (bestAxis < 0 || leafCost <= bestCost);
+    if (leaf && singleGroup) {
+        node.first = begin;
+        node.count = static_cast<uint16_t>(count);
+        node.group = primitives[indices[begin]].group;
+        return;
+    }
+
+    uint32_t middle = begin;
+    if (leaf) {
+        // separate the groups of a leaf with mixed groups
+        const uint16_t group = primitives[indices[begin]].group;
+        auto*          split = std::partition(
+            indices.data() + begin, indices.data() + end,
+            [&](uint32_t index) { return primitives[index].group == group; });
+        middle = static_cast<uint32_t>(split - indices.data());
+    } else if (bestAxis >= 0 && depth < static_cast<int>(STACK_SIZE / 2)) {
+        auto* split = std::partition(indices.data() + begin, indices.data() + end,
+                                     [&](uint32_t index) {
+                                         return binIndex(primitives[index].centroid, bestAxis) <
+                                                bestSplit;
+                                     });
+        middle = static_cast<uint32_t>(split - indices.data());
+    }
+
+    // fall back to a median split for coincident centroids and very deep subtrees,
+    // this bounds the depth of the tree by STACK_SIZE
+    if (middle == begin || middle == end) {
+        int axis = 0;
+        for (int i = 1; i < 3; i++) {
+            if (centroidBounds.upper[i] - centroidBounds.lower[i] >
+                centroidBounds.upper[axis] - centroidBounds.lower[axis]) {
+                axis = i;
+            }
+        }
+        middle = begin + count / 2;
+        std::nth_element(indices.data() + begin, indices.data() + middle, indices.data() + end,
+                         [&](uint32_t a, uint32_t b) {
+                             return primitives[a].centroid[axis] < primitives[b].centroid[axis];
+                         });
+    }
+
+    const auto leftChild = static_cast<uint32_t>(_nodes.size());
+    _nodes.emplace_back();
+    _nodes.emplace_back();
+    _nodes[nodeIndex].first = leftChild;
+    _nodes[nodeIndex].count = 0;
+
+    build(primitives, indices, leftChild, begin, middle, depth + 1);
+    build(primitives, indices, leftChild + 1, middle, end, depth + 1);
+}
+
+bool Bvh::rightChildFirst(const BvhNode& node, const Vector3df& direction) const {
+    // along the axis separating the children the most, the direction decides which one is nearer
+    const BvhNode& left  = nodeData()[node.first];
+    const BvhNode& right = nodeData()[node.first + 1];
+    size_t         axis  = 0;
+    float          separation[3];
+    for (size_t i = 0; i < 3; i++) {
+        separation[i] = (right.lower.vector[i] + right.upper.vector[i]) -
+                        (left.lower.vector[i] + left.upper.vector[i]);
+        if (std::fabs(separation[i]) > std::fabs(separation[axis])) {
+            axis = i;
+        }
+    }
+    return separation[axis] * direction.vector[axis] < 0.0f;
+}
+
+void Bvh::setBounds(BvhNode& node, const Vector3df& lower, const Vector3df& upper) {
+    for (size_t i = 0; i < 3; i++) {
+        node.lower.vector[i] =
+            lower.vector[i] - BOUNDS_PADDING * std::max(1.0f, std::fabs(lower.vector[i]));
+        node.upper.vector[i] =
+            upper.vector[i] + BOUNDS_PADDING * std::max(1.0f, std::fabs(upper.vector[i]));
+    }
+}
+
+float Bvh::cost() const {
+    if (empty()) {
+        return 0.0f;
+    }
+    return static_cast<float>(areaCost() / std::max(nodeArea(nodes()[0]), 1e-30f));
+}
+
+double Bvh::areaCost() const {
+    double sum = 0.0;
+    for (const BvhNode& node : nodes()) {
+        const double area = nodeArea(node);
+        sum += node.isLeaf() ? INTERSECTION_COST * node.count * area
+                             : _settings.traversalCost * area;
+    }
+    return sum;
+}
+
+void Bvh::keepReference() {
+    if (!_referenceArea.empty()) {
+        return;
+    }
+    _referenceArea.resize(_nodes.size());
+    for (size_t i = 0; i < _nodes.size(); i++) {
+        _referenceArea[i] = nodeArea(_nodes[i]);
+    }
+    _referenceCost = areaCost();
+}
+
+std::vector<std::pair<uint32_t, int>> Bvh::degradedSubtrees(float maxGrowth) const {
+    // A moved primitive inflates the nodes on its path to the root. Rebuilding the parent of an
+    // inflated node, rather than the node itself, can move the primitive to the sibling.
+    auto inflated = [&](uint32_t index) {
+        return nodeArea(_nodes[index]) > maxGrowth * _referenceArea[index];
+    };
+
+    std::vector<std::pair<uint32_t, int>> roots;
+    std::vector<std::pair<uint32_t, int>> stack{{0, 0}};
+    while (!stack.empty()) {
+        const auto [index, depth] = stack.back();
+        stack.pop_back();
+        const BvhNode& node = _nodes[index];
+        if (node.isLeaf()) {
+            continue;
+        }
+        if (inflated(node.first) || inflated(node.first + 1)) {
+            roots.emplace_back(index, depth);
+        } else {
+            stack.emplace_back(node.first + 1, depth + 1);
+            stack.emplace_back(node.first, depth + 1);
+        }
+    }
+    // the growth is spread over the whole tree
+    if (roots.empty()) {
+        roots.emplace_back(0, 0);
+    }
+    return roots;
+}
+
+std::vector<uint32_t> Bvh::subtreeLeaves(uint32_t root) const {
+    std::vector<uint32_t> leaves;
+    std::vector<uint32_t> stack{root};
+    while (!stack.empty()) {
+        const uint32_t index = stack.back();
+        stack.pop_back();
+        if (_nodes[index].isLeaf()) {
+            leaves.push_back(index);
+        } else {
+            stack.push_back(_nodes[index].first + 1);
+            stack.push_back(_nodes[index].first);
+        }
+    }
+    return leaves;
+}
+
+std::vector<Bvh::Reordering> Bvh::rebuildSubtree(uint32_t root, int depth,
+                                                 const std::vector<SubtreePrimitive>& primitives) {
+    std::vector<BuildPrimitive> buildPrimitives;
+    buildPrimitives.reserve(primitives.size());
+    for (const auto& primitive : primitives) {
+        buildPrimitives.push_back({primitive.bounds.lower_corner(),
+                                   primitive.bounds.upper_corner(),
+                                   primitive.bounds.get_center(), primitive.group});
+    }
+    std::vector<uint32_t> indices(primitives.size());
+    for (uint32_t i = 0; i < indices.size(); i++) {
+        indices[i] = i;
+    }
+
+    const auto firstNew = static_cast<uint32_t>(_nodes.size());
+    build(buildPrimitives, indices, root, 0, static_cast<uint32_t>(indices.size()), depth);
+
+    // The primitives of each group in the subtree occupy a contiguous range of the group, as
+    // the leaves of a subtree are consecutive in leaf order. The new leaf order fills the ranges.
+    std::vector<Reordering> reorderings;
+    std::vector<uint32_t>   position(indices.size());
+    for (uint32_t i = 0; i < indices.size(); i++) {
+        const SubtreePrimitive& primitive = primitives[indices[i]];
+        auto reordering = std::find_if(
+            reorderings.begin(), reorderings.end(),
+            [&](const Reordering& other) { return other.group == primitive.group; });
+        if (reordering == reorderings.end()) {
+            reorderings.push_back({primitive.group, std::numeric_limits<uint32_t>::max(), {}});
+            for (const auto& other : primitives) {
+                if (other.group == primitive.group) {
+                    reorderings.back().first = std::min(reorderings.back().first, other.index);
+                }
+            }
+            reordering = reorderings.end() - 1;
+        }
+        position[i] = reordering->first + static_cast<uint32_t>(reordering->previous.size());
+        reordering->previous.push_back(primitive.index);
+    }
+
+    _referenceArea.resize(_nodes.size());
+    auto finish = [&](uint32_t index) {
+        BvhNode& node = _nodes[index];
+        if (node.isLeaf()) {
+            node.first = position[node.first];
+        }
+        _referenceArea[index] = nodeArea(node);
+    };
+    finish(root);
+    for (uint32_t index = firstNew; index < _nodes.size(); index++) {
+        finish(index);
+    }
+    return reorderings;
+}
+
+void Bvh::compact() {
+    std::vector<BvhNode> nodes;
+    std::vector<float>   referenceArea;
+    nodes.reserve(_nodes.size());
+    referenceArea.reserve(_nodes.size());
+    nodes.push_back(_nodes[0]);
+    referenceArea.push_back(_referenceArea[0]);
+
+    // the same order as construction: the children of a node are placed when it is visited,
+    // then the subtree of the left child is visited before the one of the right child
+    std::vector<uint32_t> stack{0};  // indices into nodes
+    while (!stack.empty()) {
+        const uint32_t index = stack.back();
+        stack.pop_back();
+        if (nodes[index].isLeaf()) {
+            continue;
+        }
+        const uint32_t previous = nodes[index].first;
+        const auto     children = static_cast<uint32_t>(nodes.size());
+        nodes.push_back(_nodes[previous]);
+        nodes.push_back(_nodes[previous + 1]);
+        referenceArea.push_back(_referenceArea[previous]);
+        referenceArea.push_back(_referenceArea[previous + 1]);
+        nodes[index].first = children;
+        stack.push_back(children + 1);
+        stack.push_back(children);
+    }
+    _nodes         = std::move(nodes);
+    _referenceArea = std::move(referenceArea);
+}
+
+}  // namespace rt::accel
@@ -1,14 +1,111 @@
 #include "camera.h"
 
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+
 namespace rt::camera {
+
+namespace {
+
+// turns by pitch about the x axis, then by yaw about the y axis
+Transform poseRotation(float yaw, float pitch) {
+    return Transform::rotation(Vector3df{0.0f, 1.0f, 0.0f}, yaw) *
+           Transform::rotation(Vector3df{1.0f, 0.0f, 0.0f}, pitch);
+}
+
+}  // namespace
+
+Pose movePose(const Pose& pose, const Vector3df& move, float yaw, float pitch) {
+    const float maxPitch = 0.49f * std::numbers::pi_v<float>;
+
+    Pose moved   = pose;
+    moved.yaw    = pose.yaw + yaw;
+    moved.pitch  = std::clamp(pose.pitch + pitch, -maxPitch, maxPitch);
+    moved.offset = pose.offset + poseRotation(moved.yaw, moved.pitch).direction(move);
+    return moved;
+}
+
+Pose lookAlong(const Vector3df& position, const Vector3df& direction) {
+    // poseRotation turns -z into (-cos(pitch) sin(yaw), sin(pitch), -cos(pitch) cos(yaw))
+    Pose pose;
+    pose.offset = position;
+    pose.pitch  = std::asin(std::clamp(direction.vector[1], -1.0f, 1.0f));
+    pose.yaw    = std::atan2(-direction.vector[0], -direction.vector[2]);
+    return pose;
+}
+
 Camera::Camera(Vector3df position, Vector3df direction, rt::view::Viewport& viewport)
     : _position(position), _direction(direction), _viewport(viewport) {
     // Normalize direction vector if needed
     _direction.normalize();
 }
 
-Ray3df Camera::getRay(int x, int y) {
+void Camera::setPose(const Pose& pose) {
+    _pose     = pose;
+    _moved    = !(pose == Pose{});
+    _rotation = poseRotation(pose.yaw, pose.pitch);
+}
+
+Vector3df Camera::origin() const {
+    return _position + _pose.offset;
+}
+
+bool Camera::project(const Vector3df& point, float& pixelX, float& pixelY) const {
+    return projection()(point, pixelX, pixelY);
+}
+
+view::Projection Camera::projection() const {
+    // the projection of the default pose turned and moved with the view
+    view::Projection projection = _viewport.projection(_position);
+    projection.origin           = origin();
+    projection.toX              = _rotation.direction(projection.toX);
+    projection.toY              = _rotation.direction(projection.toY);
+    projection.normal           = _rotation.direction(projection.normal);
+    return projection;
+}
+
+Ray3df Camera::moved(const Ray3df& ray) const {
+    return Ray3df{origin(), _rotation.direction(ray.direction)};
+}
+
+Ray3df Camera::getRay(int x, int y) const {
     // Generate ray from camera position through the pixel on the viewport
-    return _viewport.generateRay(_position, _direction, x, y);
+    const Ray3df ray = _viewport.generateRay(_position, _direction, x, y);
+    return _moved ? moved(ray) : ray;
+}
+
+Ray3df Camera::getRay(int x, int y, float offsetX, float offsetY) const {
+    const Ray3df ray = _viewport.generateRay(_position, x, y, offsetX, offsetY);
+    return _moved ? moved(ray) : ray;
+}
+
+void Camera::getRays(int x, int y, int width, int height, accel::RayPacket& packet) const {
+    RayRow rays;
+    for (int row = y; row < y + height; row++) {
+        getRow(x, row, width, rays);
+        for (int i = 0; i < width; i++) {
+            packet.add(rays.ray(i));
+        }
+    }
+}
+
+void Camera::getRow(int x, int y, int count, RayRow& row) const {
+    row.size   = count;
+    row.origin = _position;
+    _viewport.generateDirections(_position, x, y, count, row.directionX, row.directionY,
+                                 row.directionZ);
+    if (!_moved) {
+        return;
+    }
+    // rotating keeps the directions normalised
+    row.origin = origin();
+    for (int i = 0; i < count; i++) {
+        const Vector3df direction = _rotation.direction(
+            Vector3df{row.directionX[i], row.directionY[i], row.directionZ[i]});
+        row.directionX[i] = direction.vector[0];
+        row.directionY[i] = direction.vector[1];
+        row.directionZ[i] = direction.vector[2];
+    }
 }
-};  // namespace rt::camera
\ No newline at end of file
+};  // namespace rt::camera
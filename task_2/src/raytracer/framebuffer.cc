@@ -0,0 +1,149 @@
+#include "framebuffer.h"
+#include "tonemap.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace rt::fb {
+
+// relaxed atomic accesses of a component, nothing else is published through the pixels
+static void storeComponent(float& component, float value) {
+    std::atomic_ref<float>(component).store(value, std::memory_order_relaxed);
+}
+
+static float loadComponent(const float& component) {
+    // atomic_ref needs a mutable object, the load does not modify it
+    return std::atomic_ref<float>(const_cast<float&>(component)).load(std::memory_order_relaxed);
+}
+
+MemoryFramebuffer::MemoryFramebuffer(int width, int height)
+    : _width(width), _height(height), _pixels(static_cast<size_t>(width) * height * 3, 0.0f) {}
+
+void MemoryFramebuffer::setPixel(int x, int y, const Vector3df& color) {
+    float* pixel = &_pixels[(static_cast<size_t>(y) * _width + x) * 3];
+    storeComponent(pixel[0], color.vector[0]);
+    storeComponent(pixel[1], color.vector[1]);
+    storeComponent(pixel[2], color.vector[2]);
+}
+
+Vector3df MemoryFramebuffer::getPixel(int x, int y) const {
+    const float* pixel = &_pixels[(static_cast<size_t>(y) * _width + x) * 3];
+    return Vector3df{loadComponent(pixel[0]), loadComponent(pixel[1]), loadComponent(pixel[2])};
+}
+
+void MemoryFramebuffer::copyRow(int y, float* destination) const {
+    const size_t rowLength = static_cast<size_t>(_width) * 3;
+    const float* row       = &_pixels[static_cast<size_t>(y) * rowLength];
+    for (size_t i = 0; i < rowLength; i++) {
+        destination[i] = loadComponent(row[i]);
+    }
+}
+
+static std::ofstream openImage(const std::string& path) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("can not open " + path + " for writing");
+    }
+    return file;
+}
+
+void writePpm(const MemoryFramebuffer& framebuffer, const std::string& path,
+              const Tonemap& tonemap) {
+    const Tonemapper tonemapper(tonemap);
+    std::ofstream    file = openImage(path);
+    file << "P6\n" << framebuffer.width() << " " << framebuffer.height() << "\n255\n";
+
+    std::vector<uint8_t> bytes(framebuffer.data().size());
+    tonemapper.convertRows(framebuffer, 0, framebuffer.height(), RGB_BYTES, bytes.data(),
+                           static_cast<size_t>(framebuffer.width()) * 3);
+    file.write(reinterpret_cast<const char*>(bytes.data()),
+               static_cast<std::streamsize>(bytes.size()));
+
+    if (!file) {
+        throw std::runtime_error("can not write " + path);
+    }
+}
+
+void writePfm(const MemoryFramebuffer& framebuffer, const std::string& path) {
+    std::ofstream file = openImage(path);
+    // a negative scale marks little endian data
+    file << "PF\n" << framebuffer.width() << " " << framebuffer.height() << "\n-1.0\n";
+
+    // PFM stores the rows from bottom to top
+    const size_t rowLength = static_cast<size_t>(framebuffer.width()) * 3;
+    for (int y = framebuffer.height() - 1; y >= 0; y--) {
+        const float* row = framebuffer.data().data() + y * rowLength;
+        for (size_t i = 0; i < rowLength; i++) {
+            uint32_t bits;
+            std::memcpy(&bits, &row[i], sizeof(bits));
+            const char bytes[4] = {static_cast<char>(bits), static_cast<char>(bits >> 8),
+                                   static_cast<char>(bits >> 16), static_cast<char>(bits >> 24)};
+            file.write(bytes, sizeof(bytes));
+        }
+    }
+
+    if (!file) {
+        throw std::runtime_error("can not write " + path);
+    }
+}
+
+void writeImage(const MemoryFramebuffer& framebuffer, const std::string& path,
+                const Tonemap& tonemap) {
+    const std::string extension = ".pfm";
+    if (path.size() >= extension.size() &&
+        path.compare(path.size() - extension.size(), extension.size(), extension) == 0) {
+        writePfm(framebuffer, path);
+    } else {
+        writePpm(framebuffer, path, tonemap);
+    }
+}
+
+Vector3df heatmapColor(float cost, float scale) {
+    // equally spaced colours, interpolated linearly
+    static constexpr std::array<std::array<float, 3>, 5> STOPS{{{0.0f, 0.0f, 0.5f},
+                                                                {0.0f, 0.6f, 1.0f},
+                                                                {0.1f, 0.9f, 0.1f},
+                                                                {1.0f, 0.9f, 0.0f},
+                                                                {1.0f, 0.0f, 0.0f}}};
+    const float value    = scale > 0.0f ? std::clamp(cost / scale, 0.0f, 1.0f) : 0.0f;
+    const float position = value * static_cast<float>(STOPS.size() - 1);
+    const auto  lower    = std::min(static_cast<size_t>(position), STOPS.size() - 2);
+    const float weight   = position - static_cast<float>(lower);
+
+    Vector3df color;
+    for (size_t i = 0; i < 3; i++) {
+        color.vector[i] = (1.0f - weight) * STOPS[lower][i] + weight * STOPS[lower + 1][i];
+    }
+    return color;
+}
+
+float costPercentile(std::vector<float> costs, float fraction) {
+    if (costs.empty()) {
+        return 0.0f;
+    }
+    const auto index = std::min(
+        static_cast<size_t>(std::clamp(fraction, 0.0f, 1.0f) * static_cast<float>(costs.size())),
+        costs.size() - 1);
+    std::nth_element(costs.begin(), costs.begin() + index, costs.end());
+    return costs[index];
+}
+
+void drawHeatmap(const std::vector<float>& costs, float scale, MemoryFramebuffer& framebuffer) {
+    const int width = framebuffer.width(), height = framebuffer.height();
+    if (costs.size() != static_cast<size_t>(width) * height) {
+        throw std::invalid_argument("the heatmap needs one cost per pixel");
+    }
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            framebuffer.setPixel(x, y, heatmapColor(costs[static_cast<size_t>(y) * width + x],
+                                                    scale));
+        }
+    }
+}
+
+}  // namespace rt::fb
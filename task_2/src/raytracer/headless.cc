@@ -0,0 +1,221 @@
+#include "math.h"
+#include "geometry.h"
+#include "viewport.h"
+#include "camera.h"
+#include "world.h"
+#include "scene.h"
+#include "scene_file.h"
+#include "thread_pool.h"
+#include "renderer.h"
+#include "antialias.h"
+#include "path_tracer.h"
+#include "framebuffer.h"
+#include "options.h"
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <string_view>
+#include <vector>
+
+using namespace rt;
+
+// Renders the scene without a window into an image file and exits.
+//   --scene <path>      the scene file to render, see loadSceneFile, the Cornell box if omitted
+//   --output <path>     render.ppm, a path ending with .pfm writes a float HDR image
+//   --width <pixels>    1000
+//   --height <pixels>   1000
+//   --threads <count>   0 uses all hardware threads
+//   --tile-size <pixels>
+//   --packet-size <pixels>  primary rays are traced in packets of n x n pixels, 1 to 8
+//   --max-depth <count>     reflections traced per camera ray, 0 for none
+//   --min-contribution <weight>  reflected rays with a smaller weight in their pixel are dropped
+//   --aa-grid <n>           n x n extra samples per high contrast pixel, 0 disables antialiasing
+//   --aa-threshold <value>  the difference to a neighbour in any channel that marks a pixel
+//   --aa-budget <rays>      at most this many extra camera rays per pixel on average
+//   --path-samples <n>      path traces n samples per pixel instead, 0 renders with renderImage
+//   --light-samples <n>     lights picked from the light tree at each path vertex, 1
+//   --seed <n>              the seed of the random numbers of path tracing
+//   --stats <path>          writes the ray counts, traversal counters and tile times as JSON
+//   --heatmap <path>        renders the image again and writes the cost of each pixel as heatmap
+//   --heatmap-metric <m>    nodes for the nodes visited plus primitives tested, ns for the time
+//   --heatmap-scale <cost>  the cost drawn red, 0 uses the 99th percentile of the costs
+//   --exposure <scale>      colours are scaled by this for PPM output, 1
+//   --gamma <gamma>         and gamma corrected, 1 keeps them linear
+int main(int argc, char* argv[]) {
+    const char* output   = cli::stringOption(argc, argv, "--output", "render.ppm");
+    const char* path     = cli::stringOption(argc, argv, "--scene", nullptr);
+    const int   width    = cli::intOption(argc, argv, "--width", 1000);
+    const int   height   = cli::intOption(argc, argv, "--height", 1000);
+    const int   threads  = cli::intOption(argc, argv, "--threads", 0);
+    const int   tileSize = cli::intOption(argc, argv, "--tile-size", render::DEFAULT_TILE_SIZE);
+    const int   packetSize =
+        cli::intOption(argc, argv, "--packet-size", render::DEFAULT_PACKET_SIZE);
+    const render::TraceSettings settings{
+        .maxDepth = cli::intOption(argc, argv, "--max-depth", render::DEFAULT_MAX_DEPTH),
+        .minContribution =
+            cli::floatOption(argc, argv, "--min-contribution", render::DEFAULT_MIN_CONTRIBUTION)};
+    const render::AntialiasSettings defaultAntialias;
+    const render::AntialiasSettings antialias{
+        .gridSize  = cli::intOption(argc, argv, "--aa-grid", defaultAntialias.gridSize),
+        .threshold = cli::floatOption(argc, argv, "--aa-threshold", defaultAntialias.threshold),
+        .budget    = cli::floatOption(argc, argv, "--aa-budget", defaultAntialias.budget)};
+    const render::PathSettings pathSettings{
+        .samplesPerPixel = cli::intOption(argc, argv, "--path-samples", 0),
+        .lightSamples    = cli::intOption(argc, argv, "--light-samples", 1),
+        .seed            = static_cast<uint32_t>(cli::intOption(argc, argv, "--seed", 0))};
+    const fb::Tonemap tonemap{.exposure = cli::floatOption(argc, argv, "--exposure", 1.0f),
+                              .gamma    = cli::floatOption(argc, argv, "--gamma", 1.0f)};
+
+    const char* statisticsPath = cli::stringOption(argc, argv, "--stats", nullptr);
+    const char* heatmapPath    = cli::stringOption(argc, argv, "--heatmap", nullptr);
+    const char* heatmapMetric  = cli::stringOption(argc, argv, "--heatmap-metric", "nodes");
+    float       heatmapScale   = cli::floatOption(argc, argv, "--heatmap-scale", 0.0f);
+
+    if (width <= 0 || height <= 0 || tileSize <= 0) {
+        std::cerr << "width, height and tile size have to be positive" << std::endl;
+        return 1;
+    }
+    if (packetSize < 1 || packetSize > render::MAX_PACKET_SIZE) {
+        std::cerr << "packet size has to be between 1 and " << render::MAX_PACKET_SIZE
+                  << std::endl;
+        return 1;
+    }
+    if (settings.maxDepth < 0 || settings.minContribution < 0.0f) {
+        std::cerr << "max depth and min contribution must not be negative" << std::endl;
+        return 1;
+    }
+    if (pathSettings.samplesPerPixel < 0 || pathSettings.lightSamples < 1) {
+        std::cerr << "path samples must not be negative, light samples have to be positive"
+                  << std::endl;
+        return 1;
+    }
+    if (!(tonemap.gamma > 0.0f)) {
+        std::cerr << "gamma has to be positive" << std::endl;
+        return 1;
+    }
+    if (antialias.gridSize < 0 || antialias.budget < 0.0f) {
+        std::cerr << "antialiasing grid and budget must not be negative" << std::endl;
+        return 1;
+    }
+    const std::string_view metricName = heatmapMetric;
+    if ((metricName != "nodes" && metricName != "ns") || heatmapScale < 0.0f) {
+        std::cerr << "heatmap metric has to be nodes or ns, its scale must not be negative"
+                  << std::endl;
+        return 1;
+    }
+
+    parallel::ThreadPool  pool{static_cast<unsigned>(std::max(threads, 0))};
+    fb::MemoryFramebuffer framebuffer{width, height};
+
+    world::Scene     sceneWorld;
+    world::SceneFile file;
+    if (path != nullptr) {
+        try {
+            file = world::loadSceneFile(path, sceneWorld, pool);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+        sceneWorld.build();
+    } else {
+        sceneWorld  = world::createScene<world::Scene>();
+        file.lights = world::createLights();
+    }
+    const auto& lights = file.lights;
+
+    // without a viewport in the scene file the viewport keeps the aspect ratio of the image
+    view::Viewport viewport = file.camera.viewport(width, height);
+    camera::Camera camera   = file.camera.camera(viewport);
+
+    // the counters and the time of all passes over the image
+    render::WorkerContext frame;
+    double                frameSeconds = 0.0;
+    if (pathSettings.samplesPerPixel > 0) {
+        // jittered samples antialias the image, refineAdaptive is not needed
+        const auto start    = std::chrono::steady_clock::now();
+        const auto contexts = render::renderPathTraced(pool, camera, sceneWorld, lights,
+                                                       framebuffer, pathSettings, tileSize);
+        frameSeconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        frame = render::mergeContexts(contexts);
+        std::cout << "path traced " << width << "x" << height << " with "
+                  << pathSettings.samplesPerPixel << " samples per pixel and " << pool.size()
+                  << " threads, " << static_cast<double>(frame.primaryRays) / frameSeconds / 1e6
+                  << " Msamples/s" << std::endl;
+    } else {
+        const auto start    = std::chrono::steady_clock::now();
+        const auto contexts = render::renderImage(pool, camera, sceneWorld, lights, framebuffer,
+                                                  tileSize, packetSize, settings);
+        const auto end      = std::chrono::steady_clock::now();
+
+        const double seconds = std::chrono::duration<double>(end - start).count();
+        const auto   merged  = render::mergeContexts(contexts);
+        const auto   rays    = merged.primaryRays + merged.shadowRays + merged.reflectionRays;
+        std::cout << "rendered " << width << "x" << height << " with " << pool.size()
+                  << " threads in " << seconds * 1000.0 << " ms, " << rays << " rays ("
+                  << merged.shadowRays << " shadow rays, " << merged.reflectionRays
+                  << " reflection rays), " << static_cast<double>(rays) / seconds / 1e6
+                  << " Mrays/s" << std::endl;
+
+        const auto aaStart    = std::chrono::steady_clock::now();
+        const auto statistics = render::refineAdaptive(pool, camera, sceneWorld, lights,
+                                                       framebuffer, antialias, settings);
+        const auto aaEnd      = std::chrono::steady_clock::now();
+        const auto extraRays  = statistics.rays.primaryRays + statistics.rays.shadowRays +
+                               statistics.rays.reflectionRays;
+        std::cout << "antialiased " << statistics.refinedPixels << " of "
+                  << statistics.candidatePixels << " high contrast pixels in "
+                  << std::chrono::duration<double>(aaEnd - aaStart).count() * 1000.0 << " ms, "
+                  << extraRays << " extra rays (" << statistics.rays.primaryRays
+                  << " camera rays, " << static_cast<double>(statistics.rays.primaryRays) /
+                                             static_cast<double>(merged.primaryRays)
+                  << " per pixel)" << std::endl;
+
+        frame        = render::mergeContexts({merged, statistics.rays});
+        frameSeconds = std::chrono::duration<double>(aaEnd - start).count();
+    }
+    std::cout << render::statisticsSummary(frame, frameSeconds) << std::endl;
+
+    if (statisticsPath != nullptr) {
+        std::ofstream json(statisticsPath);
+        render::writeStatisticsJson(json, frame, frameSeconds);
+        if (!json) {
+            std::cerr << "could not write " << statisticsPath << std::endl;
+            return 1;
+        }
+    }
+
+    if (heatmapPath != nullptr) {
+        // a pass of single rays, so each pixel is charged with the traversal of its own rays
+        const auto metric = metricName == "ns" ? render::CostMetric::Nanoseconds
+                                               : render::CostMetric::Traversal;
+        try {
+            fb::MemoryFramebuffer scratch{width, height};
+            std::vector<float>    costs;
+            render::renderCosts(pool, camera, sceneWorld, lights, scratch, costs, metric,
+                                settings, tileSize);
+            if (heatmapScale == 0.0f) {
+                heatmapScale = std::max(fb::costPercentile(costs, 0.99f), 1.0f);
+            }
+            fb::drawHeatmap(costs, heatmapScale, scratch);
+            fb::writeImage(scratch, heatmapPath, fb::Tonemap{});
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+        std::cout << "written " << heatmapPath << ", " << metricName << " per pixel up to "
+                  << heatmapScale << std::endl;
+    }
+
+    try {
+        fb::writeImage(framebuffer, output, tonemap);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    std::cout << "written " << output << std::endl;
+    return 0;
+}
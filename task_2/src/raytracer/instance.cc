@@ -0,0 +1,39 @@
+#include "instance.h"
+
+namespace rt::world {
+
+Instance::Instance(Mesh mesh, const Transform& toWorld)
+    : _mesh(std::move(mesh)), _toWorld(toWorld), _toObject(toWorld.inverse()),
+      _bounds(toWorld.bounds(_mesh.bounds())) {}
+
+Ray3df Instance::toObject(const Ray3df& ray, float& scale) const {
+    Vector3df direction = _toObject.direction(ray.direction);
+    scale               = direction.length();
+    direction.normalize();
+    return Ray3df{_toObject.point(ray.origin), direction};
+}
+
+bool Instance::intersects(const Ray3df& ray, Intersection_Context<float, 3>& context,
+                          float tMax) const {
+    float        scale;
+    const Ray3df objectRay = toObject(ray, scale);
+    if (!_mesh.intersects(objectRay, context, tMax * scale)) {
+        return false;
+    }
+    context.t /= scale;
+    // the point on the world ray avoids the rounding of the transformation back
+    for (size_t i = 0; i < 3; i++) {
+        context.intersection.vector[i] = ray.origin.vector[i] + context.t * ray.direction.vector[i];
+    }
+    context.normal = _toObject.transposedDirection(context.normal);
+    context.normal.normalize();
+    return true;
+}
+
+bool Instance::occludes(const Ray3df& ray, float tMax) const {
+    float        scale;
+    const Ray3df objectRay = toObject(ray, scale);
+    return _mesh.occludes(objectRay, tMax * scale);
+}
+
+}  // namespace rt::world
@@ -0,0 +1,88 @@
+#include "interactive.h"
+
+namespace rt::render {
+
+InteractiveRender::InteractiveRender(int width, int height,
+                                     const std::vector<world::PointLight>& lights,
+                                     const InteractiveSettings&            settings)
+    : _width(width), _height(height), _lights(lights), _lightTree(lights), _settings(settings),
+      _pixels(static_cast<size_t>(width) * height) {
+    // the largest power of two up to the maximum block size
+    _blockSize = 1;
+    while (_blockSize * 2 <= _settings.maxBlockSize) {
+        _blockSize *= 2;
+    }
+    _settings.maxBlockSize = _blockSize;
+}
+
+void InteractiveRender::reproject(parallel::ThreadPool& pool, const camera::Camera& camera) {
+    const size_t           size       = _pixels.size();
+    const view::Projection projection = camera.projection();
+    const float            width = static_cast<float>(_width), height = static_cast<float>(_height);
+    _targets.resize(size);
+
+    // the pixel each pixel with samples is seen through now, its hit point projected to the
+    // nearest pixel centre
+    pool.parallelFor(static_cast<size_t>(_height), [&](size_t y, unsigned) {
+        for (size_t i = y * _width; i < (y + 1) * _width; i++) {
+            Pixel& pixel = _pixels[i];
+            _targets[i]  = NO_TARGET;
+            float pixelX, pixelY;
+            if (pixel.samples == 0 || pixel.hitPoint.vector[0] == MISSED ||
+                !projection(pixel.hitPoint, pixelX, pixelY)) {
+                continue;
+            }
+            pixelX += 0.5f;
+            pixelY += 0.5f;
+            if (pixelX >= 0.0f && pixelY >= 0.0f && pixelX < width && pixelY < height) {
+                _targets[i] = static_cast<uint32_t>(
+                    index(static_cast<int>(pixelX), static_cast<int>(pixelY)));
+                pixel.distance = 0.0f;
+                for (size_t k = 0; k < 3; k++) {
+                    const float d = pixel.hitPoint.vector[k] - projection.origin.vector[k];
+                    pixel.distance += d * d;
+                }
+            }
+        }
+    });
+
+    // Pixels from anywhere in the image may land on the same pixel, the one closest to the
+    // camera is in front and kept. A pass without any arithmetic, so it runs on this thread.
+    const auto keptSamples = static_cast<uint32_t>(std::max(_settings.maxReprojectedSamples, 0));
+    const auto fullSamples = static_cast<uint32_t>(std::max(_settings.samplesPerPixel, 1));
+    size_t     converged   = 0;
+    _movedPixels.assign(size, Pixel{});
+    for (size_t i = 0; i < size; i++) {
+        const uint32_t target = _targets[i];
+        if (target == NO_TARGET) {
+            continue;
+        }
+        Pixel& moved = _movedPixels[target];
+        if (moved.samples == 0 || _pixels[i].distance < moved.distance) {
+            converged -= moved.samples >= fullSamples;
+            moved         = _pixels[i];
+            moved.samples = std::min(moved.samples, keptSamples);
+            converged += moved.samples >= fullSamples;
+        }
+    }
+    _pixels.swap(_movedPixels);
+
+    _convergedPixels = converged;
+    _pose            = camera.pose();
+    _fullyWritten    = false;
+}
+
+void InteractiveRender::adaptBlockSize(double seconds) {
+    if (!(_settings.frameSeconds > 0.0)) {
+        _blockSize = _settings.maxBlockSize;
+        return;
+    }
+    // a block size of half traces four times the rays
+    if (seconds > _settings.frameSeconds && _blockSize < _settings.maxBlockSize) {
+        _blockSize *= 2;
+    } else if (4.0 * seconds < _settings.frameSeconds && _blockSize > 1) {
+        _blockSize /= 2;
+    }
+}
+
+}  // namespace rt::render
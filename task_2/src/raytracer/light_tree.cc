@@ -0,0 +1,157 @@
+#include "light_tree.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace rt::accel {
+
+namespace {
+
+// the power of a light by which it is picked, the mean of its colour channels
+float lightPower(const world::PointLight& light) {
+    const Vector3df& color = light.color;
+    return std::max(0.0f, (color.vector[0] + color.vector[1] + color.vector[2]) / 3.0f);
+}
+
+}  // namespace
+
+LightTree::LightTree(const std::vector<world::PointLight>& lights) {
+    if (lights.empty()) {
+        return;
+    }
+
+    std::vector<BuildLight> buildLights;
+    buildLights.reserve(lights.size());
+    for (uint32_t i = 0; i < lights.size(); i++) {
+        buildLights.push_back({lights[i].position, lightPower(lights[i]), i});
+    }
+
+    _nodes.reserve(2 * lights.size() - 1);
+    _nodes.emplace_back();
+    build(buildLights, 0, 0, static_cast<uint32_t>(buildLights.size()));
+
+    // the leaves index the lights in the order of the build
+    _lights.reserve(lights.size());
+    for (const auto& light : buildLights) {
+        _lights.push_back(lights[light.index]);
+    }
+}
+
+void LightTree::build(std::vector<BuildLight>& lights, uint32_t nodeIndex, uint32_t begin,
+                      uint32_t end) {
+    Vector3df lower{std::numeric_limits<float>::infinity()};
+    Vector3df upper{-std::numeric_limits<float>::infinity()};
+    float     power = 0.0f;
+    for (uint32_t i = begin; i < end; i++) {
+        for (size_t axis = 0; axis < 3; axis++) {
+            lower.vector[axis] = std::min(lower.vector[axis], lights[i].position.vector[axis]);
+            upper.vector[axis] = std::max(upper.vector[axis], lights[i].position.vector[axis]);
+        }
+        power += lights[i].power;
+    }
+    _nodes[nodeIndex].lower = lower;
+    _nodes[nodeIndex].upper = upper;
+    _nodes[nodeIndex].power = power;
+
+    if (end - begin == 1) {
+        _nodes[nodeIndex].first = begin | LightTreeNode::LEAF;
+        return;
+    }
+
+    int axis = 0;
+    for (int i = 1; i < 3; i++) {
+        if (upper[i] - lower[i] > upper[axis] - lower[axis]) {
+            axis = i;
+        }
+    }
+    const uint32_t middle = begin + (end - begin) / 2;
+    std::nth_element(lights.begin() + begin, lights.begin() + middle, lights.begin() + end,
+                     [axis](const BuildLight& a, const BuildLight& b) {
+                         return a.position[axis] < b.position[axis];
+                     });
+
+    // _nodes grows below, so the node is not kept as a reference
+    const auto left         = static_cast<uint32_t>(_nodes.size());
+    _nodes[nodeIndex].first = left;
+    _nodes.emplace_back();
+    _nodes.emplace_back();
+    build(lights, left, begin, middle);
+    build(lights, left + 1, middle, end);
+}
+
+float LightTree::importance(const LightTreeNode& node, const Vector3df& point,
+                            const Vector3df& normal) {
+    // Two upper bounds of the cosine between the normal and the direction to any point q of the
+    // bounds, the smaller one is used: the largest normal * (q - point) divided by the smallest
+    // distance to the bounds, which is zero for bounds behind the surface, and the cone from the
+    // point around the bounding sphere of the node, whose largest cosine to the normal is at the
+    // edge of the cone closest to it.
+    Vector3df toCenter;
+    float     radiusSquared = 0.0f, nearestSquared = 0.0f, farthestAlongNormal = 0.0f;
+    for (size_t i = 0; i < 3; i++) {
+        const float lower    = node.lower.vector[i] - point.vector[i];
+        const float upper    = node.upper.vector[i] - point.vector[i];
+        const float nearest  = std::max({lower, -upper, 0.0f});
+        const float halfSize = 0.5f * (upper - lower);
+        toCenter.vector[i]   = 0.5f * (lower + upper);
+        radiusSquared += halfSize * halfSize;
+        nearestSquared += nearest * nearest;
+        farthestAlongNormal += normal.vector[i] * (normal.vector[i] > 0.0f ? upper : lower);
+    }
+    if (farthestAlongNormal <= 0.0f) {
+        return 0.0f;
+    }
+    if (nearestSquared == 0.0f) {
+        return node.power;  // the point is within the bounds, lights may lie in any direction
+    }
+    const float boxBound = farthestAlongNormal / std::sqrt(nearestSquared);
+
+    const float distanceSquared = toCenter.square_of_length();
+    float       coneBound       = 1.0f;
+    if (distanceSquared > radiusSquared) {
+        const float cosAxis = (normal * toCenter) / std::sqrt(distanceSquared);
+        const float sinCone = std::sqrt(radiusSquared / distanceSquared);
+        const float cosCone = std::sqrt(1.0f - radiusSquared / distanceSquared);
+        if (cosAxis < cosCone) {
+            const float sinAxis = std::sqrt(std::max(0.0f, 1.0f - cosAxis * cosAxis));
+            coneBound           = std::max(0.0f, cosAxis * cosCone + sinAxis * sinCone);
+        }
+    }
+    return node.power * std::min({boxBound, coneBound, 1.0f});
+}
+
+LightTree::Sample LightTree::sample(const Vector3df& point, const Vector3df& normal,
+                                    float u) const {
+    if (_nodes.empty() || importance(_nodes[0], point, normal) <= 0.0f) {
+        return {};
+    }
+
+    const LightTreeNode* nodes       = _nodes.data();
+    uint32_t             index       = 0;
+    float                probability = 1.0f;
+    while (!nodes[index].isLeaf()) {
+        const uint32_t left            = nodes[index].first;
+        const float    leftImportance  = importance(nodes[left], point, normal);
+        const float    rightImportance = importance(nodes[left + 1], point, normal);
+        const float    total           = leftImportance + rightImportance;
+        if (!(total > 0.0f)) {
+            return {};
+        }
+        // u is reused for the next level, rescaled to [0, 1) within the chosen child
+        const float leftProbability = leftImportance / total;
+        if (u < leftProbability) {
+            index = left;
+            probability *= leftProbability;
+            u /= leftProbability;
+        } else {
+            index = left + 1;
+            probability *= 1.0f - leftProbability;
+            u = (u - leftProbability) / (1.0f - leftProbability);
+        }
+        u = std::min(u, std::nextafter(1.0f, 0.0f));
+    }
+    return {&_lights[nodes[index].first & ~LightTreeNode::LEAF], probability};
+}
+
+}  // namespace rt::accel
@@ -0,0 +1,98 @@
+#include "mapped_file.h"
+
+#include <stdexcept>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace rt::io {
+
+#if defined(_WIN32)
+
+MappedFile::MappedFile(const std::string& path) {
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    LARGE_INTEGER size;
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("can not open " + path);
+    }
+    _file = file;
+    if (!GetFileSizeEx(file, &size)) {
+        release();
+        throw std::runtime_error("can not open " + path);
+    }
+    _size = static_cast<size_t>(size.QuadPart);
+    if (_size == 0) {
+        return;  // empty files can not be mapped
+    }
+
+    _mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (_mapping != nullptr) {
+        _data = static_cast<const char*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+    }
+    if (_data == nullptr) {
+        release();
+        throw std::runtime_error("can not map " + path);
+    }
+}
+
+void MappedFile::release() {
+    if (_data != nullptr) {
+        UnmapViewOfFile(_data);
+    }
+    if (_mapping != nullptr) {
+        CloseHandle(_mapping);
+    }
+    if (_file != nullptr) {
+        CloseHandle(_file);
+    }
+    _data    = nullptr;
+    _mapping = nullptr;
+    _file    = nullptr;
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& path) {
+    _descriptor = open(path.c_str(), O_RDONLY);
+    struct stat status;
+    if (_descriptor < 0 || fstat(_descriptor, &status) != 0) {
+        release();
+        throw std::runtime_error("can not open " + path);
+    }
+    _size = static_cast<size_t>(status.st_size);
+    if (_size == 0) {
+        return;  // empty files can not be mapped
+    }
+
+    void* data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, _descriptor, 0);
+    if (data == MAP_FAILED) {
+        release();
+        throw std::runtime_error("can not map " + path);
+    }
+    _data = static_cast<const char*>(data);
+    // files are read concurrently or at random, so read ahead the whole file, not sequentially
+    madvise(data, _size, MADV_WILLNEED);
+}
+
+void MappedFile::release() {
+    if (_data != nullptr) {
+        munmap(const_cast<char*>(_data), _size);
+    }
+    if (_descriptor >= 0) {
+        close(_descriptor);
+    }
+    _data       = nullptr;
+    _descriptor = -1;
+}
+
+#endif
+
+}  // namespace rt::io
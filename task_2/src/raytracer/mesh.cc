@@ -0,0 +1,259 @@
+#include "mesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+namespace rt::world {
+
+namespace {
+
+// Larger leaves than for scenes halve the nodes per triangle, at about 10% of the speed.
+// The nodes would otherwise take as much memory as the vertices and indices together.
+const accel::Bvh::Settings BVH_SETTINGS{.maxLeafSize = 8, .traversalCost = 2.0f};
+
+Vector3df difference(const Vector3df& a, const Vector3df& b) {
+    return Vector3df{a.vector[0] - b.vector[0], a.vector[1] - b.vector[1],
+                     a.vector[2] - b.vector[2]};
+}
+
+float dot(const Vector3df& a, const Vector3df& b) {
+    return a.vector[0] * b.vector[0] + a.vector[1] * b.vector[1] + a.vector[2] * b.vector[2];
+}
+
+Vector3df cross(const Vector3df& a, const Vector3df& b) {
+    return Vector3df{a.vector[1] * b.vector[2] - a.vector[2] * b.vector[1],
+                     a.vector[2] * b.vector[0] - a.vector[0] * b.vector[2],
+                     a.vector[0] * b.vector[1] - a.vector[1] * b.vector[0]};
+}
+
+// the Moeller-Trumbore test of PrecomputedTriangle::intersects on the corners of a triangle,
+// the edges are not stored, sets t and the barycentric coordinates of b and c on success
+bool intersectTriangle(const Vector3df& a, const Vector3df& b, const Vector3df& c,
+                       const Ray3df& ray, float& t, float& uB, float& uC) {
+    const float EPSILON = 10e-7f;
+
+    const Vector3df edgeAB      = difference(b, a);
+    const Vector3df edgeAC      = difference(c, a);
+    const Vector3df pVector     = cross(ray.direction, edgeAC);
+    const float     determinant = dot(edgeAB, pVector);
+    if (std::fabs(determinant) < EPSILON) {
+        return false;
+    }
+    const float inverseDeterminant = 1.0f / determinant;
+
+    const Vector3df aToOrigin = difference(ray.origin, a);
+    uB                        = dot(aToOrigin, pVector) * inverseDeterminant;
+    if (uB < 0.0f || uB > 1.0f) {
+        return false;
+    }
+
+    const Vector3df qVector = cross(aToOrigin, edgeAB);
+    uC                      = dot(ray.direction, qVector) * inverseDeterminant;
+    if (uC < 0.0f || uB + uC > 1.0f) {
+        return false;
+    }
+
+    t = dot(edgeAC, qVector) * inverseDeterminant;
+    return t >= 0.0f;
+}
+
+void checkIndices(std::span<const uint32_t> indices, size_t count, const char* name) {
+    for (uint32_t index : indices) {
+        if (index >= count) {
+            throw std::runtime_error(std::string("mesh ") + name + " index " +
+                                     std::to_string(index) + " out of range");
+        }
+    }
+}
+
+}  // namespace
+
+Mesh::Mesh(std::vector<Vector3df> positions, std::vector<uint32_t> positionIndices,
+           std::vector<Vector3df> normals, std::vector<uint32_t> normalIndices) {
+    if (positionIndices.size() % 3 != 0) {
+        throw std::runtime_error("mesh indices are no multiple of 3");
+    }
+    checkIndices(positionIndices, positions.size(), "position");
+    if (!normals.empty()) {
+        if (normalIndices.empty() && normals.size() != positions.size()) {
+            throw std::runtime_error("mesh without normal indices needs a normal per position");
+        }
+        if (!normalIndices.empty() && normalIndices.size() != positionIndices.size()) {
+            throw std::runtime_error("mesh needs as many normal indices as position indices");
+        }
+        checkIndices(normalIndices, normals.size(), "normal");
+    } else {
+        normalIndices.clear();
+    }
+
+    const size_t         triangles = positionIndices.size() / 3;
+    std::vector<AABB3df> bounds;
+    bounds.reserve(triangles);
+    for (size_t i = 0; i < triangles; i++) {
+        Vector3df lower = positions[positionIndices[3 * i]], upper = lower;
+        for (size_t j = 1; j < 3; j++) {
+            const Vector3df& corner = positions[positionIndices[3 * i + j]];
+            for (size_t k = 0; k < 3; k++) {
+                lower.vector[k] = std::min(lower.vector[k], corner.vector[k]);
+                upper.vector[k] = std::max(upper.vector[k], corner.vector[k]);
+            }
+        }
+        bounds.push_back(AABB3df::from_corners(lower, upper));
+    }
+
+    auto data = std::make_shared<Data>();
+    data->bvh = accel::Bvh(bounds, {}, BVH_SETTINGS);
+
+    // the triangles in leaf order, so each leaf covers a contiguous range
+    data->ownedPositionIndices.reserve(positionIndices.size());
+    data->ownedNormalIndices.reserve(normalIndices.size());
+    for (uint32_t triangle : data->bvh.primitiveIndices()) {
+        for (size_t j = 0; j < 3; j++) {
+            data->ownedPositionIndices.push_back(positionIndices[3 * triangle + j]);
+            if (!normalIndices.empty()) {
+                data->ownedNormalIndices.push_back(normalIndices[3 * triangle + j]);
+            }
+        }
+    }
+    data->bvh.releasePrimitiveIndices();
+    data->ownedPositions  = std::move(positions);
+    data->ownedNormals    = std::move(normals);
+    data->positions       = data->ownedPositions;
+    data->normals         = data->ownedNormals;
+    data->positionIndices = data->ownedPositionIndices;
+    data->normalIndices   = data->ownedNormalIndices;
+    _data                 = std::move(data);
+}
+
+Mesh::Mesh(const View& view, std::shared_ptr<const void> storage) {
+    if (view.positionIndices.size() % 3 != 0) {
+        throw std::runtime_error("mesh indices are no multiple of 3");
+    }
+    if (!view.normals.empty() && view.normalIndices.empty() &&
+        view.normals.size() != view.positions.size()) {
+        throw std::runtime_error("mesh without normal indices needs a normal per position");
+    }
+    if (!view.normalIndices.empty() && view.normalIndices.size() != view.positionIndices.size()) {
+        throw std::runtime_error("mesh needs as many normal indices as position indices");
+    }
+    if (view.nodes.empty() != view.positionIndices.empty()) {
+        throw std::runtime_error("mesh hierarchy does not fit its triangles");
+    }
+    checkIndices(view.positionIndices, view.positions.size(), "position");
+    if (!view.normals.empty()) {
+        checkIndices(view.normalIndices, view.normals.size(), "normal");
+    }
+
+    auto data             = std::make_shared<Data>();
+    data->positions       = view.positions;
+    data->normals         = view.normals;
+    data->positionIndices = view.positionIndices;
+    data->normalIndices   = view.normals.empty() ? std::span<const uint32_t>() : view.normalIndices;
+    data->bvh             = accel::Bvh::view(view.nodes, view.positionIndices.size() / 3);
+    data->storage         = std::move(storage);
+    _data                 = std::move(data);
+}
+
+Mesh::View Mesh::view() const {
+    return View{.positions       = _data->positions,
+                .normals         = _data->normals,
+                .positionIndices = _data->positionIndices,
+                .normalIndices   = _data->normalIndices,
+                .nodes           = _data->bvh.nodes()};
+}
+
+bool Mesh::intersectLeaf(const accel::BvhNode& leaf, const Ray3df& ray, float& tMax,
+                         TriangleHit& hit) const {
+    const auto& positions = _data->positions;
+    const auto& indices   = _data->positionIndices;
+
+    bool found = false;
+    for (uint32_t i = leaf.first; i < leaf.first + leaf.count; i++) {
+        float t, uB, uC;
+        if (intersectTriangle(positions[indices[3 * i]], positions[indices[3 * i + 1]],
+                              positions[indices[3 * i + 2]], ray, t, uB, uC) &&
+            t > 0.0f && t < tMax) {
+            tMax  = t;
+            hit   = TriangleHit{.triangle = i, .u = 1.0f - uB - uC, .v = uB};
+            found = true;
+        }
+    }
+    return found;
+}
+
+Vector3df Mesh::normal(const TriangleHit& hit) const {
+    const Data&     data    = *_data;
+    const uint32_t* corners = &data.positionIndices[3 * hit.triangle];
+    if (data.normals.empty()) {
+        const Vector3df& a = data.positions[corners[0]];
+        return cross(difference(data.positions[corners[1]], a),
+                     difference(data.positions[corners[2]], a));
+    }
+
+    if (!data.normalIndices.empty()) {
+        corners = &data.normalIndices[3 * hit.triangle];
+    }
+    const float w = 1.0f - hit.u - hit.v;
+    Vector3df   normal;
+    for (size_t i = 0; i < 3; i++) {
+        normal.vector[i] = hit.u * data.normals[corners[0]].vector[i] +
+                           hit.v * data.normals[corners[1]].vector[i] +
+                           w * data.normals[corners[2]].vector[i];
+    }
+    return normal;
+}
+
+bool Mesh::intersects(const Ray3df& ray, Intersection_Context<float, 3>& context,
+                      float tMax) const {
+    TriangleHit hit;
+    if (!_data->bvh.intersect(ray, tMax, [&](const accel::BvhNode& leaf, float& tClosest) {
+            return intersectLeaf(leaf, ray, tClosest, hit);
+        })) {
+        return false;
+    }
+
+    context.t = tMax;
+    context.u = hit.u;
+    context.v = hit.v;
+    for (size_t i = 0; i < 3; i++) {
+        context.intersection.vector[i] = ray.origin.vector[i] + tMax * ray.direction.vector[i];
+    }
+    context.normal = normal(hit);
+    return true;
+}
+
+bool Mesh::occludes(const Ray3df& ray, float tMax) const {
+    const auto& positions = _data->positions;
+    const auto& indices   = _data->positionIndices;
+    return _data->bvh.occluded(ray, tMax, [&](const accel::BvhNode& leaf) {
+        for (uint32_t i = leaf.first; i < leaf.first + leaf.count; i++) {
+            float t, uB, uC;
+            if (intersectTriangle(positions[indices[3 * i]], positions[indices[3 * i + 1]],
+                                  positions[indices[3 * i + 2]], ray, t, uB, uC) &&
+                t > 0.0f && t < tMax) {
+                return true;
+            }
+        }
+        return false;
+    });
+}
+
+AABB3df Mesh::bounds() const {
+    const auto& nodes = _data->bvh.nodes();
+    if (nodes.empty()) {
+        return AABB3df::from_corners(Vector3df{0.0f, 0.0f, 0.0f}, Vector3df{0.0f, 0.0f, 0.0f});
+    }
+    return AABB3df::from_corners(nodes[0].lower, nodes[0].upper);
+}
+
+size_t Mesh::memoryBytes() const {
+    const Data& data = *_data;
+    return data.positions.size_bytes() + data.normals.size_bytes() +
+           data.positionIndices.size_bytes() + data.normalIndices.size_bytes() +
+           data.bvh.nodes().size_bytes();
+}
+
+}  // namespace rt::world
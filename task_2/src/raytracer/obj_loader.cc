@@ -0,0 +1,352 @@
+#include "obj_loader.h"
+#include "line_parser.h"
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+namespace rt::world {
+
+namespace {
+
+using io::LineParser;
+
+// chunks are at least this large, so small files are not split into chunks of a few lines
+constexpr size_t MIN_CHUNK_SIZE = size_t{1} << 20;
+
+// chunks per worker, so workers with cheap chunks help out the others, e.g. chunks of vertices
+// are cheaper than chunks of faces
+constexpr size_t CHUNKS_PER_WORKER = 4;
+
+constexpr int32_t NO_NORMAL = std::numeric_limits<int32_t>::min();
+
+// A corner of a triangle, the indices of its vertex and normal in the whole file
+struct Corner {
+    int32_t position;
+    int32_t normal;  // NO_NORMAL if the corner has none
+};
+
+// A corner of a face while parsing its line
+struct FaceCorner {
+    Corner corner;
+    bool   relativePosition;
+    bool   relativeNormal;
+};
+
+// A range of lines of the file and what was parsed from it.
+// Negative OBJ indices count back from the last vertex defined before the face. The chunks are
+// parsed concurrently, so the number of vertices in the previous chunks is not known yet.
+// Such indices are stored relative to the first vertex of the chunk and resolved afterwards.
+struct Chunk {
+    std::string_view text;
+
+    std::vector<Vector3df> positions;
+    std::vector<Vector3df> normals;
+    std::vector<Corner>    corners;  // three per triangle
+    // 2 * i for the position and 2 * i + 1 for the normal of corners[i] with relative indices
+    std::vector<size_t> relative;
+
+    size_t      lines = 0;
+    std::string error;  // describes the first malformed line, the last parsed line
+
+    std::vector<TriangleObject>       flatTriangles;
+    std::vector<SmoothTriangleObject> smoothTriangles;
+};
+
+// converts an index of the file, starting at 1 or negative relative to count,
+// to an index starting at 0, returns false for 0
+bool resolveIndex(int32_t index, size_t count, int32_t& resolved, bool& relative) {
+    relative = index < 0;
+    if (index > 0) {
+        resolved = index - 1;
+    } else if (index < 0) {
+        resolved = static_cast<int32_t>(static_cast<int64_t>(count) + index);
+    }
+    return index != 0;
+}
+
+// parses the corners v, v/vt, v//vn or v/vt/vn of a face
+bool parseFace(LineParser& parser, Chunk& chunk, std::vector<FaceCorner>& face) {
+    face.clear();
+    while (parser.skipSpaces()) {
+        FaceCorner corner{{0, NO_NORMAL}, false, false};
+        int32_t    index;
+        if (!parser.read(index) || !resolveIndex(index, chunk.positions.size(),
+                                                 corner.corner.position, corner.relativePosition)) {
+            chunk.error = "invalid vertex index";
+            return false;
+        }
+        if (parser.consume('/')) {
+            int32_t textureIndex;
+            if (!parser.consume('/')) {
+                if (!parser.read(textureIndex)) {
+                    chunk.error = "invalid texture coordinate index";
+                    return false;
+                }
+                if (!parser.consume('/')) {
+                    face.push_back(corner);
+                    continue;
+                }
+            }
+            if (!parser.read(index) || !resolveIndex(index, chunk.normals.size(),
+                                                     corner.corner.normal, corner.relativeNormal)) {
+                chunk.error = "invalid normal index";
+                return false;
+            }
+        }
+        face.push_back(corner);
+    }
+    if (face.size() < 3) {
+        chunk.error = "face with less than 3 vertices";
+        return false;
+    }
+
+    // triangle fan around the first corner
+    for (size_t i = 1; i + 1 < face.size(); i++) {
+        for (const FaceCorner& corner : {face[0], face[i], face[i + 1]}) {
+            if (corner.relativePosition) {
+                chunk.relative.push_back(2 * chunk.corners.size());
+            }
+            if (corner.relativeNormal) {
+                chunk.relative.push_back(2 * chunk.corners.size() + 1);
+            }
+            chunk.corners.push_back(corner.corner);
+        }
+    }
+    return true;
+}
+
+// parses the lines of the chunk, stops at the first malformed line
+void parseChunk(Chunk& chunk) {
+    std::string_view        text = chunk.text;
+    std::vector<FaceCorner> face;
+    while (!text.empty()) {
+        const size_t     end  = text.find('\n');
+        std::string_view line = text.substr(0, end);
+        text = end == std::string_view::npos ? std::string_view() : text.substr(end + 1);
+        chunk.lines++;
+
+        LineParser             parser(line);
+        const std::string_view keyword = parser.keyword();
+        if (keyword == "v") {
+            Vector3df position;
+            if (!parser.readVector(position)) {
+                chunk.error = "expected 3 vertex coordinates";
+                return;
+            }
+            chunk.positions.push_back(position);
+        } else if (keyword == "vn") {
+            Vector3df normal;
+            if (!parser.readVector(normal)) {
+                chunk.error = "expected 3 normal coordinates";
+                return;
+            }
+            chunk.normals.push_back(normal);
+        } else if (keyword == "f") {
+            if (!parseFace(parser, chunk, face)) {
+                return;
+            }
+        }
+    }
+}
+
+// resolves the relative indices of the corners of the chunk and checks that all are in range
+// firstPosition and firstNormal are the numbers of vertices and normals in the previous chunks
+void resolveCorners(Chunk& chunk, size_t firstPosition, size_t firstNormal, size_t positionCount,
+                    size_t normalCount) {
+    for (size_t index : chunk.relative) {
+        Corner& corner = chunk.corners[index / 2];
+        if (index % 2 == 0) {
+            corner.position += static_cast<int32_t>(firstPosition);
+        } else {
+            corner.normal += static_cast<int32_t>(firstNormal);
+        }
+    }
+
+    for (const Corner& corner : chunk.corners) {
+        if (corner.position < 0 || static_cast<size_t>(corner.position) >= positionCount) {
+            chunk.error = "vertex index out of range";
+            return;
+        }
+        if (corner.normal != NO_NORMAL &&
+            (corner.normal < 0 || static_cast<size_t>(corner.normal) >= normalCount)) {
+            chunk.error = "normal index out of range";
+            return;
+        }
+    }
+}
+
+// creates the triangles of the resolved corners of the chunk
+void createTriangles(Chunk& chunk, const std::vector<Vector3df>& positions,
+                     const std::vector<Vector3df>& normals, const Material& material) {
+    for (size_t i = 0; i < chunk.corners.size(); i += 3) {
+        const Corner*    corners = &chunk.corners[i];
+        const Vector3df& a       = positions[corners[0].position];
+        const Vector3df& b       = positions[corners[1].position];
+        const Vector3df& c       = positions[corners[2].position];
+        if (corners[0].normal != NO_NORMAL && corners[1].normal != NO_NORMAL &&
+            corners[2].normal != NO_NORMAL) {
+            chunk.smoothTriangles.emplace_back(
+                SmoothTriangle3df(a, b, c, normals[corners[0].normal], normals[corners[1].normal],
+                                  normals[corners[2].normal]),
+                material);
+        } else {
+            chunk.flatTriangles.emplace_back(a, b, c, material);
+        }
+    }
+}
+
+// appends the vectors of all chunks selected by member into one vector
+template <typename T>
+std::vector<T> concatenate(std::vector<Chunk>& chunks, std::vector<T> Chunk::* member,
+                           parallel::ThreadPool& pool) {
+    std::vector<size_t> offsets(chunks.size() + 1, 0);
+    for (size_t i = 0; i < chunks.size(); i++) {
+        offsets[i + 1] = offsets[i] + (chunks[i].*member).size();
+    }
+    std::vector<T> all(offsets.back());
+    pool.parallelFor(chunks.size(), [&](size_t index, unsigned) {
+        std::copy((chunks[index].*member).begin(), (chunks[index].*member).end(),
+                  all.begin() + static_cast<std::ptrdiff_t>(offsets[index]));
+        (chunks[index].*member) = std::vector<T>();
+    });
+    return all;
+}
+
+// The vertices and normals of a file and its chunks with the resolved corners of the triangles
+struct ParsedObj {
+    std::vector<Chunk>     chunks;
+    std::vector<Vector3df> positions;
+    std::vector<Vector3df> normals;
+};
+
+ParsedObj parseChunks(std::string_view contents, const std::string& name,
+                      parallel::ThreadPool& pool) {
+    // chunks of whole lines
+    const size_t chunkCount = std::clamp<size_t>(contents.size() / MIN_CHUNK_SIZE, 1,
+                                                 size_t{pool.size()} * CHUNKS_PER_WORKER);
+    ParsedObj           parsed;
+    std::vector<Chunk>& chunks = parsed.chunks;
+    size_t              begin  = 0;
+    for (size_t i = 1; i <= chunkCount && begin < contents.size(); i++) {
+        // the last chunk ends at the end of the file, the others after the next line break
+        size_t end = contents.size();
+        if (i < chunkCount) {
+            end = contents.find('\n', std::max(begin, contents.size() / chunkCount * i));
+            end = end == std::string_view::npos ? contents.size() : end + 1;
+        }
+        chunks.emplace_back().text = contents.substr(begin, end - begin);
+        begin                      = end;
+    }
+
+    pool.parallelFor(chunks.size(), [&](size_t index, unsigned) { parseChunk(chunks[index]); });
+
+    size_t line = 0;
+    for (const Chunk& chunk : chunks) {
+        line += chunk.lines;
+        if (!chunk.error.empty()) {
+            throw std::runtime_error(name + ":" + std::to_string(line) + ": " + chunk.error);
+        }
+    }
+
+    // the first vertex and normal of each chunk
+    std::vector<size_t> firstPositions(chunks.size(), 0), firstNormals(chunks.size(), 0);
+    for (size_t i = 1; i < chunks.size(); i++) {
+        firstPositions[i] = firstPositions[i - 1] + chunks[i - 1].positions.size();
+        firstNormals[i]   = firstNormals[i - 1] + chunks[i - 1].normals.size();
+    }
+    parsed.positions = concatenate(chunks, &Chunk::positions, pool);
+    parsed.normals   = concatenate(chunks, &Chunk::normals, pool);
+    if (parsed.positions.size() > static_cast<size_t>(std::numeric_limits<int32_t>::max()) ||
+        parsed.normals.size() > static_cast<size_t>(std::numeric_limits<int32_t>::max())) {
+        throw std::runtime_error(name + ": too many vertices");
+    }
+
+    pool.parallelFor(chunks.size(), [&](size_t index, unsigned) {
+        resolveCorners(chunks[index], firstPositions[index], firstNormals[index],
+                       parsed.positions.size(), parsed.normals.size());
+    });
+    for (const Chunk& chunk : chunks) {
+        if (!chunk.error.empty()) {
+            throw std::runtime_error(name + ": " + chunk.error);
+        }
+    }
+    return parsed;
+}
+
+}  // namespace
+
+ObjStatistics loadObj(const std::string& path, Scene& scene, const Material& material,
+                      parallel::ThreadPool& pool) {
+    const io::MappedFile file(path);
+    return parseObj(file.contents(), path, scene, material, pool);
+}
+
+ObjStatistics parseObj(std::string_view contents, const std::string& name, Scene& scene,
+                       const Material& material, parallel::ThreadPool& pool) {
+    ParsedObj parsed = parseChunks(contents, name, pool);
+    pool.parallelFor(parsed.chunks.size(), [&](size_t index, unsigned) {
+        createTriangles(parsed.chunks[index], parsed.positions, parsed.normals, material);
+    });
+
+    ObjStatistics statistics{.vertices = parsed.positions.size(),
+                             .normals  = parsed.normals.size()};
+    for (const Chunk& chunk : parsed.chunks) {
+        statistics.smoothTriangles += chunk.smoothTriangles.size();
+        statistics.triangles += chunk.flatTriangles.size() + chunk.smoothTriangles.size();
+    }
+
+    auto& flatBatch   = scene.batch<TriangleObject>();
+    auto& smoothBatch = scene.batch<SmoothTriangleObject>();
+    flatBatch.reserve(flatBatch.objects().size() + statistics.triangles -
+                      statistics.smoothTriangles);
+    smoothBatch.reserve(smoothBatch.objects().size() + statistics.smoothTriangles);
+    for (Chunk& chunk : parsed.chunks) {
+        for (auto& triangle : chunk.flatTriangles) {
+            flatBatch.add(std::move(triangle));
+        }
+        for (auto& triangle : chunk.smoothTriangles) {
+            smoothBatch.add(std::move(triangle));
+        }
+        chunk.flatTriangles   = std::vector<TriangleObject>();
+        chunk.smoothTriangles = std::vector<SmoothTriangleObject>();
+    }
+    return statistics;
+}
+
+Mesh loadObjMesh(const std::string& path, parallel::ThreadPool& pool) {
+    const io::MappedFile file(path);
+    return parseObjMesh(file.contents(), path, pool);
+}
+
+Mesh parseObjMesh(std::string_view contents, const std::string& name,
+                  parallel::ThreadPool& pool) {
+    ParsedObj                 parsed  = parseChunks(contents, name, pool);
+    const std::vector<Corner> corners = concatenate(parsed.chunks, &Chunk::corners, pool);
+
+    bool smooth = !parsed.normals.empty(), normalPerVertex = smooth;
+    std::vector<uint32_t> positionIndices, normalIndices;
+    positionIndices.reserve(corners.size());
+    for (const Corner& corner : corners) {
+        positionIndices.push_back(static_cast<uint32_t>(corner.position));
+        smooth &= corner.normal != NO_NORMAL;
+        normalPerVertex &= corner.normal == corner.position;
+    }
+    normalPerVertex &= parsed.normals.size() == parsed.positions.size();
+    if (!smooth) {
+        parsed.normals.clear();
+    } else if (!normalPerVertex) {
+        normalIndices.reserve(corners.size());
+        for (const Corner& corner : corners) {
+            normalIndices.push_back(static_cast<uint32_t>(corner.normal));
+        }
+    }
+
+    return Mesh(std::move(parsed.positions), std::move(positionIndices), std::move(parsed.normals),
+                std::move(normalIndices));
+}
+
+}  // namespace rt::world
@@ -0,0 +1,97 @@
+#include "packet.h"
+
+#include <bit>
+
+#include "bvh.h"
+#include "simd.h"
+
+namespace rt::accel {
+
+void RayPacket::add(const Ray3df& ray, float tMaxRay) {
+    const Vector3df inverse = inverseDirection(ray.direction);
+    originX[size]           = ray.origin.vector[0];
+    originY[size]           = ray.origin.vector[1];
+    originZ[size]           = ray.origin.vector[2];
+    directionX[size]        = ray.direction.vector[0];
+    directionY[size]        = ray.direction.vector[1];
+    directionZ[size]        = ray.direction.vector[2];
+    inverseX[size]          = inverse.vector[0];
+    inverseY[size]          = inverse.vector[1];
+    inverseZ[size]          = inverse.vector[2];
+    tMax[size]              = tMaxRay;
+    size++;
+}
+
+static uint64_t intersectsNodeScalar(const BvhNode& node, const RayPacket& packet, uint64_t mask) {
+    uint64_t hits = 0;
+    for (uint64_t rays = mask; rays != 0; rays &= rays - 1) {
+        const int       i = std::countr_zero(rays);
+        const Vector3df inverse{packet.inverseX[i], packet.inverseY[i], packet.inverseZ[i]};
+        float           tEntry;
+        if (intersectsNode(node, packet.ray(i), inverse, packet.tMax[i], tEntry)) {
+            hits |= uint64_t{1} << i;
+        }
+    }
+    return hits;
+}
+
+#ifdef RT_SIMD_X86
+
+// the same slab test as intersectsNode, for 4 rays at once
+static uint64_t intersectsNodeSse(const BvhNode& node, const RayPacket& packet, uint64_t mask) {
+    const __m128 lowerX = _mm_set1_ps(node.lower.vector[0]);
+    const __m128 lowerY = _mm_set1_ps(node.lower.vector[1]);
+    const __m128 lowerZ = _mm_set1_ps(node.lower.vector[2]);
+    const __m128 upperX = _mm_set1_ps(node.upper.vector[0]);
+    const __m128 upperY = _mm_set1_ps(node.upper.vector[1]);
+    const __m128 upperZ = _mm_set1_ps(node.upper.vector[2]);
+
+    uint64_t hits = 0;
+    for (uint32_t first = 0; first < packet.size; first += 4) {
+        const unsigned lanes = static_cast<unsigned>(mask >> first) & 0xf;
+        if (lanes == 0) {
+            continue;
+        }
+
+        const __m128 originX  = _mm_load_ps(packet.originX + first);
+        const __m128 originY  = _mm_load_ps(packet.originY + first);
+        const __m128 originZ  = _mm_load_ps(packet.originZ + first);
+        const __m128 inverseX = _mm_load_ps(packet.inverseX + first);
+        const __m128 inverseY = _mm_load_ps(packet.inverseY + first);
+        const __m128 inverseZ = _mm_load_ps(packet.inverseZ + first);
+
+        const __m128 x0 = _mm_mul_ps(_mm_sub_ps(lowerX, originX), inverseX);
+        const __m128 x1 = _mm_mul_ps(_mm_sub_ps(upperX, originX), inverseX);
+        const __m128 y0 = _mm_mul_ps(_mm_sub_ps(lowerY, originY), inverseY);
+        const __m128 y1 = _mm_mul_ps(_mm_sub_ps(upperY, originY), inverseY);
+        const __m128 z0 = _mm_mul_ps(_mm_sub_ps(lowerZ, originZ), inverseZ);
+        const __m128 z1 = _mm_mul_ps(_mm_sub_ps(upperZ, originZ), inverseZ);
+
+        __m128 tNear = _mm_setzero_ps();
+        __m128 tFar  = _mm_load_ps(packet.tMax + first);
+        tNear        = _mm_max_ps(tNear, _mm_min_ps(x0, x1));
+        tFar         = _mm_min_ps(tFar, _mm_max_ps(x0, x1));
+        tNear        = _mm_max_ps(tNear, _mm_min_ps(y0, y1));
+        tFar         = _mm_min_ps(tFar, _mm_max_ps(y0, y1));
+        tNear        = _mm_max_ps(tNear, _mm_min_ps(z0, z1));
+        tFar         = _mm_min_ps(tFar, _mm_max_ps(z0, z1));
+
+        const unsigned hit = static_cast<unsigned>(_mm_movemask_ps(_mm_cmple_ps(tNear, tFar)));
+        hits |= static_cast<uint64_t>(hit & lanes) << first;
+    }
+    return hits;
+}
+
+#endif
+
+uint64_t intersectsNode(const BvhNode& node, const RayPacket& packet, uint64_t mask) {
+#ifdef RT_SIMD_X86
+    static const bool sse = simd::activeLevel() >= simd::Level::Sse;
+    if (sse) {
+        return intersectsNodeSse(node, packet, mask);
+    }
+#endif
+    return intersectsNodeScalar(node, packet, mask);
+}
+
+}  // namespace rt::accel
@@ -0,0 +1,33 @@
+#include "progressive.h"
+
+namespace rt::render {
+
+ProgressiveRender::~ProgressiveRender() {
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+}
+
+WorkerContext ProgressiveRender::wait() {
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+    return _rays;
+}
+
+void ProgressiveRender::addContexts(const std::vector<WorkerContext>& contexts) {
+    std::vector<WorkerContext> all = contexts;
+    all.push_back(_rays);
+    _rays = mergeContexts(all);
+}
+
+bool ProgressiveRender::finishPass() {
+    if (_cancelled.load(std::memory_order_relaxed)) {
+        return false;
+    }
+    _passSeconds.push_back(std::chrono::duration<double>(Clock::now() - _start).count());
+    _completedPasses.fetch_add(1, std::memory_order_release);
+    return true;
+}
+
+}  // namespace rt::render
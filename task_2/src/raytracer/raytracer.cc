@@ -4,19 +4,30 @@
 #include "viewport.h"
 #include "camera.h"
 #include "world.h"
+#include "scene.h"
+#include "scene_file.h"
+#include "thread_pool.h"
+#include "renderer.h"
+#include "progressive.h"
+#include "interactive.h"
+#include "options.h"
 
+#include <exception>
+#include <memory>
 #include <iostream>
 #include <vector>
 #include <algorithm>
+#include <chrono>
+#include <thread>
 
 using namespace rt;
 
 #ifdef _WIN32
 #include <windows.h>
-int main(void);
+int main(int argc, char* argv[]);
 
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int CmdShow) {
-    return main();
+    return main(__argc, __argv);
 }
 #endif
 
@@ -68,56 +79,188 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
 // Am besten einen Zeiger auf das Objekt zurückgeben. Wenn dieser nullptr ist, dann gibt es kein sichtbares Objekt.
 
 // Die rekursive raytracing-Methode. Am besten ab einer bestimmten Rekursionstiefe (z.B. als Parameter übergeben) abbrechen.
-static Uint32 vecToPixel(const Vector3df& c) {
-    auto to8 = [](double v) -> Uint32 {
-        if (v < 0.0)
-            v = 0.0;
-        if (v > 1.0)
-            v = 1.0;
-        return static_cast<Uint32>(v * 255.0 + 0.5);
-    };
-
-    Uint32 r = to8(c.vector[0]);
-    Uint32 g = to8(c.vector[1]);
-    Uint32 b = to8(c.vector[2]);
-
-    // Pack into 0xRRGGBB
-    return (r << 16) | (g << 8) | b;
-}
+// the camera turns by this many radians per pixel the mouse is dragged
+constexpr float TURN_PER_PIXEL = 0.005f;
 
-int main(void) {
-    // Bildschirm erstellen
-    win::Window window(win::WINDOW_TITLE, win::WINDOW_HEIGTH, win::WINDOW_WIDTH);
+// Renders frames with an InteractiveRender while the camera is moved by the controls of the
+// window until it is closed. Converged frames are not rendered again until the camera moves.
+template <typename Scene>
+int renderInteractive(parallel::ThreadPool& pool, win::Window& window, camera::Camera& camera,
+                      const Scene& scene, const std::vector<world::PointLight>& lights,
+                      const fb::Tonemapper& tonemapper, const render::InteractiveSettings& settings,
+                      float moveSpeed) {
+    using Clock = std::chrono::steady_clock;
 
-    // Kamera erstellen
-    view::Viewport viewport{2.0, 2.0, 10.0, win::WINDOW_WIDTH, win::WINDOW_HEIGTH};
-    camera::Camera camera{Vector3df{0.0, 0.0, 10.0}, Vector3df{0.0, 0.0, -1.0}, viewport};
+    fb::MemoryFramebuffer     framebuffer{win::WINDOW_WIDTH, win::WINDOW_HEIGTH};
+    render::InteractiveRender render{framebuffer.width(), framebuffer.height(), lights, settings};
 
-    const auto& sceneWorld = world::createScene();
+    auto last        = Clock::now();
+    auto reportStart = last;
+    int  frames      = 0;
+    while (true) {
+        const auto controls = win::pollCameraControls();
+        if (controls.quit) {
+            return 0;
+        }
+        // long frames move the camera no further than a tenth of a second would
+        const auto  now     = Clock::now();
+        const float seconds = std::min(std::chrono::duration<float>(now - last).count(), 0.1f);
+        last                = now;
+
+        const camera::Pose pose = camera::movePose(
+            camera.pose(), (moveSpeed * seconds) * controls.move,
+            -TURN_PER_PIXEL * controls.turnX, -TURN_PER_PIXEL * controls.turnY);
+        if (pose == camera.pose() && render.converged()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            continue;
+        }
+        camera.setPose(pose);
+        render.renderFrame(pool, camera, scene, framebuffer);
+        win::present(window, framebuffer, tonemapper);
 
-    for (int i = 0; i < win::WINDOW_WIDTH; i++) {
-        for (int j = 0; j < win::WINDOW_HEIGTH; j++) {
-            auto ray = camera.getRay(i, j);
-            auto pos = win::WindowPos{.x = i, .y = j};
-            //std::cout << pos.x << ", " << pos.y << std::endl;
+        frames++;
+        const double reportSeconds = std::chrono::duration<double>(now - reportStart).count();
+        if (reportSeconds >= 1.0) {
+            std::cout << frames / reportSeconds << " fps, one ray per " << render.blockSize()
+                      << "x" << render.blockSize() << " pixels per frame" << std::endl;
+            frames      = 0;
+            reportStart = now;
+        }
+    }
+}
 
-            auto   object = world::findVisibleObject(ray, sceneWorld);
-            Uint32 color  = 0;
+int main(int argc, char* argv[]) {
+    // --scene <path> renders a scene file, see loadSceneFile, instead of the Cornell box
+    const char* path = cli::stringOption(argc, argv, "--scene", nullptr);
+    // --threads 0 uses all hardware threads
+    const int threads  = cli::intOption(argc, argv, "--threads", 0);
+    const int tileSize = cli::intOption(argc, argv, "--tile-size", render::DEFAULT_TILE_SIZE);
+    // --packet-size 1 traces single primary rays
+    const int packetSize =
+        cli::intOption(argc, argv, "--packet-size", render::DEFAULT_PACKET_SIZE);
+    // --max-depth 0 traces no reflections, reflected rays below --min-contribution are dropped
+    const render::TraceSettings settings{
+        .maxDepth = cli::intOption(argc, argv, "--max-depth", render::DEFAULT_MAX_DEPTH),
+        .minContribution =
+            cli::floatOption(argc, argv, "--min-contribution", render::DEFAULT_MIN_CONTRIBUTION)};
+    // a preview with one ray per n x n pixels is shown first, --preview-block-size 1 disables it
+    const int previewBlockSize =
+        cli::intOption(argc, argv, "--preview-block-size", render::DEFAULT_PREVIEW_BLOCK_SIZE);
+    // --path-samples n path traces n samples per pixel instead, refined pass by pass
+    const render::PathSettings pathSettings{
+        .samplesPerPixel = cli::intOption(argc, argv, "--path-samples", 0),
+        .seed = static_cast<uint32_t>(cli::intOption(argc, argv, "--seed", 0))};
+    // the window is updated at most this often per second while rendering
+    const int maxFps = cli::intOption(argc, argv, "--max-fps", win::DEFAULT_MAX_FPS);
+    // the colours are scaled by --exposure and gamma corrected by --gamma for display
+    const fb::Tonemap tonemap{.exposure = cli::floatOption(argc, argv, "--exposure", 1.0f),
+                              .gamma    = cli::floatOption(argc, argv, "--gamma", 1.0f)};
+    // --interactive 1 moves the camera with the keyboard and mouse, at --move-speed scene units
+    // per second, and renders frames of --frame-ms milliseconds while it moves
+    const bool  interactive = cli::intOption(argc, argv, "--interactive", 0) != 0;
+    const float moveSpeed   = cli::floatOption(argc, argv, "--move-speed", 2.0f);
+    const float frameMs     = cli::floatOption(argc, argv, "--frame-ms", 1000.0f / 30.0f);
 
-            if (object.has_value()) {
-                color = vecToPixel(object.value().get().material().getColor());
-            }
+    if (tileSize <= 0) {
+        std::cerr << "tile size has to be positive" << std::endl;
+        return 1;
+    }
+    if (packetSize < 1 || packetSize > render::MAX_PACKET_SIZE) {
+        std::cerr << "packet size has to be between 1 and " << render::MAX_PACKET_SIZE
+                  << std::endl;
+        return 1;
+    }
+    if (settings.maxDepth < 0 || settings.minContribution < 0.0f) {
+        std::cerr << "max depth and min contribution must not be negative" << std::endl;
+        return 1;
+    }
+    if (!(tonemap.gamma > 0.0f)) {
+        std::cerr << "gamma has to be positive" << std::endl;
+        return 1;
+    }
+    const fb::Tonemapper tonemapper{tonemap};
 
-            win::setPixelColor(window, pos, color);
+    parallel::ThreadPool pool{static_cast<unsigned>(std::max(threads, 0))};
+
+    // Szene laden, ohne Szenendatei die Cornell-Box
+    world::Scene     sceneWorld;
+    world::SceneFile file;
+    if (path != nullptr) {
+        try {
+            file = world::loadSceneFile(path, sceneWorld, pool);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
         }
+        sceneWorld.build();
+    } else {
+        sceneWorld  = world::createScene<world::Scene>();
+        file.lights = world::createLights();
+    }
+    const auto& lights = file.lights;
+
+    // Bildschirm erstellen
+    win::Window window(win::WINDOW_TITLE, win::WINDOW_HEIGTH, win::WINDOW_WIDTH);
+
+    // Kamera erstellen
+    view::Viewport viewport = file.camera.viewport(win::WINDOW_WIDTH, win::WINDOW_HEIGTH);
+    camera::Camera camera   = file.camera.camera(viewport);
+
+    if (interactive) {
+        // --path-samples also bounds the samples per pixel, --reprojected-samples are kept when
+        // the camera moves
+        const render::InteractiveSettings interactiveSettings{
+            .samplesPerPixel       = pathSettings.samplesPerPixel > 0
+                                         ? pathSettings.samplesPerPixel
+                                         : render::DEFAULT_INTERACTIVE_SAMPLES,
+            .maxReprojectedSamples = cli::intOption(argc, argv, "--reprojected-samples",
+                                                    render::DEFAULT_REPROJECTED_SAMPLES),
+            .maxBlockSize          = std::max(previewBlockSize, 1),
+            .frameSeconds          = frameMs / 1000.0,
+            .tileSize              = tileSize,
+            .trace                 = settings,
+            .pathTraced            = pathSettings.samplesPerPixel > 0,
+            .path                  = pathSettings};
+        return renderInteractive(pool, window, camera, sceneWorld, lights, tonemapper,
+                                 interactiveSettings, moveSpeed);
     }
 
-    SDL_UpdateWindowSurface(window.handle());
     // Für jede Pixelkoordinate x,y
     //   Sehstrahl für x,y mit Kamera erzeugen
     //   Farbe mit raytracing-Methode bestimmen
     //   Beim Bildschirm die Farbe für Pixel x,y, setzten
-    std::cout << "PROGRAMM FINISHED" << std::endl;
-    win::waitForExit();
+    // Die Pixel werden kachelweise von allen Threads des Pools in einen float-Framebuffer
+    // berechnet, währenddessen zeigt der Hauptthread das Bild mit begrenzter Rate an
+    fb::MemoryFramebuffer framebuffer{win::WINDOW_WIDTH, win::WINDOW_HEIGTH};
+    const auto            progressive =
+        pathSettings.samplesPerPixel > 0
+            ? std::make_unique<render::ProgressiveRender>(pool, camera, sceneWorld, lights,
+                                                          framebuffer, pathSettings, tileSize)
+            : std::make_unique<render::ProgressiveRender>(
+                  pool, camera, sceneWorld, lights, framebuffer,
+                  render::ProgressiveSettings{.previewBlockSize = previewBlockSize,
+                                              .tileSize         = tileSize,
+                                              .packetSize       = packetSize,
+                                              .trace            = settings});
+    const bool open = win::presentUntil(
+        window, framebuffer, tonemapper, [&] { return progressive->finished(); }, maxFps);
+    // a closed window stops the render after the tiles being traced
+    if (!open) {
+        progressive->cancel();
+    }
+    const auto rays = progressive->wait();
+
+    std::cout << "PROGRAMM FINISHED (" << pool.size() << " threads), passes after";
+    for (double seconds : progressive->passSeconds()) {
+        std::cout << " " << seconds * 1000.0 << " ms";
+    }
+    std::cout << std::endl;
+    if (!progressive->passSeconds().empty()) {
+        std::cout << render::statisticsSummary(rays, progressive->passSeconds().back())
+                  << std::endl;
+    }
+    if (open) {
+        win::waitForExit();
+    }
     return 0;
 }
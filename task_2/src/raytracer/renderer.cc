@@ -0,0 +1,111 @@
+#include "renderer.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+namespace rt::render {
+
+std::vector<Tile> makeTiles(int width, int height, int tileSize) {
+    std::vector<Tile> tiles;
+    for (int y = 0; y < height; y += tileSize) {
+        for (int x = 0; x < width; x += tileSize) {
+            tiles.push_back(Tile{.x      = x,
+                                 .y      = y,
+                                 .width  = std::min(tileSize, width - x),
+                                 .height = std::min(tileSize, height - y)});
+        }
+    }
+    return tiles;
+}
+
+WorkerContext mergeContexts(const std::vector<WorkerContext>& contexts) {
+    WorkerContext merged;
+    for (const auto& context : contexts) {
+        merged.primaryRays += context.primaryRays;
+        merged.shadowRays += context.shadowRays;
+        merged.reflectionRays += context.reflectionRays;
+        merged.traversal += context.traversal;
+        merged.tileTimes.insert(merged.tileTimes.end(), context.tileTimes.begin(),
+                                context.tileTimes.end());
+    }
+    return merged;
+}
+
+namespace {
+
+// the ratio of two counters, 0 without any denominator
+double perUnit(uint64_t count, uint64_t units) {
+    return units == 0 ? 0.0 : static_cast<double>(count) / static_cast<double>(units);
+}
+
+struct TileTimeSpread {
+    double min = 0.0, mean = 0.0, max = 0.0;
+};
+
+TileTimeSpread tileTimeSpread(const std::vector<TileTime>& tileTimes) {
+    if (tileTimes.empty()) {
+        return {};
+    }
+    TileTimeSpread spread{.min = tileTimes[0].milliseconds, .max = tileTimes[0].milliseconds};
+    for (const auto& time : tileTimes) {
+        spread.min = std::min(spread.min, time.milliseconds);
+        spread.max = std::max(spread.max, time.milliseconds);
+        spread.mean += time.milliseconds;
+    }
+    spread.mean /= static_cast<double>(tileTimes.size());
+    return spread;
+}
+
+}  // namespace
+
+std::string statisticsSummary(const WorkerContext& merged, double seconds) {
+    const uint64_t     rays = merged.primaryRays + merged.shadowRays + merged.reflectionRays;
+    std::ostringstream line;
+    line << std::fixed << std::setprecision(2) << rays << " rays (" << merged.primaryRays
+         << " primary, " << merged.shadowRays << " shadow, " << merged.reflectionRays
+         << " reflection) in " << seconds * 1000.0 << " ms, "
+         << static_cast<double>(rays) / seconds / 1e6 << " Mrays/s";
+    if constexpr (stats::ENABLED) {
+        const TileTimeSpread spread = tileTimeSpread(merged.tileTimes);
+        line << ", per ray " << perUnit(merged.traversal.nodesVisited, rays) << " nodes, "
+             << perUnit(merged.traversal.primitiveTests, rays) << " primitive tests, "
+             << perUnit(merged.traversal.hits, rays) << " hits, " << merged.tileTimes.size()
+             << " tiles in " << spread.min << " / " << spread.mean << " / " << spread.max
+             << " ms (min / mean / max)";
+    }
+    return line.str();
+}
+
+void writeStatisticsJson(std::ostream& out, const WorkerContext& merged, double seconds) {
+    const uint64_t rays = merged.primaryRays + merged.shadowRays + merged.reflectionRays;
+    out << "{\n"
+        << "  \"milliseconds\": " << seconds * 1000.0 << ",\n"
+        << "  \"primary_rays\": " << merged.primaryRays << ",\n"
+        << "  \"shadow_rays\": " << merged.shadowRays << ",\n"
+        << "  \"reflection_rays\": " << merged.reflectionRays << ",\n"
+        << "  \"mrays_per_second\": " << static_cast<double>(rays) / seconds / 1e6 << ",\n"
+        << "  \"statistics\": " << (stats::ENABLED ? "true" : "false");
+    if constexpr (stats::ENABLED) {
+        const TileTimeSpread spread = tileTimeSpread(merged.tileTimes);
+        out << ",\n"
+            << "  \"nodes_visited\": " << merged.traversal.nodesVisited << ",\n"
+            << "  \"primitive_tests\": " << merged.traversal.primitiveTests << ",\n"
+            << "  \"hits\": " << merged.traversal.hits << ",\n"
+            << "  \"tile_ms_min\": " << spread.min << ",\n"
+            << "  \"tile_ms_mean\": " << spread.mean << ",\n"
+            << "  \"tile_ms_max\": " << spread.max << ",\n"
+            << "  \"tiles\": [";
+        for (size_t i = 0; i < merged.tileTimes.size(); i++) {
+            const TileTime& time = merged.tileTimes[i];
+            out << (i > 0 ? ",\n" : "\n") << "    {\"x\": " << time.tile.x
+                << ", \"y\": " << time.tile.y << ", \"width\": " << time.tile.width
+                << ", \"height\": " << time.tile.height << ", \"ms\": " << time.milliseconds
+                << "}";
+        }
+        out << "\n  ]";
+    }
+    out << "\n}\n";
+}
+
+}  // namespace rt::render
@@ -0,0 +1,282 @@
+#include "scene_cache.h"
+#include "mapped_file.h"
+#include "obj_loader.h"
+
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <system_error>
+#include <type_traits>
+
+namespace rt::world {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// The arrays are written as they are in memory and used in place after mapping
+static_assert(std::is_trivially_copyable_v<Vector3df> && sizeof(Vector3df) == 3 * sizeof(float));
+static_assert(std::is_trivially_copyable_v<accel::BvhNode>);
+
+constexpr char     MAGIC[8]   = {'R', 'T', 'M', 'E', 'S', 'H', '\0', '\0'};
+constexpr uint32_t ORDER_MARK = 0x01020304;
+
+// the arrays start at multiples of a cache line, the mapping starts at a page boundary
+constexpr uint64_t ALIGNMENT = 64;
+
+enum SectionIndex { POSITIONS, NORMALS, POSITION_INDICES, NORMAL_INDICES, NODES, SECTION_COUNT };
+
+// an array of count elements at offset bytes from the start of the file
+struct Section {
+    uint64_t offset;
+    uint64_t count;
+};
+
+// The start of a cache file, followed by the sections
+struct Header {
+    char     magic[8];
+    uint32_t version;
+    uint32_t byteOrder;  // ORDER_MARK as written by the machine, files are not portable
+    uint32_t vectorSize;
+    uint32_t indexSize;
+    uint32_t nodeSize;
+    uint32_t reserved;
+    uint64_t sourceHash;
+    float    material[11];
+    uint32_t padding;
+    Section  sections[SECTION_COUNT];
+};
+
+static_assert(std::is_trivially_copyable_v<Header>);
+
+std::array<float, 11> materialValues(const Material& material) {
+    return {material.ambient.vector[0],  material.ambient.vector[1],  material.ambient.vector[2],
+            material.diffuse.vector[0],  material.diffuse.vector[1],  material.diffuse.vector[2],
+            material.specular.vector[0], material.specular.vector[1], material.specular.vector[2],
+            material.shininess,          material.reflectivity};
+}
+
+Material material(const float (&values)[11]) {
+    Material material;
+    for (size_t k = 0; k < 3; k++) {
+        material.ambient.vector[k]  = values[k];
+        material.diffuse.vector[k]  = values[3 + k];
+        material.specular.vector[k] = values[6 + k];
+    }
+    material.shininess    = values[9];
+    material.reflectivity = values[10];
+    return material;
+}
+
+uint64_t alignUp(uint64_t offset) {
+    return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+// the elements of the section in the mapped file, which has been checked to contain it
+template <typename T>
+std::span<const T> sectionSpan(std::string_view file, const Section& section) {
+    return std::span<const T>(reinterpret_cast<const T*>(file.data() + section.offset),
+                              static_cast<size_t>(section.count));
+}
+
+// true iff the section is aligned and lies within the file
+bool contains(std::string_view file, const Section& section, uint32_t elementSize) {
+    return section.offset % ALIGNMENT == 0 && section.offset <= file.size() &&
+           section.count <= (file.size() - section.offset) / elementSize;
+}
+
+// The mixing of xxHash64: four independent lanes of 8 bytes, so the multiplications of
+// consecutive words overlap, and an avalanche at the end
+constexpr uint64_t PRIME_1 = 0x9e3779b185ebca87ULL;
+constexpr uint64_t PRIME_2 = 0xc2b2ae3d27d4eb4fULL;
+constexpr uint64_t PRIME_3 = 0x165667b19e3779f9ULL;
+
+uint64_t rotate(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+uint64_t mixLane(uint64_t lane, uint64_t word) {
+    return rotate(lane + word * PRIME_2, 31) * PRIME_1;
+}
+
+// in the byte order of the machine, as the cache files
+uint64_t loadWord(const char* bytes) {
+    uint64_t word;
+    std::memcpy(&word, bytes, sizeof(word));
+    return word;
+}
+
+}  // namespace
+
+uint64_t contentHash(std::string_view bytes, uint64_t seed) {
+    const char*  data = bytes.data();
+    const size_t size = bytes.size();
+
+    uint64_t lanes[4] = {seed + PRIME_1 + PRIME_2, seed + PRIME_2, seed, seed - PRIME_1};
+    size_t   i        = 0;
+    for (; i + 32 <= size; i += 32) {
+        for (size_t k = 0; k < 4; k++) {
+            lanes[k] = mixLane(lanes[k], loadWord(data + i + 8 * k));
+        }
+    }
+    uint64_t hash = rotate(lanes[0], 1) + rotate(lanes[1], 7) + rotate(lanes[2], 12) +
+                    rotate(lanes[3], 18) + static_cast<uint64_t>(size);
+    for (; i + 8 <= size; i += 8) {
+        hash = rotate(hash ^ mixLane(0, loadWord(data + i)), 27) * PRIME_1 + PRIME_3;
+    }
+    for (; i < size; i++) {
+        hash = rotate(hash ^ (static_cast<uint8_t>(data[i]) * PRIME_3), 11) * PRIME_1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= PRIME_2;
+    hash ^= hash >> 29;
+    hash *= PRIME_3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+uint64_t contentHash(const Material& material, uint64_t seed) {
+    const std::array<float, 11> values = materialValues(material);
+    return contentHash(std::string_view(reinterpret_cast<const char*>(values.data()),
+                                        values.size() * sizeof(float)),
+                       seed);
+}
+
+void writeMeshCache(const std::string& path, const Mesh& mesh, const Material& material,
+                    uint64_t sourceHash) {
+    const Mesh::View view = mesh.view();
+
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version    = MESH_CACHE_VERSION;
+    header.byteOrder  = ORDER_MARK;
+    header.vectorSize = sizeof(Vector3df);
+    header.indexSize  = sizeof(uint32_t);
+    header.nodeSize   = sizeof(accel::BvhNode);
+    header.sourceHash = sourceHash;
+    const std::array<float, 11> values = materialValues(material);
+    std::copy(values.begin(), values.end(), header.material);
+
+    const std::span<const std::byte> arrays[SECTION_COUNT] = {
+        std::as_bytes(view.positions), std::as_bytes(view.normals),
+        std::as_bytes(view.positionIndices), std::as_bytes(view.normalIndices),
+        std::as_bytes(view.nodes)};
+    const size_t counts[SECTION_COUNT] = {view.positions.size(), view.normals.size(),
+                                          view.positionIndices.size(), view.normalIndices.size(),
+                                          view.nodes.size()};
+    uint64_t offset = alignUp(sizeof(Header));
+    for (size_t i = 0; i < SECTION_COUNT; i++) {
+        header.sections[i] = Section{.offset = offset, .count = counts[i]};
+        offset             = alignUp(offset + arrays[i].size());
+    }
+
+    const std::string temporary = path + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            throw std::runtime_error("can not write " + temporary);
+        }
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        uint64_t   position = sizeof(header);
+        const char zeros[ALIGNMENT]{};
+        for (size_t i = 0; i < SECTION_COUNT; i++) {
+            file.write(zeros, static_cast<std::streamsize>(header.sections[i].offset - position));
+            file.write(reinterpret_cast<const char*>(arrays[i].data()),
+                       static_cast<std::streamsize>(arrays[i].size()));
+            position = header.sections[i].offset + arrays[i].size();
+        }
+        file.flush();
+        if (!file) {
+            throw std::runtime_error("can not write " + temporary);
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+    if (error) {
+        std::filesystem::remove(temporary, error);
+        throw std::runtime_error("can not write " + path);
+    }
+}
+
+std::optional<MeshObject> mapMeshCache(const std::string& path, uint64_t sourceHash) {
+    if (!std::filesystem::is_regular_file(path)) {
+        return std::nullopt;
+    }
+    std::shared_ptr<const io::MappedFile> file;
+    try {
+        file = std::make_shared<const io::MappedFile>(path);
+    } catch (const std::runtime_error&) {
+        return std::nullopt;
+    }
+
+    const std::string_view contents = file->contents();
+    Header                 header;
+    if (contents.size() < sizeof(header)) {
+        return std::nullopt;
+    }
+    std::memcpy(&header, contents.data(), sizeof(header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        header.version != MESH_CACHE_VERSION || header.byteOrder != ORDER_MARK ||
+        header.vectorSize != sizeof(Vector3df) || header.indexSize != sizeof(uint32_t) ||
+        header.nodeSize != sizeof(accel::BvhNode) || header.sourceHash != sourceHash) {
+        return std::nullopt;
+    }
+    const uint32_t elementSizes[SECTION_COUNT] = {header.vectorSize, header.vectorSize,
+                                                  header.indexSize, header.indexSize,
+                                                  header.nodeSize};
+    for (size_t i = 0; i < SECTION_COUNT; i++) {
+        if (!contains(contents, header.sections[i], elementSizes[i])) {
+            return std::nullopt;
+        }
+    }
+
+    const Mesh::View view{
+        .positions       = sectionSpan<Vector3df>(contents, header.sections[POSITIONS]),
+        .normals         = sectionSpan<Vector3df>(contents, header.sections[NORMALS]),
+        .positionIndices = sectionSpan<uint32_t>(contents, header.sections[POSITION_INDICES]),
+        .normalIndices   = sectionSpan<uint32_t>(contents, header.sections[NORMAL_INDICES]),
+        .nodes           = sectionSpan<accel::BvhNode>(contents, header.sections[NODES])};
+    try {
+        return MeshObject(Mesh(view, std::move(file)), material(header.material));
+    } catch (const std::runtime_error&) {
+        return std::nullopt;
+    }
+}
+
+MeshObject loadObjMeshCached(const std::string& objPath, const std::string& cachePath,
+                             const Material& material, parallel::ThreadPool& pool,
+                             MeshCacheStatistics* statistics) {
+    MeshCacheStatistics  ignored;
+    MeshCacheStatistics& result = statistics != nullptr ? *statistics : ignored;
+
+    const auto start = Clock::now();
+    // the mapping of the OBJ file is hashed, and parsed if the cache is not up to date
+    const io::MappedFile source(objPath);
+    const uint64_t       hash   = contentHash(source.contents(), contentHash(material));
+    const auto           hashed = Clock::now();
+    result.hashMilliseconds = std::chrono::duration<double, std::milli>(hashed - start).count();
+
+    std::optional<MeshObject> object = mapMeshCache(cachePath, hash);
+    result.fromCache                 = object.has_value();
+    result.cacheWritten              = false;
+    if (!object) {
+        object.emplace(parseObjMesh(source.contents(), objPath, pool), material);
+        try {
+            writeMeshCache(cachePath, object->geometry(), material, hash);
+            result.cacheWritten = true;
+        } catch (const std::runtime_error&) {
+            // the cache only saves time, the parsed mesh is used without it
+        }
+    }
+    result.loadMilliseconds =
+        std::chrono::duration<double, std::milli>(Clock::now() - hashed).count();
+    return std::move(*object);
+}
+
+}  // namespace rt::world
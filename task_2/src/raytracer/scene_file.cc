@@ -0,0 +1,278 @@
+#include "scene_file.h"
+#include "instance.h"
+#include "line_parser.h"
+#include "mapped_file.h"
+#include "scene_cache.h"
+#include "transform.h"
+
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <stdexcept>
+
+namespace rt::world {
+
+view::Viewport CameraSettings::viewport(int pixelWidth, int pixelHeight) const {
+    const float width = viewportWidth > 0.0f ? viewportWidth
+                                             : viewportHeight * static_cast<float>(pixelWidth) /
+                                                   static_cast<float>(pixelHeight);
+    return view::Viewport{width, viewportHeight, focalLength, pixelWidth, pixelHeight};
+}
+
+camera::Camera CameraSettings::camera(view::Viewport& viewport) const {
+    camera::Camera camera{Vector3df{0.0f, 0.0f, 0.0f}, Vector3df{0.0f, 0.0f, -1.0f}, viewport};
+    camera.setPose(camera::lookAlong(position, direction));
+    return camera;
+}
+
+namespace {
+
+using io::LineParser;
+
+// The state of the single pass over a scene file: the materials defined so far and the meshes
+// loaded so far, so meshes referenced twice share their memory
+class SceneFileParser {
+  public:
+    SceneFileParser(const std::string& name, const std::string& directory, Scene& scene,
+                    parallel::ThreadPool& pool)
+        : _name(name), _directory(directory), _scene(scene), _pool(pool) {}
+
+    // parses the statement of the next line, throws std::runtime_error if it is malformed
+    void parseLine(std::string_view line);
+
+    SceneFile& result() {
+        return _result;
+    }
+
+  private:
+    void parseMaterial(LineParser& parser);
+    void parseMesh(LineParser& parser, const Material& material);
+
+    const Material& material(LineParser& parser);
+    const Mesh&     mesh(std::string_view path);
+
+    float     readFloat(LineParser& parser, const char* field);
+    Vector3df readVector(LineParser& parser, const char* field);
+
+    [[noreturn]] void fail(const std::string& message) const {
+        throw std::runtime_error(_name + ":" + std::to_string(_line) + ": " + message);
+    }
+
+    const std::string&    _name;
+    const std::string&    _directory;
+    Scene&                _scene;
+    parallel::ThreadPool& _pool;
+    size_t                _line = 0;
+    SceneFile             _result;
+
+    std::map<std::string, Material, std::less<>> _materials;
+    std::map<std::string, Mesh, std::less<>>     _meshes;
+};
+
+float SceneFileParser::readFloat(LineParser& parser, const char* field) {
+    float value;
+    if (!parser.skipSpaces() || !parser.read(value)) {
+        fail(std::string("expected ") + field);
+    }
+    return value;
+}
+
+Vector3df SceneFileParser::readVector(LineParser& parser, const char* field) {
+    Vector3df vector;
+    if (!parser.readVector(vector)) {
+        fail(std::string("expected three numbers for ") + field);
+    }
+    return vector;
+}
+
+const Material& SceneFileParser::material(LineParser& parser) {
+    const std::string_view name  = parser.keyword();
+    const auto             found = _materials.find(name);
+    if (found == _materials.end()) {
+        fail("unknown material '" + std::string(name) + "'");
+    }
+    return found->second;
+}
+
+const Mesh& SceneFileParser::mesh(std::string_view path) {
+    auto found = _meshes.find(path);
+    if (found != _meshes.end()) {
+        return found->second;
+    }
+    std::filesystem::path file(path);
+    if (file.is_relative()) {
+        file = std::filesystem::path(_directory) / file;
+    }
+    // the cache holds the geometry only, so a mesh used with several materials has one cache
+    const std::string objPath = file.string();
+    try {
+        const MeshObject object = loadObjMeshCached(objPath, objPath + ".cache", Material(), _pool);
+        return _meshes.emplace(std::string(path), object.geometry()).first->second;
+    } catch (const std::runtime_error& error) {
+        fail(error.what());
+    }
+}
+
+void SceneFileParser::parseMaterial(LineParser& parser) {
+    const std::string_view name = parser.keyword();
+    if (name.empty()) {
+        fail("expected a material name");
+    }
+    if (_materials.find(name) != _materials.end()) {
+        fail("material '" + std::string(name) + "' defined twice");
+    }
+
+    Material material;
+    while (parser.skipSpaces()) {
+        const std::string_view property = parser.keyword();
+        if (property == "diffuse") {
+            material.diffuse = readVector(parser, "diffuse");
+        } else if (property == "ambient") {
+            material.ambient = readVector(parser, "ambient");
+        } else if (property == "specular") {
+            material.specular = readVector(parser, "specular");
+        } else if (property == "shininess") {
+            material.shininess = readFloat(parser, "shininess");
+        } else if (property == "reflectivity") {
+            material.reflectivity = readFloat(parser, "reflectivity");
+        } else {
+            fail("unknown material property '" + std::string(property) + "'");
+        }
+    }
+    _materials.emplace(std::string(name), material);
+}
+
+void SceneFileParser::parseMesh(LineParser& parser, const Material& material) {
+    const std::string_view path = parser.keyword();
+    if (path.empty()) {
+        fail("expected the path of an OBJ file");
+    }
+    const Mesh& geometry = mesh(path);
+
+    Transform toWorld;
+    bool      transformed = false;
+    while (parser.skipSpaces()) {
+        const std::string_view operation = parser.keyword();
+        Transform              transform;
+        if (operation == "translate") {
+            transform = Transform::translation(readVector(parser, "translate"));
+        } else if (operation == "rotate") {
+            const Vector3df axis    = readVector(parser, "the rotation axis");
+            const float     degrees = readFloat(parser, "the rotation angle");
+            if (axis.square_of_length() == 0.0f) {
+                fail("the rotation axis must not be zero");
+            }
+            transform = Transform::rotation(axis, degrees * static_cast<float>(PI) / 180.0f);
+        } else if (operation == "scale") {
+            // one factor for all axes unless a number follows
+            Vector3df factors;
+            factors[0] = readFloat(parser, "scale");
+            if (parser.skipSpaces() && parser.read(factors[1])) {
+                factors[2] = readFloat(parser, "scale");
+            } else {
+                factors[1] = factors[2] = factors[0];
+            }
+            transform = Transform::scaling(factors);
+        } else {
+            fail("unknown mesh transformation '" + std::string(operation) + "'");
+        }
+        toWorld     = transform * toWorld;
+        transformed = true;
+    }
+
+    if (!transformed) {
+        _scene.emplace_back(MeshObject(geometry, material));
+        return;
+    }
+    try {
+        _scene.emplace_back(InstanceObject(Instance(geometry, toWorld), material));
+    } catch (const std::runtime_error& error) {
+        fail(error.what());
+    }
+}
+
+void SceneFileParser::parseLine(std::string_view line) {
+    _line++;
+    LineParser parser(line);
+    if (!parser.skipSpaces()) {
+        return;  // empty or a comment
+    }
+
+    const std::string_view statement = parser.keyword();
+    if (statement == "material") {
+        parseMaterial(parser);
+        return;  // reads up to the end of the line itself
+    }
+
+    if (statement == "sphere") {
+        const Material& material = this->material(parser);
+        const Vector3df center   = readVector(parser, "the center");
+        const float     radius   = readFloat(parser, "the radius");
+        if (!(radius > 0.0f)) {
+            fail("the radius has to be positive");
+        }
+        _scene.emplace_back(SphereObject(center, radius, material));
+        _result.objects++;
+    } else if (statement == "triangle") {
+        const Material& material = this->material(parser);
+        const Vector3df a        = readVector(parser, "the first corner");
+        const Vector3df b        = readVector(parser, "the second corner");
+        const Vector3df c        = readVector(parser, "the third corner");
+        _scene.emplace_back(TriangleObject(a, b, c, material));
+        _result.objects++;
+    } else if (statement == "mesh") {
+        parseMesh(parser, material(parser));
+        _result.objects++;
+        return;  // reads up to the end of the line itself
+    } else if (statement == "light") {
+        PointLight light{.position = readVector(parser, "the light position")};
+        if (parser.skipSpaces()) {
+            light.color = readVector(parser, "the light color");
+        }
+        _result.lights.push_back(light);
+    } else if (statement == "camera") {
+        CameraSettings& camera = _result.camera;
+        camera.position        = readVector(parser, "the camera position");
+        camera.direction       = readVector(parser, "the camera direction");
+        if (camera.direction.square_of_length() == 0.0f) {
+            fail("the camera direction must not be zero");
+        }
+        camera.direction.normalize();
+    } else if (statement == "viewport") {
+        CameraSettings& camera = _result.camera;
+        camera.viewportWidth   = readFloat(parser, "the viewport width");
+        camera.viewportHeight  = readFloat(parser, "the viewport height");
+        camera.focalLength     = readFloat(parser, "the focal length");
+        if (camera.viewportWidth < 0.0f || !(camera.viewportHeight > 0.0f) ||
+            !(camera.focalLength > 0.0f)) {
+            fail("the viewport needs a positive height and focal length");
+        }
+    } else {
+        fail("unknown statement '" + std::string(statement) + "'");
+    }
+
+    if (parser.skipSpaces()) {
+        fail("unexpected field '" + std::string(parser.keyword()) + "'");
+    }
+}
+
+}  // namespace
+
+SceneFile loadSceneFile(const std::string& path, Scene& scene, parallel::ThreadPool& pool) {
+    const io::MappedFile file(path);
+    return parseSceneFile(file.contents(), path,
+                          std::filesystem::path(path).parent_path().string(), scene, pool);
+}
+
+SceneFile parseSceneFile(std::string_view contents, const std::string& name,
+                         const std::string& directory, Scene& scene, parallel::ThreadPool& pool) {
+    SceneFileParser parser(name, directory, scene, pool);
+    while (!contents.empty()) {
+        const size_t end = contents.find('\n');
+        parser.parseLine(contents.substr(0, end));
+        contents.remove_prefix(end == std::string_view::npos ? contents.size() : end + 1);
+    }
+    return std::move(parser.result());
+}
+
+}  // namespace rt::world
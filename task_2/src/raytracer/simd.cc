@@ -0,0 +1,79 @@
+#include "simd.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#if defined(_MSC_VER) && defined(RT_SIMD_X86)
+#include <intrin.h>
+#endif
+
+namespace rt::simd {
+
+Level detectLevel() {
+#if defined(__GNUC__) && defined(RT_SIMD_X86)
+    // also checks that the operating system saves the AVX registers
+    if (__builtin_cpu_supports("avx2")) {
+        return Level::Avx2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return Level::Sse;
+    }
+#elif defined(_MSC_VER) && defined(RT_SIMD_X86)
+    int info[4];
+    __cpuid(info, 0);
+    const int maxLeaf = info[0];
+
+    __cpuid(info, 1);
+    const bool sse2    = (info[3] & (1 << 26)) != 0;
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx     = (info[2] & (1 << 28)) != 0;
+    // the operating system has to save the SSE and AVX registers on context switches
+    const bool avxState = osxsave && avx && (_xgetbv(0) & 0x6) == 0x6;
+
+    if (avxState && maxLeaf >= 7) {
+        __cpuidex(info, 7, 0);
+        if ((info[1] & (1 << 5)) != 0) {
+            return Level::Avx2;
+        }
+    }
+    if (sse2) {
+        return Level::Sse;
+    }
+#endif
+    return Level::Scalar;
+}
+
+static Level requestedLevel(Level detected) {
+    const char* requested = std::getenv("RT_SIMD");
+    if (requested == nullptr) {
+        return detected;
+    }
+    Level level = detected;
+    if (std::strcmp(requested, "scalar") == 0) {
+        level = Level::Scalar;
+    } else if (std::strcmp(requested, "sse") == 0) {
+        level = Level::Sse;
+    } else if (std::strcmp(requested, "avx2") == 0) {
+        level = Level::Avx2;
+    }
+    return level < detected ? level : detected;
+}
+
+Level activeLevel() {
+    static const Level level = requestedLevel(detectLevel());
+    return level;
+}
+
+const char* levelName(Level level) {
+    switch (level) {
+    case Level::Sse:
+        return "sse";
+    case Level::Avx2:
+        return "avx2";
+    case Level::Scalar:
+        break;
+    }
+    return "scalar";
+}
+
+}  // namespace rt::simd
@@ -0,0 +1,106 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+namespace rt::parallel {
+
+ThreadPool::ThreadPool(unsigned threadCount) {
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (unsigned i = 0; i < threadCount; i++) {
+        _queues.push_back(std::make_unique<Queue>());
+    }
+    for (unsigned i = 0; i < threadCount; i++) {
+        _workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _wakeUp.notify_all();
+    for (auto& worker : _workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::parallelFor(size_t count, Task task) {
+    if (count == 0) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _task      = std::move(task);
+    _remaining = count;
+
+    // hand out contiguous blocks of indices, neighbouring tasks (tiles) end up on the same worker
+    // the task has to be set before, a worker still looking for work might pick up an index
+    const size_t workers = _queues.size();
+    for (size_t worker = 0; worker < workers; worker++) {
+        std::lock_guard<std::mutex> queueLock(_queues[worker]->mutex);
+        for (size_t index = worker * count / workers; index < (worker + 1) * count / workers;
+             index++) {
+            _queues[worker]->indices.push_back(index);
+        }
+    }
+
+    _generation++;
+    _wakeUp.notify_all();
+    _finished.wait(lock, [this] { return _remaining == 0; });
+    _task = nullptr;
+}
+
+bool ThreadPool::takeTask(unsigned worker, size_t& index) {
+    {
+        Queue&                      own = *_queues[worker];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.indices.empty()) {
+            index = own.indices.front();
+            own.indices.pop_front();
+            return true;
+        }
+    }
+
+    // steal from the back of the other queues, starting with the next worker
+    for (size_t offset = 1; offset < _queues.size(); offset++) {
+        Queue&                      victim = *_queues[(worker + offset) % _queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.indices.empty()) {
+            index = victim.indices.back();
+            victim.indices.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::workerLoop(unsigned worker) {
+    size_t seenGeneration = 0;
+    while (true) {
+        const Task* task;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _wakeUp.wait(lock, [&] { return _stop || _generation != seenGeneration; });
+            if (_stop) {
+                return;
+            }
+            seenGeneration = _generation;
+            task           = &_task;
+        }
+
+        size_t index;
+        while (takeTask(worker, index)) {
+            (*task)(index, worker);
+            if (--_remaining == 0) {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _finished.notify_all();
+            }
+        }
+    }
+}
+
+}  // namespace rt::parallel
@@ -0,0 +1,164 @@
+#include "tonemap.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#include "simd.h"
+
+namespace rt::fb {
+
+namespace {
+
+// the number of quantisation steps of the gamma table, fine enough that neighbouring steps
+// differ by at most a few of the 256 output values even in the steep dark part of the curve
+constexpr int TABLE_SIZE = 4096;
+
+// the quantised value of value * scale clamped to [0, 1], 0 to steps
+// NaN becomes 0 as with _mm_max_ps
+uint32_t quantizeScalar(float value, float scale, float steps) {
+    float scaled = value * scale;
+    scaled       = scaled > 0.0f ? std::min(scaled, 1.0f) : 0.0f;
+    return static_cast<uint32_t>(scaled * steps + 0.5f);
+}
+
+#ifdef RT_SIMD_X86
+
+// the quantised values of 4 floats as quantizeScalar
+__m128i quantizeSse(const float* values, __m128 scale, __m128 steps) {
+    const __m128 scaled  = _mm_mul_ps(_mm_loadu_ps(values), scale);
+    const __m128 clamped = _mm_min_ps(_mm_max_ps(scaled, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+    return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(clamped, steps), _mm_set1_ps(0.5f)));
+}
+
+// quantises the values to bytes 16 at a time, returns the number of values done
+size_t quantizeBytesSse(const float* values, size_t count, float scale, uint8_t* bytes) {
+    const __m128 scaleVector = _mm_set1_ps(scale);
+    const __m128 steps       = _mm_set1_ps(255.0f);
+    size_t       i           = 0;
+    for (; i + 16 <= count; i += 16) {
+        const __m128i a = quantizeSse(values + i, scaleVector, steps);
+        const __m128i b = quantizeSse(values + i + 4, scaleVector, steps);
+        const __m128i c = quantizeSse(values + i + 8, scaleVector, steps);
+        const __m128i d = quantizeSse(values + i + 12, scaleVector, steps);
+        // the values fit into 8 bits, so the saturating packs keep them
+        const __m128i packed = _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(bytes + i), packed);
+    }
+    return i;
+}
+
+// quantises the values to indices of the gamma table 4 at a time, returns the number done
+size_t quantizeIndicesSse(const float* values, size_t count, float scale, uint32_t* indices) {
+    const __m128 scaleVector = _mm_set1_ps(scale);
+    const __m128 steps       = _mm_set1_ps(static_cast<float>(TABLE_SIZE - 1));
+    size_t       i           = 0;
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(indices + i),
+                         quantizeSse(values + i, scaleVector, steps));
+    }
+    return i;
+}
+
+#endif
+
+bool useSse() {
+#ifdef RT_SIMD_X86
+    static const bool sse = simd::activeLevel() >= simd::Level::Sse;
+    return sse;
+#else
+    return false;
+#endif
+}
+
+}  // namespace
+
+Tonemapper::Tonemapper(const Tonemap& tonemap)
+    : _scale(tonemap.exposure), _linear(tonemap.gamma == 1.0f) {
+    if (!(tonemap.gamma > 0.0f)) {
+        throw std::runtime_error("gamma has to be positive");
+    }
+    if (!_linear) {
+        _table.resize(TABLE_SIZE);
+        for (int i = 0; i < TABLE_SIZE; i++) {
+            const float value = std::pow(static_cast<float>(i) / (TABLE_SIZE - 1),
+                                         1.0f / tonemap.gamma);
+            _table[i]         = static_cast<uint8_t>(value * 255.0f + 0.5f);
+        }
+    }
+}
+
+void Tonemapper::quantize(const float* values, size_t count, uint8_t* bytes) const {
+    size_t done = 0;
+    if (_linear) {
+#ifdef RT_SIMD_X86
+        if (useSse()) {
+            done = quantizeBytesSse(values, count, _scale, bytes);
+        }
+#endif
+        for (size_t i = done; i < count; i++) {
+            bytes[i] = static_cast<uint8_t>(quantizeScalar(values[i], _scale, 255.0f));
+        }
+        return;
+    }
+
+    constexpr size_t BLOCK = 256;
+    uint32_t         indices[BLOCK];
+    for (size_t first = 0; first < count; first += BLOCK) {
+        const size_t blockCount = std::min(BLOCK, count - first);
+        size_t       quantized  = 0;
+#ifdef RT_SIMD_X86
+        if (useSse()) {
+            quantized = quantizeIndicesSse(values + first, blockCount, _scale, indices);
+        }
+#endif
+        for (size_t i = quantized; i < blockCount; i++) {
+            indices[i] = quantizeScalar(values[first + i], _scale, TABLE_SIZE - 1);
+        }
+        for (size_t i = 0; i < blockCount; i++) {
+            bytes[first + i] = _table[indices[i]];
+        }
+    }
+}
+
+void Tonemapper::convertRows(const MemoryFramebuffer& source, int firstRow, int rowCount,
+                             const PixelLayout& layout, uint8_t* destination, size_t pitch) const {
+    if (layout.bytesPerPixel != 3 && layout.bytesPerPixel != 4) {
+        throw std::runtime_error("only pixels of 3 or 4 bytes are supported");
+    }
+    const bool rgbBytes = layout.bytesPerPixel == 3 && layout.redShift == 0 &&
+                          layout.greenShift == 8 && layout.blueShift == 16;
+
+    // the rows are copied first, the source may be rendered to while it is converted
+    const size_t         width = static_cast<size_t>(source.width());
+    std::vector<float>   values(width * 3);
+    std::vector<uint8_t> rgb(rgbBytes ? 0 : width * 3);
+    for (int row = 0; row < rowCount; row++) {
+        source.copyRow(firstRow + row, values.data());
+        uint8_t* pixels = destination + row * pitch;
+        if (rgbBytes) {
+            quantize(values.data(), width * 3, pixels);
+            continue;
+        }
+
+        quantize(values.data(), width * 3, rgb.data());
+        if (layout.bytesPerPixel == 4) {
+            for (size_t x = 0; x < width; x++) {
+                const uint32_t pixel = layout.fill |
+                                       uint32_t{rgb[3 * x]} << layout.redShift |
+                                       uint32_t{rgb[3 * x + 1]} << layout.greenShift |
+                                       uint32_t{rgb[3 * x + 2]} << layout.blueShift;
+                std::memcpy(pixels + 4 * x, &pixel, sizeof(pixel));
+            }
+        } else {
+            for (size_t x = 0; x < width; x++) {
+                pixels[3 * x + layout.redShift / 8]   = rgb[3 * x];
+                pixels[3 * x + layout.greenShift / 8] = rgb[3 * x + 1];
+                pixels[3 * x + layout.blueShift / 8]  = rgb[3 * x + 2];
+            }
+        }
+    }
+}
+
+}  // namespace rt::fb
@@ -0,0 +1,338 @@
+#include "triangle_soa.h"
+
+#include <bit>
+#include <cmath>
+
+namespace rt::accel {
+
+// same as in PrecomputedTriangle::intersects
+static constexpr float EPSILON = 10e-7f;
+
+TriangleSoA::TriangleSoA() {
+    clear();
+}
+
+void TriangleSoA::add(const PrecomputedTriangle3df& triangle) {
+    // overwrite the first padding element and append a new one
+    for (auto& component : _components) {
+        component.push_back(0.0f);
+    }
+    set(static_cast<uint32_t>(_size++), triangle);
+}
+
+void TriangleSoA::set(uint32_t index, const PrecomputedTriangle3df& triangle) {
+    const Vector3df a = triangle.get_a(), ab = triangle.get_edge_ab(),
+                    ac = triangle.get_edge_ac();
+    const float values[COMPONENT_COUNT] = {a.vector[0],  a.vector[1],  a.vector[2],
+                                           ab.vector[0], ab.vector[1], ab.vector[2],
+                                           ac.vector[0], ac.vector[1], ac.vector[2]};
+    for (size_t i = 0; i < COMPONENT_COUNT; i++) {
+        _components[i][index] = values[i];
+    }
+}
+
+void TriangleSoA::reserve(size_t count) {
+    for (auto& component : _components) {
+        component.reserve(count + MAX_LANES - 1);
+    }
+}
+
+void TriangleSoA::clear() {
+    // the padding holds degenerate triangles, which are never hit
+    for (auto& component : _components) {
+        component.assign(MAX_LANES - 1, 0.0f);
+    }
+    _size = 0;
+}
+
+struct ComponentArrays {
+    const float *ax, *ay, *az, *abx, *aby, *abz, *acx, *acy, *acz;
+};
+
+static ComponentArrays componentArrays(const TriangleSoA& triangles) {
+    return ComponentArrays{
+        triangles.component(TriangleSoA::AX),  triangles.component(TriangleSoA::AY),
+        triangles.component(TriangleSoA::AZ),  triangles.component(TriangleSoA::ABX),
+        triangles.component(TriangleSoA::ABY), triangles.component(TriangleSoA::ABZ),
+        triangles.component(TriangleSoA::ACX), triangles.component(TriangleSoA::ACY),
+        triangles.component(TriangleSoA::ACZ)};
+}
+
+template <bool ANY_HIT>
+static bool intersectScalar(const TriangleSoA& triangles, uint32_t first, uint32_t count,
+                            const Ray3df& ray, float& tMax, TriangleHit& hit) {
+    const auto [ax, ay, az, abx, aby, abz, acx, acy, acz] = componentArrays(triangles);
+    const float dx = ray.direction.vector[0], dy = ray.direction.vector[1],
+                dz = ray.direction.vector[2];
+
+    bool found = false;
+    for (uint32_t i = first; i < first + count; i++) {
+        // p = direction x (c - a)
+        const float px  = dy * acz[i] - dz * acy[i];
+        const float py  = dz * acx[i] - dx * acz[i];
+        const float pz  = dx * acy[i] - dy * acx[i];
+        const float det = abx[i] * px + aby[i] * py + abz[i] * pz;
+        if (std::fabs(det) < EPSILON) {
+            continue;
+        }
+        const float inverseDet = 1.0f / det;
+
+        const float sx = ray.origin.vector[0] - ax[i];
+        const float sy = ray.origin.vector[1] - ay[i];
+        const float sz = ray.origin.vector[2] - az[i];
+        const float ub = (sx * px + sy * py + sz * pz) * inverseDet;
+        if (ub < 0.0f || ub > 1.0f) {
+            continue;
+        }
+
+        // q = (origin - a) x (b - a)
+        const float qx = sy * abz[i] - sz * aby[i];
+        const float qy = sz * abx[i] - sx * abz[i];
+        const float qz = sx * aby[i] - sy * abx[i];
+        const float uc = (dx * qx + dy * qy + dz * qz) * inverseDet;
+        if (uc < 0.0f || ub + uc > 1.0f) {
+            continue;
+        }
+
+        const float t = (acx[i] * qx + acy[i] * qy + acz[i] * qz) * inverseDet;
+        if (t > 0.0f && t < tMax) {
+            if constexpr (ANY_HIT) {
+                return true;
+            }
+            tMax  = t;
+            hit   = TriangleHit{.index = i, .t = t, .u = 1.0f - ub - uc, .v = ub};
+            found = true;
+        }
+    }
+    return found;
+}
+
+#ifdef RT_SIMD_X86
+
+// The vector kernels compute the same as intersectScalar for all lanes at once, lanes failing a
+// test are masked out instead of skipped. Lanes beyond count may read the padding of the arrays.
+
+template <bool ANY_HIT>
+static bool intersectSse(const TriangleSoA& triangles, uint32_t first, uint32_t count,
+                         const Ray3df& ray, float& tMax, TriangleHit& hit) {
+    const auto [ax, ay, az, abx, aby, abz, acx, acy, acz] = componentArrays(triangles);
+
+    const __m128 dx = _mm_set1_ps(ray.direction.vector[0]);
+    const __m128 dy = _mm_set1_ps(ray.direction.vector[1]);
+    const __m128 dz = _mm_set1_ps(ray.direction.vector[2]);
+    const __m128 ox = _mm_set1_ps(ray.origin.vector[0]);
+    const __m128 oy = _mm_set1_ps(ray.origin.vector[1]);
+    const __m128 oz = _mm_set1_ps(ray.origin.vector[2]);
+
+    const __m128 zero      = _mm_setzero_ps();
+    const __m128 one       = _mm_set1_ps(1.0f);
+    const __m128 epsilon   = _mm_set1_ps(EPSILON);
+    const __m128 absMask   = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const __m128 laneIndex = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+
+    bool found = false;
+    for (uint32_t offset = 0; offset < count; offset += 4) {
+        const uint32_t i = first + offset;
+
+        const __m128 eabx = _mm_loadu_ps(abx + i), eaby = _mm_loadu_ps(aby + i),
+                     eabz = _mm_loadu_ps(abz + i);
+        const __m128 eacx = _mm_loadu_ps(acx + i), eacy = _mm_loadu_ps(acy + i),
+                     eacz = _mm_loadu_ps(acz + i);
+
+        const __m128 px  = _mm_sub_ps(_mm_mul_ps(dy, eacz), _mm_mul_ps(dz, eacy));
+        const __m128 py  = _mm_sub_ps(_mm_mul_ps(dz, eacx), _mm_mul_ps(dx, eacz));
+        const __m128 pz  = _mm_sub_ps(_mm_mul_ps(dx, eacy), _mm_mul_ps(dy, eacx));
+        const __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(eabx, px), _mm_mul_ps(eaby, py)),
+                                      _mm_mul_ps(eabz, pz));
+        const __m128 inverseDet = _mm_div_ps(one, det);
+
+        const __m128 sx = _mm_sub_ps(ox, _mm_loadu_ps(ax + i));
+        const __m128 sy = _mm_sub_ps(oy, _mm_loadu_ps(ay + i));
+        const __m128 sz = _mm_sub_ps(oz, _mm_loadu_ps(az + i));
+        const __m128 ub = _mm_mul_ps(
+            _mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)),
+            inverseDet);
+
+        const __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, eabz), _mm_mul_ps(sz, eaby));
+        const __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, eabx), _mm_mul_ps(sx, eabz));
+        const __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, eaby), _mm_mul_ps(sy, eabx));
+        const __m128 uc = _mm_mul_ps(
+            _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)),
+            inverseDet);
+        const __m128 t  = _mm_mul_ps(
+            _mm_add_ps(_mm_add_ps(_mm_mul_ps(eacx, qx), _mm_mul_ps(eacy, qy)),
+                       _mm_mul_ps(eacz, qz)),
+            inverseDet);
+
+        __m128 mask = _mm_cmplt_ps(laneIndex, _mm_set1_ps(static_cast<float>(count - offset)));
+        mask = _mm_and_ps(mask, _mm_cmpge_ps(_mm_and_ps(det, absMask), epsilon));
+        mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(ub, zero), _mm_cmple_ps(ub, one)));
+        mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(uc, zero),
+                                           _mm_cmple_ps(_mm_add_ps(ub, uc), one)));
+        mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpgt_ps(t, zero),
+                                           _mm_cmplt_ps(t, _mm_set1_ps(tMax))));
+
+        unsigned lanes = static_cast<unsigned>(_mm_movemask_ps(mask));
+        if (lanes == 0) {
+            continue;
+        }
+        if constexpr (ANY_HIT) {
+            return true;
+        }
+        alignas(16) float ts[4], ubs[4], ucs[4];
+        _mm_store_ps(ts, t);
+        _mm_store_ps(ubs, ub);
+        _mm_store_ps(ucs, uc);
+        for (; lanes != 0; lanes &= lanes - 1) {
+            const int lane = std::countr_zero(lanes);
+            if (ts[lane] < tMax) {
+                tMax  = ts[lane];
+                hit   = TriangleHit{.index = i + lane,
+                                    .t     = ts[lane],
+                                    .u     = 1.0f - ubs[lane] - ucs[lane],
+                                    .v     = ubs[lane]};
+                found = true;
+            }
+        }
+    }
+    return found;
+}
+
+template <bool ANY_HIT>
+RT_TARGET_AVX2 static bool intersectAvx2(const TriangleSoA& triangles, uint32_t first,
+                                         uint32_t count, const Ray3df& ray, float& tMax,
+                                         TriangleHit& hit) {
+    const auto [ax, ay, az, abx, aby, abz, acx, acy, acz] = componentArrays(triangles);
+
+    const __m256 dx = _mm256_set1_ps(ray.direction.vector[0]);
+    const __m256 dy = _mm256_set1_ps(ray.direction.vector[1]);
+    const __m256 dz = _mm256_set1_ps(ray.direction.vector[2]);
+    const __m256 ox = _mm256_set1_ps(ray.origin.vector[0]);
+    const __m256 oy = _mm256_set1_ps(ray.origin.vector[1]);
+    const __m256 oz = _mm256_set1_ps(ray.origin.vector[2]);
+
+    const __m256 zero      = _mm256_setzero_ps();
+    const __m256 one       = _mm256_set1_ps(1.0f);
+    const __m256 epsilon   = _mm256_set1_ps(EPSILON);
+    const __m256 absMask   = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    const __m256 laneIndex = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+
+    bool found = false;
+    for (uint32_t offset = 0; offset < count; offset += 8) {
+        const uint32_t i = first + offset;
+
+        const __m256 eabx = _mm256_loadu_ps(abx + i), eaby = _mm256_loadu_ps(aby + i),
+                     eabz = _mm256_loadu_ps(abz + i);
+        const __m256 eacx = _mm256_loadu_ps(acx + i), eacy = _mm256_loadu_ps(acy + i),
+                     eacz = _mm256_loadu_ps(acz + i);
+
+        const __m256 px = _mm256_sub_ps(_mm256_mul_ps(dy, eacz), _mm256_mul_ps(dz, eacy));
+        const __m256 py = _mm256_sub_ps(_mm256_mul_ps(dz, eacx), _mm256_mul_ps(dx, eacz));
+        const __m256 pz = _mm256_sub_ps(_mm256_mul_ps(dx, eacy), _mm256_mul_ps(dy, eacx));
+        const __m256 det =
+            _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(eabx, px), _mm256_mul_ps(eaby, py)),
+                          _mm256_mul_ps(eabz, pz));
+        const __m256 inverseDet = _mm256_div_ps(one, det);
+
+        const __m256 sx = _mm256_sub_ps(ox, _mm256_loadu_ps(ax + i));
+        const __m256 sy = _mm256_sub_ps(oy, _mm256_loadu_ps(ay + i));
+        const __m256 sz = _mm256_sub_ps(oz, _mm256_loadu_ps(az + i));
+        const __m256 ub = _mm256_mul_ps(
+            _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(sx, px), _mm256_mul_ps(sy, py)),
+                          _mm256_mul_ps(sz, pz)),
+            inverseDet);
+
+        const __m256 qx = _mm256_sub_ps(_mm256_mul_ps(sy, eabz), _mm256_mul_ps(sz, eaby));
+        const __m256 qy = _mm256_sub_ps(_mm256_mul_ps(sz, eabx), _mm256_mul_ps(sx, eabz));
+        const __m256 qz = _mm256_sub_ps(_mm256_mul_ps(sx, eaby), _mm256_mul_ps(sy, eabx));
+        const __m256 uc = _mm256_mul_ps(
+            _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, qx), _mm256_mul_ps(dy, qy)),
+                          _mm256_mul_ps(dz, qz)),
+            inverseDet);
+        const __m256 t = _mm256_mul_ps(
+            _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(eacx, qx), _mm256_mul_ps(eacy, qy)),
+                          _mm256_mul_ps(eacz, qz)),
+            inverseDet);
+
+        __m256 mask = _mm256_cmp_ps(laneIndex, _mm256_set1_ps(static_cast<float>(count - offset)),
+                                    _CMP_LT_OQ);
+        mask = _mm256_and_ps(mask,
+                             _mm256_cmp_ps(_mm256_and_ps(det, absMask), epsilon, _CMP_GE_OQ));
+        mask = _mm256_and_ps(mask, _mm256_and_ps(_mm256_cmp_ps(ub, zero, _CMP_GE_OQ),
+                                                 _mm256_cmp_ps(ub, one, _CMP_LE_OQ)));
+        mask = _mm256_and_ps(
+            mask, _mm256_and_ps(_mm256_cmp_ps(uc, zero, _CMP_GE_OQ),
+                                _mm256_cmp_ps(_mm256_add_ps(ub, uc), one, _CMP_LE_OQ)));
+        mask = _mm256_and_ps(
+            mask, _mm256_and_ps(_mm256_cmp_ps(t, zero, _CMP_GT_OQ),
+                                _mm256_cmp_ps(t, _mm256_set1_ps(tMax), _CMP_LT_OQ)));
+
+        unsigned lanes = static_cast<unsigned>(_mm256_movemask_ps(mask));
+        if (lanes == 0) {
+            continue;
+        }
+        if constexpr (ANY_HIT) {
+            return true;
+        }
+        alignas(32) float ts[8], ubs[8], ucs[8];
+        _mm256_store_ps(ts, t);
+        _mm256_store_ps(ubs, ub);
+        _mm256_store_ps(ucs, uc);
+        for (; lanes != 0; lanes &= lanes - 1) {
+            const int lane = std::countr_zero(lanes);
+            if (ts[lane] < tMax) {
+                tMax  = ts[lane];
+                hit   = TriangleHit{.index = i + lane,
+                                    .t     = ts[lane],
+                                    .u     = 1.0f - ubs[lane] - ucs[lane],
+                                    .v     = ubs[lane]};
+                found = true;
+            }
+        }
+    }
+    return found;
+}
+
+#endif
+
+template <bool ANY_HIT>
+static bool intersectLevel(const TriangleSoA& triangles, simd::Level level, uint32_t first,
+                           uint32_t count, const Ray3df& ray, float& tMax, TriangleHit& hit) {
+#ifdef RT_SIMD_X86
+    switch (level) {
+    case simd::Level::Avx2:
+        return intersectAvx2<ANY_HIT>(triangles, first, count, ray, tMax, hit);
+    case simd::Level::Sse:
+        return intersectSse<ANY_HIT>(triangles, first, count, ray, tMax, hit);
+    case simd::Level::Scalar:
+        break;
+    }
+#else
+    (void)level;
+#endif
+    return intersectScalar<ANY_HIT>(triangles, first, count, ray, tMax, hit);
+}
+
+bool TriangleSoA::intersect(simd::Level level, uint32_t first, uint32_t count, const Ray3df& ray,
+                            float& tMax, TriangleHit& hit) const {
+    return intersectLevel<false>(*this, level, first, count, ray, tMax, hit);
+}
+
+bool TriangleSoA::intersect(uint32_t first, uint32_t count, const Ray3df& ray, float& tMax,
+                            TriangleHit& hit) const {
+    static const simd::Level level = simd::activeLevel();
+    return intersect(level, first, count, ray, tMax, hit);
+}
+
+bool TriangleSoA::occluded(simd::Level level, uint32_t first, uint32_t count, const Ray3df& ray,
+                           float tMax) const {
+    TriangleHit unused;
+    return intersectLevel<true>(*this, level, first, count, ray, tMax, unused);
+}
+
+bool TriangleSoA::occluded(uint32_t first, uint32_t count, const Ray3df& ray, float tMax) const {
+    static const simd::Level level = simd::activeLevel();
+    return occluded(level, first, count, ray, tMax);
+}
+
+}  // namespace rt::accel
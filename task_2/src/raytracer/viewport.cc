@@ -1,5 +1,9 @@
 #include "viewport.h"
 
+#include <cmath>
+
+#include "simd.h"
+
 namespace rt::view {
 
 Viewport::Viewport(float width, float height, float focalLength, int pixelWidth, int pixelHeight)
@@ -23,14 +27,134 @@ Viewport::Viewport(float width, float height, float focalLength, int pixelWidth,
     _firstPixel = _upperLeft + (_pixelDelta_u + _pixelDelta_v) / 2.0f;
 }
 
-Ray3df Viewport::generateRay(const Vector3df& cameraPosition, const Vector3df& cameraDirection,
-                             int pixelX, int pixelY) {
-    const auto xPos          = static_cast<float>(pixelX) * _pixelDelta_u;
-    const auto yPos          = static_cast<float>(pixelY) * _pixelDelta_v;
+Ray3df Viewport::generateRay(const Vector3df& cameraPosition,
+                             [[maybe_unused]] const Vector3df& cameraDirection, int pixelX,
+                             int pixelY) const {
+    alignas(16) float x[4], y[4], z[4];
+    generateDirections(cameraPosition, pixelX, pixelY, 1, x, y, z);
+    return Ray3df{cameraPosition, Vector3df{x[0], y[0], z[0]}};
+}
+
+namespace {
+
+// writes the unit vectors of the directions base + (first + i) * step for i in [0, count)
+void normalizeRowScalar(const float base[3], const float step[3], int first, int count, float* x,
+                        float* y, float* z) {
+    for (int i = 0; i < count; i++) {
+        const float pixel = static_cast<float>(first + i);
+        const float dx    = base[0] + pixel * step[0];
+        const float dy    = base[1] + pixel * step[1];
+        const float dz    = base[2] + pixel * step[2];
+
+        const float inverseLength = 1.0f / std::sqrt(dx * dx + dy * dy + dz * dz);
+        x[i]                      = dx * inverseLength;
+        y[i]                      = dy * inverseLength;
+        z[i]                      = dz * inverseLength;
+    }
+}
+
+#ifdef RT_SIMD_X86
+
+// the same as normalizeRowScalar for 4 directions at once, stepping the pixel index of the lanes
+// by 4 from group to group. The pixel index is exact, so a direction does not depend on the pixel
+// the row starts with. The reciprocal square root estimate has a relative error of up to
+// 1.5 * 2^-12, one Newton step brings it close to the float precision.
+void normalizeRowSse(const float base[3], const float step[3], int first, int count, float* x,
+                     float* y, float* z) {
+    const __m128 baseX = _mm_set1_ps(base[0]);
+    const __m128 baseY = _mm_set1_ps(base[1]);
+    const __m128 baseZ = _mm_set1_ps(base[2]);
+    const __m128 stepX = _mm_set1_ps(step[0]);
+    const __m128 stepY = _mm_set1_ps(step[1]);
+    const __m128 stepZ = _mm_set1_ps(step[2]);
+    const __m128 four  = _mm_set1_ps(4.0f);
+    const __m128 half  = _mm_set1_ps(0.5f);
+    const __m128 three = _mm_set1_ps(3.0f);
+    __m128       pixel = _mm_add_ps(_mm_set1_ps(static_cast<float>(first)),
+                                    _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f));
+
+    for (int i = 0; i < count; i += 4) {
+        const __m128 dx      = _mm_add_ps(baseX, _mm_mul_ps(pixel, stepX));
+        const __m128 dy      = _mm_add_ps(baseY, _mm_mul_ps(pixel, stepY));
+        const __m128 dz      = _mm_add_ps(baseZ, _mm_mul_ps(pixel, stepZ));
+        const __m128 squared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)),
+                                          _mm_mul_ps(dz, dz));
+        // r' = r / 2 * (3 - s * r * r)
+        const __m128 estimate      = _mm_rsqrt_ps(squared);
+        const __m128 inverseLength = _mm_mul_ps(
+            _mm_mul_ps(half, estimate),
+            _mm_sub_ps(three, _mm_mul_ps(squared, _mm_mul_ps(estimate, estimate))));
+
+        _mm_store_ps(x + i, _mm_mul_ps(dx, inverseLength));
+        _mm_store_ps(y + i, _mm_mul_ps(dy, inverseLength));
+        _mm_store_ps(z + i, _mm_mul_ps(dz, inverseLength));
+        pixel = _mm_add_ps(pixel, four);
+    }
+}
+
+#endif
+
+}  // namespace
+
+void Viewport::generateDirections(const Vector3df& cameraPosition, int pixelX, int pixelY,
+                                  int count, float* directionX, float* directionY,
+                                  float* directionZ) const {
+    // the direction through the centre of the first pixel of the row and the step to the next
+    // pixel, computed once per row
+    const float fy = static_cast<float>(pixelY);
+    float       base[3], step[3];
+    for (size_t i = 0; i < 3; i++) {
+        base[i] = _firstPixel.vector[i] + fy * _pixelDelta_v.vector[i] - cameraPosition.vector[i];
+        step[i] = _pixelDelta_u.vector[i];
+    }
+
+#ifdef RT_SIMD_X86
+    static const bool sse = simd::activeLevel() >= simd::Level::Sse;
+    if (sse) {
+        normalizeRowSse(base, step, pixelX, count, directionX, directionY, directionZ);
+        return;
+    }
+#endif
+    normalizeRowScalar(base, step, pixelX, count, directionX, directionY, directionZ);
+}
+
+Ray3df Viewport::generateRay(const Vector3df& cameraPosition, int pixelX, int pixelY,
+                             float offsetX, float offsetY) const {
+    const auto xPos          = (static_cast<float>(pixelX) + offsetX) * _pixelDelta_u;
+    const auto yPos          = (static_cast<float>(pixelY) + offsetY) * _pixelDelta_v;
     auto       pixelCenter   = _firstPixel + (xPos + yPos);
     auto       ray_direction = (pixelCenter - cameraPosition);
     ray_direction.normalize();
     return Ray3df{cameraPosition, ray_direction};
 }
 
-}  // namespace rt::view
\ No newline at end of file
+bool Viewport::project(const Vector3df& cameraPosition, const Vector3df& point, float& pixelX,
+                       float& pixelY) const {
+    return projection(cameraPosition)(point, pixelX, pixelY);
+}
+
+Projection Viewport::projection(const Vector3df& cameraPosition) const {
+    // The line from the camera through the point meets the plane of the viewport at
+    // cameraPosition + s * q with s = (n * (firstPixel - cameraPosition)) / (n * q), in front of
+    // the camera for s > 0, n the normal of the plane. The pixel coordinates along the pixel axes
+    // are linear in s * q, so the scale of the numerator moves into the axes and its sign into
+    // the normal.
+    const Vector3df toFirst = _firstPixel - cameraPosition;
+    Vector3df       normal  = _pixelDelta_u.cross_product(_pixelDelta_v);
+    float           scale   = normal * toFirst;
+    if (scale < 0.0f) {
+        normal *= -1.0f;
+        scale = -scale;
+    }
+
+    Projection projection;
+    projection.origin  = cameraPosition;
+    projection.normal  = normal;
+    projection.toX     = (scale / _pixelDelta_u.square_of_length()) * _pixelDelta_u;
+    projection.toY     = (scale / _pixelDelta_v.square_of_length()) * _pixelDelta_v;
+    projection.offsetX = -(toFirst * _pixelDelta_u) / _pixelDelta_u.square_of_length();
+    projection.offsetY = -(toFirst * _pixelDelta_v) / _pixelDelta_v.square_of_length();
+    return projection;
+}
+
+}  // namespace rt::view
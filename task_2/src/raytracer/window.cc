@@ -1,4 +1,5 @@
 #include "window.h"
+#include <algorithm>
 #include <stdexcept>
 
 namespace rt::win {
@@ -19,9 +20,74 @@ Window::~Window() {
         SDL_DestroyWindow(_handle);
 }
 
-void setPixelColor(Window& window, WindowPos& pos, Uint32 color) {
-    Uint32* pixels                              = (Uint32*) window.surface()->pixels;
-    pixels[pos.y * window.surface()->w + pos.x] = color;
+void present(Window& window, const fb::MemoryFramebuffer& framebuffer,
+             const fb::Tonemapper& tonemapper) {
+    SDL_Surface*           surface = window.surface();
+    const SDL_PixelFormat* format  = surface->format;
+    const fb::PixelLayout  layout{.bytesPerPixel = format->BytesPerPixel,
+                                  .redShift      = format->Rshift,
+                                  .greenShift    = format->Gshift,
+                                  .blueShift     = format->Bshift,
+                                  .fill          = format->Amask};
+
+    if (SDL_MUSTLOCK(surface) && SDL_LockSurface(surface) != 0) {
+        throw std::runtime_error(SDL_GetError());
+    }
+    const int rows = std::min(surface->h, framebuffer.height());
+    if (surface->w >= framebuffer.width()) {
+        tonemapper.convertRows(framebuffer, 0, rows, layout, static_cast<Uint8*>(surface->pixels),
+                               static_cast<size_t>(surface->pitch));
+    }
+    if (SDL_MUSTLOCK(surface)) {
+        SDL_UnlockSurface(surface);
+    }
+    SDL_UpdateWindowSurface(window.handle());
+}
+
+bool presentUntil(Window& window, const fb::MemoryFramebuffer& framebuffer,
+                  const fb::Tonemapper& tonemapper, const std::function<bool()>& done,
+                  int maxFramesPerSecond) {
+    const Uint32 frameMilliseconds = 1000 / static_cast<Uint32>(std::max(maxFramesPerSecond, 1));
+    SDL_Event    event;
+    while (!done()) {
+        const Uint32 frameStart = SDL_GetTicks();
+        while (SDL_PollEvent(&event)) {
+            if (event.type == SDL_QUIT) {
+                return false;
+            }
+        }
+        present(window, framebuffer, tonemapper);
+
+        // sleep for the rest of the frame, but wake up early if the render finishes
+        while (!done() && SDL_GetTicks() - frameStart < frameMilliseconds) {
+            SDL_Delay(1);
+        }
+    }
+    present(window, framebuffer, tonemapper);
+    return true;
+}
+
+CameraControls pollCameraControls() {
+    CameraControls controls;
+    SDL_Event      event;
+    while (SDL_PollEvent(&event)) {
+        if (event.type == SDL_QUIT ||
+            (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_ESCAPE)) {
+            controls.quit = true;
+        } else if (event.type == SDL_MOUSEMOTION && (event.motion.state & SDL_BUTTON_LMASK)) {
+            controls.turnX += static_cast<float>(event.motion.xrel);
+            controls.turnY += static_cast<float>(event.motion.yrel);
+        }
+    }
+
+    // the keys held after the events
+    const Uint8* keys = SDL_GetKeyboardState(nullptr);
+    controls.move.vector[0] = static_cast<float>(keys[SDL_SCANCODE_D] - keys[SDL_SCANCODE_A]);
+    controls.move.vector[1] = static_cast<float>(
+        std::max(keys[SDL_SCANCODE_E], keys[SDL_SCANCODE_SPACE]) -
+        std::max(keys[SDL_SCANCODE_Q], keys[SDL_SCANCODE_LSHIFT]));
+    controls.move.vector[2] = static_cast<float>(keys[SDL_SCANCODE_S] - keys[SDL_SCANCODE_W]);
+    return controls;
 }
 
 void waitForExit() {
@@ -1 +1,21 @@
-#include "world.h"
\ No newline at end of file
+#include "world.h"
+
+namespace rt::world {
+
+SceneBvh::SceneBvh(std::vector<Hittable> objects) {
+    std::vector<AABB3df> bounds;
+    bounds.reserve(objects.size());
+    for (const auto& object : objects) {
+        bounds.push_back(object.bounds());
+    }
+
+    _bvh = accel::Bvh(bounds);
+
+    // store the objects in leaf order, so each leaf covers a contiguous range
+    _objects.reserve(objects.size());
+    for (uint32_t index : _bvh.primitiveIndices()) {
+        _objects.push_back(std::move(objects[index]));
+    }
+}
+
+}  // namespace rt::world
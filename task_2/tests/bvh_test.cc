@@ -0,0 +1,199 @@
+#include "world.h"
+#include "test_util.h"
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <random>
+
+namespace {
+
+using namespace rt;
+using test::expectSameHits;
+using test::randomVector;
+
+std::vector<Ray3df> randomRays(std::mt19937& random, size_t count) {
+    std::vector<Ray3df> rays;
+    for (size_t i = 0; i < count; i++) {
+        Vector3df direction = randomVector(random, -1.0f, 1.0f);
+        direction.normalize();
+        rays.push_back(Ray3df{randomVector(random, -12.0f, 12.0f), direction});
+    }
+    return rays;
+}
+
+TEST(BVH, EmptyScene) {
+    world::SceneBvh scene{std::vector<world::Hittable>{}};
+    Ray3df          ray{{0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, -1.0f}};
+
+    EXPECT_TRUE(scene.bvh().empty());
+    EXPECT_FALSE(world::findVisibleObject(ray, scene).has_value());
+}
+
+TEST(BVH, LeavesCoverAllObjectsOnce) {
+    std::mt19937                  random(7);
+    std::vector<world::Hittable> objects;
+    for (int i = 0; i < 1000; i++) {
+        objects.emplace_back(
+            world::SphereObject(randomVector(random, -10.0f, 10.0f), 0.2f, world::Material{}));
+    }
+    world::SceneBvh scene{std::move(objects)};
+
+    std::vector<int> covered(scene.objects().size(), 0);
+    for (const auto& node : scene.bvh().nodes()) {
+        if (!node.isLeaf()) {
+            continue;
+        }
+        EXPECT_LE(node.count, accel::Bvh::MAX_LEAF_SIZE);
+        for (uint32_t i = node.first; i < node.first + node.count; i++) {
+            covered[i]++;
+        }
+    }
+    for (int count : covered) {
+        EXPECT_EQ(1, count);
+    }
+}
+
+TEST(BVH, SameHitsAsLinearScanCornellBox) {
+    world::SceneBvh scene{world::createScene()};
+
+    std::vector<Ray3df> rays;
+    Vector3df           eye{0.0f, 0.0f, 10.0f};
+    for (int x = 0; x < 100; x++) {
+        for (int y = 0; y < 100; y++) {
+            Vector3df direction = Vector3df{-0.1f + 0.002f * x, -0.1f + 0.002f * y, -1.0f};
+            direction.normalize();
+            rays.push_back(Ray3df{eye, direction});
+        }
+    }
+    std::mt19937 random(1);
+    auto         randomOnes = randomRays(random, 10000);
+    rays.insert(rays.end(), randomOnes.begin(), randomOnes.end());
+
+    expectSameHits(scene, rays);
+}
+
+TEST(BVH, SameHitsAsLinearScanRandomScene) {
+    std::mt19937                  random(42);
+    std::vector<world::Hittable> objects;
+    std::uniform_real_distribution<float> radius(0.05f, 0.5f);
+    for (int i = 0; i < 500; i++) {
+        objects.emplace_back(world::SphereObject(randomVector(random, -10.0f, 10.0f),
+                                                 radius(random), world::Material{}));
+    }
+    for (int i = 0; i < 2000; i++) {
+        Vector3df a = randomVector(random, -10.0f, 10.0f);
+        objects.emplace_back(world::TriangleObject(a, a + randomVector(random, -1.0f, 1.0f),
+                                                   a + randomVector(random, -1.0f, 1.0f),
+                                                   world::Material{}));
+    }
+    world::SceneBvh scene{std::move(objects)};
+
+    expectSameHits(scene, randomRays(random, 4000));
+}
+
+// checks that the bounds of every node contain the primitives below it and every primitive of
+// each group is in exactly one leaf
+void expectValidHierarchy(const accel::Bvh& bvh, const std::vector<std::vector<AABB3df>>& groups) {
+    std::vector<std::vector<int>> covered;
+    for (const auto& group : groups) {
+        covered.emplace_back(group.size(), 0);
+    }
+    // the node and all of its ancestors
+    std::vector<std::vector<uint32_t>> stack{{0}};
+    const auto&                        nodes = bvh.nodes();
+    while (!stack.empty()) {
+        const auto path = stack.back();
+        stack.pop_back();
+        const accel::BvhNode& node = nodes[path.back()];
+        if (!node.isLeaf()) {
+            for (uint32_t child : {node.first, node.first + 1}) {
+                ASSERT_GT(child, path.back());
+                auto childPath = path;
+                childPath.push_back(child);
+                stack.push_back(childPath);
+            }
+            continue;
+        }
+        for (uint32_t i = node.first; i < node.first + node.count; i++) {
+            covered[node.group][i]++;
+            const AABB3df& bounds = groups[node.group][i];
+            for (uint32_t ancestor : path) {
+                for (size_t k = 0; k < 3; k++) {
+                    EXPECT_LE(nodes[ancestor].lower[k], bounds.lower_corner()[k]);
+                    EXPECT_GE(nodes[ancestor].upper[k], bounds.upper_corner()[k]);
+                }
+            }
+        }
+    }
+    for (const auto& group : covered) {
+        for (int count : group) {
+            EXPECT_EQ(1, count);
+        }
+    }
+}
+
+AABB3df randomBox(std::mt19937& random, float minimum, float maximum) {
+    const Vector3df lower = randomVector(random, minimum, maximum);
+    return AABB3df::from_corners(lower, lower + randomVector(random, 0.0f, 0.5f));
+}
+
+TEST(BVH, RefitKeepsTreeAndUpdateRebuildsDegradedSubtrees) {
+    std::mt19937          random(3);
+    std::vector<AABB3df>  bounds;
+    std::vector<uint16_t> groupOfBounds;
+    for (int i = 0; i < 2000; i++) {
+        bounds.push_back(randomBox(random, -10.0f, 10.0f));
+        groupOfBounds.push_back(static_cast<uint16_t>(i % 3));
+    }
+    accel::Bvh bvh(bounds, groupOfBounds);
+
+    // the primitives of each group in leaf order, as stored by an owner
+    std::vector<std::vector<AABB3df>> groups(3);
+    for (uint32_t index : bvh.primitiveIndices()) {
+        groups[groupOfBounds[index]].push_back(bounds[index]);
+    }
+    auto primitiveBounds = [&](uint16_t group, uint32_t index) { return groups[group][index]; };
+    auto reorder = [&](uint16_t group, uint32_t first, const std::vector<uint32_t>& previous) {
+        std::vector<AABB3df> moved;
+        for (uint32_t index : previous) {
+            moved.push_back(groups[group][index]);
+        }
+        std::copy(moved.begin(), moved.end(), groups[group].begin() + first);
+    };
+
+    // nothing moved
+    const float builtCost = bvh.cost();
+    const auto  unchanged = bvh.update(primitiveBounds, reorder);
+    EXPECT_FLOAT_EQ(1.0f, unchanged.costGrowth);
+    EXPECT_EQ(0u, unchanged.rebuiltSubtrees);
+    EXPECT_FLOAT_EQ(builtCost, bvh.cost());
+
+    // small moves are refitted
+    for (int i = 0; i < 20; i++) {
+        auto& box = groups[i % 3][static_cast<size_t>(i) * 7];
+        box       = AABB3df::from_corners(box.lower_corner() + Vector3df{0.01f, 0.0f, 0.0f},
+                                          box.upper_corner() + Vector3df{0.01f, 0.0f, 0.0f});
+    }
+    const auto refitted = bvh.update(primitiveBounds, reorder);
+    EXPECT_EQ(0u, refitted.rebuiltSubtrees);
+    EXPECT_LT(refitted.costGrowth, 1.01f);
+    expectValidHierarchy(bvh, groups);
+
+    // primitives moving far degrade the refitted tree until it is partially rebuilt
+    for (int i = 0; i < 20; i++) {
+        groups[i % 3][static_cast<size_t>(i) * 31] = randomBox(random, -10.0f, 10.0f);
+    }
+    const auto rebuilt = bvh.update(primitiveBounds, reorder);
+    EXPECT_GT(rebuilt.costGrowth, accel::Bvh::MAX_COST_GROWTH);
+    EXPECT_GT(rebuilt.rebuiltSubtrees, 0u);
+    EXPECT_GT(rebuilt.rebuiltPrimitives, 0u);
+    expectValidHierarchy(bvh, groups);
+    EXPECT_LT(bvh.cost(), builtCost * 1.1f);
+
+    // the rebuilt hierarchy is the new reference
+    const auto again = bvh.update(primitiveBounds, reorder);
+    EXPECT_FLOAT_EQ(1.0f, again.costGrowth);
+    EXPECT_EQ(0u, again.rebuiltSubtrees);
+}
+
+}  // namespace
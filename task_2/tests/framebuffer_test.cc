@@ -0,0 +1,222 @@
+#include "framebuffer.h"
+#include "tonemap.h"
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+using namespace rt;
+
+std::string readFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+TEST(FRAMEBUFFER, SetAndGetPixel) {
+    fb::MemoryFramebuffer framebuffer{4, 3};
+    framebuffer.setPixel(3, 2, Vector3df{0.25f, 2.0f, -1.0f});
+
+    EXPECT_EQ(4, framebuffer.width());
+    EXPECT_EQ(3, framebuffer.height());
+    EXPECT_EQ(36u, framebuffer.data().size());
+    EXPECT_NEAR(0.25, framebuffer.getPixel(3, 2)[0], 0.00001);
+    EXPECT_NEAR(2.0, framebuffer.getPixel(3, 2)[1], 0.00001);
+    EXPECT_NEAR(-1.0, framebuffer.getPixel(3, 2)[2], 0.00001);
+    EXPECT_NEAR(0.0, framebuffer.getPixel(0, 0)[0], 0.00001);
+}
+
+TEST(FRAMEBUFFER, CopyRow) {
+    fb::MemoryFramebuffer framebuffer{2, 2};
+    framebuffer.setPixel(0, 1, Vector3df{1.0f, 2.0f, 3.0f});
+    framebuffer.setPixel(1, 1, Vector3df{4.0f, 5.0f, 6.0f});
+
+    std::vector<float> row(6);
+    framebuffer.copyRow(1, row.data());
+    EXPECT_EQ((std::vector<float>{1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f}), row);
+    framebuffer.copyRow(0, row.data());
+    EXPECT_EQ(std::vector<float>(6, 0.0f), row);
+}
+
+TEST(FRAMEBUFFER, WritePpmClampsAndQuantises) {
+    fb::MemoryFramebuffer framebuffer{2, 1};
+    framebuffer.setPixel(0, 0, Vector3df{1.0f, 0.5f, 0.0f});
+    framebuffer.setPixel(1, 0, Vector3df{2.0f, -1.0f, 0.2f});
+
+    const std::string path = "framebuffer_test.ppm";
+    fb::writeImage(framebuffer, path);
+    const std::string content = readFile(path);
+    std::remove(path.c_str());
+
+    const std::string header = "P6\n2 1\n255\n";
+    ASSERT_EQ(header.size() + 6, content.size());
+    EXPECT_EQ(header, content.substr(0, header.size()));
+    const unsigned char expected[6] = {255, 128, 0, 255, 0, 51};
+    EXPECT_EQ(0, std::memcmp(expected, content.data() + header.size(), 6));
+}
+
+TEST(FRAMEBUFFER, WritePfmBottomToTop) {
+    fb::MemoryFramebuffer framebuffer{1, 2};
+    framebuffer.setPixel(0, 0, Vector3df{1.0f, 2.0f, 3.0f});
+    framebuffer.setPixel(0, 1, Vector3df{4.0f, 5.0f, 6.0f});
+
+    const std::string path = "framebuffer_test.pfm";
+    fb::writeImage(framebuffer, path);
+    const std::string content = readFile(path);
+    std::remove(path.c_str());
+
+    const std::string header = "PF\n1 2\n-1.0\n";
+    ASSERT_EQ(header.size() + 6 * sizeof(float), content.size());
+    EXPECT_EQ(header, content.substr(0, header.size()));
+
+    // little endian floats, the lower row comes first
+    const auto* bytes = reinterpret_cast<const unsigned char*>(content.data() + header.size());
+    float       values[6];
+    for (size_t i = 0; i < 6; i++) {
+        uint32_t bits = bytes[4 * i] | bytes[4 * i + 1] << 8 | bytes[4 * i + 2] << 16 |
+                        static_cast<uint32_t>(bytes[4 * i + 3]) << 24;
+        std::memcpy(&values[i], &bits, sizeof(float));
+    }
+    const float expected[6] = {4.0f, 5.0f, 6.0f, 1.0f, 2.0f, 3.0f};
+    for (size_t i = 0; i < 6; i++) {
+        EXPECT_EQ(expected[i], values[i]);
+    }
+}
+
+TEST(FRAMEBUFFER, WriteToInvalidPathThrows) {
+    fb::MemoryFramebuffer framebuffer{1, 1};
+    EXPECT_THROW(fb::writePpm(framebuffer, "/nonexistent/directory/image.ppm"),
+                 std::runtime_error);
+}
+
+TEST(HEATMAP, ColorsFromBlueToRed) {
+    const Vector3df cold = fb::heatmapColor(0.0f, 10.0f);
+    const Vector3df hot  = fb::heatmapColor(10.0f, 10.0f);
+    EXPECT_EQ(0.0f, cold[0]);
+    EXPECT_GT(cold[2], 0.0f);
+    EXPECT_EQ(1.0f, hot[0]);
+    EXPECT_EQ(0.0f, hot[2]);
+    // costs beyond the scale are clamped, as are negative costs
+    for (size_t i = 0; i < 3; i++) {
+        EXPECT_EQ(hot[i], fb::heatmapColor(1000.0f, 10.0f)[i]);
+        EXPECT_EQ(cold[i], fb::heatmapColor(-1.0f, 10.0f)[i]);
+    }
+    // the red channel never falls with the cost
+    float red = 0.0f;
+    for (int i = 0; i <= 100; i++) {
+        const float next = fb::heatmapColor(static_cast<float>(i) / 10.0f, 10.0f)[0];
+        EXPECT_GE(next, red);
+        red = next;
+    }
+}
+
+TEST(HEATMAP, PercentileAndDrawing) {
+    std::vector<float> costs(100);
+    for (size_t i = 0; i < costs.size(); i++) {
+        costs[i] = static_cast<float>(costs.size() - i);
+    }
+    EXPECT_EQ(100.0f, fb::costPercentile(costs, 1.0f));
+    EXPECT_EQ(50.0f, fb::costPercentile(costs, 0.495f));
+    EXPECT_EQ(1.0f, fb::costPercentile(costs, 0.0f));
+    EXPECT_EQ(0.0f, fb::costPercentile({}, 0.99f));
+
+    fb::MemoryFramebuffer framebuffer{10, 10};
+    fb::drawHeatmap(costs, 100.0f, framebuffer);
+    for (size_t i = 0; i < 3; i++) {
+        EXPECT_EQ(fb::heatmapColor(100.0f, 100.0f)[i], framebuffer.getPixel(0, 0)[i]);
+        EXPECT_EQ(fb::heatmapColor(1.0f, 100.0f)[i], framebuffer.getPixel(9, 9)[i]);
+        EXPECT_EQ(fb::heatmapColor(87.0f, 100.0f)[i], framebuffer.getPixel(3, 1)[i]);
+    }
+    costs.pop_back();
+    EXPECT_THROW(fb::drawHeatmap(costs, 100.0f, framebuffer), std::invalid_argument);
+}
+
+TEST(TONEMAP, QuantisesAsScalarReference) {
+    std::mt19937                          random(3);
+    std::uniform_real_distribution<float> distribution(-0.5f, 1.5f);
+    std::vector<float>                    values(3 * 37);  // not a multiple of the vector width
+    for (float& value : values) {
+        value = distribution(random);
+    }
+    values[5] = std::numeric_limits<float>::quiet_NaN();
+    values[6] = std::numeric_limits<float>::infinity();
+
+    std::vector<uint8_t> bytes(values.size());
+    fb::Tonemapper{}.quantize(values.data(), values.size(), bytes.data());
+    for (size_t i = 0; i < values.size(); i++) {
+        const float clamped = i == 5 ? 0.0f : std::clamp(values[i], 0.0f, 1.0f);
+        EXPECT_EQ(static_cast<uint8_t>(clamped * 255.0f + 0.5f), bytes[i]) << values[i];
+    }
+}
+
+TEST(TONEMAP, ExposureAndGamma) {
+    const float values[4] = {0.25f, 0.5f, 1.0f, 0.0f};
+    uint8_t     bytes[4];
+
+    fb::Tonemapper{{.exposure = 2.0f}}.quantize(values, 4, bytes);
+    EXPECT_EQ(128, bytes[0]);
+    EXPECT_EQ(255, bytes[1]);
+
+    fb::Tonemapper{{.gamma = 2.2f}}.quantize(values, 4, bytes);
+    EXPECT_EQ(static_cast<uint8_t>(std::pow(0.5f, 1.0f / 2.2f) * 255.0f + 0.5f), bytes[1]);
+    EXPECT_EQ(255, bytes[2]);
+    EXPECT_EQ(0, bytes[3]);
+
+    EXPECT_THROW(fb::Tonemapper({.gamma = 0.0f}), std::runtime_error);
+}
+
+TEST(TONEMAP, RowsHonourPitchAndLayout) {
+    fb::MemoryFramebuffer framebuffer{5, 3};
+    for (int y = 0; y < 3; y++) {
+        for (int x = 0; x < 5; x++) {
+            framebuffer.setPixel(x, y, Vector3df{x / 4.0f, y / 2.0f, 1.0f});
+        }
+    }
+    const fb::Tonemapper tonemapper;
+
+    // 4 bytes with red in the lowest byte and an opaque alpha, rows padded by 12 bytes
+    const size_t         pitch = 5 * 4 + 12;
+    std::vector<uint8_t> pixels(3 * pitch, 0xab);
+    const fb::PixelLayout abgr{
+        .redShift = 0, .greenShift = 8, .blueShift = 16, .fill = 0xff000000u};
+    tonemapper.convertRows(framebuffer, 0, 3, abgr, pixels.data(), pitch);
+    for (int y = 0; y < 3; y++) {
+        for (int x = 0; x < 5; x++) {
+            uint32_t pixel;
+            std::memcpy(&pixel, &pixels[y * pitch + 4 * x], sizeof(pixel));
+            const uint32_t red   = static_cast<uint32_t>(x / 4.0f * 255.0f + 0.5f);
+            const uint32_t green = static_cast<uint32_t>(y / 2.0f * 255.0f + 0.5f);
+            EXPECT_EQ(0xff000000u | 255u << 16 | green << 8 | red, pixel);
+        }
+        for (size_t i = 20; i < pitch; i++) {
+            EXPECT_EQ(0xab, pixels[y * pitch + i]);
+        }
+    }
+
+    // 3 bytes blue, green, red of the last two rows only
+    std::vector<uint8_t> bgr(2 * 15);
+    tonemapper.convertRows(framebuffer, 1, 2,
+                           {.bytesPerPixel = 3, .redShift = 16, .greenShift = 8, .blueShift = 0},
+                           bgr.data(), 15);
+    EXPECT_EQ(255, bgr[0]);
+    EXPECT_EQ(128, bgr[1]);
+    EXPECT_EQ(0, bgr[2]);
+    EXPECT_EQ(255, bgr[15 + 3 * 4 + 1]);
+    EXPECT_EQ(255, bgr[15 + 3 * 4 + 2]);
+
+    EXPECT_THROW(tonemapper.convertRows(framebuffer, 0, 1, {.bytesPerPixel = 2}, pixels.data(),
+                                        pitch),
+                 std::runtime_error);
+}
+
+}  // namespace
@@ -0,0 +1,148 @@
+#include "geometry.h"
+#include "test_util.h"
+#include "gtest/gtest.h"
+
+#include <random>
+
+namespace {
+
+using rt::test::randomVector;
+
+TEST(AABB, FromCorners3df) {
+    AABB3df box = AABB3df::from_corners({-1.0, 0.0, 2.0}, {3.0, 1.0, 4.0});
+
+    EXPECT_NEAR(1.0, box.get_center()[0], 0.00001);
+    EXPECT_NEAR(0.5, box.get_center()[1], 0.00001);
+    EXPECT_NEAR(3.0, box.get_center()[2], 0.00001);
+    EXPECT_NEAR(-1.0, box.lower_corner()[0], 0.00001);
+    EXPECT_NEAR(4.0, box.upper_corner()[2], 0.00001);
+}
+
+TEST(AABB, Merge3df) {
+    AABB3df box1 = AABB3df::from_corners({0.0, 0.0, 0.0}, {1.0, 1.0, 1.0});
+    AABB3df box2 = AABB3df::from_corners({2.0, -1.0, 0.5}, {3.0, 0.5, 0.75});
+    AABB3df box  = box1.merge(box2);
+
+    EXPECT_NEAR(0.0, box.lower_corner()[0], 0.00001);
+    EXPECT_NEAR(-1.0, box.lower_corner()[1], 0.00001);
+    EXPECT_NEAR(0.0, box.lower_corner()[2], 0.00001);
+    EXPECT_NEAR(3.0, box.upper_corner()[0], 0.00001);
+    EXPECT_NEAR(1.0, box.upper_corner()[1], 0.00001);
+    EXPECT_NEAR(1.0, box.upper_corner()[2], 0.00001);
+}
+
+TEST(AABB, SurfaceArea) {
+    AABB3df box3 = AABB3df::from_corners({0.0, 0.0, 0.0}, {1.0, 2.0, 3.0});
+    AABB2df box2 = AABB2df::from_corners({0.0, 0.0}, {1.0, 2.0});
+
+    EXPECT_NEAR(22.0, box3.surface_area(), 0.00001);
+    EXPECT_NEAR(6.0, box2.surface_area(), 0.00001);
+}
+
+TEST(SPHERE, Bounds3df) {
+    Sphere3df sphere({1.0, 2.0, 3.0}, 0.5);
+    AABB3df   box = sphere.bounds();
+
+    EXPECT_NEAR(0.5, box.lower_corner()[0], 0.00001);
+    EXPECT_NEAR(3.5, box.upper_corner()[2], 0.00001);
+}
+
+TEST(TRIANGLE, Bounds3df) {
+    Triangle3df triangle({0.0, 1.0, 2.0}, {-1.0, 3.0, 2.0}, {1.0, 0.0, -2.0});
+    AABB3df     box = triangle.bounds();
+
+    EXPECT_NEAR(-1.0, box.lower_corner()[0], 0.00001);
+    EXPECT_NEAR(0.0, box.lower_corner()[1], 0.00001);
+    EXPECT_NEAR(-2.0, box.lower_corner()[2], 0.00001);
+    EXPECT_NEAR(1.0, box.upper_corner()[0], 0.00001);
+    EXPECT_NEAR(3.0, box.upper_corner()[1], 0.00001);
+    EXPECT_NEAR(2.0, box.upper_corner()[2], 0.00001);
+}
+
+TEST(TRIANGLE, IntersectsNonAxisAligned) {
+    Triangle3df                    triangle({0.0, 0.0, -1.0}, {1.0, 0.0, -2.0}, {0.0, 1.0, -2.0});
+    Ray3df                         ray{{0.25, 0.25, 0.0}, {0.0, 0.0, -1.0}};
+    Intersection_Context<float, 3> context;
+
+    ASSERT_TRUE(triangle.intersects(ray, context));
+    EXPECT_NEAR(1.5, context.t, 0.00001);
+    EXPECT_NEAR(-1.5, context.intersection[2], 0.00001);
+}
+
+TEST(PRECOMPUTED_TRIANGLE, SameIntersectionsAsTriangle) {
+    std::mt19937 random(11);
+    int          hits = 0;
+    for (int i = 0; i < 20000; i++) {
+        Vector3df a = randomVector(random, -1.0f, 1.0f), b = randomVector(random, -1.0f, 1.0f),
+                  c = randomVector(random, -1.0f, 1.0f);
+        Triangle3df            triangle(a, b, c);
+        PrecomputedTriangle3df precomputed(a, b, c);
+
+        // aim at a point in the plane of the triangle, inside the triangle for about half the rays
+        std::uniform_real_distribution<float> barycentric(-0.2f, 0.8f);
+        Vector3df target = a + barycentric(random) * (b - a) + barycentric(random) * (c - a);
+        Vector3df origin = randomVector(random, -3.0f, 3.0f);
+        Vector3df direction = target - origin;
+        direction.normalize();
+        Ray3df ray{origin, direction};
+
+        // at grazing angles both algorithms are ill-conditioned in single precision
+        Vector3df normal = (b - a).cross_product(c - a);
+        if (std::fabs(normal * direction) < 0.05f * normal.length()) {
+            continue;
+        }
+
+        Intersection_Context<float, 3> expected, actual;
+        bool expectedHit = triangle.intersects(ray, expected);
+        bool actualHit   = precomputed.intersects(ray, actual);
+        if (expectedHit != actualHit) {
+            // the algorithms may only disagree for rays through the edges of the triangle
+            Intersection_Context<float, 3>& hit = expectedHit ? expected : actual;
+            EXPECT_LT(std::min({hit.u, hit.v, 1.0f - hit.u - hit.v}), 1e-4f);
+            continue;
+        }
+        if (!expectedHit) {
+            continue;
+        }
+        hits++;
+        EXPECT_NEAR(expected.t, actual.t, 1e-4f * std::max(1.0f, expected.t));
+        EXPECT_NEAR(expected.u, actual.u, 1e-3f);
+        EXPECT_NEAR(expected.v, actual.v, 1e-3f);
+        for (size_t k = 0; k < 3; k++) {
+            EXPECT_NEAR(expected.normal[k], actual.normal[k], 1e-4f);
+            EXPECT_NEAR(expected.intersection[k], actual.intersection[k], 1e-4f);
+        }
+    }
+    EXPECT_GT(hits, 4000);
+}
+
+TEST(PRECOMPUTED_TRIANGLE, MissesBehindOrigin) {
+    PrecomputedTriangle3df         triangle({-1.0, -1.0, 1.0}, {1.0, -1.0, 1.0}, {0.0, 1.0, 1.0});
+    Ray3df                         ray{{0.0, 0.0, 0.0}, {0.0, 0.0, -1.0}};
+    Intersection_Context<float, 3> context;
+
+    EXPECT_FALSE(triangle.intersects(ray, context));
+}
+
+TEST(SMOOTH_TRIANGLE, InterpolatesNormals) {
+    SmoothTriangle3df triangle({0.0, 0.0, -1.0}, {2.0, 0.0, -1.0}, {0.0, 2.0, -1.0},
+                               {1.0, 0.0, 1.0}, {0.0, 1.0, 1.0}, {0.0, 0.0, 1.0});
+    Intersection_Context<float, 3> context;
+
+    // at a the normal of a
+    ASSERT_TRUE(triangle.intersects(Ray3df{{0.01, 0.01, 0.0}, {0.0, 0.0, -1.0}}, context));
+    EXPECT_NEAR(0.99f, context.normal[0], 1e-5f);
+    EXPECT_NEAR(0.005f, context.normal[1], 1e-5f);
+    EXPECT_NEAR(1.0f, context.normal[2], 1e-5f);
+
+    // in the middle of b and c the mean of their normals
+    ASSERT_TRUE(triangle.intersects(Ray3df{{1.0, 0.999, 0.0}, {0.0, 0.0, -1.0}}, context));
+    EXPECT_NEAR(0.0005f, context.normal[0], 1e-5f);
+    EXPECT_NEAR(0.5f, context.normal[1], 1e-5f);
+    EXPECT_NEAR(1.0f, context.normal[2], 1e-5f);
+
+    // the same t as the triangle without normals
+    EXPECT_FLOAT_EQ(1.0f, triangle.intersects(Ray3df{{1.0, 0.5, 0.0}, {0.0, 0.0, -1.0}}));
+}
+
+}  // namespace
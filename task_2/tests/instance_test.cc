@@ -0,0 +1,229 @@
+#include "instance.h"
+#include "scene.h"
+#include "test_util.h"
+#include "gtest/gtest.h"
+
+#include <cmath>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using namespace rt;
+using test::expectNear;
+using test::randomVector;
+
+// a bumpy grid of size x size quads over [0, size] x [0, size] with face normals
+struct Grid {
+    std::vector<Vector3df> positions;
+    std::vector<uint32_t>  indices;
+
+    explicit Grid(int size) {
+        for (int y = 0; y <= size; y++) {
+            for (int x = 0; x <= size; x++) {
+                const float fx = static_cast<float>(x), fy = static_cast<float>(y);
+                positions.push_back(Vector3df{fx, fy, std::sin(fx * 0.9f) * std::cos(fy * 0.6f)});
+            }
+        }
+        for (int y = 0; y < size; y++) {
+            for (int x = 0; x < size; x++) {
+                const uint32_t corner = static_cast<uint32_t>(y * (size + 1) + x);
+                const uint32_t next   = corner + static_cast<uint32_t>(size + 1);
+                indices.insert(indices.end(), {corner, corner + 1, next + 1});
+                indices.insert(indices.end(), {corner, next + 1, next});
+            }
+        }
+    }
+};
+
+// moves, rotates and scales unevenly
+Transform placement() {
+    return Transform::translation({3.0f, -1.0f, 2.0f}) *
+           Transform::rotation({1.0f, 2.0f, 0.5f}, 0.7f) *
+           Transform::scaling({2.0f, 0.5f, 1.5f});
+}
+
+}  // namespace
+
+TEST(TRANSFORM, InverseUndoesTransform) {
+    const Transform transform = placement();
+    const Transform inverse   = transform.inverse();
+    std::mt19937    random(1);
+    for (int i = 0; i < 100; i++) {
+        const Vector3df point = randomVector(random, -10.0f, 10.0f);
+        expectNear(point, inverse.point(transform.point(point)), 1e-4f);
+        expectNear(point, (inverse * transform).point(point), 1e-4f);
+        expectNear(point, inverse.direction(transform.direction(point)), 1e-4f);
+    }
+}
+
+TEST(TRANSFORM, AppliesRightFactorFirst) {
+    const Transform transform = Transform::translation({1.0f, 0.0f, 0.0f}) *
+                                Transform::rotation({0.0f, 0.0f, 1.0f}, static_cast<float>(PI) / 2);
+    expectNear(Vector3df{1.0f, 1.0f, 0.0f}, transform.point({1.0f, 0.0f, 0.0f}), 1e-6f);
+    // directions are not moved
+    expectNear(Vector3df{0.0f, 1.0f, 0.0f}, transform.direction({1.0f, 0.0f, 0.0f}), 1e-6f);
+}
+
+TEST(TRANSFORM, SingularTransformThrows) {
+    EXPECT_THROW(Transform::scaling({1.0f, 0.0f, 1.0f}).inverse(), std::runtime_error);
+}
+
+TEST(TRANSFORM, BoundsContainTransformedCorners) {
+    const Transform transform = placement();
+    const AABB3df   box = AABB3df::from_corners({-1.0f, 0.0f, 2.0f}, {3.0f, 1.0f, 4.0f});
+    const AABB3df   bounds = transform.bounds(box);
+    for (int corner = 0; corner < 8; corner++) {
+        const Vector3df point = transform.point({corner & 1 ? 3.0f : -1.0f,
+                                                 corner & 2 ? 1.0f : 0.0f,
+                                                 corner & 4 ? 4.0f : 2.0f});
+        for (size_t k = 0; k < 3; k++) {
+            EXPECT_LE(bounds.lower_corner()[k], point[k] + 1e-5f);
+            EXPECT_GE(bounds.upper_corner()[k], point[k] - 1e-5f);
+        }
+    }
+}
+
+TEST(INSTANCE, SameIntersectionsAsTransformedMesh) {
+    const Grid      grid(12);
+    const Transform transform = placement();
+
+    std::vector<Vector3df> transformed;
+    for (const auto& position : grid.positions) {
+        transformed.push_back(transform.point(position));
+    }
+    const world::Mesh     expectedMesh(transformed, grid.indices);
+    const world::Instance instance(world::Mesh(grid.positions, grid.indices), transform);
+
+    // the transformed bounds of the mesh contain the bounds of the transformed vertices
+    const AABB3df bounds = instance.bounds();
+    for (size_t k = 0; k < 3; k++) {
+        EXPECT_LE(bounds.lower_corner()[k], expectedMesh.bounds().lower_corner()[k] + 1e-4f);
+        EXPECT_GE(bounds.upper_corner()[k], expectedMesh.bounds().upper_corner()[k] - 1e-4f);
+    }
+
+    std::mt19937 random(5);
+    int          hits = 0;
+    for (int i = 0; i < 2000; i++) {
+        const Vector3df origin = randomVector(random, -20.0f, 20.0f);
+        Vector3df       target = randomVector(random, 0.0f, 12.0f);
+        target[2]              = 0.0f;
+        Vector3df direction    = transform.point(target) - origin;
+        direction.normalize();
+        const Ray3df ray{origin, direction};
+
+        Intersection_Context<float, 3> expected, actual;
+        const bool                     found = expectedMesh.intersects(ray, expected);
+        ASSERT_EQ(found, instance.intersects(ray, actual));
+        if (!found) {
+            EXPECT_FALSE(instance.occludes(ray, 100.0f));
+            continue;
+        }
+        hits++;
+        EXPECT_NEAR(expected.t, actual.t, 1e-3f);
+        expectNear(expected.intersection, actual.intersection, 1e-3f);
+        // the face normal of the transformed triangle, the instance transforms the normal of the
+        // untransformed one with the inverse transpose
+        Vector3df normal = expected.normal;
+        normal.normalize();
+        expectNear(normal, actual.normal, 1e-3f);
+
+        EXPECT_TRUE(instance.occludes(ray, actual.t * 1.001f));
+        EXPECT_FALSE(instance.occludes(ray, actual.t * 0.999f));
+        // a closer bound skips the intersection
+        EXPECT_FALSE(instance.intersects(ray, actual, actual.t * 0.999f));
+    }
+    EXPECT_GT(hits, 1000);
+}
+
+TEST(INSTANCE, ScaledInstancesHitLikeTheTransformedMesh) {
+    // The triangle test rejects determinants below an absolute tolerance. They shrink with the
+    // length of the ray direction in the space of the mesh, so the tiny triangles of a mesh in
+    // small units scaled up by 20 lost their hits. Scaling down by 20 tests the other way.
+    for (const auto& [meshScale, instanceScale] : {std::pair{0.01f, 20.0f}, {1.0f, 0.05f}}) {
+        Grid grid(12);
+        for (auto& position : grid.positions) {
+            position = meshScale * position;
+        }
+        const float     scale     = instanceScale;
+        const Transform transform = Transform::translation({1.0f, 2.0f, -3.0f}) *
+                                    Transform::rotation({1.0f, 2.0f, 0.5f}, 0.7f) *
+                                    Transform::scaling({scale, scale, scale});
+
+        std::vector<Vector3df> transformed;
+        for (const auto& position : grid.positions) {
+            transformed.push_back(transform.point(position));
+        }
+        const world::Mesh     expectedMesh(transformed, grid.indices);
+        const world::Instance instance(world::Mesh(grid.positions, grid.indices), transform);
+
+        std::mt19937 random(3);
+        int          hits = 0;
+        for (int i = 0; i < 1000; i++) {
+            const Vector3df origin = transform.point(Vector3df{0.0f, 0.0f, 0.0f}) +
+                                     randomVector(random, -2.0f, 2.0f);
+            Vector3df target = randomVector(random, 0.0f, 12.0f * meshScale);
+            target[2]        = 0.0f;
+            Vector3df direction = transform.point(target) - origin;
+            direction.normalize();
+            const Ray3df ray{origin, direction};
+
+            Intersection_Context<float, 3> expected, actual;
+            const bool                     found = expectedMesh.intersects(ray, expected);
+            ASSERT_EQ(found, instance.intersects(ray, actual)) << instanceScale;
+            if (found) {
+                hits++;
+                EXPECT_NEAR(expected.t, actual.t, 1e-4f * expected.t) << instanceScale;
+                EXPECT_TRUE(instance.occludes(ray, actual.t * 1.001f)) << instanceScale;
+            }
+        }
+        EXPECT_GT(hits, 500) << instanceScale;
+    }
+}
+
+TEST(INSTANCE, InstancesShareTheMesh) {
+    const Grid        grid(8);
+    const world::Mesh mesh(grid.positions, grid.indices);
+
+    // a 10 x 10 field of rotated copies, each 20 units apart
+    world::Scene scene;
+    world::Material material;
+    for (int i = 0; i < 100; i++) {
+        const Transform transform =
+            Transform::translation({20.0f * static_cast<float>(i % 10),
+                                    20.0f * static_cast<float>(i / 10), 0.0f}) *
+            Transform::rotation({0.0f, 0.0f, 1.0f}, 0.1f * static_cast<float>(i));
+        scene.emplace_back(world::InstanceObject(world::Instance(mesh, transform), material));
+    }
+    scene.build();
+
+    const auto& instances = scene.batch<world::InstanceObject>().objects();
+    ASSERT_EQ(100u, instances.size());
+    for (const auto& instance : instances) {
+        EXPECT_TRUE(instance.geometry().mesh().sharesData(mesh));
+    }
+
+    // rays straight down hit the instance below them and only that
+    std::mt19937 random(9);
+    for (int i = 0; i < 1000; i++) {
+        const Vector3df target = randomVector(random, -5.0f, 200.0f);
+        const Ray3df    ray{{target[0], target[1], 10.0f}, {0.0f, 0.0f, -1.0f}};
+
+        float expected = std::numeric_limits<float>::infinity();
+        for (const auto& instance : instances) {
+            Intersection_Context<float, 3> context;
+            if (instance.geometry().intersects(ray, context, expected)) {
+                expected = context.t;
+            }
+        }
+        const auto hit = world::findClosestHit(ray, scene);
+        ASSERT_EQ(std::isfinite(expected), hit.has_value());
+        if (hit) {
+            EXPECT_FLOAT_EQ(expected, hit->t);
+            EXPECT_TRUE(world::occluded(ray, hit->t * 1.001f, scene));
+        }
+    }
+}
@@ -0,0 +1,161 @@
+#include "light_tree.h"
+#include "gtest/gtest.h"
+
+#include <cmath>
+#include <random>
+#include <set>
+
+namespace {
+
+using namespace rt;
+
+// lights at random positions in the box [-10, 10] x [-5, 5] x [-10, 10] with random colours
+std::vector<world::PointLight> randomLights(size_t count) {
+    std::mt19937                          random{7};
+    std::uniform_real_distribution<float> position{-10.0f, 10.0f}, color{0.0f, 1.0f};
+    std::vector<world::PointLight>        lights;
+    for (size_t i = 0; i < count; i++) {
+        lights.push_back({.position = Vector3df{position(random), 0.5f * position(random),
+                                                position(random)},
+                          .color    = Vector3df{color(random), color(random), color(random)}});
+    }
+    return lights;
+}
+
+// the light of shadeLambertian a light adds to the point, summed over the channels
+float contribution(const world::PointLight& light, const Vector3df& point,
+                   const Vector3df& normal) {
+    Vector3df toLight = light.position - point;
+    toLight.normalize();
+    const float cosine = std::max(0.0f, normal * toLight);
+    return cosine * (light.color[0] + light.color[1] + light.color[2]);
+}
+
+// the mean and variance of the contribution of one light picked by the tree divided by its
+// probability, and of one light picked uniformly divided by its probability 1 / lights.size()
+struct Estimates {
+    double treeMean = 0.0, treeVariance = 0.0, uniformMean = 0.0, uniformVariance = 0.0;
+};
+
+Estimates estimate(const std::vector<world::PointLight>& lights, const Vector3df& point,
+                   const Vector3df& normal, int samples) {
+    const accel::LightTree                tree(lights);
+    std::mt19937                          random{3};
+    std::uniform_real_distribution<float> uniform{0.0f, 1.0f};
+
+    double treeSum = 0.0, treeSquares = 0.0, uniformSum = 0.0, uniformSquares = 0.0;
+    for (int i = 0; i < samples; i++) {
+        const auto  sample = tree.sample(point, normal, uniform(random));
+        const float value =
+            sample.light ? contribution(*sample.light, point, normal) / sample.probability : 0.0f;
+        treeSum += value;
+        treeSquares += value * value;
+
+        const auto  index        = static_cast<size_t>(uniform(random) * lights.size());
+        const float uniformValue = contribution(lights[index], point, normal) * lights.size();
+        uniformSum += uniformValue;
+        uniformSquares += uniformValue * uniformValue;
+    }
+    Estimates estimates;
+    estimates.treeMean        = treeSum / samples;
+    estimates.treeVariance    = treeSquares / samples - estimates.treeMean * estimates.treeMean;
+    estimates.uniformMean     = uniformSum / samples;
+    estimates.uniformVariance = uniformSquares / samples -
+                                estimates.uniformMean * estimates.uniformMean;
+    return estimates;
+}
+
+}  // namespace
+
+TEST(LIGHT_TREE, BalancedBinaryTree) {
+    const auto             lights = randomLights(1000);
+    const accel::LightTree tree(lights);
+    ASSERT_EQ(lights.size(), tree.size());
+    EXPECT_EQ(2 * lights.size() - 1, tree.nodes().size());
+
+    // every light is in one leaf, at most ceil(log2(1000)) = 10 levels below the root
+    std::set<uint32_t>                    leaves;
+    std::vector<std::pair<uint32_t, int>> stack{{0u, 0}};
+    while (!stack.empty()) {
+        const auto [index, depth] = stack.back();
+        stack.pop_back();
+        const auto& node = tree.nodes()[index];
+        if (node.isLeaf()) {
+            EXPECT_LE(depth, 10);
+            EXPECT_TRUE(leaves.insert(node.first & ~accel::LightTreeNode::LEAF).second);
+            continue;
+        }
+        // the children lie within the bounds of the node and share its power
+        const auto& left  = tree.nodes()[node.first];
+        const auto& right = tree.nodes()[node.first + 1];
+        for (size_t i = 0; i < 3; i++) {
+            EXPECT_LE(node.lower[i], std::min(left.lower[i], right.lower[i]));
+            EXPECT_GE(node.upper[i], std::max(left.upper[i], right.upper[i]));
+        }
+        EXPECT_NEAR(node.power, left.power + right.power, 1e-3f * node.power);
+        stack.push_back({node.first, depth + 1});
+        stack.push_back({node.first + 1, depth + 1});
+    }
+    EXPECT_EQ(lights.size(), leaves.size());
+}
+
+TEST(LIGHT_TREE, ImportanceBoundsContributions) {
+    const auto             lights = randomLights(200);
+    const accel::LightTree tree(lights);
+    const Vector3df        point{0.0f, -6.0f, 0.0f};
+    const Vector3df        normals[] = {{0.0f, 1.0f, 0.0f}, {1.0f, 0.0f, 0.0f}};
+    for (const Vector3df& normal : normals) {
+        // the importance of the root bounds the cosine weighted power of each light
+        const float root = accel::LightTree::importance(tree.nodes()[0], point, normal);
+        float       sum  = 0.0f;
+        for (const auto& light : lights) {
+            sum += contribution(light, point, normal) / 3.0f;
+        }
+        EXPECT_GE(root * (1.0f + 1e-5f), sum);
+    }
+}
+
+TEST(LIGHT_TREE, UnbiasedWithLowerVariance) {
+    const auto lights = randomLights(1000);
+    // below all lights with half of them behind the surface, then among the lights, where the
+    // bounds of the upper nodes contain the point and can not tell their lights apart
+    const Vector3df points[]  = {{0.0f, -6.0f, 0.0f}, {0.0f, -4.0f, 0.0f}};
+    const Vector3df normals[] = {{1.0f, 0.0f, 0.0f}, {0.6f, 0.8f, 0.0f}};
+    const double    maxVarianceRatio[] = {0.25, 1.0};
+    for (size_t i = 0; i < 2; i++) {
+        SCOPED_TRACE(i);
+        double exact = 0.0;
+        for (const auto& light : lights) {
+            exact += contribution(light, points[i], normals[i]);
+        }
+        const Estimates estimates = estimate(lights, points[i], normals[i], 100000);
+        EXPECT_NEAR(exact, estimates.treeMean, 0.01 * exact);
+        EXPECT_NEAR(exact, estimates.uniformMean, 0.02 * exact);
+        EXPECT_LT(estimates.treeVariance, maxVarianceRatio[i] * estimates.uniformVariance);
+    }
+}
+
+TEST(LIGHT_TREE, SkipsLightsBelowTheSurface) {
+    std::vector<world::PointLight> lights{{.position = Vector3df{0.0f, -1.0f, 0.0f}},
+                                          {.position = Vector3df{3.0f, -2.0f, 1.0f}},
+                                          {.position = Vector3df{1.0f, 2.0f, 0.0f}},
+                                          {.position = Vector3df{-1.0f, 1.0f, 4.0f},
+                                           .color    = Vector3df{0.0f, 0.0f, 0.0f}}};
+    const accel::LightTree tree(lights);
+    const Vector3df        point{0.0f, 0.0f, 0.0f}, up{0.0f, 1.0f, 0.0f};
+    // only the light above the surface with power is picked, the bounds of the inner nodes may
+    // lead to lights that do not contribute, then none is picked
+    int picked = 0;
+    for (int i = 0; i < 100; i++) {
+        const auto sample = tree.sample(point, up, static_cast<float>(i) / 100.0f);
+        if (sample.light != nullptr) {
+            EXPECT_EQ(2.0f, sample.light->position[1]);
+            EXPECT_GT(sample.probability, 0.0f);
+            picked++;
+        }
+    }
+    EXPECT_GT(picked, 0);
+    // and none below all lights
+    EXPECT_EQ(nullptr, tree.sample(Vector3df{0.0f, 5.0f, 0.0f}, up, 0.5f).light);
+    EXPECT_EQ(nullptr, accel::LightTree().sample(point, up, 0.5f).light);
+}
@@ -0,0 +1,253 @@
+#include "mesh.h"
+#include "scene.h"
+#include "test_util.h"
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+using namespace rt;
+using test::randomVector;
+
+// A wavy height field of size x size quads over [0, size] x [0, size] with a normal per vertex
+struct HeightField {
+    std::vector<Vector3df> positions;
+    std::vector<Vector3df> normals;
+    std::vector<uint32_t>  indices;
+
+    explicit HeightField(int size) {
+        for (int y = 0; y <= size; y++) {
+            for (int x = 0; x <= size; x++) {
+                const float fx = static_cast<float>(x), fy = static_cast<float>(y);
+                positions.push_back(Vector3df{fx, fy, std::sin(fx * 0.7f) * std::cos(fy * 0.4f)});
+                normals.push_back(Vector3df{-0.7f * std::cos(fx * 0.7f) * std::cos(fy * 0.4f),
+                                            0.4f * std::sin(fx * 0.7f) * std::sin(fy * 0.4f),
+                                            1.0f});
+            }
+        }
+        for (int y = 0; y < size; y++) {
+            for (int x = 0; x < size; x++) {
+                const uint32_t corner = static_cast<uint32_t>(y * (size + 1) + x);
+                const uint32_t next   = corner + static_cast<uint32_t>(size + 1);
+                indices.insert(indices.end(), {corner, corner + 1, next + 1});
+                indices.insert(indices.end(), {corner, next + 1, next});
+            }
+        }
+    }
+
+    std::vector<SmoothTriangle3df> triangles() const {
+        std::vector<SmoothTriangle3df> result;
+        for (size_t i = 0; i < indices.size(); i += 3) {
+            result.emplace_back(positions[indices[i]], positions[indices[i + 1]],
+                                positions[indices[i + 2]], normals[indices[i]],
+                                normals[indices[i + 1]], normals[indices[i + 2]]);
+        }
+        return result;
+    }
+};
+
+// a ray from above the height field towards a random point of it
+Ray3df randomRay(std::mt19937& random, float size) {
+    Vector3df origin = randomVector(random, -2.0f, size + 2.0f);
+    origin[2]        = 5.0f;
+    Vector3df target = randomVector(random, 0.0f, size);
+    target[2]        = 0.0f;
+    Vector3df direction = target - origin;
+    direction.normalize();
+    return Ray3df{origin, direction};
+}
+
+}  // namespace
+
+TEST(MESH, SameIntersectionsAsSmoothTriangles) {
+    const HeightField field(20);
+    const auto        triangles = field.triangles();
+    world::Mesh       mesh(field.positions, field.indices, field.normals);
+
+    EXPECT_EQ(800u, mesh.triangleCount());
+    EXPECT_EQ(441u, mesh.vertexCount());
+
+    std::mt19937 random(11);
+    int          hits = 0;
+    for (int i = 0; i < 2000; i++) {
+        const Ray3df ray = randomRay(random, 20.0f);
+
+        Intersection_Context<float, 3> expected{};
+        expected.t = std::numeric_limits<float>::infinity();
+        for (const auto& triangle : triangles) {
+            Intersection_Context<float, 3> context;
+            if (triangle.intersects(ray, context) && context.t > 0 && context.t < expected.t) {
+                expected = context;
+            }
+        }
+
+        Intersection_Context<float, 3> actual;
+        const bool                     found = mesh.intersects(ray, actual);
+        ASSERT_EQ(std::isfinite(expected.t), found);
+        if (!found) {
+            EXPECT_FALSE(mesh.occludes(ray, 100.0f));
+            continue;
+        }
+        hits++;
+        EXPECT_NEAR(expected.t, actual.t, 1e-4f);
+        for (size_t k = 0; k < 3; k++) {
+            EXPECT_NEAR(expected.normal[k], actual.normal[k], 1e-3f);
+        }
+        EXPECT_TRUE(mesh.occludes(ray, actual.t * 1.001f));
+        EXPECT_FALSE(mesh.occludes(ray, actual.t * 0.999f));
+    }
+    EXPECT_GT(hits, 1500);
+}
+
+TEST(MESH, NormalIndicesAndFaceNormals) {
+    const HeightField field(4);
+
+    // every corner has its own normal
+    std::vector<Vector3df> cornerNormals;
+    std::vector<uint32_t>  normalIndices;
+    for (uint32_t index : field.indices) {
+        normalIndices.push_back(static_cast<uint32_t>(cornerNormals.size()));
+        cornerNormals.push_back(field.normals[index]);
+    }
+    world::Mesh perVertex(field.positions, field.indices, field.normals);
+    world::Mesh perCorner(field.positions, field.indices, cornerNormals, normalIndices);
+    world::Mesh flat(field.positions, field.indices);
+
+    const Ray3df                   ray{{1.3f, 2.6f, 5.0f}, {0.0f, 0.0f, -1.0f}};
+    Intersection_Context<float, 3> expected, actual, faceNormal;
+    ASSERT_TRUE(perVertex.intersects(ray, expected));
+    ASSERT_TRUE(perCorner.intersects(ray, actual));
+    ASSERT_TRUE(flat.intersects(ray, faceNormal));
+    for (size_t k = 0; k < 3; k++) {
+        EXPECT_FLOAT_EQ(expected.normal[k], actual.normal[k]);
+    }
+    EXPECT_FLOAT_EQ(expected.t, faceNormal.t);
+    // the face normal is perpendicular to the triangle, so it differs from the vertex normals
+    EXPECT_GT(std::fabs(faceNormal.normal[0] / faceNormal.normal[2] -
+                        expected.normal[0] / expected.normal[2]),
+              1e-3f);
+}
+
+TEST(MESH, InvalidIndicesThrow) {
+    const std::vector<Vector3df> positions{{0.0f, 0.0f, 0.0f}, {1.0f, 0.0f, 0.0f}};
+    EXPECT_THROW(world::Mesh(positions, {0, 1, 2}), std::runtime_error);
+    EXPECT_THROW(world::Mesh(positions, {0, 1}), std::runtime_error);
+    EXPECT_THROW(world::Mesh(positions, {0, 1, 1}, {{0.0f, 0.0f, 1.0f}}), std::runtime_error);
+    EXPECT_THROW(world::Mesh(positions, {0, 1, 1}, {{0.0f, 0.0f, 1.0f}}, {0, 0, 1}),
+                 std::runtime_error);
+}
+
+TEST(MESH, ViewOfDamagedArraysThrows) {
+    const HeightField field(6);
+    const world::Mesh mesh(field.positions, field.indices, field.normals);
+    const auto        view = mesh.view();
+
+    // copies of the arrays of the mesh, damaged by each case
+    struct Arrays {
+        std::vector<Vector3df>      positions, normals;
+        std::vector<uint32_t>       positionIndices, normalIndices;
+        std::vector<accel::BvhNode> nodes;
+
+        world::Mesh mesh() const {
+            return world::Mesh(world::Mesh::View{.positions       = positions,
+                                                 .normals         = normals,
+                                                 .positionIndices = positionIndices,
+                                                 .normalIndices   = normalIndices,
+                                                 .nodes           = nodes},
+                               nullptr);
+        }
+    };
+    const Arrays arrays{{view.positions.begin(), view.positions.end()},
+                        {view.normals.begin(), view.normals.end()},
+                        {view.positionIndices.begin(), view.positionIndices.end()},
+                        {view.normalIndices.begin(), view.normalIndices.end()},
+                        {view.nodes.begin(), view.nodes.end()}};
+    EXPECT_NO_THROW(arrays.mesh());
+
+    Arrays damaged             = arrays;
+    damaged.positionIndices[7] = static_cast<uint32_t>(arrays.positions.size());
+    EXPECT_THROW(damaged.mesh(), std::runtime_error);
+
+    damaged = arrays;
+    damaged.normals.pop_back();
+    damaged.normalIndices    = damaged.positionIndices;
+    damaged.normalIndices[4] = static_cast<uint32_t>(damaged.normals.size());
+    EXPECT_THROW(damaged.mesh(), std::runtime_error);
+
+    // a leaf beyond the triangles, a child beyond the nodes and a child before its parent
+    const auto leaf  = std::find_if(arrays.nodes.begin(), arrays.nodes.end(),
+                                    [](const accel::BvhNode& node) { return node.isLeaf(); });
+    const auto inner = std::find_if(arrays.nodes.begin(), arrays.nodes.end(),
+                                    [](const accel::BvhNode& node) { return !node.isLeaf(); });
+    ASSERT_NE(leaf, arrays.nodes.end());
+    ASSERT_NE(inner, arrays.nodes.end());
+    const size_t leafIndex  = static_cast<size_t>(leaf - arrays.nodes.begin());
+    const size_t innerIndex = static_cast<size_t>(inner - arrays.nodes.begin());
+    for (uint32_t first : {static_cast<uint32_t>(mesh.triangleCount()), 0xffffffffu}) {
+        damaged                        = arrays;
+        damaged.nodes[leafIndex].first = first;
+        EXPECT_THROW(damaged.mesh(), std::runtime_error) << first;
+    }
+    for (uint32_t first : {static_cast<uint32_t>(arrays.nodes.size() - 1),
+                           static_cast<uint32_t>(innerIndex)}) {
+        damaged                         = arrays;
+        damaged.nodes[innerIndex].first = first;
+        EXPECT_THROW(damaged.mesh(), std::runtime_error) << first;
+    }
+
+    // a chain of inner nodes, each with a leaf as left child, deeper than the traversal stack
+    Arrays chain = arrays;
+    for (const size_t depth : {size_t{20}, accel::Bvh::STACK_SIZE}) {
+        chain.nodes.assign(2 * depth + 1, arrays.nodes[leafIndex]);
+        for (size_t i = 0; i < depth; i++) {
+            chain.nodes[2 * i].count = 0;
+            chain.nodes[2 * i].first = static_cast<uint32_t>(2 * i + 1);
+        }
+        if (depth < accel::Bvh::STACK_SIZE) {
+            EXPECT_NO_THROW(chain.mesh());
+        } else {
+            EXPECT_THROW(chain.mesh(), std::runtime_error);
+        }
+    }
+}
+
+TEST(MESH, UsesLessMemoryThanTriangleObjects) {
+    const HeightField field(200);
+    world::Mesh       mesh(field.positions, field.indices, field.normals);
+
+    // each smooth triangle of a scene stores its corners, edges, normals, material and the SIMD
+    // copy of its corners, without the nodes of the hierarchy of the scene
+    const size_t triangleBytes = mesh.triangleCount() * (sizeof(world::SmoothTriangleObject) +
+                                                         9 * sizeof(float));
+    EXPECT_LT(3 * mesh.memoryBytes(), triangleBytes);
+}
+
+TEST(MESH, IsOneObjectOfScene) {
+    const HeightField field(10);
+    world::Material   material;
+    material.shininess = 7.0f;
+
+    world::Scene scene;
+    scene.emplace_back(world::MeshObject(world::Mesh(field.positions, field.indices), material));
+    scene.emplace_back(world::SphereObject(Vector3df{5.0f, 5.0f, 3.0f}, 0.5f, world::Material{}));
+    scene.build();
+    EXPECT_EQ(2u, scene.size());
+
+    const auto meshHit = world::findClosestHit(Ray3df{{2.2f, 7.1f, 5.0f}, {0.0f, 0.0f, -1.0f}},
+                                               scene);
+    ASSERT_TRUE(meshHit);
+    EXPECT_FLOAT_EQ(7.0f, meshHit->material->shininess);
+    EXPECT_TRUE(world::occluded(Ray3df{{2.2f, 7.1f, 5.0f}, {0.0f, 0.0f, -1.0f}}, 10.0f, scene));
+
+    // the sphere in front of the mesh
+    const auto sphereHit = world::findClosestHit(Ray3df{{5.0f, 5.0f, 5.0f}, {0.0f, 0.0f, -1.0f}},
+                                                 scene);
+    ASSERT_TRUE(sphereHit);
+    EXPECT_NEAR(1.5f, sphereHit->t, 1e-4f);
+}
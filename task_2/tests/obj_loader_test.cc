@@ -0,0 +1,189 @@
+#include "obj_loader.h"
+#include "test_util.h"
+#include "gtest/gtest.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+using namespace rt;
+using test::expectVector;
+
+// a grid of size x size quads with a normal per vertex, faces use relative indices if asked to
+std::string createGrid(int size, bool relativeIndices) {
+    std::ostringstream obj;
+    for (int y = 0; y <= size; y++) {
+        for (int x = 0; x <= size; x++) {
+            obj << "v " << x << " " << y << " " << (x * y) % 7 << "\n";
+            obj << "vn 0 " << x % 3 << " 1\n";
+        }
+    }
+    const int vertices = (size + 1) * (size + 1);
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            const int corners[4] = {y * (size + 1) + x + 1, y * (size + 1) + x + 2,
+                                    (y + 1) * (size + 1) + x + 2, (y + 1) * (size + 1) + x + 1};
+            obj << "f";
+            for (int corner : corners) {
+                const int index = relativeIndices ? corner - vertices - 1 : corner;
+                obj << " " << index << "//" << index;
+            }
+            obj << "\n";
+        }
+    }
+    return obj.str();
+}
+
+}  // namespace
+
+TEST(OBJ_LOADER, ParsesFaceFormats) {
+    const std::string obj = "# a comment\n"
+                            "o object\n"
+                            "v 0 0 0\n"
+                            "v 1 0 0\r\n"
+                            "v 1 1 0 1.0\n"
+                            "\tv 0 1 0   # the fourth vertex\n"
+                            "vt 0 0\n"
+                            "vn 0 0 1\n"
+                            "vn 0 0.5 1\n"
+                            "usemtl material\n"
+                            "f 1 2 3\n"
+                            "f 1/1 2/1 3/1 4/1\n"
+                            "f 1//1 2//1 3//2\n"
+                            "f -4/1/1 -3/1/1 -2/1/2 # relative\n"
+                            "f 1//1 2 3//1\n";
+
+    world::Scene         scene;
+    world::Material      material;
+    parallel::ThreadPool pool{2};
+    const auto statistics = world::parseObj(obj, "test.obj", scene, material, pool);
+
+    EXPECT_EQ(4u, statistics.vertices);
+    EXPECT_EQ(2u, statistics.normals);
+    EXPECT_EQ(6u, statistics.triangles);
+    EXPECT_EQ(2u, statistics.smoothTriangles);
+
+    // faces without normals at all corners are flat, the quad is split into 2 triangles
+    const auto& flat = scene.batch<world::TriangleObject>().objects();
+    ASSERT_EQ(4u, flat.size());
+    expectVector({0.0f, 0.0f, 0.0f}, flat[1].geometry().get_a());
+    expectVector({1.0f, 1.0f, 0.0f}, flat[2].geometry().get_a() + flat[2].geometry().get_edge_ab());
+    expectVector({0.0f, 1.0f, 0.0f}, flat[2].geometry().get_a() + flat[2].geometry().get_edge_ac());
+
+    const auto& smooth = scene.batch<world::SmoothTriangleObject>().objects();
+    ASSERT_EQ(2u, smooth.size());
+    for (const auto& triangle : smooth) {
+        expectVector({0.0f, 0.0f, 1.0f}, triangle.geometry().get_normal_at(1.0f, 0.0f));
+        expectVector({0.0f, 0.5f, 1.0f}, triangle.geometry().get_normal_at(0.0f, 0.0f));
+    }
+}
+
+TEST(OBJ_LOADER, ChunksGiveSameTrianglesAsOneChunk) {
+    // large enough to be split into several chunks
+    for (bool relativeIndices : {false, true}) {
+        SCOPED_TRACE(relativeIndices ? "relative indices" : "absolute indices");
+        const std::string obj = createGrid(250, relativeIndices);
+        ASSERT_GT(obj.size(), 4u << 20);
+
+        world::Scene         one, chunked;
+        world::Material      material;
+        parallel::ThreadPool singleWorker{1}, workers{4};
+        world::parseObj(obj, "grid.obj", one, material, singleWorker);
+        const auto statistics = world::parseObj(obj, "grid.obj", chunked, material, workers);
+
+        EXPECT_EQ(251u * 251u, statistics.vertices);
+        EXPECT_EQ(2u * 250u * 250u, statistics.smoothTriangles);
+
+        const auto& expected = one.batch<world::SmoothTriangleObject>().objects();
+        const auto& actual   = chunked.batch<world::SmoothTriangleObject>().objects();
+        ASSERT_EQ(expected.size(), actual.size());
+        for (size_t i = 0; i < expected.size(); i++) {
+            expectVector(expected[i].geometry().get_a(), actual[i].geometry().get_a());
+            expectVector(expected[i].geometry().get_edge_ab(), actual[i].geometry().get_edge_ab());
+            expectVector(expected[i].geometry().get_normal_at(0.2f, 0.3f),
+                         actual[i].geometry().get_normal_at(0.2f, 0.3f));
+        }
+    }
+}
+
+TEST(OBJ_LOADER, MalformedLinesThrow) {
+    world::Scene         scene;
+    world::Material      material;
+    parallel::ThreadPool pool{2};
+
+    const char* malformed[] = {"v 0 0 0\nv 1 0\n", "v 0 0 0\nf 1 1\n", "v 0 0 0\nf 0 1 1\n",
+                               "v 0 0 0\nf 1 1 x\n", "vn 0 0 1\nf 1//a 1 1\n"};
+    for (const char* obj : malformed) {
+        SCOPED_TRACE(obj);
+        EXPECT_THROW(world::parseObj(obj, "bad.obj", scene, material, pool), std::runtime_error);
+    }
+
+    try {
+        world::parseObj("v 0 0 0\n\nv 1\n", "bad.obj", scene, material, pool);
+        FAIL();
+    } catch (const std::runtime_error& error) {
+        EXPECT_EQ(std::string("bad.obj:3: expected 3 vertex coordinates"), error.what());
+    }
+
+    // indices are only resolved after all vertices are known
+    EXPECT_THROW(world::parseObj("v 0 0 0\nf 1 2 3\n", "bad.obj", scene, material, pool),
+                 std::runtime_error);
+    EXPECT_THROW(world::parseObj("v 0 0 0\nf 1 -1 -2\n", "bad.obj", scene, material, pool),
+                 std::runtime_error);
+    EXPECT_THROW(world::parseObj("v 0 0 0\nf 1//1 1//1 1//1\n", "bad.obj", scene, material, pool),
+                 std::runtime_error);
+}
+
+TEST(OBJ_LOADER, LoadsFile) {
+    const std::string path = testing::TempDir() + "obj_loader_test.obj";
+    {
+        std::ofstream file(path);
+        file << createGrid(3, false);
+    }
+
+    world::Scene         scene;
+    world::Material      material;
+    parallel::ThreadPool pool{2};
+    const auto           statistics = world::loadObj(path, scene, material, pool);
+    std::remove(path.c_str());
+
+    EXPECT_EQ(18u, statistics.triangles);
+    scene.build();
+    // the grid lies in 0 <= x, y <= 3, seen from above
+    EXPECT_TRUE(world::findClosestHit(Ray3df{{1.5f, 1.2f, 10.0f}, {0.0f, 0.0f, -1.0f}}, scene));
+    EXPECT_FALSE(world::findClosestHit(Ray3df{{4.5f, 1.2f, 10.0f}, {0.0f, 0.0f, -1.0f}}, scene));
+
+    EXPECT_THROW(world::loadObj(path, scene, material, pool), std::runtime_error);
+}
+
+TEST(OBJ_LOADER, MeshHitsSameTrianglesAsScene) {
+    // the corners of the last face have no normals, so the mesh uses face normals
+    for (const std::string& obj : {createGrid(30, true), createGrid(30, false) + "f 1 2 3\n"}) {
+        world::Scene         scene;
+        world::Material      material;
+        parallel::ThreadPool pool{2};
+        world::parseObj(obj, "grid.obj", scene, material, pool);
+        scene.build();
+        const world::Mesh mesh = world::parseObjMesh(obj, "grid.obj", pool);
+        EXPECT_EQ(scene.size(), mesh.triangleCount());
+        const bool smooth = scene.batch<world::TriangleObject>().objects().empty();
+
+        for (float x = 0.25f; x < 30.0f; x += 1.5f) {
+            for (float y = 0.75f; y < 30.0f; y += 1.5f) {
+                const Ray3df ray{{x, y, 10.0f}, {0.0f, 0.0f, -1.0f}};
+                const auto   expected = world::findClosestHit(ray, scene);
+                ASSERT_TRUE(expected);
+                Intersection_Context<float, 3> actual;
+                ASSERT_TRUE(mesh.intersects(ray, actual));
+                EXPECT_NEAR(expected->t, actual.t, 1e-4f);
+                if (smooth) {
+                    expectVector(expected->normal, actual.normal);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,913 @@
+#include "renderer.h"
+#include "progressive.h"
+#include "interactive.h"
+#include "antialias.h"
+#include "path_tracer.h"
+#include "sampler.h"
+#include "thread_pool.h"
+#include "viewport.h"
+#include "camera.h"
+#include "world.h"
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <numbers>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace {
+
+using namespace rt;
+
+TEST(THREAD_POOL, ExecutesEachIndexOnce) {
+    for (unsigned threads : {1u, 2u, 7u}) {
+        parallel::ThreadPool          pool{threads};
+        std::vector<std::atomic<int>> executed(1000);
+
+        pool.parallelFor(executed.size(), [&](size_t index, unsigned worker) {
+            EXPECT_LT(worker, threads);
+            executed[index]++;
+        });
+
+        for (const auto& count : executed) {
+            EXPECT_EQ(1, count.load());
+        }
+    }
+}
+
+TEST(THREAD_POOL, ReusableForSeveralBatches) {
+    parallel::ThreadPool pool{4};
+    std::atomic<size_t>  sum{0};
+    for (size_t batch = 1; batch <= 50; batch++) {
+        pool.parallelFor(batch, [&](size_t index, unsigned) { sum += index + 1; });
+    }
+    // sum over batches b of b * (b + 1) / 2
+    EXPECT_EQ(22100u, sum.load());
+}
+
+TEST(TILES, CoverImageOnce) {
+    const int        width = 37, height = 21;
+    std::vector<int> covered(width * height, 0);
+    for (const auto& tile : render::makeTiles(width, height, 8)) {
+        for (int y = tile.y; y < tile.y + tile.height; y++) {
+            for (int x = tile.x; x < tile.x + tile.width; x++) {
+                covered[y * width + x]++;
+            }
+        }
+    }
+    for (int count : covered) {
+        EXPECT_EQ(1, count);
+    }
+}
+
+TEST(CAMERA, RowsGiveSameRaysAsSinglePixels) {
+    view::Viewport viewport{3.0, 2.0, 10.0, 150, 100};
+    camera::Camera camera{Vector3df{0.5, -0.25, 10.0}, Vector3df{0.0, 0.0, -1.0}, viewport};
+    const Vector3df position{0.5f, -0.25f, 10.0f};
+
+    camera::RayRow row;
+    for (int y : {0, 37, 99}) {
+        for (int first : {0, 3, 61}) {
+            camera.getRow(first, y, camera::RayRow::MAX_SIZE, row);
+            ASSERT_EQ(camera::RayRow::MAX_SIZE, row.size);
+            for (int i = 0; i < row.size; i++) {
+                const Ray3df ray    = row.ray(i);
+                const Ray3df single = camera.getRay(first + i, y);
+                for (size_t k = 0; k < 3; k++) {
+                    EXPECT_EQ(position[k], ray.origin[k]);
+                    EXPECT_EQ(single.direction[k], ray.direction[k]);
+                }
+                EXPECT_NEAR(1.0f, ray.direction.square_of_length(), 1e-6f);
+
+                // through the centre of the pixel on the viewport at z = -10
+                const float t = -20.0f / ray.direction[2];
+                EXPECT_NEAR(-1.5f + (first + i + 0.5f) * 0.02f, position[0] + t * ray.direction[0],
+                            1e-4f);
+                EXPECT_NEAR(1.0f - (y + 0.5f) * 0.02f, position[1] + t * ray.direction[1], 1e-4f);
+            }
+        }
+    }
+}
+
+TEST(SHADING, LambertianWithShadows) {
+    world::Material material;
+    material.diffuse = Vector3df{0.5f, 1.0f, 1.0f};
+    material.ambient = Vector3df{0.1f, 0.1f, 0.1f};
+
+    // a floor in the plane y = 0, lit by two lights above it
+    world::Scene scene;
+    scene.emplace_back(world::TriangleObject(Vector3df{-10.0f, 0.0f, -10.0f},
+                                             Vector3df{10.0f, 0.0f, -10.0f},
+                                             Vector3df{0.0f, 0.0f, 10.0f}, material));
+    scene.build();
+    std::vector<world::PointLight> lights{{.position = Vector3df{0.0f, 2.0f, 0.0f}},
+                                          {.position = Vector3df{2.0f, 2.0f, 0.0f}}};
+
+    Ray3df     ray{{0.0f, 1.0f, 0.0f}, {0.0f, -1.0f, 0.0f}};
+    world::Hit hit        = world::findClosestHit(ray, scene).value();
+    uint64_t   shadowRays = 0;
+    Vector3df  lit = render::shadeLambertian(ray, hit, scene, lights, shadowRays);
+    // the first light is straight above, the second one at 45 degrees, halved for two lights
+    const float diffuse = 0.5f * (1.0f + std::sqrt(0.5f));
+    EXPECT_NEAR(0.5f * (0.1f + diffuse), lit[0], 1e-5f);
+    EXPECT_NEAR(0.1f + diffuse, lit[1], 1e-5f);
+    EXPECT_EQ(2u, shadowRays);
+
+    // a sphere between the floor and the first light casts a shadow
+    scene.emplace_back(world::SphereObject(Vector3df{0.0f, 1.5f, 0.0f}, 0.2f, material));
+    scene.build();
+    hit                = world::findClosestHit(ray, scene).value();
+    Vector3df shadowed = render::shadeLambertian(ray, hit, scene, lights, shadowRays);
+    EXPECT_NEAR(0.1f + 0.5f * std::sqrt(0.5f), shadowed[1], 1e-5f);
+
+    // without lights only the ambient part remains
+    Vector3df ambient = render::shadeLambertian(ray, hit, scene, {}, shadowRays);
+    EXPECT_NEAR(0.05f, ambient[0], 1e-6f);
+    EXPECT_NEAR(0.1f, ambient[1], 1e-6f);
+    EXPECT_EQ(4u, shadowRays);
+}
+
+// two mirrors in the planes z = -1 and z = 1 facing each other
+world::Scene createMirrors(float reflectivity) {
+    world::Material material;
+    material.diffuse      = Vector3df{1.0f, 0.5f, 0.25f};
+    material.ambient      = Vector3df{0.2f, 0.2f, 0.2f};
+    material.reflectivity = reflectivity;
+
+    world::Scene scene;
+    for (float z : {-1.0f, 1.0f}) {
+        scene.emplace_back(world::TriangleObject(Vector3df{-10.0f, -10.0f, z},
+                                                 Vector3df{10.0f, -10.0f, z},
+                                                 Vector3df{0.0f, 10.0f, z}, material));
+    }
+    scene.build();
+    return scene;
+}
+
+TEST(REFLECTION, StopsAtMaxDepth) {
+    const world::Scene scene = createMirrors(0.5f);
+    const Ray3df       ray{{0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, -1.0f}};
+
+    // without lights every hit has the colour 0.2 * diffuse, half of it reflects the next hit
+    for (int maxDepth : {0, 1, 2, 5}) {
+        SCOPED_TRACE(maxDepth);
+        render::WorkerContext context;
+        const Vector3df       color =
+            render::traceRay(ray, scene, {}, {.maxDepth = maxDepth, .minContribution = 0.0f},
+                             context);
+        EXPECT_EQ(static_cast<uint64_t>(maxDepth), context.reflectionRays);
+        const float weight = 1.0f - std::pow(0.5f, static_cast<float>(maxDepth + 1));
+        EXPECT_NEAR(0.2f * weight, color[0], 1e-5f);
+        EXPECT_NEAR(0.05f * weight, color[2], 1e-5f);
+    }
+}
+
+TEST(REFLECTION, DropsRaysBelowMinContribution) {
+    const world::Scene scene = createMirrors(0.5f);
+    const Ray3df       ray{{0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 1.0f}};
+
+    // the reflections have the weights 0.5, 0.25, 0.125, 0.0625, ...
+    render::WorkerContext context;
+    render::traceRay(ray, scene, {}, {.maxDepth = 100, .minContribution = 0.1f}, context);
+    EXPECT_EQ(3u, context.reflectionRays);
+
+    // the default cutoff ends the bounces long before the depth limit
+    context = {};
+    render::traceRay(ray, scene, {}, {.maxDepth = 100}, context);
+    EXPECT_EQ(8u, context.reflectionRays);
+
+    // materials that do not reflect trace no reflected rays
+    context = {};
+    render::traceRay(ray, createMirrors(0.0f), {}, {}, context);
+    EXPECT_EQ(0u, context.reflectionRays);
+}
+
+TEST(REFLECTION, MirrorShowsObjectInFront) {
+    world::Material mirror;
+    mirror.reflectivity = 1.0f;
+    world::Material red;
+    red.diffuse = Vector3df{1.0f, 0.0f, 0.0f};
+
+    // a mirror floor in the plane y = 0 and a red sphere above it, lit from below in front
+    world::Scene scene;
+    scene.emplace_back(world::TriangleObject(Vector3df{-10.0f, 0.0f, -10.0f},
+                                             Vector3df{10.0f, 0.0f, -10.0f},
+                                             Vector3df{0.0f, 0.0f, 10.0f}, mirror));
+    scene.emplace_back(world::SphereObject(Vector3df{0.0f, 2.0f, 0.0f}, 0.5f, red));
+    scene.build();
+    const std::vector<world::PointLight> lights{{.position = Vector3df{0.0f, 0.5f, 3.0f}}};
+
+    // seen via the floor at 45 degrees, the ray mirrored at (0, 0, 2) hits the sphere, the
+    // reflected ray starts slightly above the floor
+    Vector3df direction{0.0f, -1.0f, -1.0f};
+    direction.normalize();
+    const Ray3df ray{{0.0f, 2.0f, 4.0f}, direction};
+
+    render::WorkerContext context;
+    const Vector3df       color = render::traceRay(ray, scene, lights, {}, context);
+    EXPECT_EQ(1u, context.reflectionRays);
+
+    Vector3df reflected{0.0f, 1.0f, -1.0f};
+    reflected.normalize();
+    const Ray3df     mirrored{{0.0f, 0.0f, 2.0f}, reflected};
+    const world::Hit sphereHit = world::findClosestHit(mirrored, scene).value();
+    uint64_t         shadowRays = 0;
+    const Vector3df  expected =
+        render::shadeLambertian(mirrored, sphereHit, scene, lights, shadowRays);
+    EXPECT_GT(expected[0], 0.1f);
+    for (size_t i = 0; i < 3; i++) {
+        EXPECT_NEAR(expected[i], color[i], 1e-3f);
+    }
+}
+
+// renders the Cornell box with the given number of threads
+fb::MemoryFramebuffer renderCornellBox(unsigned threads) {
+    const int             size = 64;
+    view::Viewport        viewport{2.0, 2.0, 10.0, size, size};
+    camera::Camera        camera{Vector3df{0.0, 0.0, 10.0}, Vector3df{0.0, 0.0, -1.0}, viewport};
+    const world::SceneBvh scene{world::createScene()};
+
+    fb::MemoryFramebuffer framebuffer{size, size};
+    parallel::ThreadPool  pool{threads};
+    auto contexts =
+        render::renderImage(pool, camera, scene, world::createLights(), framebuffer, 8);
+
+    EXPECT_EQ(static_cast<uint64_t>(size * size), render::mergeContexts(contexts).primaryRays);
+    return framebuffer;
+}
+
+TEST(CAMERA, PoseMovesViewRigidly) {
+    view::Viewport  viewport{3.0, 2.0, 10.0, 150, 100};
+    camera::Camera  camera{Vector3df{0.5, -0.25, 10.0}, Vector3df{0.0, 0.0, -1.0}, viewport};
+    camera::Camera  moved = camera;
+    const Vector3df offset{1.0f, 2.0f, -3.0f};
+    moved.setPose({.offset = offset, .yaw = 0.3f, .pitch = -0.2f});
+    EXPECT_NEAR(1.5f, moved.origin()[0], 1e-6f);
+
+    camera::RayRow row;
+    moved.getRow(0, 40, 64, row);
+    const Ray3df first = camera.getRay(3, 7), firstMoved = moved.getRay(3, 7);
+    for (int x = 0; x < 64; x++) {
+        const Ray3df ray = camera.getRay(x, 40), rayMoved = moved.getRay(x, 40);
+        for (size_t k = 0; k < 3; k++) {
+            EXPECT_EQ(moved.origin()[k], rayMoved.origin[k]);
+            EXPECT_EQ(rayMoved.origin[k], row.ray(x).origin[k]);
+            EXPECT_EQ(rayMoved.direction[k], row.ray(x).direction[k]);
+        }
+        // the angles between the rays are kept
+        EXPECT_NEAR(1.0f, rayMoved.direction.square_of_length(), 1e-5f);
+        EXPECT_NEAR(first.direction * ray.direction, firstMoved.direction * rayMoved.direction,
+                    1e-5f);
+    }
+
+    // the default pose gives the rays of the viewport
+    moved.setPose({});
+    for (size_t k = 0; k < 3; k++) {
+        EXPECT_EQ(first.direction[k], moved.getRay(3, 7).direction[k]);
+    }
+
+    // a quarter turn of yaw looks left, moving forward then follows the view
+    const camera::Pose turned =
+        camera::movePose({}, Vector3df{0.0f, 0.0f, -1.0f}, 0.5f * std::numbers::pi_v<float>, 0.0f);
+    EXPECT_NEAR(-1.0f, turned.offset[0], 1e-6f);
+    EXPECT_NEAR(0.0f, turned.offset[2], 1e-6f);
+    // the pitch stops short of looking straight up
+    EXPECT_LT(camera::movePose({}, Vector3df{}, 0.0f, 10.0f).pitch,
+              0.5f * std::numbers::pi_v<float>);
+}
+
+TEST(CAMERA, ProjectInvertsGetRay) {
+    view::Viewport viewport{3.0, 2.0, 10.0, 150, 100};
+    camera::Camera camera{Vector3df{0.5, -0.25, 10.0}, Vector3df{0.0, 0.0, -1.0}, viewport};
+    for (const camera::Pose& pose :
+         {camera::Pose{}, camera::Pose{.offset = Vector3df{0.5f, 0.0f, -2.0f}, .yaw = -0.4f,
+                                       .pitch = 0.25f}}) {
+        camera.setPose(pose);
+        for (int y : {0, 50, 99}) {
+            for (int x : {0, 75, 149}) {
+                const Ray3df    ray   = camera.getRay(x, y, 0.25f, -0.3f);
+                const Vector3df point = ray.origin + 7.0f * ray.direction;
+                float           pixelX, pixelY;
+                ASSERT_TRUE(camera.project(point, pixelX, pixelY));
+                EXPECT_NEAR(x + 0.25f, pixelX, 1e-3f);
+                EXPECT_NEAR(y - 0.3f, pixelY, 1e-3f);
+                // nothing behind the camera
+                EXPECT_FALSE(camera.project(ray.origin - ray.direction, pixelX, pixelY));
+            }
+        }
+    }
+}
+
+TEST(RENDER, PacketsRenderSameImageAsSingleRays) {
+    const int      size = 61;  // not a multiple of the tile or packet size
+    view::Viewport viewport{2.0, 2.0, 10.0, size, size};
+    camera::Camera camera{Vector3df{0.0, 0.0, 10.0}, Vector3df{0.0, 0.0, -1.0}, viewport};
+    const auto     scene = world::createScene<world::Scene>();
+    parallel::ThreadPool pool{2};
+
+    fb::MemoryFramebuffer reference{size, size};
+    const auto referenceRays = render::mergeContexts(
+        render::renderImage(pool, camera, scene, world::createLights(), reference, 16, 1));
+    EXPECT_GT(referenceRays.shadowRays, 0u);
+    // the sphere of the Cornell box reflects
+    EXPECT_GT(referenceRays.reflectionRays, 0u);
+    for (int packetSize : {2, 4, 8}) {
+        fb::MemoryFramebuffer image{size, size};
+        auto contexts =
+            render::renderImage(pool, camera, scene, world::createLights(), image, 16, packetSize);
+        EXPECT_EQ(static_cast<uint64_t>(size * size), render::mergeContexts(contexts).primaryRays);
+        EXPECT_EQ(referenceRays.shadowRays, render::mergeContexts(contexts).shadowRays);
+        EXPECT_EQ(referenceRays.reflectionRays, render::mergeContexts(contexts).reflectionRays);
+        EXPECT_EQ(reference.data(), image.data());
+    }
+}
+
+TEST(RENDER, SameImageForAnyThreadCount) {
+    const auto reference = renderCornellBox(1);
+    for (unsigned threads : {2u, 3u, 8u}) {
+        const auto image = renderCornellBox(threads);
+        EXPECT_EQ(reference.data(), image.data());
+    }
+}
+
+TEST(STATS, CountsTraversalAndTiles) {
+    const int      size = 40;
+    view::Viewport viewport{2.0, 2.0, 10.0, size, size};
+    camera::Camera camera{Vector3df{0.0, 0.0, 10.0}, Vector3df{0.0, 0.0, -1.0}, viewport};
+    const auto     scene  = world::createScene<world::Scene>();
+    const auto     lights = world::createLights();
+
+    std::vector<render::WorkerContext> frames;
+    for (unsigned threads : {1u, 3u}) {
+        parallel::ThreadPool  pool{threads};
+        fb::MemoryFramebuffer framebuffer{size, size};
+        frames.push_back(render::mergeContexts(
+            render::renderImage(pool, camera, scene, lights, framebuffer, 16, 1)));
+    }
+    const render::WorkerContext& frame = frames[0];
+    const uint64_t rays = frame.primaryRays + frame.shadowRays + frame.reflectionRays;
+    if constexpr (!stats::ENABLED) {
+        EXPECT_EQ(0u, frame.traversal.nodesVisited);
+        EXPECT_TRUE(frame.tileTimes.empty());
+        return;
+    }
+
+    EXPECT_GE(frame.traversal.nodesVisited, rays);
+    EXPECT_GT(frame.traversal.primitiveTests, 0u);
+    // each ray finds at most one hit
+    EXPECT_GT(frame.traversal.hits, 0u);
+    EXPECT_LE(frame.traversal.hits, rays);
+    // the work of each ray does not depend on the thread tracing it
+    EXPECT_EQ(frame.traversal.nodesVisited, frames[1].traversal.nodesVisited);
+    EXPECT_EQ(frame.traversal.primitiveTests, frames[1].traversal.primitiveTests);
+    EXPECT_EQ(frame.traversal.hits, frames[1].traversal.hits);
+
+    // one time for each tile of 16 x 16 pixels
+    ASSERT_EQ(9u, frame.tileTimes.size());
+    int pixels = 0;
+    for (const auto& time : frame.tileTimes) {
+        EXPECT_GE(time.milliseconds, 0.0);
+        pixels += time.tile.width * time.tile.height;
+    }
+    EXPECT_EQ(size * size, pixels);
+
+    std::ostringstream stream;
+    render::writeStatisticsJson(stream, frame, 0.5);
+    const std::string json  = stream.str();
+    const std::string nodes = "\"nodes_visited\": " + std::to_string(frame.traversal.nodesVisited);
+    EXPECT_NE(std::string::npos, json.find(nodes));
+    EXPECT_NE(std::string::npos, json.find("\"milliseconds\": 500"));
+    EXPECT_NE(std::string::npos, json.find("{\"x\": 32, \"y\": 32, \"width\": 8"));
+    EXPECT_NE(std::string::npos, render::statisticsSummary(frame, 0.5).find("primitive tests"));
+}
+
+TEST(STATS, CostsPerPixel) {
+    const int      size = 24;
+    view::Viewport viewport{2.0, 2.0, 10.0, size, size};
+    camera::Camera camera{Vector3df{0.0, 0.0, 10.0}, Vector3df{0.0, 0.0, -1.0}, viewport};
+    const auto     scene  = world::createScene<world::Scene>();
+    const auto     lights = world::createLights();
+    parallel::ThreadPool  pool{2};
+    fb::MemoryFramebuffer expected{size, size}, framebuffer{size, size};
+    render::renderImage(pool, camera, scene, lights, expected, 16, 1);
+
+    // the time of each pixel is measured with every build
+    std::vector<float> costs;
+    render::renderCosts(pool, camera, scene, lights, framebuffer, costs,
+                        render::CostMetric::Nanoseconds);
+    ASSERT_EQ(static_cast<size_t>(size * size), costs.size());
+    EXPECT_GT(*std::max_element(costs.begin(), costs.end()), 0.0f);
+    EXPECT_EQ(expected.data(), framebuffer.data());
+
+    if constexpr (!stats::ENABLED) {
+        EXPECT_THROW(render::renderCosts(pool, camera, scene, lights, framebuffer, costs),
+                     std::runtime_error);
+        return;
+    }
+    // the traversal costs of the pixels add up to the counters of the whole image
+    const auto frame = render::mergeContexts(
+        render::renderCosts(pool, camera, scene, lights, framebuffer, costs));
+    double sum = 0.0;
+    for (float cost : costs) {
+        EXPECT_GE(cost, 1.0f);
+        sum += cost;
+    }
+    EXPECT_EQ(static_cast<double>(frame.traversal.nodesVisited + frame.traversal.primitiveTests),
+              sum);
+}
+
+TEST(PROGRESSIVE, PreviewFillsBlocks) {
+    const int      size = 61;
+    view::Viewport viewport{2.0, 2.0, 10.0, size, size};
+    camera::Camera camera{Vector3df{0.0, 0.0, 10.0}, Vector3df{0.0, 0.0, -1.0}, viewport};
+    const auto     scene  = world::createScene<world::Scene>();
+    const auto     lights = world::createLights();
+    parallel::ThreadPool pool{2};
+
+    fb::MemoryFramebuffer reference{size, size};
+    render::renderImage(pool, camera, scene, lights, reference, 16, 1);
+    fb::MemoryFramebuffer fullResolution{size, size};
+    render::renderPreview(pool, camera, scene, lights, fullResolution, 1);
+    EXPECT_EQ(reference.data(), fullResolution.data());
+
+    // one ray per block of 8 x 8 pixels, the blocks at the borders are cut off
+    fb::MemoryFramebuffer preview{size, size};
+    const auto contexts = render::renderPreview(pool, camera, scene, lights, preview, 8);
+    EXPECT_EQ(64u, render::mergeContexts(contexts).primaryRays);
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            const Vector3df expected = reference.getPixel(x - x % 8, y - y % 8);
+            const Vector3df actual   = preview.getPixel(x, y);
+            for (size_t i = 0; i < 3; i++) {
+                EXPECT_EQ(expected[i], actual[i]);
+            }
+        }
+    }
+}
+
+TEST(PROGRESSIVE, EndsWithFullImage) {
+    const int      size = 64;
+    view::Viewport viewport{2.0, 2.0, 10.0, size, size};
+    camera::Camera camera{Vector3df{0.0, 0.0, 10.0}, Vector3df{0.0, 0.0, -1.0}, viewport};
+    const auto     scene  = world::createScene<world::Scene>();
+    const auto     lights = world::createLights();
+    parallel::ThreadPool pool{3};
+
+    fb::MemoryFramebuffer reference{size, size};
+    render::renderImage(pool, camera, scene, lights, reference);
+
+    for (int previewBlockSize : {1, 4}) {
+        SCOPED_TRACE(previewBlockSize);
+        render::ProgressiveSettings settings;
+        settings.previewBlockSize = previewBlockSize;
+        fb::MemoryFramebuffer     image{size, size};
+        render::ProgressiveRender progressive{pool, camera, scene, lights, image, settings};
+        const auto rays   = progressive.wait();
+        const int  passes = previewBlockSize > 1 ? 2 : 1;
+
+        EXPECT_TRUE(progressive.finished());
+        EXPECT_EQ(passes, progressive.completedPasses());
+        ASSERT_EQ(static_cast<size_t>(passes), progressive.passSeconds().size());
+        EXPECT_LE(progressive.passSeconds().front(), progressive.passSeconds().back());
+        EXPECT_EQ(static_cast<uint64_t>(size * size + (passes - 1) * 16 * 16), rays.primaryRays);
+        EXPECT_EQ(reference.data(), image.data());
+    }
+}
+
+TEST(ANTIALIAS, SelectsHighContrastPixelsWithinBudget) {
+    // a vertical edge between black and overexposed white, the white is clamped to 1
+    fb::MemoryFramebuffer image{8, 8};
+    for (int y = 0; y < 8; y++) {
+        for (int x = 4; x < 8; x++) {
+            image.setPixel(x, y, Vector3df{3.0f, 3.0f, 3.0f});
+        }
+    }
+    const auto contrast = render::pixelContrast(image);
+    for (int y = 0; y < 8; y++) {
+        for (int x = 0; x < 8; x++) {
+            EXPECT_EQ(x == 3 || x == 4 ? 1.0f : 0.0f, contrast[y * 8 + x]);
+        }
+    }
+
+    size_t     candidates = 0;
+    const auto all = render::selectPixels(contrast, 8, 8, {.gridSize = 2, .budget = 100.0f},
+                                          candidates);
+    EXPECT_EQ(16u, candidates);
+    EXPECT_EQ(16u, all.size());
+
+    // 64 pixels * 0.35 rays allow 5 pixels with 2 x 2 samples
+    const auto limited = render::selectPixels(contrast, 8, 8, {.gridSize = 2, .budget = 0.35f},
+                                              candidates);
+    EXPECT_EQ(16u, candidates);
+    EXPECT_EQ((std::vector<uint32_t>{3, 4, 11, 12, 19}), limited);
+}
+
+TEST(ANTIALIAS, StratifiedSampleOffsets) {
+    for (int gridSize : {1, 2, 4}) {
+        for (int row = 0; row < gridSize; row++) {
+            for (int column = 0; column < gridSize; column++) {
+                float offsetX, offsetY;
+                render::sampleOffset(17, 5, column, row, gridSize, offsetX, offsetY);
+                const float cell = 1.0f / static_cast<float>(gridSize);
+                EXPECT_GE(offsetX, column * cell - 0.5f);
+                EXPECT_LT(offsetX, (column + 1) * cell - 0.5f);
+                EXPECT_GE(offsetY, row * cell - 0.5f);
+                EXPECT_LT(offsetY, (row + 1) * cell - 0.5f);
+
+                float againX, againY;
+                render::sampleOffset(17, 5, column, row, gridSize, againX, againY);
+                EXPECT_EQ(offsetX, againX);
+                EXPECT_EQ(offsetY, againY);
+            }
+        }
+    }
+}
+
+// renders the Cornell box with one sample per pixel and refines it
+fb::MemoryFramebuffer renderAntialiased(unsigned threads, const render::AntialiasSettings& settings,
+                                        render::AntialiasStatistics& statistics) {
+    const int      size = 64;
+    view::Viewport viewport{2.0, 2.0, 10.0, size, size};
+    camera::Camera camera{Vector3df{0.0, 0.0, 10.0}, Vector3df{0.0, 0.0, -1.0}, viewport};
+    const auto     scene  = world::createScene<world::Scene>();
+    const auto     lights = world::createLights();
+
+    parallel::ThreadPool  pool{threads};
+    fb::MemoryFramebuffer image{size, size};
+    render::renderImage(pool, camera, scene, lights, image);
+    statistics = render::refineAdaptive(pool, camera, scene, lights, image, settings);
+    return image;
+}
+
+TEST(ANTIALIAS, RefinesOnlySelectedPixels) {
+    render::AntialiasStatistics unrefined, refined, budgeted;
+    const auto reference = renderAntialiased(2, {.gridSize = 0}, unrefined);
+    EXPECT_EQ(0u, unrefined.rays.primaryRays);
+
+    const auto image = renderAntialiased(2, {.gridSize = 3, .budget = 100.0f}, refined);
+    EXPECT_GT(refined.refinedPixels, 0u);
+    EXPECT_EQ(refined.candidatePixels, refined.refinedPixels);
+    EXPECT_EQ(9u * refined.refinedPixels, refined.rays.primaryRays);
+    // the edges of the sphere and the box, not the uniform walls
+    EXPECT_LT(refined.refinedPixels, 64u * 64u / 4u);
+
+    size_t changed = 0;
+    for (size_t i = 0; i < reference.data().size(); i += 3) {
+        changed += reference.data()[i] != image.data()[i] ||
+                   reference.data()[i + 1] != image.data()[i + 1] ||
+                   reference.data()[i + 2] != image.data()[i + 2];
+    }
+    EXPECT_GT(changed, 0u);
+    EXPECT_LE(changed, refined.refinedPixels);
+
+    // a budget of 0.25 camera rays per pixel on average
+    renderAntialiased(2, {.gridSize = 3, .budget = 0.25f}, budgeted);
+    EXPECT_EQ(64u * 64u / 4u / 9u, budgeted.refinedPixels);
+    EXPECT_LE(budgeted.rays.primaryRays, 64u * 64u / 4u);
+
+    for (unsigned threads : {1u, 3u}) {
+        render::AntialiasStatistics statistics;
+        EXPECT_EQ(image.data(),
+                  renderAntialiased(threads, {.gridSize = 3, .budget = 100.0f}, statistics).data());
+    }
+}
+
+TEST(SAMPLER, DeterministicPerPixelAndSample) {
+    render::Sampler first(3, 5, 7, 11), same(3, 5, 7, 11);
+    render::Sampler otherPixel(5, 3, 7, 11), otherSample(3, 5, 8, 11), otherSeed(3, 5, 7, 12);
+    int             differentPixel = 0, differentSample = 0, differentSeed = 0;
+    for (int i = 0; i < 16; i++) {
+        const uint32_t value = first.next();
+        EXPECT_EQ(value, same.next());
+        differentPixel += value != otherPixel.next();
+        differentSample += value != otherSample.next();
+        differentSeed += value != otherSeed.next();
+    }
+    EXPECT_GT(differentPixel, 12);
+    EXPECT_GT(differentSample, 12);
+    EXPECT_GT(differentSeed, 12);
+}
+
+TEST(SAMPLER, UniformInUnitInterval) {
+    // the first numbers of neighbouring pixels, as a render uses them
+    double sum = 0.0, squares = 0.0;
+    int    count = 0;
+    for (uint32_t y = 0; y < 100; y++) {
+        for (uint32_t x = 0; x < 100; x++) {
+            render::Sampler sampler(x, y, 0);
+            for (int i = 0; i < 4; i++) {
+                const float value = sampler.uniform();
+                ASSERT_GE(value, 0.0f);
+                ASSERT_LT(value, 1.0f);
+                sum += value;
+                squares += value * value;
+                count++;
+            }
+        }
+    }
+    EXPECT_NEAR(0.5, sum / count, 0.01);
+    EXPECT_NEAR(1.0 / 3.0, squares / count, 0.01);
+}
+
+TEST(PATH, CosineSamplesAroundNormal) {
+    const Vector3df normals[] = {{0.0f, 0.0f, 1.0f}, {0.0f, 0.0f, -1.0f}, {0.6f, 0.0f, -0.8f}};
+    for (const Vector3df& normal : normals) {
+        // the mean cosine of a cosine distribution is 2 / 3
+        double cosines = 0.0;
+        for (uint32_t sample = 0; sample < 10000; sample++) {
+            render::Sampler sampler(1, 2, sample);
+            const Vector3df direction = render::sampleCosine(normal, sampler);
+            EXPECT_NEAR(1.0f, direction.length(), 1e-5f);
+            EXPECT_GE(direction * normal, -1e-6f);
+            cosines += direction * normal;
+        }
+        EXPECT_NEAR(2.0 / 3.0, cosines / 10000.0, 0.01);
+    }
+}
+
+TEST(PATH, DirectLightMatchesLambertian) {
+    world::Material material;
+    material.diffuse = Vector3df{0.5f, 1.0f, 1.0f};
+    material.ambient = Vector3df{0.0f, 0.0f, 0.0f};
+
+    // a floor in the plane y = 0 and nothing above it, so paths leave after the first hit
+    world::Scene scene;
+    scene.emplace_back(world::TriangleObject(Vector3df{-10.0f, 0.0f, -10.0f},
+                                             Vector3df{10.0f, 0.0f, -10.0f},
+                                             Vector3df{0.0f, 0.0f, 10.0f}, material));
+    scene.build();
+    std::vector<world::PointLight> lights{{.position = Vector3df{0.0f, 2.0f, 0.0f}},
+                                          {.position = Vector3df{2.0f, 2.0f, 0.0f}}};
+
+    const Ray3df ray{{0.0f, 1.0f, 0.0f}, {0.0f, -1.0f, 0.0f}};
+    uint64_t     shadowRays = 0;
+    const Vector3df expected =
+        render::shadeLambertian(ray, world::findClosestHit(ray, scene).value(), scene, lights,
+                                shadowRays);
+
+    render::WorkerContext context;
+    Vector3df             sum{0.0f, 0.0f, 0.0f};
+    const int             samples = 4000;
+    for (int sample = 0; sample < samples; sample++) {
+        render::Sampler sampler(0, 0, static_cast<uint32_t>(sample));
+        sum += render::tracePath(ray, scene, accel::LightTree(lights), {}, sampler, context);
+    }
+    for (size_t i = 0; i < 3; i++) {
+        EXPECT_NEAR(expected[i], sum[i] / samples, 0.01f * expected[i]);
+    }
+    EXPECT_EQ(static_cast<uint64_t>(samples), context.primaryRays);
+    EXPECT_EQ(static_cast<uint64_t>(samples), context.shadowRays);
+
+    // with a single light each sample is exact
+    lights.pop_back();
+    const Vector3df single = render::shadeLambertian(
+        ray, world::findClosestHit(ray, scene).value(), scene, lights, shadowRays);
+    render::Sampler sampler(0, 0, 0);
+    const Vector3df traced =
+        render::tracePath(ray, scene, accel::LightTree(lights), {}, sampler, context);
+    for (size_t i = 0; i < 3; i++) {
+        EXPECT_NEAR(single[i], traced[i], 1e-6f);
+    }
+}
+
+fb::MemoryFramebuffer pathTraceCornellBox(unsigned threads, const render::PathSettings& settings) {
+    const int            size = 32;
+    view::Viewport       viewport{2.0, 2.0, 10.0, size, size};
+    camera::Camera       camera{Vector3df{0.0, 0.0, 10.0}, Vector3df{0.0, 0.0, -1.0}, viewport};
+    const auto           scene = world::createScene<world::Scene>();
+    parallel::ThreadPool pool{threads};
+
+    fb::MemoryFramebuffer framebuffer{size, size};
+    const auto            rays = render::mergeContexts(render::renderPathTraced(
+        pool, camera, scene, world::createLights(), framebuffer, settings, 8));
+    EXPECT_EQ(static_cast<uint64_t>(size * size * settings.samplesPerPixel), rays.primaryRays);
+    return framebuffer;
+}
+
+// the mean of all channels of all pixels
+double brightness(const fb::MemoryFramebuffer& framebuffer) {
+    double sum = 0.0;
+    for (int y = 0; y < framebuffer.height(); y++) {
+        for (int x = 0; x < framebuffer.width(); x++) {
+            const Vector3df color = framebuffer.getPixel(x, y);
+            sum += color[0] + color[1] + color[2];
+        }
+    }
+    return sum / (3.0 * framebuffer.width() * framebuffer.height());
+}
+
+TEST(PATH, SameImageForAnyThreadCount) {
+    const auto reference = pathTraceCornellBox(1, {.samplesPerPixel = 4});
+    for (unsigned threads : {2u, 5u}) {
+        EXPECT_EQ(reference.data(), pathTraceCornellBox(threads, {.samplesPerPixel = 4}).data());
+    }
+    EXPECT_NE(reference.data(), pathTraceCornellBox(1, {.samplesPerPixel = 4, .seed = 1}).data());
+}
+
+TEST(PATH, CornellBoxConverges) {
+    const double expected = brightness(pathTraceCornellBox(2, {.samplesPerPixel = 256}));
+    // fewer samples are noisier but just as bright on average
+    EXPECT_NEAR(expected, brightness(pathTraceCornellBox(2, {.samplesPerPixel = 16})),
+                0.03 * expected);
+    // the light reflected between the walls adds to the direct light of the first hits
+    const double direct =
+        brightness(pathTraceCornellBox(2, {.samplesPerPixel = 16, .maxBounces = 1}));
+    EXPECT_GT(direct, 0.0);
+    EXPECT_GT(expected, 1.1 * direct);
+}
+
+TEST(PROGRESSIVE, PathTracedPassesRefineTheMean) {
+    const int            size = 32;
+    view::Viewport       viewport{2.0, 2.0, 10.0, size, size};
+    camera::Camera       camera{Vector3df{0.0, 0.0, 10.0}, Vector3df{0.0, 0.0, -1.0}, viewport};
+    const auto           scene  = world::createScene<world::Scene>();
+    const auto           lights = world::createLights();
+    parallel::ThreadPool pool{3};
+
+    fb::MemoryFramebuffer reference{size, size};
+    render::renderPathTraced(pool, camera, scene, lights, reference, {.samplesPerPixel = 8});
+
+    fb::MemoryFramebuffer     image{size, size};
+    render::ProgressiveRender progressive{pool, camera, scene, lights, image,
+                                          render::PathSettings{.samplesPerPixel = 8}};
+    const auto                rays = progressive.wait();
+    // passes of 1, 1, 2 and 4 samples
+    EXPECT_EQ(4, progressive.completedPasses());
+    EXPECT_EQ(static_cast<uint64_t>(size * size * 8), rays.primaryRays);
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            for (size_t i = 0; i < 3; i++) {
+                EXPECT_NEAR(reference.getPixel(x, y)[i], image.getPixel(x, y)[i], 1e-5f);
+            }
+        }
+    }
+}
+
+TEST(PROGRESSIVE, CancelStopsThePasses) {
+    const int            size = 32;
+    view::Viewport       viewport{2.0, 2.0, 10.0, size, size};
+    camera::Camera       camera{Vector3df{0.0, 0.0, 10.0}, Vector3df{0.0, 0.0, -1.0}, viewport};
+    const auto           scene  = world::createScene<world::Scene>();
+    const auto           lights = world::createLights();
+    parallel::ThreadPool pool{2};
+
+    // far more samples than the test could wait for
+    const int                 samples = 1 << 24;
+    fb::MemoryFramebuffer     image{size, size};
+    render::ProgressiveRender progressive{pool, camera, scene, lights, image,
+                                          render::PathSettings{.samplesPerPixel = samples}};
+    while (progressive.completedPasses() == 0) {
+        std::this_thread::yield();
+    }
+    progressive.cancel();
+    const auto rays = progressive.wait();
+
+    EXPECT_FALSE(progressive.finished());
+    EXPECT_GE(progressive.completedPasses(), 1);
+    EXPECT_EQ(static_cast<size_t>(progressive.completedPasses()),
+              progressive.passSeconds().size());
+    EXPECT_LT(rays.primaryRays, static_cast<uint64_t>(size * size) * samples / 1024);
+}
+
+TEST(INTERACTIVE, AccumulatesWhileStill) {
+    const int            size = 24;
+    view::Viewport       viewport{2.0, 2.0, 10.0, size, size};
+    camera::Camera       camera{Vector3df{0.0, 0.0, 10.0}, Vector3df{0.0, 0.0, -1.0}, viewport};
+    const auto           scene = world::createScene<world::Scene>();
+    parallel::ThreadPool pool{3};
+
+    // without a time budget each frame traces one pixel of each block of 2 x 2 pixels
+    render::InteractiveSettings settings;
+    settings.samplesPerPixel = 3;
+    settings.maxBlockSize    = 3;
+    settings.frameSeconds    = 0.0;
+    render::InteractiveRender render{size, size, world::createLights(), settings};
+    EXPECT_EQ(2, render.blockSize());
+    fb::MemoryFramebuffer framebuffer{size, size};
+    auto rays = render::mergeContexts(render.renderFrame(pool, camera, scene, framebuffer));
+    EXPECT_EQ(static_cast<uint64_t>(size * size / 4), rays.primaryRays);
+    // the other pixels of a block show its sample
+    EXPECT_EQ(1u, render.samples(0, 0));
+    EXPECT_EQ(0u, render.samples(1, 1));
+    for (size_t i = 0; i < 3; i++) {
+        EXPECT_EQ(render.mean(0, 0)[i], framebuffer.getPixel(1, 1)[i]);
+    }
+
+    // four frames sample every pixel once
+    for (int frame = 1; frame < 12; frame++) {
+        EXPECT_FALSE(render.converged());
+        render.renderFrame(pool, camera, scene, framebuffer);
+        if (frame == 3) {
+            for (int y = 0; y < size; y++) {
+                for (int x = 0; x < size; x++) {
+                    EXPECT_EQ(1u, render.samples(x, y));
+                }
+            }
+        }
+    }
+    EXPECT_TRUE(render.converged());
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            EXPECT_EQ(3u, render.samples(x, y));
+            for (size_t i = 0; i < 3; i++) {
+                EXPECT_EQ(render.mean(x, y)[i], framebuffer.getPixel(x, y)[i]);
+            }
+        }
+    }
+    // converged pixels are not traced again
+    rays = render::mergeContexts(render.renderFrame(pool, camera, scene, framebuffer));
+    EXPECT_EQ(0u, rays.primaryRays);
+}
+
+TEST(INTERACTIVE, PathTracedFramesConverge) {
+    const int            size = 32;
+    view::Viewport       viewport{2.0, 2.0, 10.0, size, size};
+    camera::Camera       camera{Vector3df{0.0, 0.0, 10.0}, Vector3df{0.0, 0.0, -1.0}, viewport};
+    const auto           scene  = world::createScene<world::Scene>();
+    const auto           lights = world::createLights();
+    parallel::ThreadPool pool{2};
+
+    fb::MemoryFramebuffer reference{size, size}, framebuffer{size, size};
+    render::renderPathTraced(pool, camera, scene, lights, reference, {.samplesPerPixel = 64});
+    render::InteractiveSettings settings;
+    settings.samplesPerPixel = 64;
+    settings.maxBlockSize    = 1;
+    settings.frameSeconds    = 0.0;
+    settings.pathTraced      = true;
+    render::InteractiveRender render{size, size, lights, settings};
+    while (!render.converged()) {
+        render.renderFrame(pool, camera, scene, framebuffer);
+    }
+    double expected = 0.0, brightness = 0.0;
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            for (size_t i = 0; i < 3; i++) {
+                expected += reference.getPixel(x, y)[i];
+                brightness += framebuffer.getPixel(x, y)[i];
+            }
+        }
+    }
+    EXPECT_GT(expected, 0.0);
+    EXPECT_NEAR(expected, brightness, 0.03 * expected);
+}
+
+TEST(INTERACTIVE, ReprojectsAfterSmallMove) {
+    const int            size = 48;
+    view::Viewport       viewport{2.0, 2.0, 10.0, size, size};
+    camera::Camera       camera{Vector3df{0.0, 0.0, 10.0}, Vector3df{0.0, 0.0, -1.0}, viewport};
+    const auto           scene  = world::createScene<world::Scene>();
+    const auto           lights = world::createLights();
+    parallel::ThreadPool pool{2};
+    fb::MemoryFramebuffer framebuffer{size, size};
+
+    render::InteractiveSettings settings;
+    settings.samplesPerPixel       = 4;
+    settings.maxReprojectedSamples = 2;
+    settings.maxBlockSize          = 1;
+    settings.frameSeconds          = 0.0;
+    render::InteractiveRender render{size, size, lights, settings};
+    while (!render.converged()) {
+        render.renderFrame(pool, camera, scene, framebuffer);
+    }
+
+    // the converged image of the moved camera
+    const camera::Pose pose{.offset = Vector3df{0.05f, -0.02f, -0.1f}, .yaw = 0.005f};
+    camera.setPose(pose);
+    render::InteractiveRender fresh{size, size, lights, settings};
+    while (!fresh.converged()) {
+        fresh.renderFrame(pool, camera, scene, framebuffer);
+    }
+
+    render.reproject(pool, camera);
+    int reprojected = 0, close = 0;
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            EXPECT_LE(render.samples(x, y), 2u);
+            if (render.samples(x, y) == 0) {
+                continue;
+            }
+            reprojected++;
+            float difference = 0.0f;
+            for (size_t i = 0; i < 3; i++) {
+                difference = std::max(difference,
+                                      std::abs(render.mean(x, y)[i] - fresh.mean(x, y)[i]));
+            }
+            close += difference < 0.1f;
+        }
+    }
+    // most of the image is kept and looks as from the moved camera, except at edges, which may
+    // be shifted by up to half a pixel
+    EXPECT_GT(reprojected, size * size * 9 / 10);
+    EXPECT_GT(close, reprojected * 9 / 10);
+
+    // the next frame adds to the reprojected samples without reprojecting again
+    const auto rays = render::mergeContexts(render.renderFrame(pool, camera, scene, framebuffer));
+    EXPECT_EQ(static_cast<uint64_t>(size * size), rays.primaryRays);
+    EXPECT_FALSE(render.converged());
+}
+
+}  // namespace
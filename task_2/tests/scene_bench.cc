@@ -0,0 +1,112 @@
+#include "scene.h"
+#include "test_util.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+
+// Compares the closest hit queries of the type-erased std::vector<Hittable> (linear scan and
+// hierarchy) with the type-partitioned world::Scene on a random scene,
+// and the occlusion query with a closest hit query for shadow rays of limited length.
+// usage: scene_bench [object count] [ray count]
+
+using namespace rt;
+using test::randomVector;
+
+namespace {
+
+// traces the rays and prints the throughput, returns the number of hits to keep the work alive
+template <typename Scene>
+size_t benchmark(const char* name, const Scene& scene, const std::vector<Ray3df>& rays) {
+    size_t     hits  = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (const auto& ray : rays) {
+        hits += world::findClosestHit(ray, scene).has_value();
+    }
+    const double seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << name << ": " << rays.size() << " rays in " << seconds * 1000.0 << " ms, "
+              << static_cast<double>(rays.size()) / seconds / 1e6 << " Mrays/s, " << hits
+              << " hits" << std::endl;
+    return hits;
+}
+
+// the same for shadow rays ending at tMax, answered by occluded or by a closest hit query
+template <typename Scene>
+void benchmarkShadowRays(const Scene& scene, const std::vector<Ray3df>& rays, float tMax) {
+    for (bool anyHit : {false, true}) {
+        size_t     occluded = 0;
+        const auto start    = std::chrono::steady_clock::now();
+        for (const auto& ray : rays) {
+            if (anyHit) {
+                occluded += world::occluded(ray, tMax, scene);
+            } else {
+                const auto hit = world::findClosestHit(ray, scene);
+                occluded += hit.has_value() && hit->t < tMax;
+            }
+        }
+        const double seconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "shadow rays with " << (anyHit ? "occluded" : "findClosestHit") << ": "
+                  << rays.size() << " rays in " << seconds * 1000.0 << " ms, "
+                  << static_cast<double>(rays.size()) / seconds / 1e6 << " Mrays/s, "
+                  << occluded << " occluded" << std::endl;
+    }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    const int objectCount = argc > 1 ? std::atoi(argv[1]) : 20000;
+    const int rayCount    = argc > 2 ? std::atoi(argv[2]) : 200000;
+
+    std::mt19937                 random(1);
+    std::vector<world::Hittable> hittables;
+    world::Scene                 scene;
+    for (int i = 0; i < objectCount; i++) {
+        Vector3df corner = randomVector(random, -50.0f, 50.0f);
+        if (i % 4 == 0) {
+            world::SphereObject sphere(corner, 0.5f, world::Material{});
+            hittables.emplace_back(sphere);
+            scene.emplace_back(sphere);
+        } else {
+            world::TriangleObject triangle(corner, corner + randomVector(random, -1.0f, 1.0f),
+                                           corner + randomVector(random, -1.0f, 1.0f),
+                                           world::Material{});
+            hittables.emplace_back(triangle);
+            scene.emplace_back(triangle);
+        }
+    }
+
+    std::vector<Ray3df> rays;
+    for (int i = 0; i < rayCount; i++) {
+        Vector3df direction = randomVector(random, -1.0f, 1.0f);
+        direction.normalize();
+        rays.push_back(Ray3df{randomVector(random, -60.0f, 60.0f), direction});
+    }
+
+    // the linear scan is too slow for all rays
+    std::vector<Ray3df> fewRays(rays.begin(), rays.begin() + std::min<size_t>(rays.size(), 1000));
+    benchmark("std::vector<Hittable> linear scan", hittables, fewRays);
+
+    auto start = std::chrono::steady_clock::now();
+    const world::SceneBvh hittableBvh{std::move(hittables)};
+    std::cout << "std::vector<Hittable> hierarchy built in "
+              << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() *
+                     1000.0
+              << " ms" << std::endl;
+    benchmark("std::vector<Hittable> hierarchy", hittableBvh, rays);
+
+    start = std::chrono::steady_clock::now();
+    scene.build();
+    std::cout << "world::Scene built in "
+              << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() *
+                     1000.0
+              << " ms" << std::endl;
+    benchmark("world::Scene type-partitioned", scene, rays);
+    benchmarkShadowRays(scene, rays, 60.0f);
+    return 0;
+}
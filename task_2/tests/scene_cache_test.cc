@@ -0,0 +1,215 @@
+#include "scene_cache.h"
+#include "obj_loader.h"
+#include "test_util.h"
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+using namespace rt;
+using test::expectSameHits;
+
+// a bumpy grid of size x size quads, with a normal per vertex if asked to
+std::string createGrid(int size, bool normals) {
+    std::ostringstream obj;
+    for (int y = 0; y <= size; y++) {
+        for (int x = 0; x <= size; x++) {
+            obj << "v " << x << " " << y << " " << std::sin(x * 0.7f) * std::cos(y * 0.4f) << "\n";
+            if (normals) {
+                obj << "vn " << (x % 3) * 0.1f << " 0.2 1\n";
+            }
+        }
+    }
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            const int corners[4] = {y * (size + 1) + x + 1, y * (size + 1) + x + 2,
+                                    (y + 1) * (size + 1) + x + 2, (y + 1) * (size + 1) + x + 1};
+            obj << "f";
+            for (int corner : corners) {
+                obj << " " << corner;
+                if (normals) {
+                    obj << "//" << corner;
+                }
+            }
+            obj << "\n";
+        }
+    }
+    return obj.str();
+}
+
+void writeFile(const std::string& path, const std::string& contents) {
+    std::ofstream file(path, std::ios::binary);
+    file << contents;
+}
+
+// rays from above onto the grid and beside it
+std::vector<Ray3df> gridRays(int size) {
+    std::mt19937                          random(3);
+    std::uniform_real_distribution<float> position(-1.0f, static_cast<float>(size) + 1.0f);
+    std::uniform_real_distribution<float> tilt(-0.3f, 0.3f);
+    std::vector<Ray3df>                   rays;
+    for (int i = 0; i < 500; i++) {
+        Vector3df direction{tilt(random), tilt(random), -1.0f};
+        direction.normalize();
+        rays.push_back(Ray3df{{position(random), position(random), 5.0f}, direction});
+    }
+    return rays;
+}
+
+world::Material redMaterial() {
+    world::Material material;
+    material.diffuse      = Vector3df{0.9f, 0.1f, 0.1f};
+    material.reflectivity = 0.25f;
+    return material;
+}
+
+}  // namespace
+
+TEST(SCENE_CACHE, ContentHashDetectsChanges) {
+    const std::string contents = createGrid(5, true);
+    EXPECT_EQ(world::contentHash(contents), world::contentHash(contents));
+    EXPECT_NE(world::contentHash(contents), world::contentHash(contents, 1));
+
+    // every single changed byte and every length changes the hash
+    std::string changed = contents;
+    for (size_t i = 0; i < changed.size(); i += 7) {
+        changed[i] ^= 1;
+        EXPECT_NE(world::contentHash(contents), world::contentHash(changed)) << i;
+        changed[i] ^= 1;
+    }
+    for (size_t length = 0; length < 80; length++) {
+        EXPECT_NE(world::contentHash(contents.substr(0, length)),
+                  world::contentHash(contents.substr(0, length + 1)));
+    }
+
+    world::Material material;
+    EXPECT_EQ(world::contentHash(material), world::contentHash(world::Material()));
+    EXPECT_NE(world::contentHash(material), world::contentHash(redMaterial()));
+}
+
+TEST(SCENE_CACHE, MappedMeshHitsAsBuiltMesh) {
+    const std::string     path     = testing::TempDir() + "scene_cache_test.cache";
+    const world::Material material = redMaterial();
+    parallel::ThreadPool  pool{2};
+
+    for (bool normals : {false, true}) {
+        const world::Mesh mesh = world::parseObjMesh(createGrid(20, normals), "grid.obj", pool);
+        world::writeMeshCache(path, mesh, material, 42);
+
+        const auto mapped = world::mapMeshCache(path, 42);
+        ASSERT_TRUE(mapped.has_value());
+        EXPECT_EQ(mesh.triangleCount(), mapped->geometry().triangleCount());
+        EXPECT_EQ(mesh.vertexCount(), mapped->geometry().vertexCount());
+        EXPECT_EQ(mesh.memoryBytes(), mapped->geometry().memoryBytes());
+        for (size_t k = 0; k < 3; k++) {
+            EXPECT_EQ(material.diffuse[k], mapped->material().diffuse[k]);
+        }
+        EXPECT_EQ(material.reflectivity, mapped->material().reflectivity);
+        EXPECT_GT(expectSameHits(mesh, mapped->geometry(), gridRays(20)), 300);
+
+        // the mapping is kept alive by copies of the mesh after the file is gone
+        const world::Mesh copy = mapped->geometry();
+        std::remove(path.c_str());
+        EXPECT_GT(expectSameHits(mesh, copy, gridRays(20)), 300);
+    }
+}
+
+TEST(SCENE_CACHE, RejectsOutdatedFiles) {
+    const std::string     path = testing::TempDir() + "scene_cache_outdated.cache";
+    parallel::ThreadPool  pool{1};
+    const world::Mesh     mesh = world::parseObjMesh(createGrid(4, false), "grid.obj", pool);
+    const world::Material material;
+
+    EXPECT_FALSE(world::mapMeshCache(path, 1).has_value());
+
+    world::writeMeshCache(path, mesh, material, 1);
+    EXPECT_TRUE(world::mapMeshCache(path, 1).has_value());
+    EXPECT_FALSE(world::mapMeshCache(path, 2).has_value());
+
+    std::string contents;
+    {
+        std::ifstream     file(path, std::ios::binary);
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+        contents = buffer.str();
+    }
+
+    // another version, the version follows the magic
+    std::string changed = contents;
+    changed[8] ^= 1;
+    writeFile(path, changed);
+    EXPECT_FALSE(world::mapMeshCache(path, 1).has_value());
+
+    // the nodes are the last section, a damaged node is out of range
+    changed = contents;
+    std::fill(changed.end() - sizeof(accel::BvhNode), changed.end(), '\xff');
+    writeFile(path, changed);
+    EXPECT_FALSE(world::mapMeshCache(path, 1).has_value());
+
+    // truncated files
+    writeFile(path, contents.substr(0, contents.size() - 1));
+    EXPECT_FALSE(world::mapMeshCache(path, 1).has_value());
+    writeFile(path, contents.substr(0, 16));
+    EXPECT_FALSE(world::mapMeshCache(path, 1).has_value());
+
+    std::remove(path.c_str());
+}
+
+TEST(SCENE_CACHE, LoadWritesThenMapsCache) {
+    const std::string     objPath   = testing::TempDir() + "scene_cache_test.obj";
+    const std::string     cachePath = objPath + ".cache";
+    const world::Material material  = redMaterial();
+    parallel::ThreadPool  pool{2};
+    writeFile(objPath, createGrid(12, true));
+    std::remove(cachePath.c_str());
+
+    world::MeshCacheStatistics cold, warm, changed;
+    const world::MeshObject    parsed =
+        world::loadObjMeshCached(objPath, cachePath, material, pool, &cold);
+    EXPECT_FALSE(cold.fromCache);
+    EXPECT_TRUE(cold.cacheWritten);
+    const world::MeshObject mapped =
+        world::loadObjMeshCached(objPath, cachePath, material, pool, &warm);
+    EXPECT_TRUE(warm.fromCache);
+    EXPECT_GT(expectSameHits(parsed.geometry(), mapped.geometry(), gridRays(12)), 300);
+
+    // another material or other contents invalidate the cache
+    world::loadObjMeshCached(objPath, cachePath, world::Material(), pool, &changed);
+    EXPECT_FALSE(changed.fromCache);
+    writeFile(objPath, createGrid(13, true));
+    world::loadObjMeshCached(objPath, cachePath, world::Material(), pool, &changed);
+    EXPECT_FALSE(changed.fromCache);
+    const world::MeshObject reloaded =
+        world::loadObjMeshCached(objPath, cachePath, world::Material(), pool, &changed);
+    EXPECT_TRUE(changed.fromCache);
+    EXPECT_EQ(13u * 13u * 2u, reloaded.geometry().triangleCount());
+
+    std::remove(objPath.c_str());
+    std::remove(cachePath.c_str());
+}
+
+TEST(SCENE_CACHE, LoadsWithoutWritableCache) {
+    const std::string     objPath = testing::TempDir() + "scene_cache_unwritable.obj";
+    const world::Material material;
+    parallel::ThreadPool  pool{1};
+    writeFile(objPath, createGrid(4, false));
+
+    // the directory of the cache does not exist
+    const std::string          cachePath = testing::TempDir() + "scene_cache_missing/grid.cache";
+    world::MeshCacheStatistics statistics;
+    const world::MeshObject    object =
+        world::loadObjMeshCached(objPath, cachePath, material, pool, &statistics);
+    EXPECT_FALSE(statistics.fromCache);
+    EXPECT_FALSE(statistics.cacheWritten);
+    EXPECT_EQ(4u * 4u * 2u, object.geometry().triangleCount());
+
+    std::remove(objPath.c_str());
+}
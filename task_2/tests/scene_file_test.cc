@@ -0,0 +1,231 @@
+#include "scene_file.h"
+#include "test_util.h"
+#include "gtest/gtest.h"
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace {
+
+using namespace rt;
+using test::expectVector;
+
+world::SceneFile parse(const std::string& contents, world::Scene& scene) {
+    parallel::ThreadPool pool{1};
+    return world::parseSceneFile(contents, "test.scene", testing::TempDir(), scene, pool);
+}
+
+// the message of the std::runtime_error thrown for the scene file, empty if none is thrown
+std::string parseError(const std::string& contents) {
+    world::Scene scene;
+    try {
+        parse(contents, scene);
+    } catch (const std::runtime_error& error) {
+        return error.what();
+    }
+    return "";
+}
+
+}  // namespace
+
+TEST(SCENE_FILE, ParsesStatements) {
+    const std::string contents = "# a comment\n"
+                                 "material red diffuse 0.9 0.1 0.1 shininess 8\n"
+                                 "material mirror reflectivity 1 specular 0.5 0.5 0.5\r\n"
+                                 "\n"
+                                 "sphere red 0 0 -5 1   # the first object\n"
+                                 "\tsphere mirror 3 0 -5 0.5\n"
+                                 "triangle red -1 -1 -8  1 -1 -8  0 1 -8\n"
+                                 "light 0 5 0\n"
+                                 "light 1 2 3 0.5 0.25 1\n"
+                                 "camera 0 0 4  0 0 -2\n"
+                                 "viewport 3 2 5";
+
+    world::Scene           scene;
+    const world::SceneFile file = parse(contents, scene);
+    scene.build();
+
+    EXPECT_EQ(3u, file.objects);
+    EXPECT_EQ(3u, scene.size());
+    ASSERT_EQ(2u, file.lights.size());
+    expectVector(Vector3df{0.0f, 5.0f, 0.0f}, file.lights[0].position);
+    expectVector(Vector3df{1.0f, 1.0f, 1.0f}, file.lights[0].color);
+    expectVector(Vector3df{0.5f, 0.25f, 1.0f}, file.lights[1].color);
+
+    expectVector(Vector3df{0.0f, 0.0f, 4.0f}, file.camera.position);
+    expectVector(Vector3df{0.0f, 0.0f, -1.0f}, file.camera.direction);
+    EXPECT_FLOAT_EQ(3.0f, file.camera.viewportWidth);
+    EXPECT_FLOAT_EQ(2.0f, file.camera.viewportHeight);
+    EXPECT_FLOAT_EQ(5.0f, file.camera.focalLength);
+
+    // the materials are assigned to the objects using them
+    const auto red = world::findClosestHit(Ray3df{{0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, -1.0f}}, scene);
+    ASSERT_TRUE(red);
+    EXPECT_FLOAT_EQ(4.0f, red->t);
+    expectVector(Vector3df{0.9f, 0.1f, 0.1f}, red->material->diffuse);
+    EXPECT_FLOAT_EQ(8.0f, red->material->shininess);
+
+    const auto mirror =
+        world::findClosestHit(Ray3df{{3.0f, 0.0f, 0.0f}, {0.0f, 0.0f, -1.0f}}, scene);
+    ASSERT_TRUE(mirror);
+    EXPECT_FLOAT_EQ(1.0f, mirror->material->reflectivity);
+    expectVector(world::Material().diffuse, mirror->material->diffuse);
+
+    const auto triangle =
+        world::findClosestHit(Ray3df{{0.5f, -0.9f, 0.0f}, {0.0f, 0.0f, -1.0f}}, scene);
+    ASSERT_TRUE(triangle);
+    EXPECT_FLOAT_EQ(8.0f, triangle->t);
+}
+
+TEST(SCENE_FILE, ReportsLineOfErrors) {
+    EXPECT_EQ("", parseError("material a\nsphere a 0 0 0 1\n"));
+    EXPECT_EQ("test.scene:2: unknown material 'b'", parseError("material a\nsphere b 0 0 0 1\n"));
+    EXPECT_EQ("test.scene:1: unknown statement 'cube'", parseError("cube 1 2 3"));
+    EXPECT_EQ("test.scene:3: expected the radius",
+              parseError("material a\n\nsphere a 0 0 0\n"));
+    EXPECT_EQ("test.scene:1: unexpected field '5'", parseError("light 1 2 3 4 4 4 5"));
+    EXPECT_EQ("test.scene:2: material 'a' defined twice", parseError("material a\nmaterial a"));
+    EXPECT_EQ("test.scene:1: the camera direction must not be zero",
+              parseError("camera 0 0 0 0 0 0"));
+    EXPECT_NE("", parseError("material a diffuse 1 1"));
+    EXPECT_NE("", parseError("viewport 2 0 10"));
+    EXPECT_NE("", parseError("material a\nmesh a missing.obj\n"));
+
+    parallel::ThreadPool pool{1};
+    world::Scene         scene;
+    EXPECT_THROW(world::loadSceneFile(testing::TempDir() + "missing.scene", scene, pool),
+                 std::runtime_error);
+}
+
+TEST(SCENE_FILE, LoadsMeshesRelativeToSceneFile) {
+    const std::string directory = testing::TempDir();
+    const std::string objPath   = directory + "scene_file_quad.obj";
+    const std::string path      = directory + "scene_file_test.scene";
+    {
+        std::ofstream obj(objPath);
+        obj << "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nf 1 2 3 4\n";
+        std::ofstream scene(path);
+        scene << "material blue diffuse 0.1 0.1 0.9\n"
+                 "mesh blue scene_file_quad.obj\n"
+                 "mesh blue scene_file_quad.obj scale 2 translate 5 0 0\n"
+                 "mesh blue scene_file_quad.obj rotate 0 1 0 90 translate 0 0 -3\n";
+    }
+
+    parallel::ThreadPool   pool{1};
+    world::Scene           scene;
+    const world::SceneFile file = world::loadSceneFile(path, scene, pool);
+    scene.build();
+    EXPECT_EQ(3u, file.objects);
+    ASSERT_EQ(1u, scene.batch<world::MeshObject>().objects().size());
+    const auto& instances = scene.batch<world::InstanceObject>().objects();
+    ASSERT_EQ(2u, instances.size());
+    // the file is loaded once, the instances share its mesh
+    for (const auto& instance : instances) {
+        EXPECT_TRUE(instance.geometry().mesh().sharesData(
+            scene.batch<world::MeshObject>().objects()[0].geometry()));
+    }
+
+    const Vector3df down{0.0f, 0.0f, -1.0f};
+    EXPECT_TRUE(world::findClosestHit(Ray3df{{0.5f, 0.5f, 1.0f}, down}, scene));
+    // scaled first, then moved: [5, 7] x [0, 2]
+    EXPECT_TRUE(world::findClosestHit(Ray3df{{6.5f, 1.5f, 1.0f}, down}, scene));
+    EXPECT_FALSE(world::findClosestHit(Ray3df{{4.5f, 1.5f, 1.0f}, down}, scene));
+    // rotated into the plane x = 0, then moved to z in [-4, -3]
+    const auto side =
+        world::findClosestHit(Ray3df{{-1.0f, 0.5f, -3.5f}, {1.0f, 0.0f, 0.0f}}, scene);
+    ASSERT_TRUE(side);
+    EXPECT_NEAR(1.0f, side->t, 1e-5f);
+    expectVector(Vector3df{0.1f, 0.1f, 0.9f}, side->material->diffuse);
+
+    std::remove(path.c_str());
+    std::remove(objPath.c_str());
+    std::remove((objPath + ".cache").c_str());
+}
+
+TEST(SCENE_FILE, CornellFileMatchesCreateScene) {
+    parallel::ThreadPool   pool{1};
+    world::Scene           scene;
+    const world::SceneFile file =
+        world::loadSceneFile(std::string(SCENE_DIRECTORY) + "/cornell.scene", scene, pool);
+    scene.build();
+    const auto expected = world::createScene<world::Scene>();
+    const auto lights   = world::createLights();
+
+    EXPECT_EQ(expected.size(), scene.size());
+    ASSERT_EQ(lights.size(), file.lights.size());
+    for (size_t i = 0; i < lights.size(); i++) {
+        expectVector(lights[i].position, file.lights[i].position);
+    }
+
+    // the camera of the file is the camera of the programs without scene file
+    view::Viewport       viewport = file.camera.viewport(64, 48);
+    view::Viewport       programViewport{64.0f / 48.0f * 2.0f, 2.0f, 10.0f, 64, 48};
+    const camera::Camera camera = file.camera.camera(viewport);
+    const camera::Camera programCamera{Vector3df{0.0f, 0.0f, 10.0f}, Vector3df{0.0f, 0.0f, -1.0f},
+                                       programViewport};
+
+    // its rays hit the same surfaces with the same materials
+    for (int y = 0; y < 48; y++) {
+        for (int x = 0; x < 64; x++) {
+            const Ray3df ray = camera.getRay(x, y), programRay = programCamera.getRay(x, y);
+            for (size_t k = 0; k < 3; k++) {
+                EXPECT_EQ(programRay.origin[k], ray.origin[k]);
+                EXPECT_EQ(programRay.direction[k], ray.direction[k]);
+            }
+            const auto expectedHit = world::findClosestHit(ray, expected);
+            const auto actualHit   = world::findClosestHit(ray, scene);
+            ASSERT_EQ(expectedHit.has_value(), actualHit.has_value());
+            if (expectedHit) {
+                EXPECT_FLOAT_EQ(expectedHit->t, actualHit->t);
+                expectVector(expectedHit->normal, actualHit->normal);
+                expectVector(expectedHit->material->diffuse, actualHit->material->diffuse);
+                EXPECT_EQ(expectedHit->material->reflectivity, actualHit->material->reflectivity);
+            }
+        }
+    }
+}
+
+TEST(SCENE_FILE, CameraLooksAlongItsDirection) {
+    const std::string objects = "material red diffuse 1 0 0\n"
+                                "material blue diffuse 0 0 1\n"
+                                "sphere red 0 0 -10 1\n"
+                                "sphere blue 10 2 5 1\n";
+
+    // the ray through the centre of the image of a camera with the given statement
+    const auto centreHit = [&](const std::string& camera) {
+        world::Scene           scene;
+        const world::SceneFile file = parse(objects + camera, scene);
+        scene.build();
+        view::Viewport       viewport = file.camera.viewport(65, 65);
+        const camera::Camera view     = file.camera.camera(viewport);
+        const Ray3df         ray      = view.getRay(32, 32);
+        return std::pair{ray, world::findClosestHit(ray, scene)};
+    };
+
+    const auto [ahead, red] = centreHit("camera 0 0 0  0 0 -1\nviewport 2 2 1");
+    ASSERT_TRUE(red);
+    EXPECT_FLOAT_EQ(1.0f, red->material->diffuse[0]);
+    EXPECT_NEAR(9.0f, red->t, 1e-4f);
+
+    // turned towards the blue sphere from beside it, up and back
+    const auto [turned, blue] = centreHit("camera 4 2 5  1 0 0\nviewport 2 2 1");
+    ASSERT_TRUE(blue);
+    EXPECT_FLOAT_EQ(1.0f, blue->material->diffuse[2]);
+    EXPECT_NEAR(5.0f, blue->t, 1e-4f);
+    expectVector(Vector3df{4.0f, 2.0f, 5.0f}, turned.origin);
+    EXPECT_NEAR(1.0f, turned.direction[0], 1e-6f);
+
+    // the focal length is the distance of the viewport from the camera wherever it stands: the
+    // centre of a corner pixel of 2 x 2 pixels lies 0.5 to the side and 0.5 up at distance 1
+    world::Scene           scene;
+    const world::SceneFile file = parse("camera 3 1 -2  0 -1 0\nviewport 2 2 1", scene);
+    view::Viewport         viewport = file.camera.viewport(2, 2);
+    const camera::Camera   view     = file.camera.camera(viewport);
+    const Ray3df           corner   = view.getRay(0, 0);
+    expectVector(Vector3df{3.0f, 1.0f, -2.0f}, corner.origin);
+    EXPECT_NEAR(-1.0f / std::sqrt(1.5f), corner.direction[1], 1e-5f);
+}
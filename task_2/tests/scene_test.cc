@@ -0,0 +1,251 @@
+#include "scene.h"
+#include "test_util.h"
+#include "gtest/gtest.h"
+
+#include <cmath>
+#include <random>
+
+namespace {
+
+using namespace rt;
+using test::randomVector;
+
+// adds the same random spheres and triangles to both scenes, the material encodes the index
+template <typename SceneA, typename SceneB>
+void addRandomObjects(SceneA& a, SceneB& b, std::mt19937& random) {
+    for (int i = 0; i < 300; i++) {
+        world::Material material;
+        material.shininess = static_cast<float>(i);
+        world::SphereObject sphere(randomVector(random, -10.0f, 10.0f), 0.3f, material);
+        a.emplace_back(sphere);
+        b.emplace_back(sphere);
+    }
+    for (int i = 300; i < 1500; i++) {
+        world::Material material;
+        material.shininess = static_cast<float>(i);
+        Vector3df            corner = randomVector(random, -10.0f, 10.0f);
+        world::TriangleObject triangle(corner, corner + randomVector(random, -1.0f, 1.0f),
+                                       corner + randomVector(random, -1.0f, 1.0f), material);
+        a.emplace_back(triangle);
+        b.emplace_back(triangle);
+    }
+}
+
+TEST(SCENE, StoresObjectsByType) {
+    auto scene = world::createScene<world::Scene>();
+
+    EXPECT_EQ(1u, scene.batch<world::SphereObject>().objects().size());
+    EXPECT_EQ(10u, scene.batch<world::TriangleObject>().objects().size());
+    EXPECT_EQ(11u, scene.size());
+}
+
+TEST(SCENE, EmptyScene) {
+    world::Scene scene;
+    scene.build();
+
+    EXPECT_FALSE(world::findClosestHit(Ray3df{{0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, -1.0f}}, scene));
+}
+
+TEST(SCENE, SameHitsAsHittableVector) {
+    std::mt19937                 random(3);
+    std::vector<world::Hittable> hittables;
+    world::Scene                 scene;
+    addRandomObjects(hittables, scene, random);
+    scene.build();
+
+    for (int i = 0; i < 5000; i++) {
+        Vector3df direction = randomVector(random, -1.0f, 1.0f);
+        direction.normalize();
+        Ray3df ray{randomVector(random, -12.0f, 12.0f), direction};
+
+        auto expected = world::findClosestHit(ray, hittables);
+        auto actual   = world::findClosestHit(ray, scene);
+        ASSERT_EQ(expected.has_value(), actual.has_value());
+        if (expected.has_value()) {
+            EXPECT_FLOAT_EQ(expected->t, actual->t);
+            EXPECT_EQ(expected->material->shininess, actual->material->shininess);
+            EXPECT_EQ(expected->normal.vector, actual->normal.vector);
+        }
+    }
+}
+
+TEST(SCENE, OccludedAgreesWithClosestHit) {
+    std::mt19937                 random(11);
+    std::vector<world::Hittable> hittables;
+    world::Scene                 scene;
+    addRandomObjects(hittables, scene, random);
+    scene.build();
+
+    std::vector<world::Hittable> copies;
+    for (const auto& sphere : scene.batch<world::SphereObject>().objects()) {
+        copies.emplace_back(sphere);
+    }
+    for (const auto& triangle : scene.batch<world::TriangleObject>().objects()) {
+        copies.emplace_back(triangle);
+    }
+    const world::SceneBvh sceneBvh{std::move(copies)};
+
+    std::uniform_real_distribution<float> distance(0.0f, 30.0f);
+    int                                   occluded = 0;
+    for (int i = 0; i < 5000; i++) {
+        Vector3df direction = randomVector(random, -1.0f, 1.0f);
+        direction.normalize();
+        Ray3df      ray{randomVector(random, -12.0f, 12.0f), direction};
+        const float tMax = distance(random);
+
+        auto hit = world::findClosestHit(ray, scene);
+        // rays ending right at an intersection may go either way
+        if (hit.has_value() && std::fabs(hit->t - tMax) < 1e-4f) {
+            continue;
+        }
+        const bool expected = hit.has_value() && hit->t < tMax;
+        EXPECT_EQ(expected, world::occluded(ray, tMax, scene));
+        EXPECT_EQ(expected, world::occluded(ray, tMax, hittables));
+        EXPECT_EQ(expected, world::occluded(ray, tMax, sceneBvh));
+        occluded += expected;
+    }
+    EXPECT_GT(occluded, 100);
+}
+
+// traces the packet through the scene and compares each ray with a single ray query
+void expectSameHitsAsSingleRays(const world::Scene& scene, accel::RayPacket packet) {
+    world::Hit     hits[accel::RayPacket::MAX_SIZE];
+    const uint64_t mask = scene.intersect(packet, hits);
+    for (uint32_t i = 0; i < packet.size; i++) {
+        auto expected = world::findClosestHit(packet.ray(i), scene);
+        ASSERT_EQ(expected.has_value(), ((mask >> i) & 1) != 0);
+        if (expected.has_value()) {
+            EXPECT_EQ(expected->t, hits[i].t);
+            EXPECT_EQ(expected->t, packet.tMax[i]);
+            EXPECT_EQ(expected->material, hits[i].material);
+        }
+    }
+}
+
+TEST(SCENE, PacketsSameHitsAsSingleRays) {
+    std::mt19937                 random(5);
+    std::vector<world::Hittable> hittables;
+    world::Scene                 scene;
+    addRandomObjects(hittables, scene, random);
+    scene.build();
+
+    for (uint32_t size : {1u, 4u, 37u, 64u}) {
+        for (int i = 0; i < 200; i++) {
+            // coherent rays from one point into a narrow cone, as primary rays of a camera
+            accel::RayPacket coherent;
+            const Vector3df  origin = randomVector(random, -12.0f, 12.0f);
+            const Vector3df  target = randomVector(random, -5.0f, 5.0f);
+            for (uint32_t j = 0; j < size; j++) {
+                Vector3df direction = target + randomVector(random, -1.0f, 1.0f) - origin;
+                direction.normalize();
+                coherent.add(Ray3df{origin, direction});
+            }
+            expectSameHitsAsSingleRays(scene, coherent);
+
+            // incoherent rays, which diverge right away
+            accel::RayPacket incoherent;
+            for (uint32_t j = 0; j < size; j++) {
+                Vector3df direction = randomVector(random, -1.0f, 1.0f);
+                direction.normalize();
+                incoherent.add(Ray3df{randomVector(random, -12.0f, 12.0f), direction});
+            }
+            expectSameHitsAsSingleRays(scene, incoherent);
+        }
+    }
+}
+
+TEST(SCENE, PacketRespectsTMax) {
+    auto             scene = world::createScene<world::Scene>();
+    accel::RayPacket packet;
+    for (int i = 0; i < 16; i++) {
+        packet.add(Ray3df{{0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, -1.0f}}, 1.0f);
+    }
+    world::Hit hits[accel::RayPacket::MAX_SIZE];
+
+    EXPECT_EQ(0u, scene.intersect(packet, hits));
+}
+
+TEST(SCENE, UpdateAfterReplacingObjects) {
+    std::mt19937                 random(13);
+    std::vector<world::Hittable> hittables;
+    world::Scene                 scene;
+    std::vector<Vector3df>       centers;
+    for (int i = 0; i < 500; i++) {
+        world::Material material;
+        material.shininess = static_cast<float>(i);
+        centers.push_back(randomVector(random, -10.0f, 10.0f));
+        const world::SphereObject sphere(centers.back(), 0.3f, material);
+        EXPECT_EQ(static_cast<uint32_t>(i), scene.emplace_back(sphere));
+        hittables.emplace_back(sphere);
+    }
+    for (int i = 0; i < 500; i++) {
+        world::Material material;
+        material.shininess = static_cast<float>(500 + i);
+        const Vector3df       corner = randomVector(random, -10.0f, 10.0f);
+        world::TriangleObject triangle(corner, corner + randomVector(random, -1.0f, 1.0f),
+                                       corner + randomVector(random, -1.0f, 1.0f), material);
+        scene.emplace_back(triangle);
+        hittables.emplace_back(triangle);
+    }
+    scene.build();
+
+    auto expectSameHits = [&]() {
+        for (int i = 0; i < 2000; i++) {
+            Vector3df direction = randomVector(random, -1.0f, 1.0f);
+            direction.normalize();
+            const Ray3df ray{randomVector(random, -12.0f, 12.0f), direction};
+
+            auto expected = world::findClosestHit(ray, hittables);
+            auto actual   = world::findClosestHit(ray, scene);
+            ASSERT_EQ(expected.has_value(), actual.has_value());
+            if (expected.has_value()) {
+                EXPECT_FLOAT_EQ(expected->t, actual->t);
+                EXPECT_EQ(expected->material->shininess, actual->material->shininess);
+                EXPECT_EQ(world::occluded(ray, actual->t * 0.999f, hittables),
+                          world::occluded(ray, actual->t * 0.999f, scene));
+            }
+        }
+    };
+
+    // moves spheres and triangles by the offset, the hittables along
+    auto move = [&](int count, float offset) {
+        for (int i = 0; i < count; i++) {
+            const auto id = static_cast<uint32_t>(random() % 500);
+            world::Material material;
+            material.shininess = static_cast<float>(id);
+            centers[id]        = centers[id] + randomVector(random, -offset, offset);
+            const world::SphereObject sphere(centers[id], 0.3f, material);
+            scene.replace(id, sphere);
+            hittables[id] = world::Hittable(sphere);
+
+            const auto&     batch    = scene.batch<world::TriangleObject>();
+            const auto      triangle = batch.objects()[batch.ids().position(id)];
+            const Vector3df a        = triangle.geometry().get_a();
+            const Vector3df shift    = randomVector(random, -offset, offset);
+            world::TriangleObject moved(a + shift, a + triangle.geometry().get_edge_ab() + shift,
+                                        a + triangle.geometry().get_edge_ac() + shift,
+                                        triangle.material());
+            scene.replace(id, moved);
+            hittables[500 + id] = world::Hittable(moved);
+        }
+    };
+
+    move(5, 0.05f);
+    const auto refitted = scene.update();
+    EXPECT_EQ(0u, refitted.rebuiltSubtrees);
+    expectSameHits();
+
+    move(20, 15.0f);
+    const auto rebuilt = scene.update();
+    EXPECT_GT(rebuilt.rebuiltSubtrees, 0u);
+    expectSameHits();
+
+    // the ids still find the objects after the reordering
+    const auto& spheres = scene.batch<world::SphereObject>();
+    for (uint32_t id = 0; id < 500; id++) {
+        EXPECT_EQ(static_cast<float>(id),
+                  spheres.objects()[spheres.ids().position(id)].material().shininess);
+    }
+}
+
+}  // namespace
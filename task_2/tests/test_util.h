@@ -0,0 +1,84 @@
+#pragma once
+
+#include <random>
+#include <vector>
+
+#include "math.h"
+#include "mesh.h"
+#include "world.h"
+#include "gtest/gtest.h"
+
+// Helpers shared by the tests
+namespace rt::test {
+
+// a vector with components uniformly distributed in [minimum, maximum)
+inline Vector3df randomVector(std::mt19937& random, float minimum, float maximum) {
+    std::uniform_real_distribution<float> distribution(minimum, maximum);
+    return Vector3df{distribution(random), distribution(random), distribution(random)};
+}
+
+// checks that the components are equal up to a few units in the last place
+inline void expectVector(const Vector3df& expected, const Vector3df& actual) {
+    for (size_t i = 0; i < 3; i++) {
+        EXPECT_FLOAT_EQ(expected.vector[i], actual.vector[i]);
+    }
+}
+
+// checks that the components differ by at most the tolerance
+inline void expectNear(const Vector3df& expected, const Vector3df& actual, float tolerance) {
+    for (size_t i = 0; i < 3; i++) {
+        EXPECT_NEAR(expected.vector[i], actual.vector[i], tolerance);
+    }
+}
+
+// returns the distance of the closest intersection of the ray with the object
+inline float hitDistance(const world::Hittable& object, const Ray3df& ray) {
+    float     t;
+    Vector3df normal;
+    EXPECT_TRUE(object.intersect(ray, t, normal));
+    return t;
+}
+
+// checks that the hierarchy finds the same object as the linear scan over the same objects
+inline void expectSameHits(const world::SceneBvh& scene, const std::vector<Ray3df>& rays) {
+    for (const auto& ray : rays) {
+        auto expected = world::findVisibleObject(ray, scene.objects());
+        auto actual   = world::findVisibleObject(ray, scene);
+
+        ASSERT_EQ(expected.has_value(), actual.has_value());
+        if (!expected.has_value()) {
+            continue;
+        }
+        const auto& expectedObject = expected.value().get();
+        const auto& actualObject   = actual.value().get();
+        if (&expectedObject != &actualObject) {
+            // two objects at the same distance, e.g. on the shared edge of two triangles
+            EXPECT_FLOAT_EQ(hitDistance(expectedObject, ray), hitDistance(actualObject, ray));
+        }
+    }
+}
+
+// checks that both meshes find the same intersections, returns the number of rays hitting
+inline int expectSameHits(const world::Mesh& expected, const world::Mesh& actual,
+                          const std::vector<Ray3df>& rays) {
+    int hits = 0;
+    for (const Ray3df& ray : rays) {
+        Intersection_Context<float, 3> expectedContext, actualContext;
+        const bool                     found = expected.intersects(ray, expectedContext);
+        if (found != actual.intersects(ray, actualContext)) {
+            ADD_FAILURE() << "only one of the meshes is hit";
+            continue;
+        }
+        if (found) {
+            hits++;
+            EXPECT_EQ(expectedContext.t, actualContext.t);
+            for (size_t k = 0; k < 3; k++) {
+                EXPECT_EQ(expectedContext.normal[k], actualContext.normal[k]);
+            }
+            EXPECT_TRUE(actual.occludes(ray, actualContext.t * 1.001f));
+        }
+    }
+    return hits;
+}
+
+}  // namespace rt::test
@@ -0,0 +1,134 @@
+#include "triangle_soa.h"
+#include "test_util.h"
+#include "gtest/gtest.h"
+
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+using namespace rt;
+using test::randomVector;
+
+namespace {
+
+// the levels the processor running the test supports
+std::vector<simd::Level> supportedLevels() {
+    std::vector<simd::Level> levels;
+    for (auto level : {simd::Level::Scalar, simd::Level::Sse, simd::Level::Avx2}) {
+        if (level <= simd::detectLevel()) {
+            levels.push_back(level);
+        }
+    }
+    return levels;
+}
+
+}  // namespace
+
+TEST(SIMD, LevelNames) {
+    EXPECT_STREQ("scalar", simd::levelName(simd::Level::Scalar));
+    EXPECT_STREQ("sse", simd::levelName(simd::Level::Sse));
+    EXPECT_STREQ("avx2", simd::levelName(simd::Level::Avx2));
+    EXPECT_LE(simd::activeLevel(), simd::detectLevel());
+}
+
+TEST(TRIANGLE_SOA, EmptyRange) {
+    accel::TriangleSoA triangles;
+    accel::TriangleHit hit;
+    float              tMax = std::numeric_limits<float>::infinity();
+    Ray3df             ray{{0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, -1.0f}};
+
+    for (auto level : supportedLevels()) {
+        EXPECT_FALSE(triangles.intersect(level, 0, 0, ray, tMax, hit));
+    }
+}
+
+TEST(TRIANGLE_SOA, ClosestOfRange) {
+    accel::TriangleSoA triangles;
+    // triangles in front of each other, facing the ray, at z = -1 ... -11
+    for (int i = 10; i >= 0; i--) {
+        const float z = -1.0f - static_cast<float>(i);
+        triangles.add(PrecomputedTriangle3df({-1.0f, -1.0f, z}, {1.0f, -1.0f, z}, {0.0f, 1.0f, z}));
+    }
+    Ray3df ray{{0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, -1.0f}};
+
+    for (auto level : supportedLevels()) {
+        SCOPED_TRACE(simd::levelName(level));
+        for (uint32_t first = 0; first < triangles.size(); first++) {
+            for (uint32_t count = 1; first + count <= triangles.size(); count++) {
+                accel::TriangleHit hit;
+                float              tMax = std::numeric_limits<float>::infinity();
+                ASSERT_TRUE(triangles.intersect(level, first, count, ray, tMax, hit));
+                // the last triangle of the range is the closest one
+                EXPECT_EQ(first + count - 1, hit.index);
+                EXPECT_NEAR(12.0f - static_cast<float>(first + count), hit.t, 1e-5f);
+                EXPECT_FLOAT_EQ(hit.t, tMax);
+            }
+        }
+
+        // tMax limits the search
+        accel::TriangleHit hit;
+        float              tMax = 0.5f;
+        EXPECT_FALSE(triangles.intersect(level, 0, triangles.size(), ray, tMax, hit));
+    }
+}
+
+TEST(TRIANGLE_SOA, SameIntersectionsAsPrecomputedTriangle) {
+    std::mt19937 random(7);
+
+    std::vector<PrecomputedTriangle3df> reference;
+    accel::TriangleSoA                  triangles;
+    for (int i = 0; i < 64; i++) {
+        const Vector3df a = randomVector(random, -5.0f, 5.0f);
+        reference.emplace_back(a, a + randomVector(random, -2.0f, 2.0f),
+                               a + randomVector(random, -2.0f, 2.0f));
+        triangles.add(reference.back());
+    }
+
+    int hits = 0;
+    for (int i = 0; i < 2000; i++) {
+        // aimed into the cloud of triangles, so many rays hit
+        Vector3df origin    = randomVector(random, -8.0f, 8.0f);
+        Vector3df direction = randomVector(random, -4.0f, 4.0f) - origin;
+        direction.normalize();
+        Ray3df ray{origin, direction};
+
+        std::uniform_int_distribution<uint32_t> firstDistribution(0, 63);
+        const uint32_t                          first = firstDistribution(random);
+        std::uniform_int_distribution<uint32_t> countDistribution(0, 64 - first);
+        const uint32_t                          count = countDistribution(random);
+
+        float    expectedT     = std::numeric_limits<float>::infinity();
+        uint32_t expectedIndex = 0;
+        float    expectedU = 0.0f, expectedV = 0.0f;
+        for (uint32_t j = first; j < first + count; j++) {
+            Intersection_Context<float, 3> context;
+            if (reference[j].intersects(ray, context) && context.t > 0 && context.t < expectedT) {
+                expectedT     = context.t;
+                expectedIndex = j;
+                expectedU     = context.u;
+                expectedV     = context.v;
+            }
+        }
+
+        for (auto level : supportedLevels()) {
+            SCOPED_TRACE(simd::levelName(level));
+            accel::TriangleHit hit;
+            float              tMax  = std::numeric_limits<float>::infinity();
+            const bool         found = triangles.intersect(level, first, count, ray, tMax, hit);
+            ASSERT_EQ(std::isfinite(expectedT), found);
+            if (found) {
+                EXPECT_EQ(expectedIndex, hit.index);
+                EXPECT_NEAR(expectedT, hit.t, 1e-4f * std::max(1.0f, expectedT));
+                EXPECT_NEAR(expectedU, hit.u, 1e-4f);
+                EXPECT_NEAR(expectedV, hit.v, 1e-4f);
+                hits++;
+            }
+
+            // the any hit query finds a hit before the closest one only if there is none
+            EXPECT_EQ(found, triangles.occluded(level, first, count, ray, expectedT * 1.001f));
+            EXPECT_FALSE(triangles.occluded(level, first, count, ray, expectedT * 0.999f));
+        }
+    }
+    EXPECT_GT(hits, 300);
+}